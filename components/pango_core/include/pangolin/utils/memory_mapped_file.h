@@ -0,0 +1,88 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/platform.h>
+
+#include <cstddef>
+#include <string>
+
+namespace pangolin
+{
+
+// Read-only mapping of a region of a file into memory.
+// offset need not be page aligned; the mapping is widened internally and
+// Data() points at the requested byte.
+class PANGOLIN_EXPORT MemoryMappedFile
+{
+public:
+    static constexpr size_t to_end = static_cast<size_t>(-1);
+
+    MemoryMappedFile();
+
+    MemoryMappedFile(const std::string& filename, size_t offset = 0, size_t length = to_end);
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    ~MemoryMappedFile();
+
+    // Returns false if the file could not be opened or mapped.
+    bool Open(const std::string& filename, size_t offset = 0, size_t length = to_end);
+
+    void Close();
+
+    bool IsOpen() const
+    {
+        return _data != nullptr;
+    }
+
+    const unsigned char* Data() const
+    {
+        return _data;
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    // Size of the whole underlying file at the time of mapping.
+    size_t FileSize() const
+    {
+        return _file_size;
+    }
+
+private:
+    const unsigned char* _data;
+    size_t _size;
+    size_t _file_size;
+
+    void* _map_base;
+    size_t _map_size;
+};
+
+}
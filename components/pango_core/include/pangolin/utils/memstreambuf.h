@@ -52,4 +52,35 @@ protected:
     }
 };
 
+// Read-only streambuf over existing memory, e.g. a file mapping.
+// Does not copy or take ownership of the data.
+struct memreadbuf : public std::streambuf
+{
+public:
+    memreadbuf(const unsigned char* data, size_t size)
+    {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir way, std::ios_base::openmode which) override
+    {
+        if(!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+        char* base = way == std::ios_base::beg ? eback() :
+                     way == std::ios_base::end ? egptr() : gptr();
+        char* target = base + off;
+        if(target < eback() || target > egptr()) return pos_type(off_type(-1));
+
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
 }
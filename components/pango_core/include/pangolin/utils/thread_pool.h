@@ -0,0 +1,144 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/platform.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pangolin
+{
+
+// Fixed set of worker threads which run queued tasks in order of submission.
+// Destruction waits for all queued tasks to complete.
+class PANGOLIN_EXPORT ThreadPool
+{
+public:
+    // num_threads of 0 uses one thread per hardware thread.
+    explicit ThreadPool(size_t num_threads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t NumThreads() const
+    {
+        return threads.size();
+    }
+
+    // Queue f() to run on a worker. The future holds its result or exception.
+    template<typename F>
+    auto Submit(F&& f) -> std::future<decltype(f())>
+    {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        Enqueue([task](){ (*task)(); });
+        return result;
+    }
+
+    // Call f(begin, end) over sub-ranges of [begin, end) no smaller than
+    // grain, using the workers and the calling thread. Returns once all have
+    // completed, rethrowing the first exception. Safe to call from a task.
+    template<typename F>
+    void ParallelFor(size_t begin, size_t end, F&& f, size_t grain = 1)
+    {
+        if(begin >= end) return;
+
+        struct Shared
+        {
+            std::atomic<size_t> next;
+            size_t end, chunk, num_chunks;
+            std::mutex lock;
+            std::condition_variable cond;
+            size_t done = 0;
+            std::exception_ptr error;
+        };
+
+        const size_t n = end - begin;
+        auto shared = std::make_shared<Shared>();
+        shared->next = begin;
+        shared->end = end;
+        shared->chunk = std::max(grain, (n + 4*NumThreads()) / (4*NumThreads() + 1));
+        shared->num_chunks = (n + shared->chunk - 1) / shared->chunk;
+
+        // Take chunks until none are left. Workers may only start once the
+        // caller has already finished, which is fine.
+        auto work = [shared, &f]() {
+            size_t completed = 0;
+            std::exception_ptr error;
+            for(size_t b = shared->next.fetch_add(shared->chunk); b < shared->end; b = shared->next.fetch_add(shared->chunk)) {
+                if(!error) {
+                    try {
+                        f(b, std::min(b + shared->chunk, shared->end));
+                    } catch(...) {
+                        error = std::current_exception();
+                    }
+                }
+                ++completed;
+            }
+            if(completed) {
+                std::lock_guard<std::mutex> l(shared->lock);
+                if(error && !shared->error) shared->error = error;
+                shared->done += completed;
+                if(shared->done == shared->num_chunks) shared->cond.notify_all();
+            }
+        };
+
+        const size_t helpers = std::min(NumThreads(), shared->num_chunks - 1);
+        for(size_t i=0; i < helpers; ++i) {
+            Enqueue(work);
+        }
+        work();
+
+        std::unique_lock<std::mutex> l(shared->lock);
+        shared->cond.wait(l, [&](){ return shared->done == shared->num_chunks; });
+        if(shared->error) std::rethrow_exception(shared->error);
+    }
+
+private:
+    void Enqueue(std::function<void()> task);
+    void Run();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool stop;
+};
+
+}
@@ -33,6 +33,8 @@
 
 #include <pangolin/platform.h>
 #include <thread>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 
@@ -44,21 +46,84 @@
 namespace pangolin
 {
 
+// Statistics for sizing threadedfilebuf buffers. If producer_waits is non-zero,
+// the buffer filled up and writers were blocked.
+struct ThreadedFileBufStats
+{
+    // Writes which can be in flight at once. Greater than 1 only when writes
+    // are queued through io_uring.
+    size_t queue_depth = 1;
+    size_t writes = 0;
+    size_t bytes_written = 0;
+    int64_t total_write_latency_us = 0;
+    int64_t max_write_latency_us = 0;
+    size_t max_writes_in_flight = 0;
+    size_t max_queued_bytes = 0;
+    size_t producer_waits = 0;
+    int64_t producer_wait_us = 0;
+    // Bytes given to write_pinned which are written from where they are,
+    // rather than copied into the buffer
+    size_t pinned_bytes = 0;
+
+    double mean_write_latency_us() const {
+        return writes ? double(total_write_latency_us) / writes : 0.0;
+    }
+};
+
 class PANGOLIN_EXPORT threadedfilebuf : public std::streambuf
 {
 public:
     ~threadedfilebuf();
     threadedfilebuf();
-    threadedfilebuf(const std::string& filename, size_t buffer_size_bytes);
-    
-    void open(const std::string& filename, size_t buffer_size_bytes);
+    threadedfilebuf(const std::string& filename, size_t buffer_size_bytes, size_t queue_depth = 1, size_t preallocate_bytes = 0);
+
+    // On Linux, queue_depth > 1 keeps up to queue_depth writes in flight
+    // through io_uring where the kernel supports it. preallocate_bytes
+    // reserves file space in chunks of that size ahead of the writes. Any
+    // reserved space beyond the end of the file is released on close.
+    void open(const std::string& filename, size_t buffer_size_bytes, size_t queue_depth = 1, size_t preallocate_bytes = 0);
     void close();
     void force_close();
-    
+
+    // Queue num_bytes from data to be written after what has been streamed so
+    // far. Whole blocks of data are written from where they are, without a
+    // copy, and pin is held until then. Where writes must be aligned (direct
+    // i/o), only blocks aligned both in memory and in the file qualify.
+    void write_pinned(const char* data, std::streamsize num_bytes, std::shared_ptr<const void> pin);
+
+    // Alignment in memory and in the file needed for write_pinned to avoid a copy.
+    size_t write_alignment() const;
+
+    ThreadedFileBufStats stats() const;
+
     void operator()();
     
 protected:
+    struct write_queue;
+
+    struct pinned_buffer
+    {
+        const char* data;
+        std::streamsize size;
+        std::shared_ptr<const void> pin;
+        // Bytes streamed through the ring buffer before this one
+        int64_t ring_pos;
+    };
+
+    struct write_chunk
+    {
+        const char* data = nullptr;
+        std::streamsize size = 0;
+        bool pinned = false;
+    };
+
     void soft_close();
+    void run_queued();
+    bool next_write(std::streamsize ring_skip, size_t pinned_skip, bool flush, write_chunk& chunk) const;
+    void release_ring(std::streamsize bytes);
+    void reserve(int64_t file_end);
+    void trim_reserved();
+    void record_write(std::streamsize bytes, int64_t latency_us, size_t in_flight);
 
     //! Override streambuf::xsputn for asynchronous write
     std::streamsize xsputn(const char * s, std::streamsize n) override;
@@ -76,16 +141,28 @@ protected:
 #else
     std::filebuf file;
 #endif
+    std::unique_ptr<write_queue> queue;
+    int64_t file_pos;
+    int64_t preallocated;
+    int64_t preallocate_chunk;
 
     char* mem_buffer;
     std::streamsize mem_size;
     std::streamsize mem_max_size;
     std::streamsize mem_start;
     std::streamsize mem_end;
+    std::streamsize mem_submitted;
+    int64_t ring_in;
+    int64_t ring_out;
+
+    std::deque<pinned_buffer> pinned;
+    std::streamsize pinned_size;
 
     std::streampos input_pos;
     
-    std::mutex update_mutex;
+    ThreadedFileBufStats write_stats;
+
+    mutable std::mutex update_mutex;
     std::condition_variable cond_queued;
     std::condition_variable cond_dequeued;
     std::thread write_thread;
@@ -0,0 +1,179 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/utils/memory_mapped_file.h>
+
+#ifdef _WIN_
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+
+namespace pangolin
+{
+
+MemoryMappedFile::MemoryMappedFile()
+    : _data(nullptr), _size(0), _file_size(0), _map_base(nullptr), _map_size(0)
+{
+}
+
+MemoryMappedFile::MemoryMappedFile(const std::string& filename, size_t offset, size_t length)
+    : _data(nullptr), _size(0), _file_size(0), _map_base(nullptr), _map_size(0)
+{
+    Open(filename, offset, length);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN_
+
+bool MemoryMappedFile::Open(const std::string& filename, size_t offset, size_t length)
+{
+    Close();
+
+    HANDLE file = CreateFileA(
+        filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if(file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size) || static_cast<size_t>(file_size.QuadPart) <= offset) {
+        CloseHandle(file);
+        return false;
+    }
+    _file_size = static_cast<size_t>(file_size.QuadPart);
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping) {
+        return false;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const size_t granularity = info.dwAllocationGranularity;
+    const size_t map_offset = offset - (offset % granularity);
+    const size_t size = std::min(length, _file_size - offset);
+    const size_t map_size = size + (offset - map_offset);
+
+    void* base = MapViewOfFile(
+        mapping, FILE_MAP_READ,
+        static_cast<DWORD>(static_cast<uint64_t>(map_offset) >> 32),
+        static_cast<DWORD>(map_offset & 0xFFFFFFFF),
+        map_size
+    );
+    CloseHandle(mapping);
+    if(!base) {
+        return false;
+    }
+
+    _map_base = base;
+    _map_size = map_size;
+    _data = static_cast<const unsigned char*>(base) + (offset - map_offset);
+    _size = size;
+    return true;
+}
+
+void MemoryMappedFile::Close()
+{
+    if(_map_base) {
+        UnmapViewOfFile(_map_base);
+    }
+    _map_base = nullptr;
+    _map_size = 0;
+    _data = nullptr;
+    _size = 0;
+    _file_size = 0;
+}
+
+#else // _WIN_
+
+bool MemoryMappedFile::Open(const std::string& filename, size_t offset, size_t length)
+{
+    Close();
+
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd == -1) {
+        return false;
+    }
+
+    struct stat sbuf;
+    if(fstat(fd, &sbuf) == -1 || static_cast<size_t>(sbuf.st_size) <= offset) {
+        ::close(fd);
+        return false;
+    }
+    _file_size = static_cast<size_t>(sbuf.st_size);
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t map_offset = offset - (offset % page_size);
+    const size_t size = std::min(length, _file_size - offset);
+    const size_t map_size = size + (offset - map_offset);
+
+    void* base = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(map_offset));
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if(base == MAP_FAILED) {
+        return false;
+    }
+
+    _map_base = base;
+    _map_size = map_size;
+    _data = static_cast<const unsigned char*>(base) + (offset - map_offset);
+    _size = size;
+    return true;
+}
+
+void MemoryMappedFile::Close()
+{
+    if(_map_base) {
+        munmap(_map_base, _map_size);
+    }
+    _map_base = nullptr;
+    _map_size = 0;
+    _data = nullptr;
+    _size = 0;
+    _file_size = 0;
+}
+
+#endif // _WIN_
+
+}
@@ -27,9 +27,13 @@
 
 #include <pangolin/utils/threadedfilebuf.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/log.h>
 #include <pangolin/utils/sigstate.h>
+#include <pangolin/utils/timer.h>
 
+#include <algorithm>
 #include <cstring>
+#include <deque>
 #include <stdexcept>
 
 #ifdef USE_POSIX_FILE_IO
@@ -40,6 +44,17 @@
 // Optionally use direct file i/o to avoid the cache.
 #define USE_DIRECT_FILE_IO
 #define POSIX_BLOCK_SIZE 4096
+
+// Use io_uring (via raw syscalls) to keep several direct writes in flight.
+#if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#    define USE_IO_URING
+#  endif
+#endif
 #endif
 
 using namespace std;
@@ -72,20 +87,170 @@ void free_buffer(char* mem_buffer)
     delete mem_buffer;
 #endif
 }
+
+std::streamsize buffer_size(std::streamsize requested_bytes)
+{
+#ifdef USE_DIRECT_FILE_IO
+    // Keep every block in the ring aligned for direct writes
+    return ((requested_bytes + POSIX_BLOCK_SIZE - 1) / POSIX_BLOCK_SIZE) * POSIX_BLOCK_SIZE;
+#else
+    return requested_bytes;
+#endif
+}
 }
 
+#ifdef USE_IO_URING
+// Split large writes so that several can be in flight at once.
+const std::streamsize max_queued_write_bytes = 8*1024*1024;
+
+// Minimal io_uring submission / completion queue for vectored writes.
+struct threadedfilebuf::write_queue
+{
+    struct request
+    {
+        iovec iov;
+        basetime submitted;
+        bool pinned;
+        bool done;
+    };
+
+    write_queue() : fd(-1), depth(0) {}
+
+    ~write_queue()
+    {
+        if(fd != -1) {
+            if(sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+            if(cq_ring != MAP_FAILED) munmap(cq_ring, cq_ring_size);
+            if(sqes != MAP_FAILED) munmap(sqes, sqes_size);
+            ::close(fd);
+        }
+    }
+
+    bool open(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if(fd < 0) {
+            // Not supported by this kernel, or disallowed.
+            fd = -1;
+            return false;
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sq_ring = mmap(0, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_ring = mmap(0, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes = mmap(0, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sq_ring);
+        char* cq = static_cast<char*>(cq_ring);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        depth = entries;
+        return true;
+    }
+
+    // Submit write of chunk at file offset, returning the request.
+    request& submit(int filenum, const write_chunk& chunk, int64_t offset)
+    {
+        in_flight.push_back({{const_cast<char*>(chunk.data), static_cast<size_t>(chunk.size)}, TimeNow(), chunk.pinned, false});
+
+        const unsigned tail = *sq_tail;
+        const unsigned idx = tail & sq_mask;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes)[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_WRITEV;
+        sqe.fd = filenum;
+        sqe.addr = reinterpret_cast<uint64_t>(&in_flight.back().iov);
+        sqe.len = 1;
+        sqe.off = static_cast<uint64_t>(offset);
+        sqe.user_data = next_id++;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        enter(1, 0);
+        return in_flight.back();
+    }
+
+    // Block until at least one request completes, then mark completed requests.
+    void wait()
+    {
+        enter(0, 1);
+
+        unsigned head = *cq_head;
+        const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for(; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+            request& r = in_flight[static_cast<size_t>(cqe.user_data - front_id)];
+            if(cqe.res < 0 || static_cast<size_t>(cqe.res) != r.iov.iov_len) {
+                throw std::runtime_error("Unable to write data.");
+            }
+            r.done = true;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    void pop()
+    {
+        in_flight.pop_front();
+        ++front_id;
+    }
+
+    void enter(unsigned to_submit, unsigned min_complete)
+    {
+        const unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        while(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0) < 0) {
+            if(errno != EINTR) {
+                throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(errno)));
+            }
+        }
+    }
+
+    int fd;
+    unsigned depth;
+    void* sq_ring = MAP_FAILED;
+    void* cq_ring = MAP_FAILED;
+    void* sqes = MAP_FAILED;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe* cqes;
+
+    // References to requests are stable under push_back / pop_front
+    std::deque<request> in_flight;
+    uint64_t front_id = 0;
+    uint64_t next_id = 0;
+};
+#else
+struct threadedfilebuf::write_queue {};
+#endif
+
 threadedfilebuf::threadedfilebuf()
-    : mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), should_run(false), is_pipe(false)
+    : file_pos(0), preallocated(0), preallocate_chunk(0), mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), mem_submitted(0), ring_in(0), ring_out(0), pinned_size(0), should_run(false), is_pipe(false)
 {
 }
 
-threadedfilebuf::threadedfilebuf(const std::string& filename, size_t buffer_size_bytes )
-    : mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), should_run(false), is_pipe(pangolin::IsPipe(filename))
+threadedfilebuf::threadedfilebuf(const std::string& filename, size_t buffer_size_bytes, size_t queue_depth, size_t preallocate_bytes)
+    : file_pos(0), preallocated(0), preallocate_chunk(0), mem_buffer(0), mem_size(0), mem_max_size(0), mem_start(0), mem_end(0), mem_submitted(0), ring_in(0), ring_out(0), pinned_size(0), should_run(false), is_pipe(pangolin::IsPipe(filename))
 {
-    open(filename, buffer_size_bytes);
+    open(filename, buffer_size_bytes, queue_depth, preallocate_bytes);
 }
 
-void threadedfilebuf::open(const std::string& filename, size_t buffer_size_bytes)
+void threadedfilebuf::open(const std::string& filename, size_t buffer_size_bytes, size_t queue_depth, size_t preallocate_bytes)
 {
     is_pipe = pangolin::IsPipe(filename);
 
@@ -119,11 +284,36 @@ void threadedfilebuf::open(const std::string& filename, size_t buffer_size_bytes
         throw std::runtime_error("Unable to open '" + filename + "' for writing.");
     }
 
+    file_pos = 0;
+    preallocated = 0;
+    preallocate_chunk = is_pipe ? 0 : static_cast<int64_t>(preallocate_bytes);
+    write_stats = ThreadedFileBufStats();
+
+#ifdef USE_IO_URING
+    if(queue_depth > 1 && !is_pipe) {
+        queue.reset(new write_queue());
+        if(!queue->open(static_cast<unsigned>(queue_depth))) {
+            // Fall back to a single synchronous write at a time.
+            queue.reset();
+        }
+    }
+#else
+    (void)queue_depth;
+#endif
+#ifdef USE_IO_URING
+    write_stats.queue_depth = queue ? queue->depth : 1;
+#endif
+
     mem_buffer = 0;
     mem_size = 0;
     mem_start = 0;
     mem_end = 0;
-    mem_max_size = static_cast<std::streamsize>(buffer_size_bytes);
+    mem_submitted = 0;
+    ring_in = 0;
+    ring_out = 0;
+    pinned_size = 0;
+    input_pos = 0;
+    mem_max_size = buffer_size(static_cast<std::streamsize>(buffer_size_bytes));
     mem_buffer = allocate_buffer(mem_max_size);
     should_run = true;
     write_thread = std::thread(std::ref(*this));
@@ -140,6 +330,10 @@ void threadedfilebuf::close()
         write_thread.join();
     }
 
+    queue.reset();
+    pinned.clear();
+    pinned_size = 0;
+
     if(mem_buffer)
     {
         free_buffer(mem_buffer);
@@ -147,7 +341,10 @@ void threadedfilebuf::close()
     }
 
 #ifdef USE_POSIX_FILE_IO
-    ::close(filenum);
+    if(filenum != -1) {
+        trim_reserved();
+        ::close(filenum);
+    }
     filenum = -1;
 #else
     file.close();
@@ -157,7 +354,10 @@ void threadedfilebuf::close()
 void threadedfilebuf::soft_close()
 {
     // Forces sputn to write no bytes and exit early, results in lost data
+    std::unique_lock<std::mutex> lock(update_mutex);
     mem_size = 0;
+    pinned.clear();
+    pinned_size = 0;
 }
 
 void threadedfilebuf::force_close()
@@ -171,29 +371,139 @@ threadedfilebuf::~threadedfilebuf()
     close();
 }
 
+size_t threadedfilebuf::write_alignment() const
+{
+#ifdef USE_DIRECT_FILE_IO
+    return POSIX_BLOCK_SIZE;
+#else
+    return 1;
+#endif
+}
+
+ThreadedFileBufStats threadedfilebuf::stats() const
+{
+    std::unique_lock<std::mutex> lock(update_mutex);
+    return write_stats;
+}
+
+void threadedfilebuf::record_write(std::streamsize bytes, int64_t latency_us, size_t in_flight)
+{
+    // Expects update_mutex to be held
+    ++write_stats.writes;
+    write_stats.bytes_written += static_cast<size_t>(bytes);
+    write_stats.total_write_latency_us += latency_us;
+    write_stats.max_write_latency_us = std::max(write_stats.max_write_latency_us, latency_us);
+    write_stats.max_writes_in_flight = std::max(write_stats.max_writes_in_flight, in_flight);
+}
+
+void threadedfilebuf::reserve(int64_t file_end)
+{
+#ifdef USE_POSIX_FILE_IO
+    if(preallocate_chunk && file_end > preallocated) {
+        const int64_t size = std::max(preallocate_chunk, file_end - preallocated);
+        // Keep the file size as is so that readers only see what we've written.
+        if(fallocate(filenum, FALLOC_FL_KEEP_SIZE, preallocated, size) == 0) {
+            preallocated += size;
+        }else{
+            // Unsupported by this file system
+            preallocate_chunk = 0;
+        }
+    }
+#else
+    (void)file_end;
+#endif
+}
+
+void threadedfilebuf::trim_reserved()
+{
+#ifdef USE_POSIX_FILE_IO
+    // Release space reserved beyond the end of what was written, e.g. when a
+    // recording is stopped early. Truncating to the current size frees
+    // blocks allocated with FALLOC_FL_KEEP_SIZE.
+    if(preallocated > file_pos) {
+        if(ftruncate(filenum, file_pos) != 0) {
+            pango_print_warn("Unable to release space reserved beyond the end of file.\n");
+        }
+        preallocated = file_pos;
+    }
+#endif
+}
+
+void threadedfilebuf::release_ring(std::streamsize bytes)
+{
+    // Expects update_mutex to be held
+    mem_size -= bytes;
+    mem_start = (mem_start + bytes) % mem_max_size;
+    ring_out += bytes;
+}
+
+bool threadedfilebuf::next_write(std::streamsize ring_skip, size_t pinned_skip, bool flush, write_chunk& chunk) const
+{
+    // Expects update_mutex to be held
+    chunk = write_chunk();
+
+    std::streamsize limit = mem_size - ring_skip;
+    bool to_pinned = false;
+    if(pinned_skip < pinned.size()) {
+        const pinned_buffer& p = pinned[pinned_skip];
+        limit = p.ring_pos - (ring_out + ring_skip);
+        if(limit == 0) {
+            chunk = {p.data, p.size, true};
+            return true;
+        }
+        // Data up to a pinned buffer ends on a block boundary
+        to_pinned = true;
+    }
+
+    if(limit > 0) {
+        const std::streamsize start = (mem_start + ring_skip) % mem_max_size;
+        chunk = {mem_buffer + start, std::min(limit, mem_max_size - start), false};
+        if(!to_pinned && !flush) {
+            // Direct writes are limited to block size boundaries
+            chunk.size -= chunk.size % static_cast<std::streamsize>(write_alignment());
+        }
+    }
+    return chunk.size > 0;
+}
+
 std::streamsize threadedfilebuf::xsputn(const char* data, std::streamsize num_bytes)
 {
-    if( num_bytes > mem_max_size ) {
+    // A partial block may have to wait in the buffer for more data, so leave
+    // room for it alongside the new data.
+    const std::streamsize align = static_cast<std::streamsize>(write_alignment());
+    if( num_bytes > mem_max_size - (align - 1) ) {
         std::unique_lock<std::mutex> lock(update_mutex);
-        // Wait until queue is empty
-        while( mem_size > 0 ) {
+
+        // Wait until queue is empty, aside from any partial block
+        while( mem_size >= align || mem_submitted > 0 || !pinned.empty() ) {
             cond_dequeued.wait(lock);
         }
 
-        // Allocate bigger buffer
+        // Allocate bigger buffer, keeping what remains aligned as in the file
+        const std::streamsize new_max_size = buffer_size(num_bytes * 4);
+        const std::streamsize new_start = static_cast<std::streamsize>(file_pos % align);
+        char* new_buffer = allocate_buffer(new_max_size);
+        for(std::streamsize i=0; i < mem_size; ++i) {
+            new_buffer[new_start + i] = mem_buffer[(mem_start + i) % mem_max_size];
+        }
         free_buffer(mem_buffer);
-        mem_start = 0;
-        mem_end = 0;
-        mem_max_size = num_bytes * 4;
-        mem_buffer = allocate_buffer(mem_max_size);
+        mem_buffer = new_buffer;
+        mem_start = new_start;
+        mem_end = new_start + mem_size;
+        mem_max_size = new_max_size;
     }
 
     {
         std::unique_lock<std::mutex> lock(update_mutex);
 
         // wait until there is space to write into buffer
-        while( mem_size + num_bytes > mem_max_size ) {
-            cond_dequeued.wait(lock);
+        if( mem_size + num_bytes > mem_max_size ) {
+            const basetime start = TimeNow();
+            while( mem_size + num_bytes > mem_max_size ) {
+                cond_dequeued.wait(lock);
+            }
+            ++write_stats.producer_waits;
+            write_stats.producer_wait_us += TimeDiff_us(start, TimeNow());
         }
 
         // add image to end of mem_buffer
@@ -216,6 +526,9 @@ std::streamsize threadedfilebuf::xsputn(const char* data, std::streamsize num_by
 
         if(mem_end == mem_max_size)
             mem_end = 0;
+
+        ring_in += num_bytes;
+        write_stats.max_queued_bytes = std::max(write_stats.max_queued_bytes, static_cast<size_t>(mem_size + pinned_size));
     }
 
     cond_queued.notify_one();
@@ -224,6 +537,44 @@ std::streamsize threadedfilebuf::xsputn(const char* data, std::streamsize num_by
     return num_bytes;
 }
 
+void threadedfilebuf::write_pinned(const char* data, std::streamsize num_bytes, std::shared_ptr<const void> pin)
+{
+    // Only whole blocks which are aligned both in memory and in the file
+    // can be written directly. The rest is copied into the buffer.
+    const std::streamsize align = static_cast<std::streamsize>(write_alignment());
+    const std::streamsize head = (align - static_cast<std::streamsize>(reinterpret_cast<uintptr_t>(data) % align)) % align;
+    const std::streamsize body = num_bytes > head ? (num_bytes - head) - (num_bytes - head) % align : 0;
+    if(body == 0 || (std::streamoff(input_pos) + head) % align != 0) {
+        xsputn(data, num_bytes);
+        return;
+    }
+
+    if(head) xsputn(data, head);
+
+    {
+        std::unique_lock<std::mutex> lock(update_mutex);
+
+        // Pinned data also counts towards our buffer limit
+        if( pinned_size > 0 && pinned_size + body > mem_max_size ) {
+            const basetime start = TimeNow();
+            while( pinned_size > 0 && pinned_size + body > mem_max_size ) {
+                cond_dequeued.wait(lock);
+            }
+            ++write_stats.producer_waits;
+            write_stats.producer_wait_us += TimeDiff_us(start, TimeNow());
+        }
+
+        pinned.push_back({data + head, body, std::move(pin), ring_in});
+        pinned_size += body;
+        write_stats.pinned_bytes += static_cast<size_t>(body);
+        write_stats.max_queued_bytes = std::max(write_stats.max_queued_bytes, static_cast<size_t>(mem_size + pinned_size));
+    }
+    cond_queued.notify_one();
+    input_pos += body;
+
+    if(head + body < num_bytes) xsputn(data + head + body, num_bytes - head - body);
+}
+
 int threadedfilebuf::overflow(int c)
 {
     const std::streamsize num_bytes = 1;
@@ -240,6 +591,7 @@ int threadedfilebuf::overflow(int c)
         mem_buffer[mem_end] = c;
         mem_end += num_bytes;
         mem_size += num_bytes;
+        ring_in += num_bytes;
 
         if(mem_end == mem_max_size)
             mem_end = 0;
@@ -264,7 +616,10 @@ std::streampos threadedfilebuf::seekoff(
 
 void threadedfilebuf::operator()()
 {
-    std::streamsize data_to_write = 0;
+    if(queue) {
+        run_queued();
+        return;
+    }
 
     while(true)
     {
@@ -283,32 +638,25 @@ void threadedfilebuf::operator()()
             }
         }
 
+        write_chunk chunk;
         {
             std::unique_lock<std::mutex> lock(update_mutex);
 
             // Wait until there is data to write or we are stopping the write thread.
-#ifdef USE_DIRECT_FILE_IO
-            while(mem_size < POSIX_BLOCK_SIZE && should_run) {
-#else
-            while(mem_size == 0 && should_run) {
-#endif
+            while(!next_write(0, 0, !should_run, chunk) && should_run) {
                 cond_queued.wait(lock);
             }
 
-            if (mem_size == 0 && !should_run)
+            if (chunk.size == 0 && !should_run)
             {
                 return;
             }
 
-            data_to_write =
-                    (mem_start < mem_end) ?
-                        mem_end - mem_start :
-                        mem_max_size - mem_start;
+            mem_submitted = chunk.pinned ? 0 : chunk.size;
         }
 
-        // Adjust write size if appropriate.
 #ifdef USE_DIRECT_FILE_IO
-        if (!should_run && data_to_write < POSIX_BLOCK_SIZE)
+        if (!should_run && chunk.size % POSIX_BLOCK_SIZE)
         {
             // Stopping the write thread - allow non-direct write of final block.
             int fopts = fcntl(filenum, F_GETFL);
@@ -318,37 +666,129 @@ void threadedfilebuf::operator()()
                 throw std::runtime_error("fcntl failed with result: " + std::to_string(result));
             }
         }
-        else
-        {
-            // Direct writes are limited to block size boundaries
-            data_to_write = data_to_write - (data_to_write%POSIX_BLOCK_SIZE);
-        }
 #endif
 
         // Write data through to disk.
+        reserve(file_pos + chunk.size);
+        const basetime start = TimeNow();
 #ifdef USE_POSIX_FILE_IO
-        int bytes_written = ::write(filenum, mem_buffer + mem_start, data_to_write);
+        int bytes_written = ::write(filenum, chunk.data, chunk.size);
         if(bytes_written == -1)
         {
             throw std::runtime_error("Unable to write data.");
         }
 #else
         std::streamsize bytes_written =
-                file.sputn(mem_buffer + mem_start, data_to_write );
+                file.sputn(chunk.data, chunk.size );
 #endif
 
         {
             std::unique_lock<std::mutex> lock(update_mutex);
 
-            mem_size -= bytes_written;
-            mem_start += bytes_written;
-
-            if(mem_start == mem_max_size)
-                mem_start = 0;
+            record_write(bytes_written, TimeDiff_us(start, TimeNow()), 1);
+            file_pos += bytes_written;
+            mem_submitted = 0;
+
+            if(chunk.pinned) {
+                pinned_buffer& p = pinned.front();
+                p.data += bytes_written;
+                p.size -= bytes_written;
+                pinned_size -= bytes_written;
+                if(p.size == 0) pinned.pop_front();
+            }else{
+                release_ring(bytes_written);
+            }
         }
 
         cond_dequeued.notify_all();
     }
 }
 
+void threadedfilebuf::run_queued()
+{
+#ifdef USE_IO_URING
+    // Pinned buffers from the front which have been submitted
+    size_t pinned_submitted = 0;
+
+    while(true)
+    {
+        write_chunk chunk;
+        int64_t offset = 0;
+        bool finished = false;
+
+        {
+            std::unique_lock<std::mutex> lock(update_mutex);
+
+            // Wait for a block to write, unless there are writes to complete.
+            while(queue->in_flight.empty() && !next_write(mem_submitted, pinned_submitted, false, chunk) && should_run) {
+                cond_queued.wait(lock);
+            }
+
+            if(queue->in_flight.size() < queue->depth && next_write(mem_submitted, pinned_submitted, false, chunk)) {
+                if(chunk.pinned) {
+                    ++pinned_submitted;
+                }else{
+                    chunk.size = std::min(chunk.size, max_queued_write_bytes);
+                    mem_submitted += chunk.size;
+                }
+                offset = file_pos;
+                file_pos += chunk.size;
+            }else{
+                chunk = write_chunk();
+            }
+            finished = !should_run && queue->in_flight.empty() && chunk.size == 0;
+        }
+
+        if(chunk.size) {
+            reserve(offset + chunk.size);
+            queue->submit(filenum, chunk, offset);
+        }else if(!queue->in_flight.empty()) {
+            queue->wait();
+
+            // Release completed writes in order
+            std::unique_lock<std::mutex> lock(update_mutex);
+            const size_t in_flight = queue->in_flight.size();
+            while(!queue->in_flight.empty() && queue->in_flight.front().done) {
+                const write_queue::request& r = queue->in_flight.front();
+                const std::streamsize bytes = static_cast<std::streamsize>(r.iov.iov_len);
+                record_write(bytes, TimeDiff_us(r.submitted, TimeNow()), in_flight);
+                if(r.pinned) {
+                    pinned_size -= bytes;
+                    pinned.pop_front();
+                    --pinned_submitted;
+                }else{
+                    release_ring(bytes);
+                    mem_submitted -= bytes;
+                }
+                queue->pop();
+            }
+            lock.unlock();
+            cond_dequeued.notify_all();
+        }else if(finished) {
+            break;
+        }
+    }
+
+    // Write the remaining partial block without O_DIRECT
+    std::unique_lock<std::mutex> lock(update_mutex);
+    if(mem_size > 0) {
+        int fopts = fcntl(filenum, F_GETFL);
+        if (fcntl(filenum, F_SETFL, fopts & ~O_DIRECT) == -1) {
+            throw std::runtime_error("fcntl failed.");
+        }
+        while(mem_size > 0) {
+            const std::streamsize bytes = std::min(mem_size, mem_max_size - mem_start);
+            if(pwrite(filenum, mem_buffer + mem_start, bytes, file_pos) != bytes) {
+                throw std::runtime_error("Unable to write data.");
+            }
+            file_pos += bytes;
+            release_ring(bytes);
+        }
+        mem_end = mem_start;
+    }
+    lock.unlock();
+    cond_dequeued.notify_all();
+#endif
+}
+
 }
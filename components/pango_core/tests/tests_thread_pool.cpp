@@ -0,0 +1,53 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <pangolin/utils/thread_pool.h>
+
+TEST_CASE("Thread pool runs submitted tasks")
+{
+    pangolin::ThreadPool pool(3);
+    REQUIRE(pool.NumThreads() == 3);
+
+    std::vector<std::future<int>> results;
+    for(int i=0; i < 100; ++i) {
+        results.push_back(pool.Submit([i](){ return i*i; }));
+    }
+    for(int i=0; i < 100; ++i) {
+        REQUIRE(results[i].get() == i*i);
+    }
+
+    auto failed = pool.Submit([](){ throw std::runtime_error("task"); });
+    REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+}
+
+TEST_CASE("Thread pool parallel for covers range once")
+{
+    pangolin::ThreadPool pool(4);
+
+    for(size_t n : {size_t(1), size_t(7), size_t(1000)}) {
+        std::vector<std::atomic<int>> visits(n);
+        pool.ParallelFor(0, n, [&](size_t b, size_t e){
+            for(size_t i=b; i < e; ++i) ++visits[i];
+        });
+        for(auto& v : visits) REQUIRE(v == 1);
+    }
+
+    // Nested use from within tasks mustn't deadlock
+    std::atomic<size_t> total(0);
+    pool.ParallelFor(0, 8, [&](size_t b, size_t e){
+        for(size_t i=b; i < e; ++i) {
+            pool.ParallelFor(0, 100, [&](size_t b2, size_t e2){ total += e2 - b2; });
+        }
+    });
+    REQUIRE(total == 800);
+
+    REQUIRE_THROWS_AS(pool.ParallelFor(0, 100, [](size_t, size_t){ throw std::runtime_error("body"); }), std::runtime_error);
+}
@@ -31,6 +31,7 @@
 
 #include <pangolin/gl/glfont.h>
 #include <pangolin/gl/colour.h>
+#include <pangolin/gl/gltextbatch.h>
 #include <pangolin/var/var.h>
 #include <pangolin/display/view.h>
 #include <pangolin/handler/handler.h>
@@ -81,7 +82,7 @@ public:
     void Keyboard(View&, unsigned char key, int x, int y, bool pressed) override;
 
 private:
-    void DrawLine(const ConsoleView::Line& l, int carat);
+    void DrawLine(const ConsoleView::Line& l, GLfloat x, GLfloat y, int carat);
 
     void ProcessOutputLines();
 
@@ -92,6 +93,7 @@ private:
     std::shared_ptr<InterpreterInterface> interpreter;
 
     GlFont& font;
+    GlTextBatch text_batch;
 
     int carat;
     Line current_line;
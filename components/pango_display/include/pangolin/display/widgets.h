@@ -31,6 +31,7 @@
 #include <pangolin/var/var.h>
 #include <pangolin/handler/handler.h>
 #include <pangolin/gl/glfont.h>
+#include <pangolin/gl/gltextbatch.h>
 
 #include <functional>
 
@@ -54,6 +55,7 @@ private:
 
     sigslot::scoped_connection var_added_connection;
     std::string auto_register_var_prefix;
+    GlTextBatch text_batch;
 };
 
 template<typename T>
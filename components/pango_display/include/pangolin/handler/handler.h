@@ -39,6 +39,8 @@
 #include <Eigen/Core>
 #endif
 
+#include <memory>
+
 #ifdef _OSX_
 #define PANGO_DFLT_HANDLER3D_ZF (1.0f/50.0f)
 #else
@@ -50,6 +52,7 @@ namespace pangolin
 
 // Forward declarations
 struct View;
+struct HandlerDepthReads;
 
 /// Input Handler base class.
 /// Virtual methods which recurse into sub-displays.
@@ -72,15 +75,30 @@ struct PANGOLIN_EXPORT HandlerScroll : Handler
 struct PANGOLIN_EXPORT HandlerBase3D : Handler
 {
     HandlerBase3D(OpenGlRenderState& cam_state, AxisDirection enforce_up=AxisNone, float trans_scale=0.01f, float zoom_fraction= PANGO_DFLT_HANDLER3D_ZF);
+    ~HandlerBase3D();
 
     virtual bool ValidWinDepth(GLprecision depth);
     virtual void PixelUnproject( View& view, GLprecision winx, GLprecision winy, GLprecision winz, GLprecision Pc[3]);
     virtual void GetPosNormal(View& view, int x, int y, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3], GLprecision default_z = 1.0);
     virtual void GetPosNormalImpl(View& view, int x, int y, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3], GLprecision default_z, float *zs);
 
+    // By default the depth around the cursor is read back through pixel
+    // pack buffers without waiting for the GPU, and GetPosNormal() uses the
+    // latest read to complete near the cursor, typically from the previous
+    // frame. Reads are also made as the mouse hovers. Disable to wait for a
+    // read on every call instead. Contexts without fences (GL 3.2 or
+    // ARB_sync) and GLES always wait.
+    void SetAsyncDepthPicking(bool async);
+
+    // World space bounds of the scene. When no asynchronous depth read near
+    // the cursor has completed, the cursor ray is intersected with these
+    // rather than falling back to the last picked depth.
+    void SetSceneBounds(const GLprecision min_w[3], const GLprecision max_w[3]);
+
     void Keyboard(View&, unsigned char key, int x, int y, bool pressed);
     void Mouse(View&, MouseButton button, int x, int y, bool pressed, int button_state);
     void MouseMotion(View&, int x, int y, int button_state);
+    void PassiveMouseMotion(View&, int x, int y, int button_state);
     void Special(View&, InputSpecial inType, float x, float y, float p1, float p2, float p3, float p4, int button_state);
     
 #ifdef USE_EIGEN
@@ -94,6 +112,23 @@ struct PANGOLIN_EXPORT HandlerBase3D : Handler
     }
 
 protected:
+    // True iff depth reads should be asynchronous, setting them up for the
+    // current context if needed
+    bool UseAsyncDepthReads();
+
+    // Start reading depth around (x,y), unless too many reads are pending
+    void RequestDepthRead(int x, int y);
+
+    // Consume any depth reads which have completed, without waiting
+    void CollectDepthReads(View& view);
+
+    // Fill in p, Pc from a world point Pw, as seen from the current camera.
+    // Returns false if it lies outside of the view frustum depth range.
+    bool SetPickedPoint(int x, int y, const GLprecision Pw_in[3], const GLprecision nw_in[3], GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3]);
+
+    bool PickFromDepthReads(int x, int y, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3]);
+    bool PickFromSceneBounds(View& view, int x, int y, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3]);
+
     OpenGlRenderState* cam_state;
     const static int hwin = 8;
     AxisDirection enforce_up;
@@ -110,6 +145,15 @@ protected:
     GLprecision n[3];
 
     int funcKeyState;
+
+    // Reads for the context they were last used with, made on first use.
+    // Null when depth is read synchronously.
+    bool async_depth_picking;
+    std::unique_ptr<HandlerDepthReads> depth_reads;
+
+    bool has_scene_bounds;
+    GLprecision scene_min_w[3];
+    GLprecision scene_max_w[3];
 };
 
 #ifndef HAVE_GLES
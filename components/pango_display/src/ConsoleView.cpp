@@ -118,13 +118,13 @@ bool ConsoleView::IsShown() const
     return show && !hiding;
 }
 
-void ConsoleView::DrawLine(const ConsoleView::Line& l, int carat=-1)
+void ConsoleView::DrawLine(const ConsoleView::Line& l, GLfloat x, GLfloat y, int carat=-1)
 {
-    glColour(line_colours[l.linetype]);
-    l.text.Draw();
+    text_batch.Add(l.text, x, y, line_colours[l.linetype]);
     if(carat >= 0) {
-        const double w = font.Text(l.text.str.substr(0,carat)).Width();
-        glDrawLine(w,-2,w,font.Height()-4);
+        const GLfloat w = x + font.Text(l.text.str.substr(0,carat)).Width();
+        glColour(line_colours[l.linetype]);
+        glDrawLine(w,y-2,w,y+font.Height()-4);
     }
 }
 
@@ -175,14 +175,15 @@ void ConsoleView::Render()
     glDisableClientState(GL_VERTEX_ARRAY);
 
 
+    // Lines are drawn together once queued, skipping those above the view
     const GLfloat line_space = font.Height();
-    glTranslatef(10.0f, 10.0f + bottom*v.h, 0.0f );
-    DrawLine(current_line, carat);
-    glTranslatef(0.0f, line_space, 0.0f);
-    for(size_t l=0; l < line_buffer.size(); ++l) {
-        DrawLine(line_buffer[l]);
-        glTranslatef(0.0f, line_space, 0.0f);
+    GLfloat y = 10.0f + bottom*v.h;
+    DrawLine(current_line, 10.0f, y, carat);
+    for(size_t l=0; l < line_buffer.size() && y < v.h; ++l) {
+        y += line_space;
+        DrawLine(line_buffer[l], 10.0f, y);
     }
+    text_batch.Flush();
 
 #ifndef HAVE_GLES
     glPopAttrib();
@@ -31,6 +31,9 @@
 
 #include "pangolin_gl.h"
 
+#include <cstdio>
+#include <cstring>
+
 namespace pangolin
 {
 
@@ -38,6 +41,89 @@ namespace {
     constexpr float sentinal = std::numeric_limits<float>::quiet_NaN();
 }
 
+#ifndef HAVE_GLES
+namespace {
+// Depth reads are fenced, which needs GL 3.2 or ARB_sync, into pixel pack
+// buffers, which need GL 2.1. False without a current context.
+bool AsyncDepthReadsSupported()
+{
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if(!version || std::sscanf(version, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    if(major > 3 || (major == 3 && minor >= 2)) {
+        return true;
+    }
+    if(major < 2 || (major == 2 && minor < 1)) {
+        return false;
+    }
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    return extensions && std::strstr(extensions, "GL_ARB_sync");
+}
+}
+
+// Ring of depth reads into pixel pack buffers, completed in order. The GL
+// objects belong to the context current when this was created.
+struct HandlerDepthReads
+{
+    static constexpr size_t num_reads = 4;
+
+    HandlerDepthReads()
+        : window(GetCurrentContext() ? GetCurrentContext()->window : nullptr)
+    {
+    }
+
+    struct Read
+    {
+        GlBufferData pbo;
+        GLsync fence = 0;
+        int winx = 0;
+        int winy = 0;
+        // Camera the depth was rendered with
+        OpenGlMatrix projection;
+        OpenGlMatrix modelview;
+    };
+
+    // True iff the context which owns these reads is current
+    bool ContextIsCurrent() const
+    {
+        const std::shared_ptr<WindowInterface> w = window.lock();
+        return w && GetCurrentContext() && GetCurrentContext()->window == w;
+    }
+
+    ~HandlerDepthReads()
+    {
+        // Objects can only be deleted through their own context. Otherwise
+        // they are abandoned, and go with the context when it is destroyed.
+        const bool current = ContextIsCurrent();
+        for(Read& r : reads) {
+            if(current) {
+                if(r.fence) glDeleteSync(r.fence);
+            }else{
+                r.pbo.bo = 0;
+            }
+        }
+    }
+
+    std::weak_ptr<WindowInterface> window;
+
+    Read reads[num_reads];
+    size_t first = 0;
+    size_t pending = 0;
+
+    // Latest completed read
+    bool has_result = false;
+    bool result_hit = false;
+    int result_winx = 0;
+    int result_winy = 0;
+    GLprecision result_Pw[3];
+    GLprecision result_nw[3];
+};
+#else
+struct HandlerDepthReads {};
+#endif
+
 void Handler::Keyboard(View& d, unsigned char key, int x, int y, bool pressed)
 {
     View* child = d.FindChild(x,y);
@@ -124,11 +210,58 @@ HandlerBase3D::HandlerBase3D(OpenGlRenderState& cam_state, AxisDirection enforce
       Pw{sentinal,sentinal,sentinal},
       Pc{sentinal,sentinal,sentinal},
       n{sentinal,sentinal,sentinal},
-      funcKeyState(0)
+      funcKeyState(0),
+      async_depth_picking(true),
+      has_scene_bounds(false),
+      scene_min_w{0.0,0.0,0.0},
+      scene_max_w{0.0,0.0,0.0}
 {
     SetZero<3,1>(rot_center);
 }
 
+HandlerBase3D::~HandlerBase3D()
+{
+}
+
+void HandlerBase3D::SetAsyncDepthPicking(bool async)
+{
+    async_depth_picking = async;
+    if(!async) {
+        depth_reads.reset();
+    }
+}
+
+bool HandlerBase3D::UseAsyncDepthReads()
+{
+#ifndef HAVE_GLES
+    if(!async_depth_picking) {
+        return false;
+    }
+    if(depth_reads && depth_reads->ContextIsCurrent()) {
+        return true;
+    }
+
+    // Reads are made on first use, or again for a different context
+    depth_reads.reset();
+    if(AsyncDepthReadsSupported()) {
+        depth_reads.reset(new HandlerDepthReads());
+        if(!depth_reads->ContextIsCurrent()) {
+            depth_reads.reset();
+        }
+    }
+    return bool(depth_reads);
+#else
+    return false;
+#endif
+}
+
+void HandlerBase3D::SetSceneBounds(const GLprecision min_w[3], const GLprecision max_w[3])
+{
+    std::copy(min_w, min_w+3, scene_min_w);
+    std::copy(max_w, max_w+3, scene_max_w);
+    has_scene_bounds = true;
+}
+
 void HandlerBase3D::Keyboard(View&, unsigned char /*key*/, int /*x*/, int /*y*/, bool /*pressed*/)
 {
     // TODO: hooks for reset / changing mode (perspective / ortho etc)
@@ -183,8 +316,180 @@ void HandlerBase3D::GetPosNormalImpl(pangolin::View& view, int winx, int winy, G
     LieApplySO3(nw,T_wc,nc);
 }
 
+void HandlerBase3D::RequestDepthRead(int winx, int winy)
+{
+#ifndef HAVE_GLES
+    HandlerDepthReads& dr = *depth_reads;
+    if(dr.pending == HandlerDepthReads::num_reads) {
+        // The GPU is behind, so this position will be superseded anyway
+        return;
+    }
+
+    const int zl = (hwin*2+1);
+    HandlerDepthReads::Read& r = dr.reads[(dr.first + dr.pending) % HandlerDepthReads::num_reads];
+    if(!r.pbo.IsValid()) {
+        r.pbo.Reinitialise(GlPixelPackBuffer, zl*zl*sizeof(GLfloat), GL_STREAM_READ);
+    }
+
+    GLint readid = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readid);
+    glReadBuffer(readid == 0 ? GL_FRONT : GL_COLOR_ATTACHMENT0);
+    r.pbo.Bind();
+    glReadPixels(winx-hwin,winy-hwin,zl,zl,GL_DEPTH_COMPONENT,GL_FLOAT,0);
+    r.pbo.Unbind();
+    r.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    r.winx = winx;
+    r.winy = winy;
+    r.projection = cam_state->GetProjectionMatrix();
+    r.modelview = cam_state->GetModelViewMatrix();
+    ++dr.pending;
+#else
+    PANGOLIN_UNUSED(winx);
+    PANGOLIN_UNUSED(winy);
+#endif
+}
+
+void HandlerBase3D::CollectDepthReads(View& view)
+{
+#ifndef HAVE_GLES
+    HandlerDepthReads& dr = *depth_reads;
+    const int zl = (hwin*2+1);
+    const int zsize = zl*zl;
+    GLfloat zs[zsize];
+
+    while(dr.pending) {
+        HandlerDepthReads::Read& r = dr.reads[dr.first];
+        const GLenum status = glClientWaitSync(r.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(status == GL_TIMEOUT_EXPIRED) break;
+
+        glDeleteSync(r.fence);
+        r.fence = 0;
+        dr.first = (dr.first + 1) % HandlerDepthReads::num_reads;
+        --dr.pending;
+        if(status == GL_WAIT_FAILED) continue;
+
+        r.pbo.Download(zs, sizeof(zs));
+
+        // Unproject with the camera the depth was rendered from
+        OpenGlRenderState* current = cam_state;
+        OpenGlRenderState at_read(r.projection, r.modelview);
+        cam_state = &at_read;
+        GLprecision rp[3], rPc[3];
+        GetPosNormalImpl(view, r.winx, r.winy, rp, dr.result_Pw, rPc, dr.result_nw, 1.0, zs);
+        cam_state = current;
+
+        dr.has_result = true;
+        dr.result_hit = ValidWinDepth(rp[2]);
+        dr.result_winx = r.winx;
+        dr.result_winy = r.winy;
+    }
+#else
+    PANGOLIN_UNUSED(view);
+#endif
+}
+
+bool HandlerBase3D::SetPickedPoint(int winx, int winy, const GLprecision Pw_in[3], const GLprecision nw_in[3], GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3])
+{
+    GLprecision T_cw[3*4];
+    LieSE3from4x4(T_cw, cam_state->GetModelViewMatrix().m);
+    GLprecision Pc_in[3];
+    LieApplySE3vec(Pc_in, T_cw, Pw_in);
+
+    // Window depth of Pc_in from the projection
+    const GLprecision* P = cam_state->GetProjectionMatrix().m;
+    const GLprecision clip_z = P[2]*Pc_in[0] + P[6]*Pc_in[1] + P[10]*Pc_in[2] + P[14];
+    const GLprecision clip_w = P[3]*Pc_in[0] + P[7]*Pc_in[1] + P[11]*Pc_in[2] + P[15];
+    const GLprecision winz = (clip_z / clip_w) * 0.5 + 0.5;
+    if( !(0 < winz && winz < 1) ) return false;
+
+    p[0] = winx; p[1] = winy; p[2] = winz;
+    std::copy(Pc_in, Pc_in+3, Pc);
+    std::copy(Pw_in, Pw_in+3, Pw);
+    std::copy(nw_in, nw_in+3, nw);
+    return true;
+}
+
+bool HandlerBase3D::PickFromDepthReads(int winx, int winy, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3])
+{
+#ifndef HAVE_GLES
+    const HandlerDepthReads& dr = *depth_reads;
+    if( dr.has_result && dr.result_hit &&
+        std::abs(dr.result_winx - winx) <= hwin && std::abs(dr.result_winy - winy) <= hwin )
+    {
+        return SetPickedPoint(winx, winy, dr.result_Pw, dr.result_nw, p, Pw, Pc, nw);
+    }
+#else
+    PANGOLIN_UNUSED(winx); PANGOLIN_UNUSED(winy);
+    PANGOLIN_UNUSED(p); PANGOLIN_UNUSED(Pw); PANGOLIN_UNUSED(Pc); PANGOLIN_UNUSED(nw);
+#endif
+    return false;
+}
+
+bool HandlerBase3D::PickFromSceneBounds(View& view, int winx, int winy, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3])
+{
+    if(!has_scene_bounds) return false;
+
+    // Ray between the near and far planes through the cursor, in world frame
+    GLprecision T_wc[3*4];
+    LieSE3from4x4(T_wc, cam_state->GetModelViewMatrix().Inverse().m );
+    GLprecision c_near[3], c_far[3], o[3], e[3], d[3];
+    PixelUnproject(view, winx, winy, 0.0, c_near);
+    PixelUnproject(view, winx, winy, 1.0, c_far);
+    LieApplySE3vec(o, T_wc, c_near);
+    LieApplySE3vec(e, T_wc, c_far);
+    MatSub<3,1>(d, e, o);
+
+    // Slab test for where the ray enters the box
+    GLprecision t_enter = 0.0;
+    GLprecision t_exit = 1.0;
+    int enter_axis = -1;
+    for(int i=0; i < 3; ++i) {
+        if(d[i] == 0) {
+            if(o[i] < scene_min_w[i] || o[i] > scene_max_w[i]) return false;
+            continue;
+        }
+        GLprecision t0 = (scene_min_w[i] - o[i]) / d[i];
+        GLprecision t1 = (scene_max_w[i] - o[i]) / d[i];
+        if(t0 > t1) std::swap(t0, t1);
+        if(t0 > t_enter) {
+            t_enter = t0;
+            enter_axis = i;
+        }
+        t_exit = std::min(t_exit, t1);
+    }
+
+    // Inside the bounds already, the far side is no better a guess than the
+    // last depth
+    if(enter_axis < 0 || t_enter > t_exit) return false;
+
+    GLprecision hit_w[3];
+    GLprecision hit_nw[3] = {0.0, 0.0, 0.0};
+    for(int i=0; i < 3; ++i) hit_w[i] = o[i] + t_enter * d[i];
+    hit_nw[enter_axis] = d[enter_axis] > 0 ? -1.0 : 1.0;
+    return SetPickedPoint(winx, winy, hit_w, hit_nw, p, Pw, Pc, nw);
+}
+
 void HandlerBase3D::GetPosNormal(pangolin::View& view, int winx, int winy, GLprecision p[3], GLprecision Pw[3], GLprecision Pc[3], GLprecision nw[3], GLprecision default_z)
 {
+    if(UseAsyncDepthReads()) {
+        CollectDepthReads(view);
+        RequestDepthRead(winx, winy);
+
+        if( PickFromDepthReads(winx, winy, p, Pw, Pc, nw) ||
+            PickFromSceneBounds(view, winx, winy, p, Pw, Pc, nw) )
+        {
+            return;
+        }
+
+        // As for a synchronous read which finds nothing under the cursor
+        const int zl = (hwin*2+1);
+        GLfloat zs[zl*zl];
+        std::fill(zs, zs+zl*zl, 1.0f);
+        GetPosNormalImpl(view, winx, winy, p, Pw, Pc, nw, default_z, zs);
+        return;
+    }
+
     const int zl = (hwin*2+1);
     const int zsize = zl*zl;
     GLfloat zs[zsize];
@@ -235,6 +540,18 @@ void HandlerBase3D::Mouse(View& display, MouseButton button, int x, int y, bool
     }
 }
 
+void HandlerBase3D::PassiveMouseMotion(View& display, int x, int y, int button_state)
+{
+    // Keep depth under the cursor fresh for the next interaction
+    if(UseAsyncDepthReads()) {
+        CollectDepthReads(display);
+        RequestDepthRead(x, y);
+    }
+
+    // Child views still track hover
+    Handler::PassiveMouseMotion(display, x, y, button_state);
+}
+
 void HandlerBase3D::MouseMotion(View& display, int x, int y, int button_state)
 {
     const GLprecision rf = 0.01;
@@ -55,9 +55,17 @@ const static GLfloat colour_dn[4] = {1.0f, 0.7f, 0.7f, 1.0f};
 // TODO: It doesn't look like this is doing anything meaningful right now...
 std::mutex display_mutex;
 
+// Text of the Panel being rendered is queued here, to be drawn together
+static GlTextBatch* panel_text_batch = nullptr;
+
 // Render at (x,y) in window coordinates.
 inline void DrawWindow(GlText& text, GLfloat x, GLfloat y, GLfloat z = 0.0)
 {
+    if(panel_text_batch) {
+        panel_text_batch->Add(text, std::floor(x), std::floor(y), Colour(colour_tx));
+        return;
+    }
+
     // Backup viewport
     GLint    view[4];
     glGetIntegerv(GL_VIEWPORT, view );
@@ -275,7 +283,13 @@ void Panel::Render()
     glRect(v);
     DrawShadowRect(v);
 
+    GlTextBatch* parent_text_batch = panel_text_batch;
+    panel_text_batch = &text_batch;
     RenderChildren();
+    panel_text_batch = parent_text_batch;
+
+    DisplayBase().ActivatePixelOrthographic();
+    text_batch.Flush();
 
 #ifndef HAVE_GLES
     glPopAttrib();
@@ -87,7 +87,7 @@ struct PlyPropertyDetails
     int num_items;
 
     bool isList() const {
-        return list_index_type > 0;
+        return list_index_type != PlyType_none;
     }
 };
 
@@ -129,7 +129,13 @@ struct PlyBuffer
     std::vector<unsigned char> data;
 };
 
-void ParsePlyAscii(pangolin::Geometry& /*geom*/, const PlyHeaderDetails& /*ply*/, std::istream& /*is*/);
+class ThreadPool;
+
+// Parse the element data which follows the header, held in [begin,end), for
+// each of the PLY encodings. Elements are parsed straight into the buffers of
+// geom, and large elements are split between the threads of pool, which may
+// be null. Items with lists must all share the same list lengths.
+void ParsePlyAscii(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool = nullptr);
 
 // Convert Seperate "x","y","z" attributes into a single "vertex" attribute
 void StandardizeXyzToVertex(pangolin::Geometry& geom);
@@ -139,12 +145,14 @@ void StandardizeMultiTextureFaceToXyzuv(pangolin::Geometry& geom);
 
 void Standardize(pangolin::Geometry& geom);
 
-void ParsePlyLE(pangolin::Geometry& geom, PlyHeaderDetails& ply, std::istream& is);
+void ParsePlyLE(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool = nullptr);
 
-void ParsePlyBE(pangolin::Geometry& /*geom*/, const PlyHeaderDetails& /*ply*/, std::istream& /*is*/);
+void ParsePlyBE(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool = nullptr);
 
 void AttachAssociatedTexturesPly(pangolin::Geometry& geom, const std::string& filename);
 
-pangolin::Geometry LoadGeometryPly(const std::string& filename);
+// Load PLY file, memory mapped where possible. num_threads of 0 uses one
+// thread per hardware thread for large files.
+pangolin::Geometry LoadGeometryPly(const std::string& filename, size_t num_threads = 0);
 
 }
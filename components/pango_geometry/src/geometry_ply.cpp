@@ -32,8 +32,17 @@
 #include <pangolin/utils/parse.h>
 #include <pangolin/utils/type_convert.h>
 #include <pangolin/utils/simple_math.h>
+#include <pangolin/utils/memory_mapped_file.h>
+#include <pangolin/utils/thread_pool.h>
 #include <pangolin/image/image_io.h>
 
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <locale>
+#include <sstream>
+#include <thread>
+
 namespace pangolin {
 
 #define FORMAT_STRING_LIST(x) #x,
@@ -54,6 +63,15 @@ const char* PlyTypeString[] = {
 
 PLY_GROUP_LIST(PANGOLIN_DEFINE_PARSE_TOKEN)
 
+// Geometry attributes have no double type, so reject such files up front
+// rather than part way through reading their data.
+void CheckPlyPropertyType(PlyType type)
+{
+    if(type == PlyType_double) {
+        throw std::runtime_error("PLY properties of type double are not supported.");
+    }
+}
+
 void ParsePlyHeader(PlyHeaderDetails& ply, std::istream& is)
 {
     // 'Active' element for property definitions.
@@ -99,12 +117,14 @@ void ParsePlyHeader(PlyHeaderDetails& ply, std::istream& is)
                     const PlyType idtype = ParseTokenPlyType(is);
                     ConsumeWhitespace(is);
                     const PlyType itemtype = ParseTokenPlyType(is);
+                    CheckPlyPropertyType(itemtype);
                     prop.list_index_type = idtype;
                     prop.type = itemtype;
                     prop.offset_bytes = el.stride_bytes;
                     prop.num_items = -1;
                     el.stride_bytes = -1;
                 }else{
+                    CheckPlyPropertyType(t);
                     prop.list_index_type = PlyType_none;
                     prop.type = t;
                     prop.offset_bytes = el.stride_bytes;
@@ -131,11 +151,6 @@ void ParsePlyHeader(PlyHeaderDetails& ply, std::istream& is)
     }
 }
 
-void ParsePlyAscii(pangolin::Geometry& /*geom*/, const PlyHeaderDetails& /*ply*/, std::istream& /*is*/)
-{
-    throw std::runtime_error("ASCII Ply loading not currently supported. Consider converting to binary.");
-}
-
 void AddVertexNormals(pangolin::Geometry& geom)
 {
     auto it_geom = geom.buffers.find("geometry");
@@ -344,107 +359,396 @@ void Standardize(pangolin::Geometry& geom)
     AddVertexNormals(geom);
 }
 
-inline int ReadGlIntType(PlyType type, std::istream& is)
+namespace {
+
+// Elements are split between threads in chunks of at least this many bytes
+const size_t ply_min_chunk_bytes = 1 << 20;
+
+template<typename F>
+void ForEachChunk(ThreadPool* pool, size_t begin, size_t end, size_t grain, F f)
+{
+    if(pool && end - begin > grain) {
+        pool->ParallelFor(begin, end, f, grain);
+    }else if(begin < end) {
+        f(begin, end);
+    }
+}
+
+bool HostIsLittleEndian()
 {
-    // TODO: This seems really dodgey...
-    // int may not be big enough and if the datatype is smaller will it be padded?
-    int v = 0;
-    is.read( (char*)&v, PlyTypeSizeBytes[type]);
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 1;
+}
+
+template<typename T>
+T LoadAs(const unsigned char* p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
     return v;
 }
 
-inline void ReadInto(std::vector<unsigned char>& vec, std::istream& is, size_t num_bytes)
+int64_t ReadPlyInteger(const unsigned char* p, PlyType type, bool swap)
 {
-    const size_t current_size = vec.size();
-    vec.resize(current_size + num_bytes);
-    is.read((char*)vec.data() + current_size, num_bytes);
+    unsigned char b[8];
+    const size_t size = PlyTypeSizeBytes[type];
+    std::memcpy(b, p, size);
+    if(swap) std::reverse(b, b + size);
+
+    switch (type) {
+    case PlyType_char:   return LoadAs<int8_t>(b);
+    case PlyType_uchar:  return LoadAs<uint8_t>(b);
+    case PlyType_short:  return LoadAs<int16_t>(b);
+    case PlyType_ushort: return LoadAs<uint16_t>(b);
+    case PlyType_int:    return LoadAs<int32_t>(b);
+    case PlyType_uint:   return LoadAs<uint32_t>(b);
+    default:
+        throw std::runtime_error("PLY list lengths must have integer type.");
+    }
 }
 
-void ParsePlyLE(pangolin::Geometry& geom, PlyHeaderDetails& ply, std::istream& is)
+void CheckListLength(const PlyPropertyDetails& prop, int64_t list_items)
 {
-    std::vector<uint8_t> buffer;
+    if(list_items != prop.num_items) {
+        throw std::runtime_error("PLY lists of differing lengths within an element are not supported.");
+    }
+}
 
-    for(auto& el : ply.elements) {
-        pangolin::Geometry::Element geom_el;
+// Lay out properties contiguously in memory, once the lengths of lists are known.
+void LayoutPlyElement(PlyElementDetails& el)
+{
+    el.stride_bytes = 0;
+    for(auto& prop : el.properties) {
+        prop.offset_bytes = el.stride_bytes;
+        el.stride_bytes += prop.num_items * PlyTypeSizeBytes[prop.type];
+    }
+}
 
-        if(el.stride_bytes > 0) {
-            // This will usually be the case for vertex buffers with a known number of attributes
-            PANGO_ASSERT(el.num_items > 0);
-            geom_el.Reinitialise(el.stride_bytes, el.num_items);
-            is.read((char*)geom_el.ptr, geom_el.Area());
-        }else {
-            // This will generally be the case for face data (containing a list of vertex indices)
-
-            // Reserve enough space for a list of quads
-            buffer.clear();
-            buffer.reserve(el.num_items * el.properties.size() * 4);
-
-            for(int i=0; i< el.num_items; ++i) {
-                size_t offset_bytes = 0;
-                for(auto& prop : el.properties) {
+void AddPlyElement(pangolin::Geometry& geom, const PlyElementDetails& el, pangolin::Geometry::Element&& geom_el)
+{
+    for(auto& prop : el.properties) {
+        Image<uint8_t> attrib(geom_el.ptr + prop.offset_bytes, prop.num_items, el.num_items, geom_el.pitch);
+        switch (prop.type) {
+        case PlyType_char:
+        case PlyType_uchar:
+            geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint8_t>();
+            break;
+        case PlyType_short:
+        case PlyType_ushort:
+            geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint16_t>();
+            break;
+        case PlyType_int:
+        case PlyType_uint:
+            geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint32_t>();
+            break;
+        case PlyType_float:
+            geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<float>();
+            break;
+        default:
+            throw std::runtime_error("Unsupported PLY data type");
+        }
+    }
+    if(el.name == "vertex") {
+        geom.buffers["geometry"] = std::move(geom_el);
+    }else if(el.name == "face") {
+        geom.objects.emplace("default", std::move(geom_el));
+    }else{
+        geom.buffers[el.name] = std::move(geom_el);
+    }
+}
+
+// Returns the end of the element's data
+const unsigned char* ParsePlyBinaryElement(pangolin::Geometry::Element& geom_el, PlyElementDetails& el, const unsigned char* begin, const unsigned char* end, bool swap, ThreadPool* pool)
+{
+    PANGO_ASSERT(el.num_items >= 0);
+    const size_t num_items = el.num_items;
+
+    // Items share list lengths, so take them from the first item. Every item
+    // then has the same size in the file.
+    size_t file_stride = 0;
+    bool has_lists = false;
+    for(auto& prop : el.properties) {
+        if(prop.isList()) {
+            has_lists = true;
+            prop.num_items = 0;
+            if(num_items) {
+                if(size_t(end - begin) < file_stride + PlyTypeSizeBytes[prop.list_index_type]) {
+                    throw std::runtime_error("PLY file is truncated.");
+                }
+                prop.num_items = (int)ReadPlyInteger(begin + file_stride, prop.list_index_type, swap);
+            }
+            file_stride += PlyTypeSizeBytes[prop.list_index_type];
+        }
+        file_stride += prop.num_items * PlyTypeSizeBytes[prop.type];
+    }
+
+    LayoutPlyElement(el);
+    if(size_t(end - begin) < file_stride * num_items) {
+        throw std::runtime_error("PLY file is truncated.");
+    }
+    geom_el.Reinitialise(el.stride_bytes, num_items);
+
+    const size_t grain = std::max<size_t>(1, ply_min_chunk_bytes / std::max<size_t>(1, file_stride));
+
+    if(!has_lists && !swap) {
+        // Rows are laid out in memory exactly as in the file
+        ForEachChunk(pool, 0, num_items, grain, [&](size_t i0, size_t i1){
+            std::memcpy(geom_el.RowPtr(i0), begin + i0*file_stride, (i1-i0)*file_stride);
+        });
+    }else{
+        ForEachChunk(pool, 0, num_items, grain, [&](size_t i0, size_t i1){
+            for(size_t i=i0; i < i1; ++i) {
+                const unsigned char* src = begin + i*file_stride;
+                unsigned char* dst = geom_el.RowPtr(i);
+                for(const auto& prop : el.properties) {
                     if(prop.isList()) {
-                        const int list_items = ReadGlIntType(prop.list_index_type, is);
-                        if(prop.num_items == -1) {
-                            prop.num_items = list_items;
-                            prop.offset_bytes = offset_bytes;
-                        }else{
-                            PANGO_ASSERT(prop.num_items == list_items);
+                        CheckListLength(prop, ReadPlyInteger(src, prop.list_index_type, swap));
+                        src += PlyTypeSizeBytes[prop.list_index_type];
+                    }
+                    const size_t type_size = PlyTypeSizeBytes[prop.type];
+                    const size_t num_bytes = prop.num_items * type_size;
+                    std::memcpy(dst + prop.offset_bytes, src, num_bytes);
+                    if(swap) {
+                        for(size_t b=0; b < num_bytes; b += type_size) {
+                            std::reverse(dst + prop.offset_bytes + b, dst + prop.offset_bytes + b + type_size);
                         }
                     }
-                    const size_t num_bytes = prop.num_items * PlyTypeSizeBytes[prop.type];
-                    ReadInto(buffer, is, num_bytes);
-                    offset_bytes += num_bytes;
+                    src += num_bytes;
                 }
             }
+        });
+    }
 
-            // Update element stride now we know
-            el.stride_bytes = 0;
-            for(auto& prop : el.properties) {
-                el.stride_bytes += prop.num_items * PlyTypeSizeBytes[prop.type];
-            }
+    return begin + file_stride * num_items;
+}
+
+void ParsePlyBinary(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, bool swap, ThreadPool* pool)
+{
+    for(auto& el : ply.elements) {
+        pangolin::Geometry::Element geom_el;
+        begin = ParsePlyBinaryElement(geom_el, el, begin, end, swap, pool);
+        AddPlyElement(geom, el, std::move(geom_el));
+    }
+
+    Standardize(geom);
+}
+
+// Lines of an ASCII PLY body, which has one element item per line
+struct PlyAsciiChunk
+{
+    const char* begin;
+    const char* end;
+    size_t first_line;
+    size_t lines;
+};
+
+// Split [begin,end) at line boundaries into chunks for each thread, and count their lines
+std::vector<PlyAsciiChunk> SplitPlyAsciiLines(const char* begin, const char* end, ThreadPool* pool)
+{
+    const size_t bytes = end - begin;
+    const size_t num_chunks = pool ? std::max<size_t>(1, std::min(4*(pool->NumThreads()+1), bytes / ply_min_chunk_bytes)) : 1;
+
+    std::vector<PlyAsciiChunk> chunks(num_chunks);
+    const char* p = begin;
+    for(size_t c=0; c < num_chunks; ++c) {
+        chunks[c].begin = p;
+        const char* q = (c+1 == num_chunks) ? end : std::max(p, begin + (c+1)*(bytes/num_chunks));
+        if(q < end) {
+            q = (const char*)std::memchr(q, '\n', end - q);
+            q = q ? q + 1 : end;
+        }
+        chunks[c].end = p = q;
+    }
 
-            geom_el.Reinitialise(el.stride_bytes, el.num_items);
-            PANGO_ASSERT(geom_el.SizeBytes() == buffer.size());
-            std::memcpy(geom_el.ptr, buffer.data(), buffer.size());
+    ForEachChunk(pool, 0, num_chunks, 1, [&](size_t c0, size_t c1){
+        for(size_t c=c0; c < c1; ++c) {
+            PlyAsciiChunk& chunk = chunks[c];
+            chunk.lines = std::count(chunk.begin, chunk.end, '\n');
+            if(chunk.end > chunk.begin && chunk.end[-1] != '\n') ++chunk.lines;
         }
+    });
+
+    size_t line = 0;
+    for(auto& chunk : chunks) {
+        chunk.first_line = line;
+        line += chunk.lines;
+    }
+    return chunks;
+}
+
+const char* SkipLines(const char* p, const char* end, size_t lines)
+{
+    for(; lines && p < end; --lines) {
+        p = (const char*)std::memchr(p, '\n', end - p);
+        p = p ? p + 1 : end;
+    }
+    return p;
+}
+
+// Find the next whitespace separated token on the current line, advancing p beyond it
+bool NextToken(const char*& p, const char* end, const char*& token, size_t& length)
+{
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    if(p == end || *p == '\n') return false;
+    token = p;
+    while(p < end && !std::isspace((unsigned char)*p)) ++p;
+    length = p - token;
+    return true;
+}
+
+const char* ExpectToken(const char*& p, const char* end, size_t& length)
+{
+    const char* token;
+    if(!NextToken(p, end, token, length)) {
+        throw std::runtime_error("ASCII PLY file has too few values on a line.");
+    }
+    return token;
+}
+
+template<typename T>
+void ParsePlyAsciiInteger(const char* token, size_t length, unsigned char* dst)
+{
+    T v;
+    const std::from_chars_result r = std::from_chars(token, token + length, v);
+    if(r.ec != std::errc() || r.ptr != token + length) {
+        throw std::runtime_error("Bad integer in ASCII PLY file: " + std::string(token, length));
+    }
+    std::memcpy(dst, &v, sizeof(T));
+}
+
+// PLY numbers always use '.', whatever the global locale
+template<typename T>
+void ParsePlyAsciiReal(const char* token, size_t length, unsigned char* dst)
+{
+    T v;
+#if defined(__cpp_lib_to_chars)
+    const std::from_chars_result r = std::from_chars(token, token + length, v);
+    const bool parsed = r.ec == std::errc() && r.ptr == token + length;
+#else
+    std::istringstream ss(std::string(token, length));
+    ss.imbue(std::locale::classic());
+    ss >> v;
+    const bool parsed = !ss.fail() && ss.peek() == std::char_traits<char>::eof();
+#endif
+    if(!parsed) {
+        throw std::runtime_error("Bad number in ASCII PLY file: " + std::string(token, length));
+    }
+    std::memcpy(dst, &v, sizeof(T));
+}
+
+void ParsePlyAsciiValue(const char* token, size_t length, PlyType type, unsigned char* dst)
+{
+    switch (type) {
+    case PlyType_char:   ParsePlyAsciiInteger<int8_t>(token, length, dst); break;
+    case PlyType_uchar:  ParsePlyAsciiInteger<uint8_t>(token, length, dst); break;
+    case PlyType_short:  ParsePlyAsciiInteger<int16_t>(token, length, dst); break;
+    case PlyType_ushort: ParsePlyAsciiInteger<uint16_t>(token, length, dst); break;
+    case PlyType_int:    ParsePlyAsciiInteger<int32_t>(token, length, dst); break;
+    case PlyType_uint:   ParsePlyAsciiInteger<uint32_t>(token, length, dst); break;
+    case PlyType_float:  ParsePlyAsciiReal<float>(token, length, dst); break;
+    default:
+        throw std::runtime_error("Unsupported PLY data type");
+    }
+}
+
+int64_t ParsePlyAsciiListLength(const char* token, size_t length, PlyType type)
+{
+    unsigned char v[8];
+    ParsePlyAsciiValue(token, length, type, v);
+    return ReadPlyInteger(v, type, false);
+}
 
+// Parse item on the line starting at p into dst
+void ParsePlyAsciiItem(const PlyElementDetails& el, const char* p, const char* end, unsigned char* dst)
+{
+    size_t length;
+    for(const auto& prop : el.properties) {
+        if(prop.isList()) {
+            const char* token = ExpectToken(p, end, length);
+            CheckListLength(prop, ParsePlyAsciiListLength(token, length, prop.list_index_type));
+        }
+        const size_t type_size = PlyTypeSizeBytes[prop.type];
+        for(int i=0; i < prop.num_items; ++i) {
+            const char* token = ExpectToken(p, end, length);
+            ParsePlyAsciiValue(token, length, prop.type, dst + prop.offset_bytes + i*type_size);
+        }
+    }
+}
+
+// Returns the line following the element
+size_t ParsePlyAsciiElement(pangolin::Geometry::Element& geom_el, PlyElementDetails& el, const std::vector<PlyAsciiChunk>& chunks, size_t first_line, ThreadPool* pool)
+{
+    PANGO_ASSERT(el.num_items >= 0);
+    const size_t num_items = el.num_items;
+    const size_t total_lines = chunks.back().first_line + chunks.back().lines;
+    if(total_lines < first_line + num_items) {
+        throw std::runtime_error("PLY file is truncated.");
+    }
+
+    // Items share list lengths, so take them from the first item
+    for(auto& prop : el.properties) {
+        if(prop.isList()) prop.num_items = 0;
+    }
+    if(num_items) {
+        const PlyAsciiChunk& chunk = *std::find_if(chunks.begin(), chunks.end(), [&](const PlyAsciiChunk& c){
+            return first_line < c.first_line + c.lines;
+        });
+        const char* p = SkipLines(chunk.begin, chunk.end, first_line - chunk.first_line);
+        size_t length;
         for(auto& prop : el.properties) {
-            Image<uint8_t> attrib(geom_el.ptr + prop.offset_bytes, prop.num_items, el.num_items, geom_el.pitch);
-            switch (prop.type) {
-            case PlyType_char:
-            case PlyType_uchar:
-                geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint8_t>();
-                break;
-            case PlyType_short:
-            case PlyType_ushort:
-                geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint16_t>();
-                break;
-            case PlyType_int:
-            case PlyType_uint:
-                geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<uint32_t>();
-                break;
-            case PlyType_float:
-                geom_el.attributes[prop.name] = attrib.UnsafeReinterpret<float>();
-                break;
-            default:
-                throw std::runtime_error("Unsupported PLY data type");
+            if(prop.isList()) {
+                const char* token = ExpectToken(p, chunk.end, length);
+                prop.num_items = (int)ParsePlyAsciiListLength(token, length, prop.list_index_type);
+            }
+            for(int i=0; i < prop.num_items; ++i) {
+                ExpectToken(p, chunk.end, length);
             }
         }
-        if(el.name == "vertex") {
-            geom.buffers["geometry"] = std::move(geom_el);
-        }else if(el.name == "face") {
-            geom.objects.emplace("default", std::move(geom_el));
-        }else{
-            geom.buffers[el.name] = std::move(geom_el);
+    }
+
+    LayoutPlyElement(el);
+    geom_el.Reinitialise(el.stride_bytes, num_items);
+
+    ForEachChunk(pool, 0, chunks.size(), 1, [&](size_t c0, size_t c1){
+        for(size_t c=c0; c < c1; ++c) {
+            const PlyAsciiChunk& chunk = chunks[c];
+            const size_t l0 = std::max(first_line, chunk.first_line);
+            const size_t l1 = std::min(first_line + num_items, chunk.first_line + chunk.lines);
+            const char* p = SkipLines(chunk.begin, chunk.end, l0 - std::min(l0, chunk.first_line));
+            for(size_t l=l0; l < l1; ++l) {
+                ParsePlyAsciiItem(el, p, chunk.end, geom_el.RowPtr(l - first_line));
+                p = SkipLines(p, chunk.end, 1);
+            }
         }
+    });
+
+    return first_line + num_items;
+}
+
+}
+
+void ParsePlyAscii(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool)
+{
+    const std::vector<PlyAsciiChunk> chunks = SplitPlyAsciiLines((const char*)begin, (const char*)end, pool);
+
+    size_t line = 0;
+    for(auto& el : ply.elements) {
+        pangolin::Geometry::Element geom_el;
+        line = ParsePlyAsciiElement(geom_el, el, chunks, line, pool);
+        AddPlyElement(geom, el, std::move(geom_el));
     }
 
     Standardize(geom);
 }
 
-void ParsePlyBE(pangolin::Geometry& /*geom*/, const PlyHeaderDetails& /*ply*/, std::istream& /*is*/)
+void ParsePlyLE(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool)
 {
-    throw std::runtime_error("Not implemented.");
+    ParsePlyBinary(geom, ply, begin, end, !HostIsLittleEndian(), pool);
+}
+
+void ParsePlyBE(pangolin::Geometry& geom, PlyHeaderDetails& ply, const unsigned char* begin, const unsigned char* end, ThreadPool* pool)
+{
+    ParsePlyBinary(geom, ply, begin, end, HostIsLittleEndian(), pool);
 }
 
 void AttachAssociatedTexturesPly(pangolin::Geometry& geom, const std::string& filename)
@@ -470,7 +774,7 @@ void AttachAssociatedTexturesPly(pangolin::Geometry& geom, const std::string& fi
     }
 }
 
-pangolin::Geometry LoadGeometryPly(const std::string& filename)
+pangolin::Geometry LoadGeometryPly(const std::string& filename, size_t num_threads)
 {
     std::ifstream bFile( filename.c_str(), std::ios::in | std::ios::binary );
     if( !bFile.is_open() ) throw std::runtime_error("Unable to open PLY file: " + filename);
@@ -478,16 +782,40 @@ pangolin::Geometry LoadGeometryPly(const std::string& filename)
     PlyHeaderDetails ply;
     ParsePlyHeader(ply, bFile);
 
+    const std::streamoff data_offset = bFile.tellg();
+    if(data_offset < 0) throw std::runtime_error("Unable to read PLY header: " + filename);
+
+    // Parse element data in place from a mapping of the file where possible
+    MemoryMappedFile mapped;
+    std::vector<unsigned char> read;
+    const unsigned char* begin;
+    const unsigned char* end;
+    if(mapped.Open(filename, (size_t)data_offset)) {
+        begin = mapped.Data();
+        end = begin + mapped.Size();
+    }else{
+        read.assign(std::istreambuf_iterator<char>(bFile), std::istreambuf_iterator<char>());
+        begin = read.data();
+        end = begin + read.size();
+    }
+
+    // The calling thread parses too
+    if(num_threads == 0) num_threads = std::thread::hardware_concurrency();
+    std::unique_ptr<ThreadPool> pool;
+    if(num_threads > 1 && size_t(end - begin) > 2*ply_min_chunk_bytes) {
+        pool.reset(new ThreadPool(num_threads - 1));
+    }
+
     // Initialise geom object
     pangolin::Geometry geom;
 
     // Fill in geometry from file.
     if(ply.format == PlyFormat_ascii) {
-        ParsePlyAscii(geom, ply, bFile);
+        ParsePlyAscii(geom, ply, begin, end, pool.get());
     }else if(ply.format == PlyFormat_binary_little_endian) {
-        ParsePlyLE(geom, ply, bFile);
+        ParsePlyLE(geom, ply, begin, end, pool.get());
     }else if(ply.format == PlyFormat_binary_big_endian) {
-        ParsePlyBE(geom, ply, bFile);
+        ParsePlyBE(geom, ply, begin, end, pool.get());
     }
 
     AttachAssociatedTexturesPly(geom, filename);
@@ -0,0 +1,186 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <algorithm>
+#include <clocale>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <pangolin/geometry/geometry_ply.h>
+
+namespace
+{
+
+const std::string test_filename = "test_geometry.ply";
+
+// Vertices with positions and colours, and a strip of triangles between them
+struct TestMesh
+{
+    explicit TestMesh(size_t num_vertices) : num_vertices(num_vertices) {}
+
+    float Position(size_t i, size_t d) const
+    {
+        const float v[3] = {i * 0.25f - 3.0f, -1.5e-3f * i, 1e5f + i};
+        return v[d];
+    }
+
+    uint8_t Colour(size_t i, size_t c) const
+    {
+        return uint8_t((i * (1 + 6*c)) % 256);
+    }
+
+    uint32_t Index(size_t f, size_t k) const
+    {
+        return uint32_t(f + k);
+    }
+
+    size_t NumFaces() const
+    {
+        return num_vertices - 2;
+    }
+
+    size_t num_vertices;
+};
+
+std::string PlyHeader(const TestMesh& mesh, const char* format)
+{
+    return std::string("ply\nformat ") + format + " 1.0\n"
+        "comment written by tests_geometry_ply\n"
+        "element vertex " + std::to_string(mesh.num_vertices) + "\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+        "element face " + std::to_string(mesh.NumFaces()) + "\n"
+        "property list uchar int vertex_indices\n"
+        "end_header\n";
+}
+
+void WriteAsciiPly(const std::string& filename, const TestMesh& mesh)
+{
+    std::ofstream out(filename, std::ios::binary);
+    out << PlyHeader(mesh, "ascii");
+    char line[256];
+    for(size_t i=0; i < mesh.num_vertices; ++i) {
+        std::snprintf(line, sizeof(line), "%.9g %.9g %.9g %d %d %d\n",
+                      mesh.Position(i,0), mesh.Position(i,1), mesh.Position(i,2),
+                      mesh.Colour(i,0), mesh.Colour(i,1), mesh.Colour(i,2));
+        out << line;
+    }
+    for(size_t f=0; f < mesh.NumFaces(); ++f) {
+        out << "3 " << mesh.Index(f,0) << " " << mesh.Index(f,1) << " " << mesh.Index(f,2) << "\n";
+    }
+}
+
+template<typename T>
+void WriteBinary(std::ofstream& out, T v, bool big_endian)
+{
+    char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    const uint16_t one = 1;
+    const bool host_little = *(const uint8_t*)&one == 1;
+    if(big_endian == host_little) std::reverse(b, b + sizeof(T));
+    out.write(b, sizeof(T));
+}
+
+void WriteBinaryPly(const std::string& filename, const TestMesh& mesh, bool big_endian)
+{
+    std::ofstream out(filename, std::ios::binary);
+    out << PlyHeader(mesh, big_endian ? "binary_big_endian" : "binary_little_endian");
+    for(size_t i=0; i < mesh.num_vertices; ++i) {
+        for(size_t d=0; d < 3; ++d) WriteBinary(out, mesh.Position(i,d), big_endian);
+        for(size_t c=0; c < 3; ++c) WriteBinary(out, mesh.Colour(i,c), big_endian);
+    }
+    for(size_t f=0; f < mesh.NumFaces(); ++f) {
+        WriteBinary(out, uint8_t(3), big_endian);
+        for(size_t k=0; k < 3; ++k) WriteBinary(out, int32_t(mesh.Index(f,k)), big_endian);
+    }
+}
+
+void CheckMesh(const pangolin::Geometry& geom, const TestMesh& mesh)
+{
+    // Loading gathers x,y,z and red,green,blue into vertex and color
+    const auto& verts = geom.buffers.at("geometry");
+    REQUIRE(verts.h == mesh.num_vertices);
+    const auto& pos = std::get<pangolin::Image<float>>(verts.attributes.at("vertex"));
+    const auto& col = std::get<pangolin::Image<uint8_t>>(verts.attributes.at("color"));
+    REQUIRE(pos.w == 3);
+    REQUIRE(col.w == 3);
+    for(size_t i=0; i < mesh.num_vertices; ++i) {
+        for(size_t d=0; d < 3; ++d) {
+            REQUIRE(pos(d,i) == mesh.Position(i,d));
+            REQUIRE(col(d,i) == mesh.Colour(i,d));
+        }
+    }
+
+    const auto& faces = geom.objects.find("default")->second;
+    const auto& indices = std::get<pangolin::Image<uint32_t>>(faces.attributes.at("vertex_indices"));
+    REQUIRE(indices.w == 3);
+    REQUIRE(indices.h == mesh.NumFaces());
+    for(size_t f=0; f < mesh.NumFaces(); ++f) {
+        for(size_t k=0; k < 3; ++k) {
+            REQUIRE(indices(k,f) == mesh.Index(f,k));
+        }
+    }
+}
+
+void CheckAllFormats(const TestMesh& mesh, size_t num_threads)
+{
+    WriteAsciiPly(test_filename, mesh);
+    CheckMesh(pangolin::LoadGeometryPly(test_filename, num_threads), mesh);
+
+    WriteBinaryPly(test_filename, mesh, false);
+    CheckMesh(pangolin::LoadGeometryPly(test_filename, num_threads), mesh);
+
+    WriteBinaryPly(test_filename, mesh, true);
+    CheckMesh(pangolin::LoadGeometryPly(test_filename, num_threads), mesh);
+
+    std::remove(test_filename.c_str());
+}
+
+}
+
+TEST_CASE("PLY files are read back in each format")
+{
+    CheckAllFormats(TestMesh(5), 1);
+}
+
+TEST_CASE("Large PLY files are read back on several threads")
+{
+    // Large enough to be split into chunks between threads
+    CheckAllFormats(TestMesh(150000), 4);
+}
+
+TEST_CASE("ASCII PLY numbers don't depend on the locale")
+{
+    const char* locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"};
+    const char* set = nullptr;
+    for(const char* l : locales) {
+        if((set = std::setlocale(LC_NUMERIC, l))) break;
+    }
+    if(!set) {
+        WARN("No locale with a decimal comma is installed, so this isn't tested.");
+        return;
+    }
+
+    const TestMesh mesh(5);
+    std::setlocale(LC_NUMERIC, "C");
+    WriteAsciiPly(test_filename, mesh);
+    std::setlocale(LC_NUMERIC, set);
+    const pangolin::Geometry geom = pangolin::LoadGeometryPly(test_filename, 1);
+    std::setlocale(LC_NUMERIC, "C");
+    CheckMesh(geom, mesh);
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("PLY double properties are rejected when the header is read")
+{
+    std::ofstream(test_filename, std::ios::binary) <<
+        "ply\nformat ascii 1.0\nelement vertex 1\nproperty double x\nend_header\n1.0\n";
+    REQUIRE_THROWS_AS(pangolin::LoadGeometryPly(test_filename, 1), std::runtime_error);
+    std::remove(test_filename.c_str());
+}
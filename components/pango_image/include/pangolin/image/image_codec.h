@@ -0,0 +1,95 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/platform.h>
+
+#include <pangolin/image/typed_image.h>
+#include <pangolin/utils/file_extension.h>
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pangolin {
+
+// Encodes a sequence of images of one format, keeping codec contexts and
+// scratch buffers from one image to the next. Encode may be called from
+// several threads at once.
+class PANGOLIN_EXPORT ImageEncoder
+{
+public:
+    virtual ~ImageEncoder() {}
+    virtual void Encode(std::ostream& out, const Image<unsigned char>& image) = 0;
+};
+
+// Decodes a sequence of images, keeping codec contexts and scratch buffers
+// from one image to the next. Decode may be called from several threads at once.
+class PANGOLIN_EXPORT ImageDecoder
+{
+public:
+    virtual ~ImageDecoder() {}
+    virtual TypedImage Decode(std::istream& in) = 0;
+};
+
+/// Quality \in [0..100] for lossy formats, or the compression level for zstd
+/// and lz4. num_threads > 1 lets zstd and lz4 compress a single image on
+/// several threads, using zstd's worker threads or independent lz4 row blocks.
+PANGOLIN_EXPORT
+std::unique_ptr<ImageEncoder> CreateImageEncoder(ImageFileType file_type, const PixelFormat& fmt, float quality = 100.0f, size_t num_threads = 1);
+
+/// num_threads > 1 decodes lz4 row blocks in parallel.
+PANGOLIN_EXPORT
+std::unique_ptr<ImageDecoder> CreateImageDecoder(ImageFileType file_type, size_t num_threads = 1);
+
+// Codec state which is reused once a thread is done with it, so that
+// concurrent users each get their own.
+template<typename Context>
+class CodecContextPool
+{
+public:
+    std::unique_ptr<Context> Acquire()
+    {
+        std::lock_guard<std::mutex> l(lock);
+        if(free_contexts.empty()) return nullptr;
+        std::unique_ptr<Context> ctx = std::move(free_contexts.back());
+        free_contexts.pop_back();
+        return ctx;
+    }
+
+    void Release(std::unique_ptr<Context> ctx)
+    {
+        std::lock_guard<std::mutex> l(lock);
+        free_contexts.push_back(std::move(ctx));
+    }
+
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<Context>> free_contexts;
+};
+
+}
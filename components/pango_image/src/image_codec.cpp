@@ -0,0 +1,104 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/image/image_codec.h>
+#include <pangolin/image/image_io.h>
+
+namespace pangolin {
+
+// ZSTD (https://github.com/facebook/zstd)
+std::unique_ptr<ImageEncoder> CreateZstdEncoder(const PixelFormat& fmt, int compression_level, size_t num_threads);
+std::unique_ptr<ImageDecoder> CreateZstdDecoder();
+
+// https://github.com/lz4/lz4
+std::unique_ptr<ImageEncoder> CreateLz4Encoder(const PixelFormat& fmt, int compression_level, size_t num_threads);
+std::unique_ptr<ImageDecoder> CreateLz4Decoder(size_t num_threads);
+
+namespace {
+
+// Formats without persistent codec state go through SaveImage / LoadImage
+class StatelessImageEncoder : public ImageEncoder
+{
+public:
+    StatelessImageEncoder(ImageFileType file_type, const PixelFormat& fmt, float quality)
+        : file_type(file_type), fmt(fmt), quality(quality)
+    {
+    }
+
+    void Encode(std::ostream& out, const Image<unsigned char>& image) override
+    {
+        SaveImage(image, fmt, out, file_type, true, quality);
+    }
+
+private:
+    ImageFileType file_type;
+    PixelFormat fmt;
+    float quality;
+};
+
+class StatelessImageDecoder : public ImageDecoder
+{
+public:
+    StatelessImageDecoder(ImageFileType file_type)
+        : file_type(file_type)
+    {
+    }
+
+    TypedImage Decode(std::istream& in) override
+    {
+        return LoadImage(in, file_type);
+    }
+
+private:
+    ImageFileType file_type;
+};
+
+}
+
+std::unique_ptr<ImageEncoder> CreateImageEncoder(ImageFileType file_type, const PixelFormat& fmt, float quality, size_t num_threads)
+{
+    switch (file_type) {
+    case ImageFileTypeZstd:
+        return CreateZstdEncoder(fmt, (int)quality, num_threads);
+    case ImageFileTypeLz4:
+        return CreateLz4Encoder(fmt, (int)quality, num_threads);
+    default:
+        return std::unique_ptr<ImageEncoder>(new StatelessImageEncoder(file_type, fmt, quality));
+    }
+}
+
+std::unique_ptr<ImageDecoder> CreateImageDecoder(ImageFileType file_type, size_t num_threads)
+{
+    switch (file_type) {
+    case ImageFileTypeZstd:
+        return CreateZstdDecoder();
+    case ImageFileTypeLz4:
+        return CreateLz4Decoder(num_threads);
+    default:
+        return std::unique_ptr<ImageDecoder>(new StatelessImageDecoder(file_type));
+    }
+}
+
+}
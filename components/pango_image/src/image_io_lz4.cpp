@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <memory>
 
+#include <pangolin/image/image_codec.h>
 #include <pangolin/image/typed_image.h>
+#include <pangolin/utils/format_string.h>
+#include <pangolin/utils/thread_pool.h>
 
 #ifdef HAVE_LZ4
 #  include <lz4.h>
@@ -15,72 +20,247 @@ struct lz4_image_header
     char magic[3];
     char fmt[16];
     size_t w, h;
+    // Size of the compressed data which follows. When negative, the image is
+    // instead split into -compressed_size blocks of equal rows (the last may
+    // be shorter), compressed independently. Their compressed sizes follow
+    // as an array of int64_t, and then the blocks themselves.
     int64_t compressed_size;
 };
 #pragma pack(pop)
 
-void SaveLz4(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level)
-{
 #ifdef HAVE_LZ4
-    const int64_t src_size = image.SizeBytes();
-    const int64_t max_dst_size = LZ4_compressBound(src_size);
-    std::unique_ptr<char[]> output_buffer(new char[max_dst_size]);
-
-    // Same as LZ4_compress_default(), but allows to select an "acceleration" factor. 
-    // The larger the acceleration value, the faster the algorithm, but also the lesser the compression.
-    // It's a trade-off. It can be fine tuned, with each successive value providing roughly +~3% to speed.
-    // An acceleration value of "1" is the same as regular LZ4_compress_default()
-    // Values <= 0 will be replaced by ACCELERATION_DEFAULT (see lz4.c), which is 1. 
-    const int64_t compressed_data_size = LZ4_compress_fast((char*)image.ptr, output_buffer.get(), src_size, max_dst_size, compression_level);
-
-    if (compressed_data_size < 0)
-        throw std::runtime_error("A negative result from LZ4_compress_default indicates a failure trying to compress the data.");
-    if (compressed_data_size == 0)
-        throw std::runtime_error("A result of 0 for LZ4 means compression worked, but was stopped because the destination buffer couldn't hold all the information.");
-
-    lz4_image_header header;
-    memcpy(header.magic,"LZ4",3);
-    strncpy(header.fmt, fmt.format.c_str(), sizeof(header.fmt));
-    header.w = image.w;
-    header.h = image.h;
-    header.compressed_size = compressed_data_size;
-    out.write((char*)&header, sizeof(header));
-
-    out.write(output_buffer.get(), compressed_data_size);
 
+namespace {
+
+// Blocks compress slightly worse than whole images, so only split images into
+// blocks at least this large.
+const size_t lz4_min_block_bytes = 512*1024;
+
+void CheckDecompressed(int decompressed_size, size_t expected_size)
+{
+    if (decompressed_size < 0)
+        throw std::runtime_error(FormatString("A negative result from LZ4_decompress_safe indicates a failure trying to decompress the data.  See exit code (%) for value returned.", decompressed_size));
+    if (decompressed_size == 0)
+        throw std::runtime_error("I'm not sure this function can ever return 0.  Documentation in lz4.h doesn't indicate so.");
+    if (decompressed_size != (int)expected_size)
+        throw std::runtime_error(FormatString("decompressed size % is not equal to predicted size %", decompressed_size, expected_size));
+}
+
+std::unique_ptr<ThreadPool> CreateBlockPool(size_t num_threads)
+{
+    // The calling thread works on blocks too
+    return std::unique_ptr<ThreadPool>(num_threads > 1 ? new ThreadPool(num_threads - 1) : nullptr);
+}
+
+template<typename F>
+void ForEachBlock(ThreadPool* pool, size_t num_blocks, F f)
+{
+    if(pool && num_blocks > 1) {
+        pool->ParallelFor(0, num_blocks, [&](size_t b0, size_t b1) {
+            for(size_t b=b0; b < b1; ++b) f(b);
+        });
+    }else{
+        for(size_t b=0; b < num_blocks; ++b) f(b);
+    }
+}
+
+}
+
+class Lz4Encoder : public ImageEncoder
+{
+public:
+    Lz4Encoder(const PixelFormat& fmt, int compression_level, size_t num_threads)
+        : fmt(fmt), compression_level(compression_level), num_threads(std::max<size_t>(1, num_threads)),
+          pool(CreateBlockPool(num_threads))
+    {
+    }
+
+    void Encode(std::ostream& out, const Image<unsigned char>& image) override
+    {
+        std::unique_ptr<Context> ctx = contexts.Acquire();
+        if(!ctx) ctx.reset(new Context());
+
+        const size_t row_bytes = (fmt.bpp * image.w)/8;
+        const size_t src_size = row_bytes * image.h;
+
+        // Rows must be packed, as they are on decompression
+        const char* src = (const char*)image.ptr;
+        if(image.pitch != row_bytes) {
+            ctx->packed.resize(src_size);
+            for(size_t y=0; y < image.h; ++y) {
+                std::memcpy(ctx->packed.data() + y*row_bytes, image.RowPtr(y), row_bytes);
+            }
+            src = ctx->packed.data();
+        }
+
+        const size_t num_blocks = std::max<size_t>(1, std::min({num_threads, src_size / lz4_min_block_bytes, image.h}));
+        const size_t block_rows = (image.h + num_blocks - 1) / num_blocks;
+        const size_t max_block_size = LZ4_compressBound(int(block_rows * row_bytes));
+        ctx->compressed.resize(num_blocks * max_block_size);
+        ctx->block_sizes.resize(num_blocks);
+
+        ForEachBlock(pool.get(), num_blocks, [&](size_t b) {
+            const size_t y0 = std::min(image.h, b * block_rows);
+            const size_t y1 = std::min(image.h, y0 + block_rows);
+
+            // Same as LZ4_compress_default(), but allows to select an "acceleration" factor.
+            // The larger the acceleration value, the faster the algorithm, but also the lesser the compression.
+            // It's a trade-off. It can be fine tuned, with each successive value providing roughly +~3% to speed.
+            // An acceleration value of "1" is the same as regular LZ4_compress_default()
+            // Values <= 0 will be replaced by ACCELERATION_DEFAULT (see lz4.c), which is 1.
+            const int64_t compressed_data_size = LZ4_compress_fast(
+                src + y0*row_bytes, ctx->compressed.data() + b*max_block_size,
+                int((y1-y0)*row_bytes), int(max_block_size), compression_level
+            );
+
+            if (compressed_data_size < 0)
+                throw std::runtime_error("A negative result from LZ4_compress_default indicates a failure trying to compress the data.");
+            if (compressed_data_size == 0 && y1 > y0)
+                throw std::runtime_error("A result of 0 for LZ4 means compression worked, but was stopped because the destination buffer couldn't hold all the information.");
+            ctx->block_sizes[b] = compressed_data_size;
+        });
+
+        lz4_image_header header;
+        memcpy(header.magic,"LZ4",3);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wstringop-truncation"
+        strncpy(header.fmt, fmt.format.c_str(), sizeof(header.fmt));
+#pragma GCC diagnostic pop
+        header.w = image.w;
+        header.h = image.h;
+        header.compressed_size = num_blocks == 1 ? ctx->block_sizes[0] : -int64_t(num_blocks);
+        out.write((char*)&header, sizeof(header));
+
+        if(num_blocks > 1) {
+            out.write((char*)ctx->block_sizes.data(), num_blocks * sizeof(int64_t));
+        }
+        for(size_t b=0; b < num_blocks; ++b) {
+            out.write(ctx->compressed.data() + b*max_block_size, ctx->block_sizes[b]);
+        }
+
+        contexts.Release(std::move(ctx));
+    }
+
+private:
+    struct Context
+    {
+        std::vector<char> packed;
+        std::vector<char> compressed;
+        std::vector<int64_t> block_sizes;
+    };
+
+    PixelFormat fmt;
+    int compression_level;
+    size_t num_threads;
+    std::unique_ptr<ThreadPool> pool;
+    CodecContextPool<Context> contexts;
+};
+
+class Lz4Decoder : public ImageDecoder
+{
+public:
+    Lz4Decoder(size_t num_threads)
+        : pool(CreateBlockPool(num_threads))
+    {
+    }
+
+    TypedImage Decode(std::istream& in) override
+    {
+        std::unique_ptr<Context> ctx = contexts.Acquire();
+        if(!ctx) ctx.reset(new Context());
+
+        // Read in header, uncompressed
+        lz4_image_header header;
+        in.read( (char*)&header, sizeof(header));
+
+        TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
+
+        // Sizes come from the file, so check them before allocating anything
+        const bool split_into_blocks = header.compressed_size < 0;
+        const size_t num_blocks = split_into_blocks ? size_t(-header.compressed_size) : 1;
+        if(split_into_blocks) {
+            if(num_blocks < 1 || num_blocks > img.h)
+                throw std::runtime_error(FormatString("LZ4 image has % row blocks, but only % rows", num_blocks, img.h));
+            ctx->block_sizes.resize(num_blocks);
+            in.read((char*)ctx->block_sizes.data(), num_blocks * sizeof(int64_t));
+        }else{
+            ctx->block_sizes.assign(1, header.compressed_size);
+        }
+
+        const size_t block_rows = (img.h + num_blocks - 1) / num_blocks;
+        const int64_t max_block_size = LZ4_compressBound(int(block_rows * img.pitch));
+
+        ctx->block_offsets.resize(num_blocks);
+        size_t total_size = 0;
+        for(size_t b=0; b < num_blocks; ++b) {
+            if(ctx->block_sizes[b] < 0 || ctx->block_sizes[b] > max_block_size)
+                throw std::runtime_error(FormatString("LZ4 block size % is larger than any block of this image could compress to", ctx->block_sizes[b]));
+            ctx->block_offsets[b] = total_size;
+            total_size += ctx->block_sizes[b];
+        }
+        ctx->compressed.resize(total_size);
+        in.read(ctx->compressed.data(), total_size);
+
+        ForEachBlock(pool.get(), num_blocks, [&](size_t b) {
+            const size_t y0 = std::min(img.h, b * block_rows);
+            const size_t y1 = std::min(img.h, y0 + block_rows);
+            const size_t block_bytes = (y1-y0) * img.pitch;
+            if(block_bytes == 0) return;
+            const int decompressed_size = LZ4_decompress_safe(
+                ctx->compressed.data() + ctx->block_offsets[b], (char*)img.RowPtr(y0),
+                int(ctx->block_sizes[b]), int(block_bytes)
+            );
+            CheckDecompressed(decompressed_size, block_bytes);
+        });
+
+        contexts.Release(std::move(ctx));
+        return img;
+    }
+
+private:
+    struct Context
+    {
+        std::vector<char> compressed;
+        std::vector<int64_t> block_sizes;
+        std::vector<size_t> block_offsets;
+    };
+
+    std::unique_ptr<ThreadPool> pool;
+    CodecContextPool<Context> contexts;
+};
+
+#endif // HAVE_LZ4
+
+std::unique_ptr<ImageEncoder> CreateLz4Encoder(const PixelFormat& fmt, int compression_level, size_t num_threads)
+{
+#ifdef HAVE_LZ4
+    return std::unique_ptr<ImageEncoder>(new Lz4Encoder(fmt, compression_level, num_threads));
 #else
-    PANGOLIN_UNUSED(image);
     PANGOLIN_UNUSED(fmt);
-    PANGOLIN_UNUSED(out);
     PANGOLIN_UNUSED(compression_level);
+    PANGOLIN_UNUSED(num_threads);
     throw std::runtime_error("Rebuild Pangolin for LZ4 support.");
 #endif // HAVE_LZ4
 }
 
-TypedImage LoadLz4(std::istream& in)
+std::unique_ptr<ImageDecoder> CreateLz4Decoder(size_t num_threads)
 {
 #ifdef HAVE_LZ4
-    // Read in header, uncompressed
-    lz4_image_header header;
-    in.read( (char*)&header, sizeof(header));
-
-    TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
-    std::unique_ptr<char[]> input_buffer(new char[header.compressed_size]);
-
-    in.read(input_buffer.get(), header.compressed_size);
-    const int decompressed_size = LZ4_decompress_safe(input_buffer.get(), (char*)img.ptr, header.compressed_size, img.SizeBytes());
-    if (decompressed_size < 0)
-        throw std::runtime_error(FormatString("A negative result from LZ4_decompress_safe indicates a failure trying to decompress the data.  See exit code (%) for value returned.", decompressed_size));
-    if (decompressed_size == 0)
-        throw std::runtime_error("I'm not sure this function can ever return 0.  Documentation in lz4.h doesn't indicate so.");
-    if (decompressed_size != (int)img.SizeBytes())
-        throw std::runtime_error(FormatString("decompressed size % is not equal to predicted size %", decompressed_size, img.SizeBytes()));
-
-    return img;
+    return std::unique_ptr<ImageDecoder>(new Lz4Decoder(num_threads));
 #else
-    PANGOLIN_UNUSED(in);
+    PANGOLIN_UNUSED(num_threads);
     throw std::runtime_error("Rebuild Pangolin for LZ4 support.");
 #endif // HAVE_LZ4
 }
 
+void SaveLz4(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level)
+{
+    CreateLz4Encoder(fmt, compression_level, 1)->Encode(out, image);
+}
+
+TypedImage LoadLz4(std::istream& in)
+{
+    return CreateLz4Decoder(1)->Decode(in);
+}
+
 }
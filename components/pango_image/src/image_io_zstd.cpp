@@ -1,11 +1,18 @@
-
 #include <fstream>
 #include <memory>
 
+#include <pangolin/image/image_codec.h>
 #include <pangolin/image/typed_image.h>
+#include <pangolin/utils/format_string.h>
+#include <pangolin/utils/log.h>
 
 #ifdef HAVE_ZSTD
 #  include <zstd.h>
+// Parameters, including worker threads, are set through the advanced API
+// from zstd 1.4. Older versions compress on one thread.
+#  if ZSTD_VERSION_NUMBER >= 10400
+#    define PANGO_ZSTD_ADVANCED_API
+#  endif
 #endif
 
 namespace pangolin {
@@ -19,110 +26,208 @@ struct zstd_image_header
 };
 #pragma pack(pop)
 
-void SaveZstd(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level)
-{
 #ifdef HAVE_ZSTD
-    // Write out header, uncompressed
-    zstd_image_header header;
-    memcpy(header.magic,"ZSTD",4);
+
+class ZstdEncoder : public ImageEncoder
+{
+public:
+    ZstdEncoder(const PixelFormat& fmt, int compression_level, size_t num_threads)
+        : fmt(fmt), compression_level(compression_level), num_threads(num_threads)
+    {
+    }
+
+    void Encode(std::ostream& out, const Image<unsigned char>& image) override
+    {
+        std::unique_ptr<Context> ctx = contexts.Acquire();
+        if(!ctx) ctx = CreateContext();
+
+        // Write out header, uncompressed
+        zstd_image_header header;
+        memcpy(header.magic,"ZSTD",4);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstringop-truncation"
-    strncpy(header.fmt, fmt.format.c_str(), sizeof(header.fmt));
+        strncpy(header.fmt, fmt.format.c_str(), sizeof(header.fmt));
 #pragma GCC diagnostic pop
-    header.w = image.w;
-    header.h = image.h;
-    out.write((char*)&header, sizeof(header));
+        header.w = image.w;
+        header.h = image.h;
+        out.write((char*)&header, sizeof(header));
+
+        const size_t row_size_bytes = (fmt.bpp * image.w)/8;
+#ifdef PANGO_ZSTD_ADVANCED_API
+        Check(ZSTD_CCtx_reset(ctx->cstream, ZSTD_reset_session_only), "ZSTD_CCtx_reset()");
+        Check(ZSTD_CCtx_setPledgedSrcSize(ctx->cstream, row_size_bytes * image.h), "ZSTD_CCtx_setPledgedSrcSize()");
+#else
+        Check(ZSTD_initCStream(ctx->cstream, compression_level), "ZSTD_initCStream()");
+#endif
 
-    // Write out image data
-    const size_t output_buffer_size = ZSTD_CStreamOutSize();
-    std::unique_ptr<char[]> output_buffer(new char[output_buffer_size]);
+        // Write out image data
+        for(size_t y=0; y < image.h; ++y) {
+            ZSTD_inBuffer input = { image.RowPtr(y), row_size_bytes, 0 };
+            while (input.pos < input.size) {
+                ZSTD_outBuffer output = { ctx->output_buffer.data(), ctx->output_buffer.size(), 0 };
+#ifdef PANGO_ZSTD_ADVANCED_API
+                Check(ZSTD_compressStream2(ctx->cstream, &output, &input, ZSTD_e_continue), "ZSTD_compressStream2()");
+#else
+                Check(ZSTD_compressStream(ctx->cstream, &output, &input), "ZSTD_compressStream()");
+#endif
+                out.write(ctx->output_buffer.data(), output.pos);
+            }
+        }
 
-    ZSTD_CStream* const cstream = ZSTD_createCStream();
-    if (cstream==nullptr) {
-        throw std::runtime_error("ZSTD_createCStream() error");
-    }
+        // close frame, waiting for any worker threads
+        size_t remaining_to_flush;
+        do {
+            ZSTD_outBuffer output = { ctx->output_buffer.data(), ctx->output_buffer.size(), 0 };
+#ifdef PANGO_ZSTD_ADVANCED_API
+            ZSTD_inBuffer input = { nullptr, 0, 0 };
+            remaining_to_flush = Check(ZSTD_compressStream2(ctx->cstream, &output, &input, ZSTD_e_end), "ZSTD_compressStream2()");
+#else
+            remaining_to_flush = Check(ZSTD_endStream(ctx->cstream, &output), "ZSTD_endStream()");
+#endif
+            out.write(ctx->output_buffer.data(), output.pos);
+        } while(remaining_to_flush);
 
-    size_t const initResult = ZSTD_initCStream(cstream, compression_level);
-    if (ZSTD_isError(initResult)) {
-        throw std::runtime_error(FormatString("ZSTD_initCStream() error : %", ZSTD_getErrorName(initResult)));
+        contexts.Release(std::move(ctx));
     }
 
-    const size_t row_size_bytes = (fmt.bpp * image.w)/8;
-
-    for(size_t y=0; y < image.h; ++y) {
-        ZSTD_inBuffer input = { image.RowPtr(y), row_size_bytes, 0 };
+private:
+    struct Context
+    {
+        ~Context() { ZSTD_freeCStream(cstream); }
+        ZSTD_CStream* cstream = nullptr;
+        std::vector<char> output_buffer;
+    };
 
-        while (input.pos < input.size) {
-            ZSTD_outBuffer output = { output_buffer.get(), output_buffer_size, 0 };
-            size_t left_to_read = ZSTD_compressStream(cstream, &output , &input);
-            if (ZSTD_isError(left_to_read)) {
-                throw std::runtime_error(FormatString("ZSTD_compressStream() error : %", ZSTD_getErrorName(left_to_read)));
-            }
-            out.write(output_buffer.get(), output.pos);
+    static size_t Check(size_t result, const char* what)
+    {
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(FormatString("% error : %", what, ZSTD_getErrorName(result)));
         }
+        return result;
     }
 
-    ZSTD_outBuffer output = { output_buffer.get(), output_buffer_size, 0 };
-    size_t const remainingToFlush = ZSTD_endStream(cstream, &output);   /* close frame */
-    if (remainingToFlush) {
-        throw std::runtime_error("not fully flushed");
-    }
-    out.write(output_buffer.get(), output.pos);
+    std::unique_ptr<Context> CreateContext() const
+    {
+        std::unique_ptr<Context> ctx(new Context());
+        ctx->cstream = ZSTD_createCStream();
+        if (ctx->cstream==nullptr) {
+            throw std::runtime_error("ZSTD_createCStream() error");
+        }
+        ctx->output_buffer.resize(ZSTD_CStreamOutSize());
 
-    ZSTD_freeCStream(cstream);
+#ifdef PANGO_ZSTD_ADVANCED_API
+        Check(ZSTD_CCtx_setParameter(ctx->cstream, ZSTD_c_compressionLevel, compression_level), "ZSTD_CCtx_setParameter()");
+        if(num_threads > 1 && ZSTD_isError(ZSTD_CCtx_setParameter(ctx->cstream, ZSTD_c_nbWorkers, (int)num_threads))) {
+            pango_print_warn("libzstd was built without multithreading, compressing on one thread.\n");
+        }
 #else
-    PANGOLIN_UNUSED(image);
-    PANGOLIN_UNUSED(fmt);
-    PANGOLIN_UNUSED(out);
-    PANGOLIN_UNUSED(compression_level);
-    throw std::runtime_error("Rebuild Pangolin for ZSTD support.");
-#endif // HAVE_ZSTD
-}
+        if(num_threads > 1) {
+            pango_print_warn("libzstd is older than 1.4, compressing on one thread.\n");
+        }
+#endif
+        return ctx;
+    }
 
-TypedImage LoadZstd(std::istream& in)
+    PixelFormat fmt;
+    int compression_level;
+    size_t num_threads;
+    CodecContextPool<Context> contexts;
+};
+
+class ZstdDecoder : public ImageDecoder
 {
-#ifdef HAVE_ZSTD
-    // Read in header, uncompressed
-    zstd_image_header header;
-    in.read( (char*)&header, sizeof(header));
+public:
+    TypedImage Decode(std::istream& in) override
+    {
+        std::unique_ptr<Context> ctx = contexts.Acquire();
+        if(!ctx) ctx = CreateContext();
 
-    TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
+        // Read in header, uncompressed
+        zstd_image_header header;
+        in.read( (char*)&header, sizeof(header));
 
-    const size_t input_buffer_size = ZSTD_DStreamInSize();
-    std::unique_ptr<char[]> input_buffer(new char[input_buffer_size]);
+        TypedImage img(header.w, header.h, PixelFormatFromString(header.fmt));
 
-    ZSTD_DStream* dstream = ZSTD_createDStream();
-    if(!dstream) {
-        throw std::runtime_error("ZSTD_createDStream() error");
-    }
+        size_t read_size_hint = ZSTD_initDStream(ctx->dstream);
+        if (ZSTD_isError(read_size_hint)) {
+            throw std::runtime_error(FormatString("ZSTD_initDStream() error : % \n", ZSTD_getErrorName(read_size_hint)));
+        }
+
+        // Image represents our fixed buffer.
+        ZSTD_outBuffer output = { img.ptr, img.SizeBytes(), 0 };
+
+        while(read_size_hint)
+        {
+            if(read_size_hint > ctx->input_buffer.size()) {
+                ctx->input_buffer.resize(read_size_hint);
+            }
+            in.read(ctx->input_buffer.data(), read_size_hint);
+            ZSTD_inBuffer input = { ctx->input_buffer.data(), read_size_hint, 0 };
+            while (input.pos < input.size) {
+                read_size_hint = ZSTD_decompressStream(ctx->dstream, &output , &input);
+                if (ZSTD_isError(read_size_hint)) {
+                    throw std::runtime_error(FormatString("ZSTD_decompressStream() error : %", ZSTD_getErrorName(read_size_hint)));
+                }
+            }
+        }
 
-    size_t read_size_hint = ZSTD_initDStream(dstream);
-    if (ZSTD_isError(read_size_hint)) {
-        throw std::runtime_error(FormatString("ZSTD_initDStream() error : % \n", ZSTD_getErrorName(read_size_hint)));
+        contexts.Release(std::move(ctx));
+        return img;
     }
 
-    // Image represents our fixed buffer.
-    ZSTD_outBuffer output = { img.ptr, img.SizeBytes(), 0 };
+private:
+    struct Context
+    {
+        ~Context() { ZSTD_freeDStream(dstream); }
+        ZSTD_DStream* dstream = nullptr;
+        std::vector<char> input_buffer;
+    };
 
-    while(read_size_hint)
+    static std::unique_ptr<Context> CreateContext()
     {
-        in.read(input_buffer.get(), read_size_hint);
-        ZSTD_inBuffer input = { input_buffer.get(), read_size_hint, 0 };
-        while (input.pos < input.size) {
-            read_size_hint = ZSTD_decompressStream(dstream, &output , &input);
-            if (ZSTD_isError(read_size_hint)) {
-                throw std::runtime_error(FormatString("ZSTD_decompressStream() error : %", ZSTD_getErrorName(read_size_hint)));
-            }
+        std::unique_ptr<Context> ctx(new Context());
+        ctx->dstream = ZSTD_createDStream();
+        if(!ctx->dstream) {
+            throw std::runtime_error("ZSTD_createDStream() error");
         }
+        ctx->input_buffer.resize(ZSTD_DStreamInSize());
+        return ctx;
     }
 
-    ZSTD_freeDStream(dstream);
+    CodecContextPool<Context> contexts;
+};
 
-    return img;
+#endif // HAVE_ZSTD
+
+std::unique_ptr<ImageEncoder> CreateZstdEncoder(const PixelFormat& fmt, int compression_level, size_t num_threads)
+{
+#ifdef HAVE_ZSTD
+    return std::unique_ptr<ImageEncoder>(new ZstdEncoder(fmt, compression_level, num_threads));
+#else
+    PANGOLIN_UNUSED(fmt);
+    PANGOLIN_UNUSED(compression_level);
+    PANGOLIN_UNUSED(num_threads);
+    throw std::runtime_error("Rebuild Pangolin for ZSTD support.");
+#endif // HAVE_ZSTD
+}
+
+std::unique_ptr<ImageDecoder> CreateZstdDecoder()
+{
+#ifdef HAVE_ZSTD
+    return std::unique_ptr<ImageDecoder>(new ZstdDecoder());
 #else
-    PANGOLIN_UNUSED(in);
     throw std::runtime_error("Rebuild Pangolin for ZSTD support.");
 #endif // HAVE_ZSTD
 }
 
+void SaveZstd(const Image<unsigned char>& image, const pangolin::PixelFormat& fmt, std::ostream& out, int compression_level)
+{
+    CreateZstdEncoder(fmt, compression_level, 1)->Encode(out, image);
+}
+
+TypedImage LoadZstd(std::istream& in)
+{
+    return CreateZstdDecoder()->Decode(in);
+}
+
 }
@@ -31,14 +31,17 @@
 
 #include <cstdio>
 #include <cstdarg>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace pangolin {
 
 class PANGOLIN_EXPORT GlFont
 {
 public:
-    // Load GL Font data. Delay uploading as texture until first use.
+    // Load GL Font data. Glyphs are rasterized into tex_w x tex_h atlas pages
+    // the first time they are used, and uploaded as textures when they are.
     GlFont(const unsigned char* ttf_buffer, float pixel_height, int tex_w=512, int tex_h=512);
     GlFont(const std::string& filename, float pixel_height, int tex_w=512, int tex_h=512);
 
@@ -58,22 +61,52 @@ public:
     }
 
 protected:
-    void InitialiseFont(const unsigned char* ttf_buffer, float pixel_height, int tex_w, int tex_h);
+    using codepoint_t = uint32_t;
+
+    struct FontInfo;
+
+    struct AtlasPage
+    {
+        ManagedImage<unsigned char> bitmap;
+        GlTexture tex;
+        // Packing position for the next glyph
+        int x, y, bottom_y;
+        // Rows changed since the page was last uploaded
+        int dirty_y0, dirty_y1;
+    };
+
+    struct Glyph
+    {
+        GlChar ch;
+        // 0 for codepoints which aren't in the font
+        int index;
+        size_t page;
+    };
 
-    // This can only be called once GL context is initialised
-    void InitialiseGlTexture();
+    void InitialiseFont(const unsigned char* ttf_buffer, size_t ttf_size, float pixel_height, int tex_w, int tex_h);
+
+    // Rasterize codepoint into an atlas page on first use
+    const Glyph& FindGlyph(codepoint_t c);
+
+    GLfloat Kerning(const Glyph& g1, const Glyph& g2);
+
+    // Upload pages with newly rasterized glyphs. Requires a GL context.
+    void UploadPages();
 
     float font_height_px;
     float font_max_width_px;
+    float scale;
+    int tex_w, tex_h;
 
-    ManagedImage<unsigned char> font_bitmap;
-    GlTexture mTex;
+    std::vector<unsigned char> font_data;
+    std::unique_ptr<FontInfo> font_info;
 
-    using codepoint_t = uint32_t;
-    using codepointpair_t = std::pair<codepoint_t, codepoint_t>;
+    // Heap allocated so that textures referenced by GlText stay put
+    std::vector<std::unique_ptr<AtlasPage>> pages;
 
-    std::map<codepoint_t, GlChar> chardata;
-    std::map<codepointpair_t, GLfloat> kern_table;
+    std::unordered_map<codepoint_t, Glyph> chardata;
+    // Keyed on glyph index pair, for pairs which have been used
+    std::unordered_map<uint64_t, GLfloat> kern_table;
 };
 
 }
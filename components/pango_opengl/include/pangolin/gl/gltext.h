@@ -49,6 +49,10 @@ public:
     // Add specified charector to this string.
     void Add(unsigned char c, const GlChar& glc);
 
+    // Add charector whose glyph is in glyph_tex, which may differ from
+    // the texture of previous charectors.
+    void Add(unsigned char c, const GlChar& glc, const GlTexture& glyph_tex);
+
     // Clear text
     void Clear();
 
@@ -91,6 +95,14 @@ public:
     GLfloat ymax;
     
     std::vector<XYUV> vs;
+
+    // Vertices from .second onwards use texture .first, when they don't all
+    // use tex. Glyphs of large fonts may be spread over several textures.
+    std::vector<std::pair<const GlTexture*, size_t>> tex_changes;
+
+protected:
+    template<typename DrawRange>
+    void ForEachTexture(DrawRange draw) const;
 };
 
 }
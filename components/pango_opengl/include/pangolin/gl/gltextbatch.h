@@ -0,0 +1,85 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+
+#include <pangolin/gl/colour.h>
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/gltext.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace pangolin {
+
+// Collects many strings over a frame so that they can be drawn with one draw
+// call per glyph texture, rather than one (or more) per string. Vertices are
+// kept in a buffer object between frames, and only the vertices which changed
+// since the last Flush are uploaded again.
+class PANGOLIN_EXPORT GlTextBatch
+{
+public:
+    // Queue text with its origin at (x,y) in the coordinates that will be
+    // active when the batch is flushed.
+    void Add(const GlText& text, GLfloat x, GLfloat y, const Colour& colour);
+
+    // Draw and then clear queued text using fixed function pipeline
+    void Flush();
+
+    // Draw and then clear queued text using the bound program, with positions,
+    // texture coordinates and colours in the default attribute locations.
+    void FlushGlSl();
+
+    // Discard queued text without drawing it
+    void Clear();
+
+    bool Empty() const;
+
+protected:
+    struct Vertex
+    {
+        GLfloat x, y, tu, tv;
+        GLfloat r, g, b, a;
+    };
+
+    struct Batch
+    {
+        // Queued this frame
+        std::vector<Vertex> vs;
+        // Contents of bo, which may be larger than vs
+        std::vector<Vertex> uploaded;
+        GlBufferData bo;
+    };
+
+    void Append(const GlTexture* tex, const GlText& text, size_t begin, size_t end, GLfloat x, GLfloat y, const Colour& colour);
+
+    template<typename DrawBatch>
+    void ForEachBatch(DrawBatch draw);
+
+    static void Upload(Batch& batch);
+
+    std::unordered_map<const GlTexture*, Batch> batches;
+};
+
+}
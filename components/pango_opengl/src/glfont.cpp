@@ -25,6 +25,8 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <locale>
 #include <codecvt>
 
@@ -55,59 +57,17 @@
 namespace pangolin
 {
 
-// Hacked version of stbtt_FindGlyphIndex to extract valid codepoints in font
-// Good reference for file format here https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6cmap.html
-std::vector<std::pair<uint32_t,uint32_t>> GetCodepointRanges(const stbtt_fontinfo *info)
+// Size of TrueType data from the extent of its tables
+size_t TrueTypeDataSize(const unsigned char* truetype_data)
 {
-    std::vector<std::pair<uint32_t,uint32_t>> ranges;
-
-    stbtt_uint8 *data = info->data;
-    stbtt_uint32 index_map = info->index_map;
-
-    stbtt_uint16 format = ttUSHORT(data + index_map + 0);
-    if (format == 0) { // apple byte encoding
-        stbtt_int32 bytes = ttUSHORT(data + index_map + 2);
-        ranges.emplace_back(0, bytes-6);
-    } else if (format == 6) {
-        stbtt_uint32 first = ttUSHORT(data + index_map + 6);
-        stbtt_uint32 count = ttUSHORT(data + index_map + 8);
-        ranges.emplace_back(first, first+count);
-    } else if (format == 2) {
-        STBTT_assert(0); // @TODO: high-byte mapping for japanese/chinese/korean
-    } else if (format == 4) { // standard mapping for windows fonts: binary search collection of ranges
-        const stbtt_uint16 segcount = ttUSHORT(data+index_map+6) >> 1;
-
-        // table ranges from [0 to segcount-1]
-        stbtt_uint8 *endCodeTable = data + index_map + 14;
-        stbtt_uint8 *startCodeTable = endCodeTable + 2*segcount + 2;
-
-        for(size_t seg = 0; seg < segcount; ++seg) {
-            const uint16_t startCode = ttUSHORT(startCodeTable + 2*seg);
-            const uint16_t endCode = ttUSHORT(endCodeTable + 2*seg);
-
-            if(endCode != 0xFFFF) {
-                if(startCode < endCode) {
-                    ranges.emplace_back(startCode,endCode+1);
-                }
-            }else{
-                break;
-            }
-        }
-    } else if (format == 12 || format == 13) {
-        const stbtt_uint32 ngroups = ttULONG(data + index_map + 12);
-        stbtt_uint8* range_table = data + index_map + 12 + 4;
-
-        for(size_t group = 0; group < ngroups; ++group)
-        {
-            const uint32_t startCode = ttULONG(range_table + 4*(3*group));
-            const uint32_t endCode = ttULONG(range_table + 4*(3*group+1));
-            ranges.emplace_back(startCode,endCode+1);
-        }
-    } else{
-        STBTT_assert(0);
+    stbtt_uint8* data = const_cast<stbtt_uint8*>(truetype_data);
+    const stbtt_uint16 num_tables = ttUSHORT(data + 4);
+    size_t size = 12 + 16 * num_tables;
+    for(size_t t=0; t < num_tables; ++t) {
+        stbtt_uint8* table = data + 12 + 16*t;
+        size = std::max<size_t>(size, size_t(ttULONG(table + 8)) + ttULONG(table + 12));
     }
-
-    return ranges;
+    return size;
 }
 
 std::string vformat(const char * format, va_list args)
@@ -138,87 +98,124 @@ std::string format(const char * format, ...)
   return s;
 }
 
+struct GlFont::FontInfo
+{
+    stbtt_fontinfo info;
+};
+
 GlFont::GlFont(const unsigned char* truetype_data, float pixel_height, int tex_w, int tex_h)
 {
-    InitialiseFont(truetype_data, pixel_height, tex_w, tex_h);
+    InitialiseFont(truetype_data, TrueTypeDataSize(truetype_data), pixel_height, tex_w, tex_h);
 }
 
 GlFont::GlFont(const std::string& filename, float pixel_height, int tex_w, int tex_h)
 {
     const std::string file_contents = GetFileContents(filename);
-    InitialiseFont(reinterpret_cast<const unsigned char*>(file_contents.data()), pixel_height, tex_w, tex_h);
+    InitialiseFont(reinterpret_cast<const unsigned char*>(file_contents.data()), file_contents.size(), pixel_height, tex_w, tex_h);
 }
 
 GlFont::~GlFont()
 {
 }
 
-void GlFont::InitialiseFont(const unsigned char* truetype_data, float pixel_height, int tex_w, int tex_h)
+void GlFont::InitialiseFont(const unsigned char* truetype_data, size_t truetype_size, float pixel_height, int tex_w, int tex_h)
 {
-    font_height_px = pixel_height;
-    font_max_width_px = 0;
+    // Keep our own copy, which glyphs are rasterized from as they're needed.
+    font_data.assign(truetype_data, truetype_data + truetype_size);
+    font_info.reset(new FontInfo());
+    this->tex_w = tex_w;
+    this->tex_h = tex_h;
 
-    font_bitmap.Reinitialise(tex_w,tex_h);
     const int offset = 0;
-
-    stbtt_fontinfo f;
-    if (!stbtt_InitFont(&f, truetype_data, offset)) {
+    stbtt_fontinfo& f = font_info->info;
+    if (!stbtt_InitFont(&f, font_data.data(), offset)) {
        throw std::runtime_error("Unable to initialise font: stbtt_InitFont failed.");
     }
 
-    float scale = stbtt_ScaleForPixelHeight(&f, pixel_height);
-
-    font_bitmap.Memset(0);
-    int x = 1;
-    int y = 1;
-    int bottom_y = 1;
-
-    const auto ranges = GetCodepointRanges(&f);
-
-    for(const auto& r : ranges) {
-        for(uint32_t codepoint=r.first; codepoint < r.second; ++codepoint) {
-            int advance, lsb, x0,y0,x1,y1,gw,gh;
-            int g = stbtt_FindGlyphIndex(&f, codepoint);
-            stbtt_GetGlyphHMetrics(&f, g, &advance, &lsb);
-            stbtt_GetGlyphBitmapBox(&f, g, scale,scale, &x0,&y0,&x1,&y1);
-            gw = x1-x0;
-            gh = y1-y0;
-            font_max_width_px = std::max(font_max_width_px, (float)gw);
-
-            if (x + gw + 1 >= tex_w)
-               y = bottom_y, x = 1; // advance to next row
-            if (y + gh + 1 >= tex_h) // check if it fits vertically AFTER potentially moving to next row
-               throw std::runtime_error("Unable to initialise font: run out of texture pixel space.");
-            STBTT_assert(x+gw < tex_w);
-            STBTT_assert(y+gh < tex_h);
-            stbtt_MakeGlyphBitmap(&f, font_bitmap.RowPtr(y)+x, gw,gh, font_bitmap.pitch, scale, scale, g);
-
-            // Adjust offset for edges of pixels
-            chardata.try_emplace(codepoint, tex_w,tex_h, x, y, gw, gh, scale*advance, x0 -0.5f, -y0 -0.5f);
-
-            x = x + gw + 1;
-            if (y+gh+1 > bottom_y)
-               bottom_y = y+gh+1;
-        }
+    font_height_px = pixel_height;
+    scale = stbtt_ScaleForPixelHeight(&f, pixel_height);
+
+    // Widest any glyph can be, rather than rasterizing them all to find out
+    int x0,y0,x1,y1;
+    stbtt_GetFontBoundingBox(&f, &x0, &y0, &x1, &y1);
+    font_max_width_px = std::ceil(scale * (x1 - x0));
+}
+
+const GlFont::Glyph& GlFont::FindGlyph(codepoint_t codepoint)
+{
+    const auto it = chardata.find(codepoint);
+    if(it != chardata.end()) {
+        return it->second;
     }
 
-    // This could be a nasty slow loop...
-    for(const auto& r1 : ranges) {
-        for(uint32_t cp1=r1.first; cp1 < r1.second; ++cp1) {
-            for(const auto& r2 : ranges) {
-                for(uint32_t cp2=r2.first; cp2 < r2.second; ++cp2) {
-                    kern_table[codepointpair_t(cp1,cp2)] = scale * stbtt_GetCodepointKernAdvance(&f,cp1,cp2);
-                }
-            }
+    stbtt_fontinfo& f = font_info->info;
+    Glyph glyph;
+    glyph.index = stbtt_FindGlyphIndex(&f, codepoint);
+    glyph.page = 0;
+
+    if(glyph.index) {
+        int advance, lsb, x0,y0,x1,y1;
+        stbtt_GetGlyphHMetrics(&f, glyph.index, &advance, &lsb);
+        stbtt_GetGlyphBitmapBox(&f, glyph.index, scale,scale, &x0,&y0,&x1,&y1);
+        const int gw = x1-x0;
+        const int gh = y1-y0;
+
+        if (gw + 2 >= tex_w || gh + 2 >= tex_h)
+           throw std::runtime_error("Unable to rasterize glyph: larger than font texture.");
+
+        AtlasPage* page = pages.empty() ? nullptr : pages.back().get();
+        if (page && page->x + gw + 1 >= tex_w)
+           page->y = page->bottom_y, page->x = 1; // advance to next row
+        if (!page || page->y + gh + 1 >= tex_h) {
+            // check if it fits vertically AFTER potentially moving to next row
+            pages.emplace_back(new AtlasPage());
+            page = pages.back().get();
+            page->bitmap.Reinitialise(tex_w, tex_h);
+            page->bitmap.Memset(0);
+            page->x = page->y = page->bottom_y = 1;
+            page->dirty_y0 = tex_h;
+            page->dirty_y1 = 0;
         }
+        STBTT_assert(page->x+gw < tex_w);
+        STBTT_assert(page->y+gh < tex_h);
+        stbtt_MakeGlyphBitmap(&f, page->bitmap.RowPtr(page->y)+page->x, gw,gh, page->bitmap.pitch, scale, scale, glyph.index);
+
+        // Adjust offset for edges of pixels
+        glyph.ch = GlChar(tex_w,tex_h, page->x, page->y, gw, gh, scale*advance, x0 -0.5f, -y0 -0.5f);
+        glyph.page = pages.size() - 1;
+
+        page->dirty_y0 = std::min(page->dirty_y0, page->y);
+        page->dirty_y1 = std::max(page->dirty_y1, page->y + gh);
+        page->x = page->x + gw + 1;
+        if (page->y+gh+1 > page->bottom_y)
+           page->bottom_y = page->y+gh+1;
+    }
+
+    return chardata.emplace(codepoint, glyph).first->second;
+}
+
+GLfloat GlFont::Kerning(const Glyph& g1, const Glyph& g2)
+{
+    const uint64_t key = (uint64_t(g1.index) << 32) | uint32_t(g2.index);
+    const auto it = kern_table.find(key);
+    if(it != kern_table.end()) {
+        return it->second;
     }
+    const GLfloat kern = scale * stbtt_GetGlyphKernAdvance(&font_info->info, g1.index, g2.index);
+    kern_table.emplace(key, kern);
+    return kern;
 }
 
-void GlFont::InitialiseGlTexture()
+void GlFont::UploadPages()
 {
-    if(font_bitmap.IsValid()) {
-        mTex.Reinitialise(font_bitmap.w, font_bitmap.h, GL_ALPHA, true, 0, GL_ALPHA,GL_UNSIGNED_BYTE, font_bitmap.ptr);
-        font_bitmap.Deallocate();
+    for(auto& page : pages) {
+        if(!page->tex.IsValid()) {
+            page->tex.Reinitialise(tex_w, tex_h, GL_ALPHA, true, 0, GL_ALPHA, GL_UNSIGNED_BYTE, page->bitmap.ptr);
+        }else if(page->dirty_y0 < page->dirty_y1) {
+            page->tex.Upload(page->bitmap.RowPtr(page->dirty_y0), 0, page->dirty_y0, tex_w, page->dirty_y1 - page->dirty_y0, GL_ALPHA, GL_UNSIGNED_BYTE);
+        }
+        page->dirty_y0 = tex_h;
+        page->dirty_y1 = 0;
     }
 }
 
@@ -235,35 +232,30 @@ GlText GlFont::Text(const std::string& utf8 )
 {
     const std::u32string utf32 = std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t>{}.from_bytes(utf8);
 
-    if(!mTex.IsValid()) InitialiseGlTexture();
-
-    GlText ret(mTex);
+    GlText ret;
     ret.str = utf8;
 
-    char32_t last_c = '\0';
+    const Glyph* last = nullptr;
 
     for(char32_t c : utf32)
     {
-        const auto it = chardata.find(c);
-        if(it != chardata.end()) {
-            const GlChar& ch = it->second;
-
+        const Glyph& glyph = FindGlyph(c);
+        if(glyph.index) {
             // Kerning
-            if(last_c) {
-                codepointpair_t key(last_c, c);
-                const auto kit = kern_table.find(key);
-                const GLfloat kern = (kit != kern_table.end()) ? kit->second : font_max_width_px;
-                ret.AddSpace(kern);
+            if(last) {
+                ret.AddSpace(Kerning(*last, glyph));
             }
 
-            ret.Add(' ', ch);
-            last_c = c;
+            ret.Add(' ', glyph.ch, pages[glyph.page]->tex);
+            last = &glyph;
         }else{
             // codepoint doesn't exists in font
             // TODO: use some symbol such as '?'?
         }
     }
 
+    UploadPages();
+
     return ret;
 }
 
@@ -41,7 +41,7 @@ GlText::GlText()
 
 GlText::GlText(const GlText& txt)
     : tex(txt.tex), str(txt.str), width(txt.width),
-      ymin(txt.ymin), ymax(txt.ymax), vs(txt.vs)
+      ymin(txt.ymin), ymax(txt.ymax), vs(txt.vs), tex_changes(txt.tex_changes)
 {
 }
 
@@ -75,15 +75,42 @@ void GlText::Add(unsigned char c, const GlChar& glc)
     str.append(1,c);
 }
 
+void GlText::Add(unsigned char c, const GlChar& glc, const GlTexture& glyph_tex)
+{
+    if(!tex) {
+        tex = &glyph_tex;
+    }else if(&glyph_tex != (tex_changes.empty() ? tex : tex_changes.back().first)) {
+        if(tex_changes.empty()) tex_changes.emplace_back(tex, 0);
+        tex_changes.emplace_back(&glyph_tex, vs.size());
+    }
+    Add(c, glc);
+}
+
 void GlText::Clear()
 {
     str.clear();
     vs.clear();
+    tex_changes.clear();
     width = 0;
     ymin = +std::numeric_limits<GLfloat>::max();
     ymax = -std::numeric_limits<GLfloat>::max();
 }
 
+template<typename DrawRange>
+void GlText::ForEachTexture(DrawRange draw) const
+{
+    if(tex_changes.empty()) {
+        tex->Bind();
+        draw(0, vs.size());
+    }else{
+        for(size_t i=0; i < tex_changes.size(); ++i) {
+            const size_t end = i+1 < tex_changes.size() ? tex_changes[i+1].second : vs.size();
+            tex_changes[i].first->Bind();
+            draw(tex_changes[i].second, end);
+        }
+    }
+}
+
 void GlText::DrawGlSl() const
 {
 #if !defined(HAVE_GLES) || defined(HAVE_GLES_2)
@@ -94,9 +121,10 @@ void GlText::DrawGlSl() const
         glVertexAttribPointer(pangolin::DEFAULT_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(XYUV), &vs[0].x);
         glVertexAttribPointer(pangolin::DEFAULT_LOCATION_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(XYUV), &vs[0].tu);
 
-        tex->Bind();
         glEnable(GL_TEXTURE_2D);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vs.size() );
+        ForEachTexture([](size_t begin, size_t end){
+            glDrawArrays(GL_TRIANGLES, (GLint)begin, (GLsizei)(end - begin) );
+        });
         glDisable(GL_TEXTURE_2D);
 
         glDisableVertexAttribArray(pangolin::DEFAULT_LOCATION_POSITION);
@@ -126,9 +154,10 @@ void GlText::Draw() const
         glEnableClientState(GL_VERTEX_ARRAY);
         glTexCoordPointer(2, GL_FLOAT, sizeof(XYUV), &vs[0].tu);
         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        tex->Bind();
         glEnable(GL_TEXTURE_2D);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vs.size() );
+        ForEachTexture([](size_t begin, size_t end){
+            glDrawArrays(GL_TRIANGLES, (GLint)begin, (GLsizei)(end - begin) );
+        });
         glDisable(GL_TEXTURE_2D);
         glDisableClientState(GL_VERTEX_ARRAY);
         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -0,0 +1,166 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <pangolin/gl/gltextbatch.h>
+#include <pangolin/gl/glsl.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace pangolin
+{
+
+void GlTextBatch::Add(const GlText& text, GLfloat x, GLfloat y, const Colour& colour)
+{
+    if(text.vs.empty() || !text.tex) return;
+
+    if(text.tex_changes.empty()) {
+        Append(text.tex, text, 0, text.vs.size(), x, y, colour);
+    }else{
+        for(size_t i=0; i < text.tex_changes.size(); ++i) {
+            const size_t end = i+1 < text.tex_changes.size() ? text.tex_changes[i+1].second : text.vs.size();
+            Append(text.tex_changes[i].first, text, text.tex_changes[i].second, end, x, y, colour);
+        }
+    }
+}
+
+void GlTextBatch::Append(const GlTexture* tex, const GlText& text, size_t begin, size_t end, GLfloat x, GLfloat y, const Colour& colour)
+{
+    std::vector<Vertex>& vs = batches[tex].vs;
+    vs.reserve(vs.size() + end - begin);
+    for(size_t i=begin; i < end; ++i) {
+        const XYUV& v = text.vs[i];
+        vs.push_back({v.x + x, v.y + y, v.tu, v.tv, colour.red, colour.green, colour.blue, colour.alpha});
+    }
+}
+
+void GlTextBatch::Clear()
+{
+    for(auto& b : batches) {
+        b.second.vs.clear();
+    }
+}
+
+bool GlTextBatch::Empty() const
+{
+    for(const auto& b : batches) {
+        if(!b.second.vs.empty()) return false;
+    }
+    return true;
+}
+
+void GlTextBatch::Upload(Batch& batch)
+{
+    const std::vector<Vertex>& vs = batch.vs;
+
+    if(vs.size() > batch.uploaded.size()) {
+        // Grow geometrically so that text which gets longer each frame
+        // doesn't reallocate every frame.
+        const size_t capacity = std::max(vs.size(), 2 * batch.uploaded.size());
+        batch.uploaded = vs;
+        batch.uploaded.resize(capacity, Vertex());
+        batch.bo.Reinitialise(GlArrayBuffer, capacity * sizeof(Vertex), GL_DYNAMIC_DRAW, batch.uploaded.data());
+        return;
+    }
+
+    // Upload only the range of vertices which differ from last time. Strings
+    // which are redrawn unchanged each frame cost nothing.
+    auto differs = [&](size_t i) {
+        return std::memcmp(&vs[i], &batch.uploaded[i], sizeof(Vertex)) != 0;
+    };
+    size_t begin = 0;
+    while(begin < vs.size() && !differs(begin)) ++begin;
+    if(begin == vs.size()) return;
+    size_t end = vs.size();
+    while(end > begin && !differs(end-1)) --end;
+
+    std::copy(vs.begin() + begin, vs.begin() + end, batch.uploaded.begin() + begin);
+    batch.bo.Upload(&vs[begin], (end - begin) * sizeof(Vertex), begin * sizeof(Vertex));
+}
+
+template<typename DrawBatch>
+void GlTextBatch::ForEachBatch(DrawBatch draw)
+{
+    glEnable(GL_TEXTURE_2D);
+    for(auto& b : batches) {
+        Batch& batch = b.second;
+        if(batch.vs.empty()) continue;
+        Upload(batch);
+        batch.bo.Bind();
+        b.first->Bind();
+        draw(batch);
+        batch.vs.clear();
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDisable(GL_TEXTURE_2D);
+}
+
+#define VERTEX_OFFSET(member) ((GLvoid*)offsetof(Vertex, member))
+
+void GlTextBatch::Flush()
+{
+    ForEachBatch([](Batch& batch){
+        glVertexPointer(2, GL_FLOAT, sizeof(Vertex), VERTEX_OFFSET(x));
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), VERTEX_OFFSET(tu));
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+#ifdef HAVE_GLES_2
+        glVertexAttribPointer(DEFAULT_LOCATION_COLOUR, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), VERTEX_OFFSET(r));
+#else
+        glColorPointer(4, GL_FLOAT, sizeof(Vertex), VERTEX_OFFSET(r));
+#endif
+        glEnableClientState(GL_COLOR_ARRAY);
+
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)batch.vs.size());
+
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    });
+}
+
+void GlTextBatch::FlushGlSl()
+{
+#if !defined(HAVE_GLES) || defined(HAVE_GLES_2)
+    ForEachBatch([](Batch& batch){
+        glEnableVertexAttribArray(DEFAULT_LOCATION_POSITION);
+        glEnableVertexAttribArray(DEFAULT_LOCATION_TEXCOORD);
+        glEnableVertexAttribArray(DEFAULT_LOCATION_COLOUR);
+        glVertexAttribPointer(DEFAULT_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), VERTEX_OFFSET(x));
+        glVertexAttribPointer(DEFAULT_LOCATION_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), VERTEX_OFFSET(tu));
+        glVertexAttribPointer(DEFAULT_LOCATION_COLOUR, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), VERTEX_OFFSET(r));
+
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)batch.vs.size());
+
+        glDisableVertexAttribArray(DEFAULT_LOCATION_COLOUR);
+        glDisableVertexAttribArray(DEFAULT_LOCATION_TEXCOORD);
+        glDisableVertexAttribArray(DEFAULT_LOCATION_POSITION);
+    });
+#endif
+}
+
+#undef VERTEX_OFFSET
+
+}
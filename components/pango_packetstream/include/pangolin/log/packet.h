@@ -25,17 +25,19 @@
 
 #pragma once
 
+#include <memory>
 #include <mutex>
 
 #include <pangolin/log/packetstream.h>
 #include <pangolin/log/packetstream_source.h>
+#include <pangolin/utils/memory_mapped_file.h>
 
 namespace pangolin {
 
 // Encapsulate serialized reading of Packet from stream.
 struct PANGOLIN_EXPORT Packet
 {
-    Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& mutex, std::vector<PacketStreamSource>& srcs);
+    Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& mutex, std::vector<PacketStreamSource>& srcs, std::shared_ptr<const MemoryMappedFile> mapping = nullptr);
     Packet(const Packet&) = delete;
     Packet(Packet&& o);
     ~Packet();
@@ -48,6 +50,14 @@ struct PANGOLIN_EXPORT Packet
         return _stream;
     }
 
+    // Pointer to the start of this packet's data within the reader's file
+    // mapping, or nullptr if the data isn't mapped (pipes, or packets written
+    // after the file was last mapped). Data can be consumed from here instead
+    // of Stream(); unread bytes are skipped when the Packet is destroyed. The
+    // mapping is kept alive for the lifetime of the Packet, even if the
+    // reader remaps a growing file in the meantime.
+    const unsigned char* Data() const;
+
     PacketStreamSourceId src;
     int64_t time;
     size_t size;
@@ -60,6 +70,7 @@ private:
     void ReadRemaining();
 
     PacketStream& _stream;
+    std::shared_ptr<const MemoryMappedFile> _mapping;
 
     std::unique_lock<std::recursive_mutex> lock;
 
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <pangolin/platform.h>
+
+namespace pangolin {
+
+// Fixed-width index record. Binary indices and checkpoints store these, and
+// their counts, as raw host memory so they can be used in place from a file
+// mapping. Like the rest of the .pango format ("endian": "little_endian" in
+// the header) that is only correct on little endian hosts, checked below.
+struct PacketIndexRecord
+{
+    int64_t pos;
+    int64_t capture_time;
+};
+
+static_assert(sizeof(PacketIndexRecord) == 16, "PacketIndexRecord must match on-disk layout");
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Binary packet indices are read and written in place, which needs a little endian host");
+#endif
+
+// Binary index layout, following TAG_PANGO_INDEX:
+//   zero padding up to the next PACKET_INDEX_ALIGNMENT byte file offset
+//   uint32_t version, uint32_t num_sources
+//   uint64_t num_packets[num_sources]
+//   PacketIndexRecord records[sum(num_packets)], grouped by source
+const uint32_t PACKET_INDEX_VERSION = 1;
+const uint64_t PACKET_INDEX_ALIGNMENT = 8;
+
+// Checkpoint layout, following TAG_PANGO_CHECKPOINT. Written periodically
+// while recording so that unfinished files can be indexed without a rescan:
+//   zero padding up to the next PACKET_INDEX_ALIGNMENT byte file offset
+//   uint32_t version, uint32_t num_sources
+//   uint64_t file offset of the previous checkpoint's tag, or 0 if none
+//   uint64_t num_packets[num_sources], packets since the previous checkpoint
+//   PacketIndexRecord records[sum(num_packets)], grouped by source
+//   uint64_t file offset of this checkpoint's tag
+//   char magic[8] = PACKET_CHECKPOINT_MAGIC
+// The trailing offset and magic let a reader find the last checkpoint by
+// scanning backwards from the end of the file.
+const uint32_t PACKET_CHECKPOINT_VERSION = 1;
+const char PACKET_CHECKPOINT_MAGIC[8] = {'P','A','N','G','O','C','K','P'};
+
+inline uint64_t PacketIndexAlign(uint64_t file_pos)
+{
+    return (file_pos + PACKET_INDEX_ALIGNMENT - 1) & ~(PACKET_INDEX_ALIGNMENT - 1);
+}
+
+// Sequence of PacketIndexRecord, keyed by packet id. Either owns its records
+// or is a read-only view into memory held alive by 'owner' (e.g. a mapped
+// index footer). Any modification turns a view into an owned copy.
+class PANGOLIN_EXPORT PacketIndex
+{
+public:
+    using value_type = PacketIndexRecord;
+    using const_iterator = const PacketIndexRecord*;
+
+    PacketIndex()
+        : _view(nullptr), _view_size(0)
+    {
+    }
+
+    PacketIndex(std::vector<PacketIndexRecord>&& records)
+        : _view(nullptr), _view_size(0), _owned(std::move(records))
+    {
+    }
+
+    PacketIndex(const PacketIndexRecord* records, size_t size, std::shared_ptr<const void> owner)
+        : _view(records), _view_size(size), _owner(std::move(owner))
+    {
+    }
+
+    bool IsView() const
+    {
+        return _view != nullptr;
+    }
+
+    size_t size() const
+    {
+        return _view ? _view_size : _owned.size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    const PacketIndexRecord* data() const
+    {
+        return _view ? _view : _owned.data();
+    }
+
+    const PacketIndexRecord& operator[](size_t i) const
+    {
+        return data()[i];
+    }
+
+    const PacketIndexRecord& back() const
+    {
+        return data()[size()-1];
+    }
+
+    const_iterator begin() const
+    {
+        return data();
+    }
+
+    const_iterator end() const
+    {
+        return data() + size();
+    }
+
+    void push_back(const PacketIndexRecord& record)
+    {
+        MakeOwned();
+        _owned.push_back(record);
+    }
+
+    void clear()
+    {
+        _view = nullptr;
+        _view_size = 0;
+        _owner.reset();
+        _owned.clear();
+    }
+
+private:
+    void MakeOwned()
+    {
+        if(_view) {
+            _owned.assign(_view, _view + _view_size);
+            _view = nullptr;
+            _view_size = 0;
+            _owner.reset();
+        }
+    }
+
+    const PacketIndexRecord* _view;
+    size_t _view_size;
+    std::shared_ptr<const void> _owner;
+    std::vector<PacketIndexRecord> _owned;
+};
+
+}
@@ -33,6 +33,7 @@
 
 #include <pangolin/log/sync_time.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/memory_mapped_file.h>
 #include <pangolin/utils/timer.h>
 
 namespace pangolin
@@ -68,6 +69,12 @@ public:
         return _stream.good();
     }
 
+    // True if seekable files are memory mapped so that Packet::Data() is available.
+    bool IsMapped() const
+    {
+        return _mapping != nullptr;
+    }
+
     // Jumps to a particular packet.
     size_t Seek(PacketStreamSourceId src, size_t framenum);
 
@@ -76,6 +83,31 @@ public:
 
     void FixFileIndex();
 
+    // Locate the data and metadata of a packet by index, without moving the
+    // read position, so that packets can be read ahead from other threads.
+    // data points into mapping, which keeps it valid even if the reader
+    // remaps a growing file in the meantime.
+    // Returns false if the file isn't mapped or the packet is not valid.
+    bool ReadPacket(PacketStreamSourceId src, size_t packet_id, std::shared_ptr<const MemoryMappedFile>& mapping, const unsigned char*& data, size_t& size, picojson::value& meta);
+
+    // Number of packets indexed for src so far, and the capture time of a
+    // packet (0 if not indexed). Unlike Sources(), these are safe to use while
+    // another thread extends the index through NextFrame() or UpdateIndex().
+    size_t IndexSize(PacketStreamSourceId src);
+
+    int64_t PacketTime(PacketStreamSourceId src, size_t packet_id);
+
+    // Capture time of the packet src will read next (0 if not indexed)
+    int64_t NextPacketTime(PacketStreamSourceId src);
+
+    // For files without a final index (still being written, or never closed)
+    // extends the index with any complete packets appended since it was last
+    // updated. NextFrame() calls this when it reaches the end of the index.
+    // Returns true if new packets were found. Once the file has finished,
+    // stopped growing for a while or can't be parsed, this always returns
+    // false.
+    bool UpdateIndex();
+
 private:
     bool GoodToRead();
 
@@ -87,8 +119,16 @@ private:
 
     bool ParseIndex();
 
+    bool ParseBinaryIndex(std::streampos footer_pos);
+
+    bool SetupCheckpointIndex();
+
+    void SkipCheckpoint();
+
     void RebuildIndex();
 
+    void RebuildIndexParallel(std::streampos start);
+
     void AppendIndex();
 
     std::streampos ParseFooter();
@@ -104,8 +144,22 @@ private:
     SyncTime::TimePoint packet_stream_start;
 
     PacketStream _stream;
+    // Replaced, rather than remapped, as a growing file is extended, since
+    // Packets may still hold the previous mapping.
+    std::shared_ptr<const MemoryMappedFile> _mapping;
     std::recursive_mutex _mutex;
 
+    // True if sources were written with index checkpoints enabled.
+    bool _has_checkpoints;
+
+    // True while a file indexed through checkpoints may still be appended to.
+    bool _growing;
+    size_t _growing_file_size;
+    basetime _growing_last_change;
+
+    // When indexed through checkpoints, packets are only read up to here.
+    std::streampos _index_end;
+
     bool _is_pipe;
     int _pipe_fd;
 };
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <pangolin/platform.h>
+#include <pangolin/log/packet_index.h>
 #include <pangolin/utils/picojson.h>
 
 namespace pangolin {
@@ -10,11 +11,7 @@ using PacketStreamSourceId = size_t;
 
 struct PANGOLIN_EXPORT PacketStreamSource
 {
-    struct PacketInfo
-    {
-        std::streampos pos;
-        int64_t capture_time;
-    };
+    using PacketInfo = PacketIndexRecord;
 
     PacketStreamSource()
         : id(static_cast<PacketStreamSourceId>(-1)),
@@ -54,7 +51,7 @@ struct PANGOLIN_EXPORT PacketStreamSource
     int64_t         data_size_bytes;
 
     // Index keyed by packet_id
-    std::vector<PacketInfo> index;
+    PacketIndex index;
 
     // Based on current position in stream
     size_t          next_packet_id;
@@ -16,6 +16,7 @@ const static std::string pss_src_info = "info";
 const static std::string pss_src_uri = "uri";
 const static std::string pss_src_packet = "packet";
 const static std::string pss_src_version = "version";
+const static std::string pss_src_checkpoints = "checkpoints";
 const static std::string pss_pkt_alignment_bytes = "alignment_bytes";
 const static std::string pss_pkt_definitions = "definitions";
 const static std::string pss_pkt_size_bytes = "size_bytes";
@@ -29,6 +30,8 @@ const PangoTagType TAG_PANGO_MAGIC  = PANGO_TAG('P', 'A', 'N');
 const PangoTagType TAG_PANGO_SYNC   = PANGO_TAG('S', 'Y', 'N');
 const PangoTagType TAG_PANGO_STATS  = PANGO_TAG('S', 'T', 'A');
 const PangoTagType TAG_PANGO_FOOTER = PANGO_TAG('F', 'T', 'R');
+const PangoTagType TAG_PANGO_INDEX  = PANGO_TAG('I', 'D', 'X');
+const PangoTagType TAG_PANGO_CHECKPOINT = PANGO_TAG('C', 'K', 'P');
 const PangoTagType TAG_ADD_SOURCE   = PANGO_TAG('S', 'R', 'C');
 const PangoTagType TAG_SRC_JSON     = PANGO_TAG('J', 'S', 'N');
 const PangoTagType TAG_SRC_PACKET   = PANGO_TAG('P', 'K', 'T');
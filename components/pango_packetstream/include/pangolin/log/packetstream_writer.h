@@ -35,18 +35,27 @@
 namespace pangolin
 {
 
+// Contiguous part of a packet's data
+struct PacketSegment
+{
+    const char* data;
+    size_t size;
+};
+
 class PANGOLIN_EXPORT PacketStreamWriter
 {
 public:
     PacketStreamWriter()
-        : _stream(&_buffer), _indexable(false), _open(false), _bytes_written(0)
+        : _stream(&_buffer), _indexable(false), _open(false), _bytes_written(0),
+          _max_alignment_padding(_buffer.write_alignment() - 1), _checkpoint_packets(0), _checkpoint_interval_us(0)
     {
         _stream.exceptions(std::ostream::badbit);
     }
 
     PacketStreamWriter(const std::string& filename, size_t buffer_size  = 100*1024*1024)
         : _buffer(pangolin::PathExpand(filename), buffer_size), _stream(&_buffer),
-          _indexable(!IsPipe(filename)), _open(_stream.good()), _bytes_written(0)
+          _indexable(!IsPipe(filename)), _open(_stream.good()), _bytes_written(0),
+          _max_alignment_padding(_buffer.write_alignment() - 1), _checkpoint_packets(0), _checkpoint_interval_us(0)
     {
         _stream.exceptions(std::ostream::badbit);
         WriteHeader();
@@ -56,10 +65,11 @@ public:
         Close();
     }
 
-    void Open(const std::string& filename, size_t buffer_size = 100 * 1024 * 1024)
+    // See threadedfilebuf::open for write_queue_depth and preallocate_bytes
+    void Open(const std::string& filename, size_t buffer_size = 100 * 1024 * 1024, size_t write_queue_depth = 1, size_t preallocate_bytes = 0)
     {
         Close();
-        _buffer.open(filename, buffer_size);
+        _buffer.open(filename, buffer_size, write_queue_depth, preallocate_bytes);
         _open = _stream.good();
         _bytes_written = 0;
         _indexable = !IsPipe(filename);
@@ -101,6 +111,38 @@ public:
         size_t sourcelen, const picojson::value& meta = picojson::value()
     );
 
+    // Write packet made up of segments, in order. The whole blocks of large
+    // segments are written to file from where they are rather than copied
+    // into the write buffer, where alignment allows (see
+    // SetAlignmentPadding). Partial blocks at either end are still copied.
+    // 'pin' is held until then, and must keep all segments valid and
+    // unchanged. Metadata is only written if meta is a non-empty value.
+    void WriteSourcePacket(
+        PacketStreamSourceId src, const std::vector<PacketSegment>& segments,
+        const int64_t receive_time_us, std::shared_ptr<const void> pin,
+        const picojson::value& meta = picojson::value()
+    );
+
+    // With direct i/o, large segments can only be written in place when they
+    // are aligned in the file as they are in memory. Up to max_bytes of
+    // whitespace may be added to a packet's metadata to line them up, adding
+    // a metadata block to packets without one. The default, one less than
+    // the write alignment, can line up any segment. 0 never pads, and
+    // misaligned segments are copied into the write buffer instead.
+    void SetAlignmentPadding(size_t max_bytes);
+
+    // Write an index checkpoint after every 'packets' packets, or with the
+    // first packet once 'interval_us' has elapsed since the last one. 0
+    // disables either condition. Checkpoints let readers seek within files
+    // which are still being written, or which were never closed. Must be
+    // set before sources are added, since sources record that the file has
+    // checkpoints.
+    void SetCheckpointInterval(size_t packets, int64_t interval_us);
+
+    // Write index checkpoint covering all packets since the previous one.
+    // Readers ignore checkpoints unless SetCheckpointInterval() enabled them.
+    void WriteCheckpoint();
+
     // For stream read/write synchronization. Note that this is NOT the same as
     // time synchronization on playback of iPacketStreams.
     void WriteSync();
@@ -117,18 +159,35 @@ public:
         return _open;
     }
 
+    ThreadedFileBufStats WriteStats() const {
+        return _buffer.stats();
+    }
+
 private:
     void WriteHeader();
     void Write(const PacketStreamSource&);
     void WriteMeta(PacketStreamSourceId src, const picojson::value& data);
+    void WritePacketHeader(PacketStreamSourceId src, const int64_t receive_time_us, size_t sourcelen);
+    void PacketWritten(size_t sourcelen);
 
     threadedfilebuf _buffer;
     std::ostream _stream;
     bool _indexable, _open;
 
+    void ResetCheckpoints();
+
     std::vector<PacketStreamSource> _sources;
     size_t _bytes_written;
     std::recursive_mutex _lock;
+
+    size_t _max_alignment_padding;
+
+    size_t _checkpoint_packets;
+    int64_t _checkpoint_interval_us;
+    uint64_t _last_checkpoint_pos;
+    int64_t _last_checkpoint_time_us;
+    size_t _packets_since_checkpoint;
+    std::vector<size_t> _checkpoint_index_start;
 };
 
 inline void writeCompressedUnsignedInt(std::ostream& writer, size_t n)
@@ -151,6 +210,41 @@ inline void writeTag(std::ostream& writer, const PangoTagType tag)
     writer.write(reinterpret_cast<const char*>(&tag), TAG_LENGTH);
 }
 
+// Pad with zeros from file offset pos to the next PACKET_INDEX_ALIGNMENT boundary
+inline void writeIndexPadding(std::ostream& writer, uint64_t pos)
+{
+    for(uint64_t p = pos; p < PacketIndexAlign(pos); ++p) {
+        writer.put(0);
+    }
+}
+
+// Write fixed-width binary index for srcs, as described in packet_index.h.
+// tag_pos is the file offset the index will be written at.
+inline void writeBinaryIndex(std::ostream& writer, const std::vector<PacketStreamSource>& srcs, uint64_t tag_pos)
+{
+    writeTag(writer, TAG_PANGO_INDEX);
+    writeIndexPadding(writer, tag_pos + TAG_LENGTH);
+
+    const uint32_t version = PACKET_INDEX_VERSION;
+    const uint32_t num_sources = static_cast<uint32_t>(srcs.size());
+    writer.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    writer.write(reinterpret_cast<const char*>(&num_sources), sizeof(num_sources));
+
+    for(auto& src : srcs) {
+        const uint64_t num_packets = src.index.size();
+        writer.write(reinterpret_cast<const char*>(&num_packets), sizeof(num_packets));
+    }
+
+    for(auto& src : srcs) {
+        writer.write(reinterpret_cast<const char*>(src.index.data()), src.index.size() * sizeof(PacketIndexRecord));
+    }
+}
+
+inline void writeBinaryIndex(std::ostream& writer, const std::vector<PacketStreamSource>& srcs)
+{
+    writeBinaryIndex(writer, srcs, static_cast<uint64_t>(writer.tellp()));
+}
+
 inline picojson::value SourceStats(const std::vector<PacketStreamSource>& srcs)
 {
     picojson::value stat;
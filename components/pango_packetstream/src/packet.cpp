@@ -3,8 +3,8 @@
 namespace pangolin {
 
 
-Packet::Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& lock, std::vector<PacketStreamSource>& srcs)
-    : _stream(s), lock(std::move(lock))
+Packet::Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& lock, std::vector<PacketStreamSource>& srcs, std::shared_ptr<const MemoryMappedFile> mapping)
+    : _stream(s), _mapping(std::move(mapping)), lock(std::move(lock))
 {
     ParsePacketHeader(s, srcs);
 }
@@ -12,7 +12,7 @@ Packet::Packet(PacketStream& s, std::unique_lock<std::recursive_mutex>&& lock, s
 Packet::Packet(Packet&& o)
     : src(o.src), time(o.time), size(o.size), sequence_num(o.sequence_num),
       meta(std::move(o.meta)), frame_streampos(o.frame_streampos), _stream(o._stream),
-      lock(std::move(o.lock)), data_streampos(o.data_streampos), _data_len(o._data_len)
+      _mapping(std::move(o._mapping)), lock(std::move(o.lock)), data_streampos(o.data_streampos), _data_len(o._data_len)
 {
     o._data_len = 0;
 }
@@ -36,6 +36,17 @@ int Packet::BytesRemaining() const
     }
 }
 
+const unsigned char* Packet::Data() const
+{
+    if(_mapping && _mapping->IsOpen()) {
+        const size_t start = static_cast<size_t>(std::streamoff(data_streampos));
+        if(start + size <= _mapping->Size()) {
+            return _mapping->Data() + start;
+        }
+    }
+    return nullptr;
+}
+
 void Packet::ParsePacketHeader(PacketStream& s, std::vector<PacketStreamSource>& srcs)
 {
     size_t json_src = -1;
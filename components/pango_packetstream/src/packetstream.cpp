@@ -112,6 +112,8 @@ static bool valid(PangoTagType t)
         case TAG_SRC_PACKET:
         case TAG_PANGO_STATS:
         case TAG_PANGO_FOOTER:
+        case TAG_PANGO_INDEX:
+        case TAG_PANGO_CHECKPOINT:
         case TAG_END:
         case TAG_PANGO_HDR:
         case TAG_PANGO_MAGIC:
@@ -25,6 +25,11 @@
 
 #include <pangolin/log/packetstream_reader.h>
 #include <pangolin/log/packetstream_writer.h>
+#include <pangolin/utils/memory_mapped_file.h>
+#include <pangolin/utils/memstreambuf.h>
+
+#include <cstdio>
+#include <cstring>
 
 using std::string;
 using std::istream;
@@ -35,22 +40,296 @@ using std::ios_base;
 using std::streampos;
 using std::streamoff;
 
+#include <algorithm>
+#include <future>
 #include <thread>
 
 #ifndef _WIN_
+#  include <fcntl.h>
 #  include <unistd.h>
+#else
+#  include <Windows.h>
 #endif
 
 namespace pangolin
 {
 
+namespace
+{
+
+// Number of consecutive items that must parse before we trust a resync point
+// found by scanning raw bytes.
+const size_t scan_sync_chain = 4;
+
+// Smallest span of the file given to each rebuild thread.
+const uint64_t scan_min_chunk_bytes = 16*1024*1024;
+
+// How far back from the end of a file to look for the last checkpoint before
+// falling back to a rebuild.
+const uint64_t checkpoint_search_bytes = 64*1024*1024;
+
+// A growing file which hasn't changed for this long is assumed to have been
+// abandoned by its writer.
+const double growing_timeout_s = 10.0;
+
+std::shared_ptr<const MemoryMappedFile> MapFile(const std::string& filename)
+{
+    auto mapping = std::make_shared<MemoryMappedFile>(filename);
+    if(!mapping->IsOpen()) mapping.reset();
+    return mapping;
+}
+
+enum class ScanResult
+{
+    Packet,  // Complete packet (with any preceding metadata)
+    Source,  // TAG_ADD_SOURCE, which must be parsed in order
+    Skip,    // Sync / magic markers carrying no data
+    End,     // End of packet data (index, footer or end of file)
+    Invalid  // Not a packet boundary
+};
+
+struct MappedCheckpoint
+{
+    uint64_t pos;
+    uint64_t prev_pos;
+    uint32_t num_sources;
+    uint64_t counts_pos;
+    uint64_t records_pos;
+    uint64_t end;
+};
+
+// Parses packet headers directly from a mapped packetstream. Mirrors what
+// Packet::ParsePacketHeader reads, without touching PacketStreamSource state,
+// so that independent regions of a file can be scanned concurrently.
+struct MappedPacketScanner
+{
+    const unsigned char* data;
+    uint64_t size;
+
+    bool ReadTag(uint64_t& p, PangoTagType& tag) const
+    {
+        if(p + TAG_LENGTH > size) return false;
+        tag = data[p] | (data[p+1] << 8) | (data[p+2] << 16);
+        p += TAG_LENGTH;
+        return true;
+    }
+
+    bool ReadUINT(uint64_t& p, uint64_t& n) const
+    {
+        n = 0;
+        for(uint32_t shift = 0; p < size && shift < 64; shift += 7) {
+            const uint64_t v = data[p++];
+            n |= (v & 0x7F) << shift;
+            if(!(v & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool SkipJson(uint64_t& p) const
+    {
+        picojson::null_parse_context ctx;
+        std::string err;
+        const char* begin = reinterpret_cast<const char*>(data);
+        const char* end = picojson::_parse(ctx, begin + p, begin + size, &err);
+        p = end - begin;
+        return err.empty();
+    }
+
+    bool ReadJson(uint64_t& p, picojson::value& json) const
+    {
+        picojson::default_parse_context ctx(&json);
+        std::string err;
+        const char* begin = reinterpret_cast<const char*>(data);
+        const char* end = picojson::_parse(ctx, begin + p, begin + size, &err);
+        p = end - begin;
+        return err.empty();
+    }
+
+    // Parse checkpoint whose tag is at tag_pos. Returns Skip if valid, End if
+    // it runs past the end of the mapping and Invalid otherwise.
+    ScanResult ReadCheckpoint(uint64_t tag_pos, MappedCheckpoint& cp) const
+    {
+        uint64_t p = PacketIndexAlign(tag_pos + TAG_LENGTH);
+        const uint64_t counts_pos = p + 2*sizeof(uint32_t) + sizeof(uint64_t);
+        if(counts_pos > size) return ScanResult::End;
+
+        uint32_t version;
+        std::memcpy(&version, data + p, sizeof(version));
+        std::memcpy(&cp.num_sources, data + p + sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&cp.prev_pos, data + p + 2*sizeof(uint32_t), sizeof(uint64_t));
+        if(version != PACKET_CHECKPOINT_VERSION || cp.prev_pos >= tag_pos) return ScanResult::Invalid;
+
+        cp.pos = tag_pos;
+        cp.counts_pos = counts_pos;
+        cp.records_pos = counts_pos + uint64_t(cp.num_sources) * sizeof(uint64_t);
+        if(cp.records_pos > size) return ScanResult::End;
+
+        uint64_t num_records = 0;
+        for(uint32_t s=0; s < cp.num_sources; ++s) {
+            uint64_t n;
+            std::memcpy(&n, data + counts_pos + s*sizeof(uint64_t), sizeof(n));
+            if(n > size) return ScanResult::Invalid;
+            num_records += n;
+        }
+
+        const uint64_t trailer_pos = cp.records_pos + num_records * sizeof(PacketIndexRecord);
+        cp.end = trailer_pos + sizeof(uint64_t) + sizeof(PACKET_CHECKPOINT_MAGIC);
+        if(num_records > size || cp.end > size) return ScanResult::End;
+
+        uint64_t self_pos;
+        std::memcpy(&self_pos, data + trailer_pos, sizeof(self_pos));
+        if(self_pos != tag_pos || std::memcmp(data + trailer_pos + sizeof(uint64_t), PACKET_CHECKPOINT_MAGIC, sizeof(PACKET_CHECKPOINT_MAGIC))) {
+            return ScanResult::Invalid;
+        }
+        return ScanResult::Skip;
+    }
+
+    uint64_t CheckpointPackets(const MappedCheckpoint& cp, uint32_t src) const
+    {
+        uint64_t n;
+        std::memcpy(&n, data + cp.counts_pos + src*sizeof(uint64_t), sizeof(n));
+        return n;
+    }
+
+    ScanResult Scan(
+        uint64_t p, const std::vector<PacketStreamSource>& srcs,
+        PacketIndexRecord& rec, size_t& src, uint64_t& next
+    ) const {
+        const uint64_t start = p;
+        PangoTagType tag;
+        if(!ReadTag(p, tag)) return ScanResult::End;
+
+        uint64_t json_src = uint64_t(-1);
+
+        switch(tag) {
+        case TAG_SRC_JSON:
+            if(!ReadUINT(p, json_src) || !SkipJson(p) || !ReadTag(p, tag) || tag != TAG_SRC_PACKET) {
+                return ScanResult::Invalid;
+            }
+            [[fallthrough]];
+        case TAG_SRC_PACKET:
+        {
+            int64_t time;
+            uint64_t packet_src;
+            if(p + sizeof(time) > size) return ScanResult::End;
+            std::memcpy(&time, data + p, sizeof(time));
+            p += sizeof(time);
+            if(!ReadUINT(p, packet_src) || packet_src >= srcs.size()) return ScanResult::Invalid;
+            if(json_src != uint64_t(-1) && json_src != packet_src) return ScanResult::Invalid;
+
+            uint64_t len = static_cast<uint64_t>(srcs[packet_src].data_size_bytes);
+            if(!len && !ReadUINT(p, len)) return ScanResult::Invalid;
+
+            // Truncated final packet (e.g. recording was killed)
+            if(len > size - p) return ScanResult::End;
+
+            rec = {static_cast<int64_t>(start), time};
+            src = packet_src;
+            next = p + len;
+            return ScanResult::Packet;
+        }
+        case TAG_PANGO_SYNC:
+            next = p;
+            return ScanResult::Skip;
+        case TAG_PANGO_MAGIC:
+            // Remainder of 'PANGO'
+            next = p + 2;
+            return ScanResult::Skip;
+        case TAG_PANGO_CHECKPOINT:
+        {
+            MappedCheckpoint cp;
+            const ScanResult r = ReadCheckpoint(start, cp);
+            next = cp.end;
+            return r;
+        }
+        case TAG_ADD_SOURCE:
+            return ScanResult::Source;
+        case TAG_PANGO_STATS:
+        case TAG_PANGO_INDEX:
+        case TAG_PANGO_FOOTER:
+            return ScanResult::End;
+        default:
+            return ScanResult::Invalid;
+        }
+    }
+
+    // First position in [begin,end) which looks like a packet boundary and
+    // is followed by a chain of valid items. Returns end if there is none.
+    uint64_t FindSync(uint64_t begin, uint64_t end, const std::vector<PacketStreamSource>& srcs) const
+    {
+        PacketIndexRecord rec;
+        size_t src;
+        for(uint64_t p = begin; p < end; ++p) {
+            PangoTagType tag;
+            uint64_t q = p;
+            if(!ReadTag(q, tag)) return end;
+            if(tag != TAG_SRC_PACKET && tag != TAG_SRC_JSON) continue;
+
+            size_t packets = 0;
+            bool good = true;
+            q = p;
+            for(size_t i=0; good && i < scan_sync_chain; ++i) {
+                uint64_t next;
+                const ScanResult r = Scan(q, srcs, rec, src, next);
+                if(r == ScanResult::Packet) {
+                    ++packets;
+                    q = next;
+                }else if(r == ScanResult::Skip) {
+                    q = next;
+                }else{
+                    good = (r == ScanResult::End || r == ScanResult::Source) && packets > 0;
+                    break;
+                }
+            }
+            if(good) return p;
+        }
+        return end;
+    }
+};
+
+struct ScannedPacket
+{
+    PacketIndexRecord rec;
+    size_t src;
+};
+
+struct ScannedChunk
+{
+    uint64_t begin;
+    uint64_t end;
+    // Contiguous chain of packets found from the first sync point in chunk
+    std::vector<ScannedPacket> packets;
+    // Position at which the chain stopped
+    uint64_t stop;
+};
+
+void ScanChunk(const MappedPacketScanner& scanner, const std::vector<PacketStreamSource>& srcs, ScannedChunk& chunk)
+{
+    uint64_t p = scanner.FindSync(chunk.begin, chunk.end, srcs);
+    while(p < chunk.end) {
+        ScannedPacket pkt;
+        uint64_t next;
+        const ScanResult r = scanner.Scan(p, srcs, pkt.rec, pkt.src, next);
+        if(r == ScanResult::Packet) {
+            chunk.packets.push_back(pkt);
+        }else if(r != ScanResult::Skip) {
+            // Sources must be added in order, so are left for the merge.
+            break;
+        }
+        p = next;
+    }
+    chunk.stop = p;
+}
+
+}
+
 PacketStreamReader::PacketStreamReader()
-    : _pipe_fd(-1)
+    : _has_checkpoints(false), _growing(false), _growing_file_size(0), _index_end(0), _pipe_fd(-1)
 {
 }
 
 PacketStreamReader::PacketStreamReader(const std::string& filename)
-    : _pipe_fd(-1)
+    : _has_checkpoints(false), _growing(false), _growing_file_size(0), _index_end(0), _pipe_fd(-1)
 {
     Open(filename);
 }
@@ -91,7 +370,14 @@ void PacketStreamReader::Open(const std::string& filename)
         ParseNewSource();
     }
 
-    if(!SetupIndex()) {
+    // Packets can be handed out as views of the mapping, and the index
+    // rebuilt from it in parallel. If mapping fails (e.g. address space on
+    // 32bit), we read through _stream only.
+    if(_stream.seekable()) {
+        _mapping = MapFile(_filename);
+    }
+
+    if(!SetupIndex() && !(_has_checkpoints && SetupCheckpointIndex())) {
         FixFileIndex();
     }
 }
@@ -100,7 +386,11 @@ void PacketStreamReader::Close() {
     std::lock_guard<std::recursive_mutex> lg(_mutex);
 
     _stream.close();
+    _mapping.reset();
     _sources.clear();
+    _has_checkpoints = false;
+    _growing = false;
+    _index_end = 0;
 
 #ifndef _WIN_
     if (_pipe_fd != -1) {
@@ -146,6 +436,10 @@ void PacketStreamReader::ParseNewSource()
     pss.data_alignment_bytes = json[pss_src_packet][pss_pkt_alignment_bytes].get<int64_t>();
     pss.data_definitions = json[pss_src_packet][pss_pkt_definitions].get<string>();
     pss.data_size_bytes = json[pss_src_packet][pss_pkt_size_bytes].get<int64_t>();
+
+    if(json.contains(pss_src_checkpoints) && json[pss_src_checkpoints].evaluate_as_boolean()) {
+        _has_checkpoints = true;
+    }
 }
 
 bool PacketStreamReader::SetupIndex()
@@ -159,12 +453,17 @@ bool PacketStreamReader::SetupIndex()
 
         // Look for footer at end of file (TAG_PANGO_FOOTER + index position).
         _stream.seekg(-(static_cast<istream::off_type>(sizeof(uint64_t)) + TAG_LENGTH), ios_base::end);
+        const std::streampos footer_pos = _stream.tellg();
         if (_stream.peekTag() == TAG_PANGO_FOOTER)
         {
             //parsing the footer returns the index position
             _stream.seekg(ParseFooter());
-            if (_stream.peekTag() == TAG_PANGO_STATS) {
-                // Read the pre-build index from the file
+            const PangoTagType index_tag = _stream.peekTag();
+            if (index_tag == TAG_PANGO_INDEX) {
+                // Map the fixed-width binary index in place
+                index_good = ParseBinaryIndex(footer_pos);
+            }else if (index_tag == TAG_PANGO_STATS) {
+                // Older files store their index as JSON
                 index_good = ParseIndex();
             }
         }
@@ -209,17 +508,100 @@ bool PacketStreamReader::ParseIndex()
         // Populate index
         for(size_t i=0; i < _sources.size(); ++i) {
             PANGO_ENSURE(json_index[i].size() == json_times[i].size());
-            _sources[i].index.resize(json_index[i].size());
+            std::vector<PacketStreamSource::PacketInfo> index(json_index[i].size());
             for(size_t f=0; f < json_index[i].size(); ++f) {
-                _sources[i].index[f].pos = json_index[i][f].get<int64_t>();
-                _sources[i].index[f].capture_time = json_times[i][f].get<int64_t>();
+                index[f].pos = json_index[i][f].get<int64_t>();
+                index[f].capture_time = json_times[i][f].get<int64_t>();
             }
+            _sources[i].index = PacketIndex(std::move(index));
         }
     }
 
     return index_good;
 }
 
+bool PacketStreamReader::ParseBinaryIndex(std::streampos footer_pos)
+{
+    const uint64_t tag_pos = static_cast<uint64_t>(_stream.tellg());
+    _stream.readTag(TAG_PANGO_INDEX);
+
+    const uint64_t header_pos = PacketIndexAlign(tag_pos + TAG_LENGTH);
+    const uint64_t end_pos = static_cast<uint64_t>(footer_pos);
+    if(end_pos < header_pos || end_pos - header_pos < 2*sizeof(uint32_t)) {
+        return false;
+    }
+    const size_t length = static_cast<size_t>(end_pos - header_pos);
+
+    // Records are used in place from the mapping. If the file can't be
+    // mapped, read the same bytes into memory instead.
+    std::shared_ptr<const void> owner;
+    const unsigned char* data = nullptr;
+    auto mapping = std::make_shared<MemoryMappedFile>(_filename, header_pos, length);
+    if(mapping->IsOpen() && mapping->Size() == length) {
+        data = mapping->Data();
+        owner = mapping;
+    }else{
+        auto buffer = std::make_shared<std::vector<unsigned char>>(length);
+        _stream.seekg(header_pos);
+        if(_stream.read(reinterpret_cast<char*>(buffer->data()), length) != length) {
+            return false;
+        }
+        data = buffer->data();
+        owner = buffer;
+    }
+
+    uint32_t version = 0;
+    uint32_t num_sources = 0;
+    std::memcpy(&version, data, sizeof(version));
+    std::memcpy(&num_sources, data + sizeof(version), sizeof(num_sources));
+
+    if(version != PACKET_INDEX_VERSION) {
+        pango_print_warn("Unsupported packet index version %u in '%s'.\n", version, _filename.c_str());
+        return false;
+    }
+
+    const size_t counts_offset = 2*sizeof(uint32_t);
+    if(num_sources > (length - counts_offset) / sizeof(uint64_t)) {
+        return false;
+    }
+    const size_t records_offset = counts_offset + num_sources * sizeof(uint64_t);
+
+    // We shouldn't have seen more sources than exist in the index, otherwise
+    // it's stale or from another file, and will be rebuilt.
+    if(_sources.size() > num_sources) {
+        return false;
+    }
+
+    std::vector<uint64_t> num_packets(num_sources);
+    std::memcpy(num_packets.data(), data + counts_offset, num_sources * sizeof(uint64_t));
+
+    // Every count must fit within the records left, so that corrupt counts
+    // can't overflow their sum or its size in bytes.
+    if((length - records_offset) % sizeof(PacketIndexRecord)) {
+        return false;
+    }
+    uint64_t records_left = (length - records_offset) / sizeof(PacketIndexRecord);
+    for(uint64_t n : num_packets) {
+        if(n > records_left) {
+            return false;
+        }
+        records_left -= n;
+    }
+    if(records_left) {
+        return false;
+    }
+
+    _sources.resize(num_sources);
+
+    const PacketIndexRecord* records = reinterpret_cast<const PacketIndexRecord*>(data + records_offset);
+    for(size_t i=0; i < _sources.size(); ++i) {
+        _sources[i].index = PacketIndex(records, num_packets[i], owner);
+        records += num_packets[i];
+    }
+
+    return true;
+}
+
 bool PacketStreamReader::GoodToRead()
 {
     if(!_stream.good()) {
@@ -258,6 +640,11 @@ Packet PacketStreamReader::NextFrame()
 
     while (GoodToRead())
     {
+        // Only read what has been indexed from files which were indexed
+        // through checkpoints, since anything beyond may be incomplete.
+        if (_index_end != std::streampos(0) && _stream.tellg() >= _index_end && !UpdateIndex())
+            throw std::runtime_error("PacketStreamReader: no frame");
+
         const PangoTagType t = _stream.peekTag();
 
         switch (t)
@@ -270,10 +657,14 @@ Packet PacketStreamReader::NextFrame()
             break;
         case TAG_SRC_JSON: //frames are sometimes preceded by metadata, but metadata must ALWAYS be followed by a frame from the same source.
         case TAG_SRC_PACKET:
-            return Packet(_stream, std::move(lock), _sources);
+            return Packet(_stream, std::move(lock), _sources, _mapping);
         case TAG_PANGO_STATS:
             ParseIndex();
             break;
+        case TAG_PANGO_CHECKPOINT:
+            SkipCheckpoint();
+            break;
+        case TAG_PANGO_INDEX: //index is always followed by footer
         case TAG_PANGO_FOOTER: //end of frames
         case TAG_END:
             throw std::runtime_error("PacketStreamReader: end of stream");
@@ -306,6 +697,228 @@ Packet PacketStreamReader::NextFrame(PacketStreamSourceId src)
     }
 }
 
+bool PacketStreamReader::ReadPacket(PacketStreamSourceId src, size_t packet_id, std::shared_ptr<const MemoryMappedFile>& mapping, const unsigned char*& data, size_t& size, picojson::value& meta)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+
+    if(!_mapping || src >= _sources.size() || packet_id >= _sources[src].index.size()) {
+        return false;
+    }
+
+    const MappedPacketScanner scanner = {_mapping->Data(), _mapping->Size()};
+    uint64_t p = static_cast<uint64_t>(_sources[src].index[packet_id].pos);
+    PangoTagType tag;
+    uint64_t packet_src;
+    meta = picojson::value();
+
+    if(!scanner.ReadTag(p, tag)) return false;
+    if(tag == TAG_SRC_JSON) {
+        if(!scanner.ReadUINT(p, packet_src) || !scanner.ReadJson(p, meta) || !scanner.ReadTag(p, tag)) {
+            return false;
+        }
+    }
+    p += sizeof(int64_t);
+    if(tag != TAG_SRC_PACKET || !scanner.ReadUINT(p, packet_src) || packet_src != src) {
+        return false;
+    }
+
+    uint64_t len = static_cast<uint64_t>(_sources[src].data_size_bytes);
+    if((!len && !scanner.ReadUINT(p, len)) || p > scanner.size || len > scanner.size - p) {
+        return false;
+    }
+
+    mapping = _mapping;
+    data = scanner.data + p;
+    size = static_cast<size_t>(len);
+    return true;
+}
+
+size_t PacketStreamReader::IndexSize(PacketStreamSourceId src)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    return src < _sources.size() ? _sources[src].index.size() : 0;
+}
+
+int64_t PacketStreamReader::PacketTime(PacketStreamSourceId src, size_t packet_id)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    if(src < _sources.size() && packet_id < _sources[src].index.size()) {
+        return _sources[src].index[packet_id].capture_time;
+    }
+    return 0;
+}
+
+int64_t PacketStreamReader::NextPacketTime(PacketStreamSourceId src)
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+    return src < _sources.size() ? _sources[src].NextPacketTime() : 0;
+}
+
+bool PacketStreamReader::SetupCheckpointIndex()
+{
+    if(!_mapping) return false;
+
+    const MappedPacketScanner scanner = {_mapping->Data(), _mapping->Size()};
+    const uint64_t data_start = static_cast<uint64_t>(std::streamoff(_stream.tellg()));
+    const size_t magic_size = sizeof(PACKET_CHECKPOINT_MAGIC);
+
+    // Find the most recent checkpoint within the tail of the file. Its
+    // trailer is aligned, so only aligned offsets need testing.
+    MappedCheckpoint last = {};
+    bool found = false;
+    if(scanner.size >= data_start + magic_size + sizeof(uint64_t)) {
+        const uint64_t search_start = std::max(data_start, scanner.size - std::min(scanner.size, checkpoint_search_bytes)) + sizeof(uint64_t);
+        for(uint64_t m = (scanner.size - magic_size) & ~(PACKET_INDEX_ALIGNMENT-1);
+            !found && m >= search_start; m -= PACKET_INDEX_ALIGNMENT)
+        {
+            if(!std::memcmp(scanner.data + m, PACKET_CHECKPOINT_MAGIC, magic_size)) {
+                uint64_t tag_pos;
+                std::memcpy(&tag_pos, scanner.data + m - sizeof(uint64_t), sizeof(tag_pos));
+                PangoTagType tag;
+                uint64_t q = tag_pos;
+                found = tag_pos >= data_start && tag_pos < m &&
+                        scanner.ReadTag(q, tag) && tag == TAG_PANGO_CHECKPOINT &&
+                        scanner.ReadCheckpoint(tag_pos, last) == ScanResult::Skip &&
+                        last.end == m + magic_size;
+            }
+        }
+    }
+    if(!found) return false;
+
+    // Follow chain back to the first checkpoint
+    std::vector<MappedCheckpoint> chain = {last};
+    while(chain.back().prev_pos) {
+        MappedCheckpoint cp;
+        if(chain.back().prev_pos < data_start || scanner.ReadCheckpoint(chain.back().prev_pos, cp) != ScanResult::Skip) {
+            pango_print_warn("Broken checkpoint chain in '%s'.\n", _filename.c_str());
+            return false;
+        }
+        chain.push_back(cp);
+    }
+
+    std::vector<std::vector<PacketIndexRecord>> index(_sources.size());
+    for(auto cp = chain.rbegin(); cp != chain.rend(); ++cp) {
+        if(index.size() < cp->num_sources) {
+            index.resize(cp->num_sources);
+        }
+        const PacketIndexRecord* records = reinterpret_cast<const PacketIndexRecord*>(scanner.data + cp->records_pos);
+        for(uint32_t s=0; s < cp->num_sources; ++s) {
+            const uint64_t n = scanner.CheckpointPackets(*cp, s);
+            index[s].insert(index[s].end(), records, records + n);
+            records += n;
+        }
+    }
+
+    // Sources may have been added after the header
+    PANGO_ENSURE(_sources.size() <= index.size());
+    _sources.resize(index.size());
+    for(size_t s=0; s < _sources.size(); ++s) {
+        _sources[s].index = PacketIndex(std::move(index[s]));
+    }
+
+    // The writer may still be appending to this file, so we don't write an
+    // index to it. Packets after the last checkpoint are picked up below.
+    _growing = true;
+    _growing_file_size = _mapping->FileSize();
+    _growing_last_change = TimeNow();
+    _index_end = last.end;
+    UpdateIndex();
+
+    // Sources added after the header are only described before the last
+    // checkpoint, so in that case we fall back to a full rebuild.
+    for(PacketStreamSource& s : _sources) {
+        if(s.id == static_cast<PacketStreamSourceId>(-1)) {
+            _growing = false;
+            _index_end = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PacketStreamReader::UpdateIndex()
+{
+    lock_guard<decltype(_mutex)> lg(_mutex);
+
+    if(!_growing) return false;
+
+    // Map again to include data appended since we last looked. Packets may
+    // still be using the current mapping, so it is replaced, not remapped.
+    std::shared_ptr<const MemoryMappedFile> mapping = MapFile(_filename);
+    if(!mapping) return false;
+
+    if(mapping->FileSize() != _growing_file_size) {
+        _growing_file_size = mapping->FileSize();
+        _growing_last_change = TimeNow();
+    }else if(TimeDiff_s(_growing_last_change, TimeNow()) > growing_timeout_s) {
+        // Index what is complete one last time.
+        pango_print_warn("'%s' has stopped growing. Recording was probably interrupted.\n", _filename.c_str());
+        _growing = false;
+    }
+    _mapping = mapping;
+
+    const MappedPacketScanner scanner = {_mapping->Data(), _mapping->Size()};
+    const std::streampos read_pos = _stream.tellg();
+    bool found = false;
+
+    uint64_t p = static_cast<uint64_t>(std::streamoff(_index_end));
+    while(p < scanner.size) {
+        ScannedPacket pkt;
+        uint64_t next;
+        const ScanResult r = scanner.Scan(p, _sources, pkt.rec, pkt.src, next);
+        if(r == ScanResult::Packet) {
+            _sources[pkt.src].index.push_back(pkt.rec);
+            found = true;
+        }else if(r == ScanResult::Source) {
+            _stream.clear();
+            _stream.seekg(p);
+            ParseNewSource();
+            next = static_cast<uint64_t>(std::streamoff(_stream.tellg()));
+        }else if(r == ScanResult::Invalid) {
+            pango_print_warn("Unexpected data at %llu in '%s'. No longer following the file.\n", (unsigned long long)p, _filename.c_str());
+            _growing = false;
+            break;
+        }else if(r == ScanResult::End) {
+            // Either incomplete data, or the writer has finished and written
+            // its index.
+            PangoTagType tag;
+            uint64_t q = p;
+            if(scanner.ReadTag(q, tag) && (tag == TAG_PANGO_INDEX || tag == TAG_PANGO_STATS || tag == TAG_PANGO_FOOTER)) {
+                _growing = false;
+            }
+            break;
+        }
+        p = next;
+    }
+    _index_end = p;
+
+    _stream.clear();
+    _stream.seekg(read_pos);
+
+    return found;
+}
+
+void PacketStreamReader::SkipCheckpoint()
+{
+    const uint64_t tag_pos = static_cast<uint64_t>(std::streamoff(_stream.tellg()));
+    _stream.readTag(TAG_PANGO_CHECKPOINT);
+    _stream.skip(PacketIndexAlign(tag_pos + TAG_LENGTH) - tag_pos - TAG_LENGTH);
+
+    uint32_t header[2];
+    uint64_t prev_pos;
+    _stream.read(reinterpret_cast<char*>(header), sizeof(header));
+    _stream.read(reinterpret_cast<char*>(&prev_pos), sizeof(prev_pos));
+
+    uint64_t num_records = 0;
+    for(uint32_t s=0; s < header[1] && _stream.good(); ++s) {
+        uint64_t n = 0;
+        _stream.read(reinterpret_cast<char*>(&n), sizeof(n));
+        num_records += n;
+    }
+    _stream.skip(num_records * sizeof(PacketIndexRecord) + sizeof(uint64_t) + sizeof(PACKET_CHECKPOINT_MAGIC));
+}
+
 void PacketStreamReader::RebuildIndex()
 {
     lock_guard<decltype(_mutex)> lg(_mutex);
@@ -322,17 +935,33 @@ void PacketStreamReader::RebuildIndex()
             s.next_packet_id = 0;
         }
 
-        // Read through entire file, updating index
-        try{
-            while (1)
-            {
-                // This will throw if we've run out of frames
-                auto fi = NextFrame();
-                PacketStreamSource& s = _sources[fi.src];
-                PANGO_ENSURE(s.index.size() == fi.sequence_num);
-                s.index.push_back({fi.frame_streampos, fi.time});
+        if(_mapping) {
+            RebuildIndexParallel(pos);
+        }else{
+            _stream.seekg(0, ios_base::end);
+            const std::streampos file_end = _stream.tellg();
+            _stream.clear();
+            _stream.seekg(pos);
+
+            // Read through entire file, updating index
+            try{
+                while (1)
+                {
+                    // This will throw if we've run out of frames
+                    auto fi = NextFrame();
+
+                    // Truncated final packet (e.g. recording was killed),
+                    // as MappedPacketScanner::Scan rejects it.
+                    if(fi.Stream().tellg() + std::streamoff(fi.BytesRemaining()) > file_end) {
+                        break;
+                    }
+
+                    PacketStreamSource& s = _sources[fi.src];
+                    PANGO_ENSURE(s.index.size() == fi.sequence_num);
+                    s.index.push_back({fi.frame_streampos, fi.time});
+                }
+            }catch(...){
             }
-        }catch(...){
         }
 
         // Reset Packet id's
@@ -346,22 +975,156 @@ void PacketStreamReader::RebuildIndex()
     }
 }
 
+void PacketStreamReader::RebuildIndexParallel(std::streampos start)
+{
+    const MappedPacketScanner scanner = {_mapping->Data(), _mapping->Size()};
+    const uint64_t begin = static_cast<uint64_t>(std::streamoff(start));
+    const uint64_t end = scanner.size;
+    if(begin >= end) return;
+
+    // Split file into chunks which are each resynchronised to a packet
+    // boundary and scanned independently.
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const uint64_t chunk_bytes = std::max(scan_min_chunk_bytes, (end - begin) / (4*num_threads) + 1);
+
+    std::vector<ScannedChunk> chunks;
+    for(uint64_t b = begin; b < end; b += chunk_bytes) {
+        chunks.push_back({b, std::min(end, b + chunk_bytes), {}, b});
+    }
+
+    const std::vector<PacketStreamSource>& srcs = _sources;
+    std::vector<std::future<void>> work;
+    for(size_t t=0; t < std::min<size_t>(num_threads, chunks.size()); ++t) {
+        work.push_back(std::async(std::launch::async, [&, t](){
+            for(size_t c = t; c < chunks.size(); c += num_threads) {
+                ScanChunk(scanner, srcs, chunks[c]);
+            }
+        }));
+    }
+    for(auto& w : work) w.get();
+
+    // Merge by following the true packet chain from the start of the data.
+    // Each chunk's results are used from the point its chain coincides with
+    // ours; anything else (sources, corruption, a missed sync) is stepped
+    // over one item at a time here.
+    uint64_t p = begin;
+    for(const ScannedChunk& chunk : chunks) {
+        while(p < chunk.end) {
+            auto it = std::lower_bound(chunk.packets.begin(), chunk.packets.end(), p,
+                [](const ScannedPacket& a, uint64_t pos){ return static_cast<uint64_t>(a.rec.pos) < pos; }
+            );
+            if(it != chunk.packets.end() && static_cast<uint64_t>(it->rec.pos) == p) {
+                for(; it != chunk.packets.end(); ++it) {
+                    _sources[it->src].index.push_back(it->rec);
+                }
+                p = chunk.stop;
+                continue;
+            }
+
+            ScannedPacket pkt;
+            uint64_t next;
+            switch(scanner.Scan(p, _sources, pkt.rec, pkt.src, next)) {
+            case ScanResult::Packet:
+                _sources[pkt.src].index.push_back(pkt.rec);
+                p = next;
+                break;
+            case ScanResult::Skip:
+                p = next;
+                break;
+            case ScanResult::Source:
+                _stream.clear();
+                _stream.seekg(p);
+                ParseNewSource();
+                p = static_cast<uint64_t>(std::streamoff(_stream.tellg()));
+                break;
+            case ScanResult::End:
+                return;
+            case ScanResult::Invalid:
+                pango_print_warn("Unexpected data at %llu in '%s'. Resyncing.\n", (unsigned long long)p, _filename.c_str());
+                p = scanner.FindSync(p + 1, end, _sources);
+                break;
+            }
+        }
+    }
+}
+
 void PacketStreamReader::AppendIndex()
 {
     lock_guard<decltype(_mutex)> lg(_mutex);
 
-    if(_stream.seekable()) {
-        // Open file again for append
-        std::ofstream of(_filename, std::ios::app | std::ios::binary);
-        if(of.is_open()) {
-            pango_print_warn("Appending new index to '%s'.\n", _filename.c_str());
-            uint64_t indexpos = (uint64_t)of.tellp();
-            writeTag(of, TAG_PANGO_STATS);
-            SourceStats(_sources).serialize(std::ostream_iterator<char>(of), false);
-            writeTag(of, TAG_PANGO_FOOTER);
-            of.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
+    if(!_stream.seekable()) return;
+
+    // The footer is the commit point: it is only written once the index it
+    // points to is on disk, so an interrupted append leaves a file that still
+    // reads as unindexed rather than one with a bad index.
+    auto make_buffers = [this](uint64_t indexpos, memstreambuf& index_buf, memstreambuf& footer_buf) {
+        std::ostream index_stream(&index_buf);
+        writeBinaryIndex(index_stream, _sources, indexpos);
+
+        std::ostream footer_stream(&footer_buf);
+        writeTag(footer_stream, TAG_PANGO_FOOTER);
+        footer_stream.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
+    };
+
+    memstreambuf index_buf(0);
+    memstreambuf footer_buf(TAG_LENGTH + sizeof(uint64_t));
+
+#ifndef _WIN_
+    const int fd = ::open(_filename.c_str(), O_WRONLY | O_APPEND);
+    if(fd == -1) return;
+
+    pango_print_warn("Appending new index to '%s'.\n", _filename.c_str());
+    make_buffers(static_cast<uint64_t>(lseek(fd, 0, SEEK_END)), index_buf, footer_buf);
+
+    auto write_all = [fd](const unsigned char* data, size_t size) {
+        while(size) {
+            const ssize_t written = ::write(fd, data, size);
+            if(written <= 0) return false;
+            data += written;
+            size -= written;
         }
+        return true;
+    };
+
+    if( !write_all(index_buf.data(), index_buf.size()) || fsync(fd) ||
+        !write_all(footer_buf.data(), footer_buf.size()) || fsync(fd) )
+    {
+        pango_print_warn("Unable to write index to '%s'.\n", _filename.c_str());
     }
+    ::close(fd);
+#else
+    // Shares access with our own read handle and mapping, which only ever
+    // see the packets that were already there.
+    const HANDLE file = CreateFileA(
+        _filename.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if(file == INVALID_HANDLE_VALUE) return;
+
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file, &size)) {
+        pango_print_warn("Appending new index to '%s'.\n", _filename.c_str());
+        make_buffers(static_cast<uint64_t>(size.QuadPart), index_buf, footer_buf);
+
+        auto write_all = [file](const unsigned char* data, size_t size) {
+            while(size) {
+                DWORD written = 0;
+                const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+                if(!WriteFile(file, data, chunk, &written, NULL) || !written) return false;
+                data += written;
+                size -= written;
+            }
+            return true;
+        };
+
+        if( !write_all(index_buf.data(), index_buf.size()) || !FlushFileBuffers(file) ||
+            !write_all(footer_buf.data(), footer_buf.size()) || !FlushFileBuffers(file) )
+        {
+            pango_print_warn("Unable to write index to '%s'.\n", _filename.c_str());
+        }
+    }
+    CloseHandle(file);
+#endif
 }
 
 void PacketStreamReader::FixFileIndex()
@@ -393,6 +1156,8 @@ size_t PacketStreamReader::Seek(PacketStreamSourceId src, size_t framenum)
 // Jumps to the first packet with time >= time
 size_t PacketStreamReader::Seek(PacketStreamSourceId src, SyncTime::TimePoint time)
 {
+    lock_guard<decltype(_mutex)> lg(_mutex);
+
     PacketStreamSource& source = _sources[src];
 
     PacketStreamSource::PacketInfo v = {
@@ -37,6 +37,16 @@ using std::lock_guard;
 namespace pangolin
 {
 
+// Segments smaller than this are just copied into the write buffer
+static const size_t min_pinned_segment_bytes = 64*1024;
+
+static inline size_t compressedUnsignedIntSize(size_t n)
+{
+    size_t bytes = 1;
+    for(; n >= 0x80; n >>= 7) ++bytes;
+    return bytes;
+}
+
 static inline const std::string CurrentTimeStr()
 {
     time_t time_now = time(0);
@@ -49,6 +59,7 @@ static inline const std::string CurrentTimeStr()
 void PacketStreamWriter::WriteHeader()
 {
     SCOPED_LOCK;
+    ResetCheckpoints();
     _stream.write(PANGO_MAGIC.c_str(), PANGO_MAGIC.size());
     picojson::value pango;
     pango["pangolin_version"] = PANGOLIN_VERSION_STRING;
@@ -76,6 +87,11 @@ void PacketStreamWriter::Write(const PacketStreamSource& source)
     serialize[pss_src_packet][pss_pkt_definitions] = source.data_definitions;
     serialize[pss_src_packet][pss_pkt_size_bytes] = source.data_size_bytes;
 
+    // Readers only look for checkpoints in files which say they have them
+    if(_indexable && (_checkpoint_packets || _checkpoint_interval_us)) {
+        serialize[pss_src_checkpoints] = true;
+    }
+
     writeTag(_stream, TAG_ADD_SOURCE);
     serialize.serialize(std::ostream_iterator<char>(_stream), true);
 }
@@ -109,15 +125,8 @@ void PacketStreamWriter::WriteMeta(PacketStreamSourceId src, const picojson::val
     data.serialize(std::ostream_iterator<char>(_stream), false);
 }
 
-void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const char* source, const int64_t receive_time_us, size_t sourcelen, const picojson::value& meta)
+void PacketStreamWriter::WritePacketHeader(PacketStreamSourceId src, const int64_t receive_time_us, size_t sourcelen)
 {
-
-    SCOPED_LOCK;
-    _sources[src].index.push_back({_stream.tellp(), receive_time_us});
-
-    if (!meta.is<picojson::null>())
-        WriteMeta(src, meta);
-
     writeTag(_stream, TAG_SRC_PACKET);
     writeTimestamp(_stream, receive_time_us);
     writeCompressedUnsignedInt(_stream, src);
@@ -128,9 +137,159 @@ void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const char*
     } else {
         writeCompressedUnsignedInt(_stream, sourcelen);
     }
+}
 
-    _stream.write(source, sourcelen);
+void PacketStreamWriter::PacketWritten(size_t sourcelen)
+{
     _bytes_written += sourcelen;
+
+    if(_indexable) {
+        ++_packets_since_checkpoint;
+        if( (_checkpoint_packets && _packets_since_checkpoint >= _checkpoint_packets) ||
+            (_checkpoint_interval_us && Time_us(TimeNow()) - _last_checkpoint_time_us >= _checkpoint_interval_us) )
+        {
+            WriteCheckpoint();
+        }
+    }
+}
+
+void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const char* source, const int64_t receive_time_us, size_t sourcelen, const picojson::value& meta)
+{
+
+    SCOPED_LOCK;
+    _sources[src].index.push_back({_stream.tellp(), receive_time_us});
+
+    if (!meta.is<picojson::null>())
+        WriteMeta(src, meta);
+
+    WritePacketHeader(src, receive_time_us, sourcelen);
+    _stream.write(source, sourcelen);
+    PacketWritten(sourcelen);
+}
+
+void PacketStreamWriter::WriteSourcePacket(PacketStreamSourceId src, const std::vector<PacketSegment>& segments, const int64_t receive_time_us, std::shared_ptr<const void> pin, const picojson::value& meta)
+{
+    SCOPED_LOCK;
+
+    size_t sourcelen = 0;
+    for(const PacketSegment& seg : segments) {
+        sourcelen += seg.size;
+    }
+
+    const uint64_t pos = static_cast<uint64_t>(_stream.tellp());
+    const bool has_meta = !meta.is<picojson::null>() && !(meta.is<picojson::object>() && meta.get<picojson::object>().empty());
+    std::string meta_str = has_meta ? meta.serialize() : std::string();
+    size_t padding = 0;
+
+    // Direct writes need data to be aligned in the file as it is in memory.
+    // We can shift the first large segment into place by padding the json
+    // metadata which precedes the packet with whitespace, if allowed.
+    const size_t align = _buffer.write_alignment();
+    if(align > 1 && _max_alignment_padding) {
+        const size_t header_bytes = TAG_LENGTH + sizeof(receive_time_us) + compressedUnsignedIntSize(src) +
+            (_sources[src].data_size_bytes ? 0 : compressedUnsignedIntSize(sourcelen));
+        size_t offset = header_bytes;
+        for(const PacketSegment& seg : segments) {
+            if(seg.size >= min_pinned_segment_bytes) {
+                const size_t mem_align = reinterpret_cast<uintptr_t>(seg.data) % align;
+                if(meta_str.empty() && (pos + offset) % align == mem_align) {
+                    break;
+                }
+                const std::string padded_meta = meta_str.empty() ? std::string("null") : meta_str;
+                offset += TAG_LENGTH + compressedUnsignedIntSize(src) + padded_meta.size();
+                const size_t needed = (mem_align + align - (pos + offset) % align) % align;
+                if(needed <= _max_alignment_padding) {
+                    meta_str = padded_meta;
+                    padding = needed;
+                }
+                break;
+            }
+            offset += seg.size;
+        }
+    }
+
+    _sources[src].index.push_back({static_cast<int64_t>(pos), receive_time_us});
+
+    if(!meta_str.empty()) {
+        writeTag(_stream, TAG_SRC_JSON);
+        writeCompressedUnsignedInt(_stream, src);
+        for(size_t i=0; i < padding; ++i) {
+            _stream.put(' ');
+        }
+        _stream.write(meta_str.data(), meta_str.size());
+    }
+
+    WritePacketHeader(src, receive_time_us, sourcelen);
+
+    for(const PacketSegment& seg : segments) {
+        if(seg.size >= min_pinned_segment_bytes) {
+            _buffer.write_pinned(seg.data, seg.size, pin);
+        }else{
+            _stream.write(seg.data, seg.size);
+        }
+    }
+
+    PacketWritten(sourcelen);
+}
+
+void PacketStreamWriter::SetAlignmentPadding(size_t max_bytes)
+{
+    SCOPED_LOCK;
+    _max_alignment_padding = max_bytes;
+}
+
+void PacketStreamWriter::SetCheckpointInterval(size_t packets, int64_t interval_us)
+{
+    SCOPED_LOCK;
+    _checkpoint_packets = packets;
+    _checkpoint_interval_us = interval_us;
+}
+
+void PacketStreamWriter::ResetCheckpoints()
+{
+    SCOPED_LOCK;
+    _last_checkpoint_pos = 0;
+    _last_checkpoint_time_us = Time_us(TimeNow());
+    _packets_since_checkpoint = 0;
+    _checkpoint_index_start.clear();
+}
+
+void PacketStreamWriter::WriteCheckpoint()
+{
+    SCOPED_LOCK;
+    if (!_indexable)
+        return;
+
+    _checkpoint_index_start.resize(_sources.size(), 0);
+
+    const uint64_t pos = static_cast<uint64_t>(_stream.tellp());
+    writeTag(_stream, TAG_PANGO_CHECKPOINT);
+    writeIndexPadding(_stream, pos + TAG_LENGTH);
+
+    const uint32_t version = PACKET_CHECKPOINT_VERSION;
+    const uint32_t num_sources = static_cast<uint32_t>(_sources.size());
+    _stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    _stream.write(reinterpret_cast<const char*>(&num_sources), sizeof(num_sources));
+    _stream.write(reinterpret_cast<const char*>(&_last_checkpoint_pos), sizeof(uint64_t));
+
+    for(size_t s=0; s < _sources.size(); ++s) {
+        const uint64_t num_packets = _sources[s].index.size() - _checkpoint_index_start[s];
+        _stream.write(reinterpret_cast<const char*>(&num_packets), sizeof(num_packets));
+    }
+
+    for(size_t s=0; s < _sources.size(); ++s) {
+        const size_t start = _checkpoint_index_start[s];
+        const size_t num_packets = _sources[s].index.size() - start;
+        _stream.write(reinterpret_cast<const char*>(_sources[s].index.data() + start), num_packets * sizeof(PacketIndexRecord));
+        _checkpoint_index_start[s] = _sources[s].index.size();
+    }
+
+    _stream.write(reinterpret_cast<const char*>(&pos), sizeof(uint64_t));
+    _stream.write(PACKET_CHECKPOINT_MAGIC, sizeof(PACKET_CHECKPOINT_MAGIC));
+
+    _last_checkpoint_pos = pos;
+    _last_checkpoint_time_us = Time_us(TimeNow());
+    _packets_since_checkpoint = 0;
 }
 
 void PacketStreamWriter::WriteSync()
@@ -146,9 +305,8 @@ void PacketStreamWriter::WriteEnd()
     if (!_indexable)
         return;
 
-    auto indexpos = _stream.tellp();
-    writeTag(_stream, TAG_PANGO_STATS);
-    SourceStats(_sources).serialize(std::ostream_iterator<char>(_stream), false);
+    uint64_t indexpos = static_cast<uint64_t>(_stream.tellp());
+    writeBinaryIndex(_stream, _sources);
     writeTag(_stream, TAG_PANGO_FOOTER);
     _stream.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
 }
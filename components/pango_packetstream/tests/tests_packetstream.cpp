@@ -0,0 +1,536 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pangolin/log/packetstream_reader.h>
+#include <pangolin/log/packetstream_writer.h>
+
+#ifdef _LINUX_
+#  include <sys/stat.h>
+#endif
+
+namespace
+{
+
+const std::string test_filename = "test_packetstream.pango";
+const size_t num_test_packets = 100;
+
+std::vector<char> TestPayload(size_t src, size_t i, size_t scale = 1)
+{
+    return std::vector<char>(scale * (16 + 7*i + src), static_cast<char>('a' + (i+src) % 26));
+}
+
+void WriteTestPackets(pangolin::PacketStreamWriter& writer, size_t scale)
+{
+    for(size_t s=0; s < 2; ++s) {
+        pangolin::PacketStreamSource src;
+        src.driver = "test";
+        src.uri = "test://" + std::to_string(s);
+        writer.AddSource(src);
+    }
+
+    for(size_t i=0; i < num_test_packets; ++i) {
+        for(size_t s=0; s < 2; ++s) {
+            const std::vector<char> payload = TestPayload(s, i, scale);
+            writer.WriteSourcePacket(s, payload.data(), 1000*i + s, payload.size());
+        }
+    }
+}
+
+void WriteTestFile(const std::string& filename, size_t scale = 1, size_t checkpoint_packets = 0)
+{
+    pangolin::PacketStreamWriter writer(filename);
+    writer.SetCheckpointInterval(checkpoint_packets, 0);
+    WriteTestPackets(writer, scale);
+}
+
+// As WriteTestFile, through the writer's queued and preallocated writes
+pangolin::ThreadedFileBufStats WriteQueuedTestFile(const std::string& filename, size_t scale, size_t write_queue_depth, size_t preallocate_bytes)
+{
+    pangolin::PacketStreamWriter writer;
+    writer.Open(filename, 1024*1024, write_queue_depth, preallocate_bytes);
+    WriteTestPackets(writer, scale);
+    writer.Close();
+    return writer.WriteStats();
+}
+
+std::string ReadFile(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void CheckPacket(pangolin::Packet& pkt, size_t src, size_t i, size_t scale = 1)
+{
+    REQUIRE(pkt.src == src);
+    REQUIRE(pkt.sequence_num == i);
+    REQUIRE(pkt.time == int64_t(1000*i + src));
+
+    const std::vector<char> expected = TestPayload(src, i, scale);
+    std::vector<char> data(pkt.BytesRemaining());
+    REQUIRE(data.size() == expected.size());
+    pkt.Stream().read(data.data(), data.size());
+    REQUIRE(data == expected);
+}
+
+}
+
+TEST_CASE("Binary packet index is read in place")
+{
+    WriteTestFile(test_filename);
+
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources().size() == 2);
+
+        for(const auto& src : reader.Sources()) {
+            REQUIRE(src.index.size() == num_test_packets);
+            REQUIRE(src.index.IsView());
+        }
+
+        reader.Seek(1, 42);
+        {
+            pangolin::Packet pkt = reader.NextFrame();
+            CheckPacket(pkt, 1, 42);
+        }
+
+        // Payload is also available in place from the file mapping
+        REQUIRE(reader.IsMapped());
+        reader.Seek(0, 7);
+        {
+            pangolin::Packet pkt = reader.NextFrame();
+            const std::vector<char> expected = TestPayload(0, 7);
+            REQUIRE(pkt.Data() != nullptr);
+            REQUIRE(std::memcmp(pkt.Data(), expected.data(), expected.size()) == 0);
+        }
+        {
+            // Unread mapped data was skipped over
+            pangolin::Packet pkt = reader.NextFrame();
+            REQUIRE(pkt.src == 1);
+            REQUIRE(pkt.time == 7001);
+        }
+
+        // Packets are found by index without moving the read position
+        {
+            std::shared_ptr<const pangolin::MemoryMappedFile> mapping;
+            const unsigned char* data = nullptr;
+            size_t size = 0;
+            picojson::value meta;
+            REQUIRE(reader.ReadPacket(1, 93, mapping, data, size, meta));
+            const std::vector<char> expected = TestPayload(1, 93);
+            REQUIRE(mapping != nullptr);
+            REQUIRE(size == expected.size());
+            REQUIRE(std::memcmp(data, expected.data(), size) == 0);
+            REQUIRE(!reader.ReadPacket(1, num_test_packets, mapping, data, size, meta));
+
+            pangolin::Packet pkt = reader.NextFrame();
+            CheckPacket(pkt, 0, 8);
+        }
+
+        reader.Seek(0, pangolin::SyncTime::TimePoint(std::chrono::microseconds(57500)));
+        {
+            pangolin::Packet pkt = reader.NextFrame();
+            CheckPacket(pkt, 0, 58);
+        }
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Corrupt or foreign binary indices are rebuilt")
+{
+    // Replace the index with one holding 'counts' and num_records records,
+    // each copied from the first, keeping the footer pointing at it.
+    auto write_index = [](const std::vector<uint64_t>& counts, size_t num_records) {
+        WriteTestFile(test_filename);
+        const std::string file = ReadFile(test_filename);
+        const std::string footer = file.substr(file.size() - pangolin::TAG_LENGTH - sizeof(uint64_t));
+        uint64_t index_pos = 0;
+        std::memcpy(&index_pos, footer.data() + pangolin::TAG_LENGTH, sizeof(index_pos));
+        const size_t header_pos = pangolin::PacketIndexAlign(index_pos + pangolin::TAG_LENGTH);
+
+        std::string index = file.substr(header_pos, sizeof(uint32_t));
+        const uint32_t num_sources = static_cast<uint32_t>(counts.size());
+        index.append(reinterpret_cast<const char*>(&num_sources), sizeof(num_sources));
+        index.append(reinterpret_cast<const char*>(counts.data()), counts.size() * sizeof(uint64_t));
+        const size_t records_pos = header_pos + 2*sizeof(uint32_t) + 2*sizeof(uint64_t);
+        for(size_t r=0; r < num_records; ++r) {
+            index.append(file, records_pos, sizeof(pangolin::PacketIndexRecord));
+        }
+
+        std::ofstream(test_filename, std::ios::binary | std::ios::trunc)
+            << file.substr(0, header_pos) << index << footer;
+    };
+
+    auto check_rebuilt = [](){
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources().size() == 2);
+        for(const auto& src : reader.Sources()) {
+            REQUIRE(src.index.size() == num_test_packets);
+        }
+        reader.Seek(1, 42);
+        pangolin::Packet pkt = reader.NextFrame();
+        CheckPacket(pkt, 1, 42);
+    };
+
+    // Counts whose size in bytes wraps around to the size of the records
+    const uint64_t wrap = uint64_t(1) << 60;
+    write_index({num_test_packets + wrap, num_test_packets}, 2*num_test_packets);
+    check_rebuilt();
+
+    // Counts whose sum wraps around
+    write_index({num_test_packets, uint64_t(0) - 1}, num_test_packets - 1);
+    check_rebuilt();
+
+    // Fewer sources than the file holds
+    write_index({2*num_test_packets}, 2*num_test_packets);
+    check_rebuilt();
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("JSON packet index from older files is still read")
+{
+    WriteTestFile(test_filename);
+
+    // Serialize before rewriting the file, which the reader's index maps.
+    picojson::value stats;
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        stats = pangolin::SourceStats(reader.Sources());
+    }
+
+    // Replace binary index and footer with the legacy JSON index.
+    std::string contents;
+    {
+        std::ifstream in(test_filename, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint64_t indexpos = 0;
+    std::memcpy(&indexpos, contents.data() + contents.size() - sizeof(uint64_t), sizeof(uint64_t));
+    contents.resize(indexpos);
+    {
+        std::ofstream of(test_filename, std::ios::binary | std::ios::trunc);
+        of.write(contents.data(), contents.size());
+        pangolin::writeTag(of, pangolin::TAG_PANGO_STATS);
+        stats.serialize(std::ostream_iterator<char>(of), false);
+        pangolin::writeTag(of, pangolin::TAG_PANGO_FOOTER);
+        of.write(reinterpret_cast<char*>(&indexpos), sizeof(uint64_t));
+    }
+
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources().size() == 2);
+        for(const auto& src : reader.Sources()) {
+            REQUIRE(src.index.size() == num_test_packets);
+            REQUIRE(!src.index.IsView());
+        }
+
+        reader.Seek(0, 13);
+        pangolin::Packet pkt = reader.NextFrame();
+        CheckPacket(pkt, 0, 13);
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Index is rebuilt for truncated files")
+{
+    // Large enough to be split across several rebuild chunks
+    const size_t scale = 512;
+    WriteTestFile(test_filename, scale);
+
+    // Drop the index, footer and half of the final packet
+    std::string contents;
+    {
+        std::ifstream in(test_filename, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint64_t indexpos = 0;
+    std::memcpy(&indexpos, contents.data() + contents.size() - sizeof(uint64_t), sizeof(uint64_t));
+    contents.resize(indexpos - TestPayload(1, num_test_packets-1, scale).size() / 2);
+    {
+        std::ofstream of(test_filename, std::ios::binary | std::ios::trunc);
+        of.write(contents.data(), contents.size());
+    }
+
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources().size() == 2);
+        REQUIRE(reader.Sources()[0].index.size() == num_test_packets);
+        REQUIRE(reader.Sources()[1].index.size() == num_test_packets-1);
+
+        for(size_t i : {size_t(0), size_t(31), num_test_packets-2}) {
+            reader.Seek(1, i);
+            pangolin::Packet pkt = reader.NextFrame();
+            CheckPacket(pkt, 1, i, scale);
+        }
+    }
+
+    {
+        // The rebuilt index was written back, so is used directly next time
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources()[0].index.IsView());
+        REQUIRE(reader.Sources()[1].index.size() == num_test_packets-1);
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Checkpoints index files which are still being written")
+{
+    WriteTestFile(test_filename, 1, 10);
+
+    const std::string contents = ReadFile(test_filename);
+    uint64_t indexpos = 0;
+    std::memcpy(&indexpos, contents.data() + contents.size() - sizeof(uint64_t), sizeof(uint64_t));
+
+    std::streampos cut_pos;
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        cut_pos = reader.Sources()[0].index[60].pos + std::streamoff(10);
+    }
+
+    // As if the writer is part way through packet 60 of source 0
+    {
+        std::ofstream of(test_filename, std::ios::binary | std::ios::trunc);
+        of.write(contents.data(), cut_pos);
+    }
+
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources().size() == 2);
+        REQUIRE(reader.Sources()[0].index.size() == 60);
+        REQUIRE(reader.Sources()[1].index.size() == 60);
+
+        // The file mustn't be touched while it may still be written to.
+        REQUIRE(ReadFile(test_filename).size() == size_t(cut_pos));
+
+        reader.Seek(1, 59);
+        reader.Seek(0, 59);
+        {
+            pangolin::Packet pkt = reader.NextFrame();
+            const unsigned char* data = pkt.Data();
+            REQUIRE(data != nullptr);
+
+            // The rest of the recording arrives, and is mapped in
+            {
+                std::ofstream of(test_filename, std::ios::binary | std::ios::app);
+                of.write(contents.data() + size_t(cut_pos), indexpos - size_t(cut_pos));
+            }
+            REQUIRE(reader.UpdateIndex());
+
+            // The packet's view of the previous mapping is still valid
+            const std::vector<char> expected = TestPayload(0, 59);
+            REQUIRE(std::memcmp(data, expected.data(), expected.size()) == 0);
+            CheckPacket(pkt, 0, 59);
+        }
+
+        for(size_t i=59; i < num_test_packets; ++i) {
+            for(size_t s = (i==59 ? 1 : 0); s < 2; ++s) {
+                pangolin::Packet pkt = reader.NextFrame();
+                CheckPacket(pkt, s, i);
+            }
+        }
+        REQUIRE(reader.Sources()[0].index.size() == num_test_packets);
+        REQUIRE_THROWS(reader.NextFrame());
+
+        // Once the writer has finished, the file is no longer followed
+        {
+            std::ofstream of(test_filename, std::ios::binary | std::ios::app);
+            of.write(contents.data() + indexpos, contents.size() - indexpos);
+        }
+        REQUIRE(!reader.UpdateIndex());
+        REQUIRE(!reader.UpdateIndex());
+        REQUIRE_THROWS(reader.NextFrame());
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Files written without checkpoints aren't searched for them")
+{
+    WriteTestFile(test_filename, 1, 10);
+    const std::string with_checkpoints = ReadFile(test_filename);
+    WriteTestFile(test_filename);
+    const std::string without_checkpoints = ReadFile(test_filename);
+
+    REQUIRE(with_checkpoints.find("\"checkpoints\"") != std::string::npos);
+    REQUIRE(without_checkpoints.find("\"checkpoints\"") == std::string::npos);
+
+    // Truncate within the packet data, so that neither has a final index
+    const auto truncate = [](const std::string& contents) {
+        uint64_t indexpos = 0;
+        std::memcpy(&indexpos, contents.data() + contents.size() - sizeof(uint64_t), sizeof(uint64_t));
+        std::ofstream of(test_filename, std::ios::binary | std::ios::trunc);
+        of.write(contents.data(), indexpos - 10);
+        return indexpos - 10;
+    };
+
+    // Checkpointed files are left alone, since they may still be written to
+    const size_t cut_checkpoints = truncate(with_checkpoints);
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources()[0].index.size() == num_test_packets);
+    }
+    REQUIRE(ReadFile(test_filename).size() == cut_checkpoints);
+
+    // Otherwise the index is rebuilt, and written back
+    const size_t cut = truncate(without_checkpoints);
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources()[0].index.size() == num_test_packets);
+        REQUIRE(reader.Sources()[1].index.size() == num_test_packets-1);
+    }
+    REQUIRE(ReadFile(test_filename).size() > cut);
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Packets written with several writes in flight are read back")
+{
+    const size_t scale = 64;
+    const pangolin::ThreadedFileBufStats stats = WriteQueuedTestFile(test_filename, scale, 4, 1024*1024);
+
+#ifdef _LINUX_
+    if(stats.queue_depth > 1) {
+        REQUIRE(stats.queue_depth == 4);
+        REQUIRE(stats.max_writes_in_flight > 1);
+    }else{
+        WARN("io_uring is unavailable, so writes were not queued");
+    }
+#endif
+    REQUIRE(stats.max_writes_in_flight <= stats.queue_depth);
+
+    {
+        pangolin::PacketStreamReader reader(test_filename);
+        REQUIRE(reader.Sources()[0].index.IsView());
+        for(size_t i=0; i < num_test_packets; ++i) {
+            for(size_t s=0; s < 2; ++s) {
+                pangolin::Packet pkt = reader.NextFrame();
+                CheckPacket(pkt, s, i, scale);
+            }
+        }
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+#ifdef _LINUX_
+TEST_CASE("Space reserved beyond the end of the file is released on close")
+{
+    const size_t preallocate_bytes = 64*1024*1024;
+    WriteQueuedTestFile(test_filename, 1, 1, preallocate_bytes);
+
+    struct stat st;
+    REQUIRE(stat(test_filename.c_str(), &st) == 0);
+    REQUIRE(size_t(st.st_size) < 1024*1024);
+    REQUIRE(size_t(st.st_blocks) * 512 < size_t(st.st_size) + 1024*1024);
+
+    std::remove(test_filename.c_str());
+}
+#endif
+
+TEST_CASE("Packets written from pinned segments are read back")
+{
+    const size_t scale = 8192;
+    std::weak_ptr<const void> pinned;
+
+    for(size_t padding : {size_t(0), size_t(4096)}) {
+    for(size_t write_queue_depth : {size_t(1), size_t(4)}) {
+        size_t payload_bytes = 0;
+        {
+            pangolin::PacketStreamWriter writer;
+            writer.SetAlignmentPadding(padding);
+            writer.Open(test_filename, 1024*1024, write_queue_depth);
+            for(size_t s=0; s < 2; ++s) {
+                pangolin::PacketStreamSource src;
+                src.driver = "test";
+                writer.AddSource(src);
+            }
+
+            for(size_t i=0; i < num_test_packets; ++i) {
+                for(size_t s=0; s < 2; ++s) {
+                    // Payload split into segments at unaligned offsets
+                    auto payload = std::make_shared<std::vector<char>>(TestPayload(s, i, scale));
+                    const size_t split = 100 + 33*i;
+                    const std::vector<pangolin::PacketSegment> segments = {
+                        {payload->data(), split},
+                        {payload->data() + split, payload->size() - split}
+                    };
+                    picojson::value meta;
+                    if(i % 3 == 0) meta["i"] = picojson::value(double(i));
+                    writer.WriteSourcePacket(s, segments, 1000*i + s, payload, meta);
+                    payload_bytes += payload->size();
+                    pinned = payload;
+                }
+            }
+        }
+        REQUIRE(pinned.expired());
+
+        if(!padding) {
+            // Only headers, metadata and the index are added to the payload
+            REQUIRE(ReadFile(test_filename).size() < payload_bytes + 2*num_test_packets*64 + 4096);
+        }
+
+        pangolin::PacketStreamReader reader(test_filename);
+        for(size_t i=0; i < num_test_packets; ++i) {
+            for(size_t s=0; s < 2; ++s) {
+                pangolin::Packet pkt = reader.NextFrame();
+                if(i % 3 == 0) {
+                    REQUIRE(pkt.meta["i"].get<double>() == double(i));
+                }else{
+                    REQUIRE(pkt.meta.is<picojson::null>());
+                }
+                CheckPacket(pkt, s, i, scale);
+            }
+        }
+    }
+    }
+
+    std::remove(test_filename.c_str());
+}
+
+TEST_CASE("Large segments are written without a copy by default")
+{
+    const size_t scale = 8192;
+    const size_t max_block_bytes = 4096;
+
+    size_t payload_bytes = 0;
+    pangolin::ThreadedFileBufStats stats;
+    {
+        pangolin::PacketStreamWriter writer;
+        writer.Open(test_filename, 1024*1024);
+        pangolin::PacketStreamSource src;
+        src.driver = "test";
+        writer.AddSource(src);
+
+        for(size_t i=0; i < num_test_packets; ++i) {
+            auto payload = std::make_shared<std::vector<char>>(TestPayload(0, i, scale));
+            writer.WriteSourcePacket(0, {{payload->data(), payload->size()}}, 1000*i, payload);
+            payload_bytes += payload->size();
+        }
+        writer.Close();
+        stats = writer.WriteStats();
+    }
+
+    // Only the partial blocks at either end of each packet are copied
+    REQUIRE(stats.pinned_bytes + num_test_packets * 2 * max_block_bytes >= payload_bytes);
+
+    pangolin::PacketStreamReader reader(test_filename);
+    for(size_t i=0; i < num_test_packets; ++i) {
+        pangolin::Packet pkt = reader.NextFrame();
+        CheckPacket(pkt, 0, i, scale);
+    }
+
+    std::remove(test_filename.c_str());
+}
@@ -30,6 +30,7 @@
 #include <pangolin/platform.h>
 
 #include <algorithm> // std::min, std::max
+#include <atomic>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -93,6 +94,10 @@ public:
     {
         sample_buffer = std::unique_ptr<float[]>(new float[dim*max_samples]);
 //        stats = std::unique_ptr<DimensionStats[]>(new DimensionStats[dim]);
+        for(size_t l=1; LevelBucketSize(l) < max_samples; ++l) {
+            const size_t buckets = (max_samples + LevelBucketSize(l) - 1) / LevelBucketSize(l);
+            levels.emplace_back(new float[2*dim*buckets]);
+        }
     }
 
     ~DataLogBlock()
@@ -165,22 +170,91 @@ public:
         }
     }
 
+    /// Samples are also kept decimated at several levels of detail, so that
+    /// many samples can be drawn at once. At level l > 0 each bucket of
+    /// LevelBucketSize(l) samples is reduced to two: the minimum and then the
+    /// maximum of each dimension over the bucket. Level 0 is the samples.
+    static size_t LevelBucketSize(size_t level)
+    {
+        return size_t(1) << (2*level);
+    }
+
+    size_t Levels() const
+    {
+        return levels.size() + 1;
+    }
+
+    size_t LevelSamples(size_t level) const
+    {
+        if(level == 0) return samples;
+        const size_t bucket_size = LevelBucketSize(level);
+        return 2 * ((samples + bucket_size - 1) / bucket_size);
+    }
+
+    /// Equivalent of DimData(d) for the given level, with the same stride.
+    const float* LevelDimData(size_t level, size_t d) const
+    {
+        return (level == 0 ? sample_buffer.get() : levels[level-1].get()) + d;
+    }
+
     // Line width for this datalog block
     void SetLineWidth( float width ) { line_width_ = width; }
     // Get line width for this datalog block
     float GetLineWidth() const { return line_width_; }
 
 protected:
+    /// Update the buckets of each level which cover samples from first_sample
+    void UpdateLevels(size_t first_sample);
+
     size_t dim;
     size_t max_samples;
     size_t samples;
     size_t start_id;
     std::unique_ptr<float[]> sample_buffer;
 //    std::unique_ptr<DimensionStats[]> stats;
+    std::vector<std::unique_ptr<float[]>> levels;
     std::unique_ptr<DataLogBlock> nextBlock;
     float line_width_ = 1.0f; // Default line width
 };
 
+class DataLog;
+
+/// Queues samples for a DataLog from one thread without locking or blocking.
+/// Queued samples are moved into the log by DataLog::Merge(), which is
+/// called by the thread reading the log. Create one producer per logging
+/// thread with DataLog::CreateProducer().
+class PANGOLIN_EXPORT DataLogProducer
+{
+public:
+    /// @param capacity number of floats which can be queued, rounded up to a power of two.
+    DataLogProducer(size_t capacity);
+
+    /// Queue samples, as DataLog::Log(). Returns false, dropping the samples,
+    /// if they don't fit in the queue.
+    bool Log(size_t dimension, const float * vals, unsigned int samples = 1);
+    bool Log(const std::vector<float> & vals);
+
+    /// Number of samples dropped because the queue was full.
+    size_t Dropped() const;
+
+protected:
+    friend class DataLog;
+
+    /// Move samples queued so far into log. Only DataLog::Merge() calls this.
+    void Consume(DataLog& log);
+
+    size_t mask;
+    std::unique_ptr<float[]> ring;
+    std::vector<float> consumed;
+    std::atomic<size_t> dropped;
+
+    // Floats written by the producer and read by the consumer, wrapping
+    // around ring. Kept on their own cache lines, as each is written by one
+    // thread and read by the other.
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
 /// A DataLog can efficiently record floating point sample data of any size.
 /// Memory is allocated in blocks is transparent to the user.
 class PANGOLIN_EXPORT DataLog
@@ -217,6 +291,22 @@ public:
     }
 #endif
 
+    /// Create a queue through which one other thread can log samples
+    /// without ever blocking. See DataLogProducer.
+    std::shared_ptr<DataLogProducer> CreateProducer(size_t capacity = 1 << 16);
+
+    /// Move samples queued by producers into the log. Samples of each
+    /// producer stay in order.
+    void Merge();
+
+    /// Merge(), then return the log to read a consistent snapshot of
+    /// everything logged so far, e.g. log.Snapshot().Samples(). The const
+    /// accessors below don't merge, so only see samples queued by
+    /// producers as of the last Merge(). Plotter, Save() and the Python
+    /// bindings read through here. Not to be called while holding
+    /// access_mutex.
+    const DataLog& Snapshot();
+
     void Clear();
     void Save(std::string filename);
 
@@ -244,6 +334,9 @@ protected:
     DataLogBlock* blockn;
     std::vector<DimensionStats> stats;
     bool record_stats;
+
+    std::mutex producers_mutex;
+    std::vector<std::shared_ptr<DataLogProducer>> producers;
 };
 
 }
@@ -35,6 +35,7 @@
 #include <pangolin/gl/gl.h>
 #include <pangolin/gl/glfont.h>
 #include <pangolin/gl/glsl.h>
+#include <pangolin/gl/gltextbatch.h>
 #include <pangolin/handler/handler.h>
 #include <pangolin/utils/range.h>
 #include <pangolin/plot/datalog.h>
@@ -219,6 +220,12 @@ protected:
         GlSlProgram prog;
         GlText title;
         bool contains_id;
+        // Sequence x is plotted against alone (-1 for $i), otherwise -2
+        int x_sequence;
+        // True if x and y are each a sequence alone. Only then can a level
+        // of detail be drawn, since the bucket minima and maxima of
+        // different sequences come from different samples.
+        bool single_sequences;
         std::vector<PlotAttrib> attribs;
         DataLog* log;
         GLenum drawing_mode;
@@ -247,6 +254,12 @@ protected:
     void UpdateView();
     Tick FindTickFactor(float tick);
 
+    // Range of x within block when the series' x increases with each sample
+    static bool BlockRangeX(const PlotSeries& ps, const DataLog& log, const DataLogBlock& block, float& x_first, float& x_last);
+
+    // Sample ids of the vertices of a level of detail
+    const float* IdArray(size_t level, size_t num_samples);
+
     DataLog* default_log;
 
     ColourWheel colour_wheel;
@@ -256,6 +269,8 @@ protected:
 
     GlSlProgram prog_lines;
     GlSlProgram prog_text;
+    GlTextBatch text_batch;
+    std::vector<std::vector<float>> id_arrays;
 
     std::vector<PlotSeries> plotseries;
     std::vector<Marker> plotmarkers;
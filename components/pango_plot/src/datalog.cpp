@@ -28,6 +28,8 @@
 #include <pangolin/plot/datalog.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <limits>
 
@@ -47,6 +49,7 @@ void DataLogBlock::AddSamples(size_t num_samples, size_t dimensions, const float
         }else{
             // Try to copy samples to this block
             const size_t samples_to_copy = std::min(num_samples, SampleSpaceLeft());
+            const size_t first_sample = samples;
 
             if(dimensions == dim) {
                 // Copy entire block all together
@@ -55,18 +58,20 @@ void DataLogBlock::AddSamples(size_t num_samples, size_t dimensions, const float
                 data_dim_major += samples_to_copy*dim;
             }else{
                 // Copy sample at a time, filling with NaN's where needed.
-                float* dst = sample_buffer.get();
+                float* dst = sample_buffer.get() + samples*dim;
                 for(size_t i=0; i< samples_to_copy; ++i) {
                     std::copy(data_dim_major, data_dim_major + dimensions, dst);
                     for(size_t ii = dimensions; ii < dim; ++ii) {
                         dst[ii] = std::numeric_limits<float>::quiet_NaN();
                     }
-                    dst += dimensions;
+                    dst += dim;
                     data_dim_major += dimensions;
                 }
                 samples += samples_to_copy;
             }
 
+            UpdateLevels(first_sample);
+
 //            // Update Stats
 //            for(size_t s=0; s < samples_to_copy; ++s) {
 //                for(size_t d = 0; d < dimensions; ++d) {
@@ -83,6 +88,123 @@ void DataLogBlock::AddSamples(size_t num_samples, size_t dimensions, const float
     }
 }
 
+void DataLogBlock::UpdateLevels(size_t first_sample)
+{
+    // Each level is computed from the one below, which has two samples per
+    // bucket except for level 0. Only buckets containing new samples change.
+    const float* src = sample_buffer.get();
+    size_t src_samples = samples;
+    size_t src_first = first_sample;
+
+    for(size_t l=0; l < levels.size(); ++l) {
+        const size_t src_per_bucket = LevelBucketSize(1) * (l == 0 ? 1 : 2);
+        const size_t b0 = src_first / src_per_bucket;
+        const size_t b1 = (src_samples + src_per_bucket - 1) / src_per_bucket;
+        float* dst = levels[l].get();
+
+        for(size_t b=b0; b < b1; ++b) {
+            float* lo = dst + 2*b*dim;
+            float* hi = lo + dim;
+            std::fill(lo, hi, std::numeric_limits<float>::infinity());
+            std::fill(hi, hi + dim, -std::numeric_limits<float>::infinity());
+
+            const size_t s1 = std::min(src_samples, (b+1)*src_per_bucket);
+            for(size_t s=b*src_per_bucket; s < s1; ++s) {
+                const float* v = src + s*dim;
+                for(size_t d=0; d < dim; ++d) {
+                    // Comparisons with NaN are false, so missing values are skipped
+                    if(v[d] < lo[d]) lo[d] = v[d];
+                    if(v[d] > hi[d]) hi[d] = v[d];
+                }
+            }
+
+            for(size_t d=0; d < dim; ++d) {
+                if(lo[d] > hi[d]) {
+                    lo[d] = hi[d] = std::numeric_limits<float>::quiet_NaN();
+                }
+            }
+        }
+
+        src = dst;
+        src_samples = 2*b1;
+        src_first = 2*b0;
+    }
+}
+
+namespace {
+// Each queued record starts with its dimension and number of samples
+const size_t producer_header_size = 2;
+}
+
+DataLogProducer::DataLogProducer(size_t capacity)
+    : dropped(0), head(0), tail(0)
+{
+    size_t size = 1;
+    while(size < capacity) size *= 2;
+    mask = size - 1;
+    ring = std::unique_ptr<float[]>(new float[size]);
+}
+
+bool DataLogProducer::Log(size_t dimension, const float* vals, unsigned int samples)
+{
+    const size_t size = mask + 1;
+    const size_t count = dimension * samples;
+    const size_t h = head.load(std::memory_order_relaxed);
+
+    if(producer_header_size + count > size - (h - tail.load(std::memory_order_acquire))) {
+        dropped.fetch_add(samples, std::memory_order_relaxed);
+        return false;
+    }
+
+    const uint32_t header[producer_header_size] = {(uint32_t)dimension, (uint32_t)samples};
+    std::memcpy(&ring[h & mask], &header[0], sizeof(float));
+    std::memcpy(&ring[(h+1) & mask], &header[1], sizeof(float));
+
+    // Copy in at most two parts, around the end of the ring
+    const size_t start = (h + producer_header_size) & mask;
+    const size_t first = std::min(count, size - start);
+    std::copy(vals, vals + first, &ring[start]);
+    std::copy(vals + first, vals + count, &ring[0]);
+
+    head.store(h + producer_header_size + count, std::memory_order_release);
+    return true;
+}
+
+bool DataLogProducer::Log(const std::vector<float> & vals)
+{
+    return Log(vals.size(), vals.data());
+}
+
+size_t DataLogProducer::Dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void DataLogProducer::Consume(DataLog& log)
+{
+    const size_t size = mask + 1;
+    const size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    while(t != h) {
+        uint32_t header[producer_header_size];
+        std::memcpy(&header[0], &ring[t & mask], sizeof(float));
+        std::memcpy(&header[1], &ring[(t+1) & mask], sizeof(float));
+        const size_t count = header[0] * header[1];
+
+        const size_t start = (t + producer_header_size) & mask;
+        const size_t first = std::min(count, size - start);
+        consumed.resize(count);
+        std::copy(&ring[start], &ring[start] + first, consumed.begin());
+        std::copy(&ring[0], &ring[0] + (count - first), consumed.begin() + first);
+
+        if(count) log.Log(header[0], consumed.data(), header[1]);
+        t += producer_header_size + count;
+    }
+
+    tail.store(t, std::memory_order_release);
+}
+
 DataLog::DataLog(unsigned int buffer_size)
     : block_samples_alloc(buffer_size), block0(nullptr), blockn(nullptr), record_stats(true)
 {
@@ -123,19 +245,27 @@ void DataLog::Log(size_t dimension, const float* vals, unsigned int samples )
         while(stats.size() < dimension) {
             stats.push_back( DimensionStats() );
         }
-        for(unsigned int d=0; d<dimension; ++d) {
-            DimensionStats& ds = stats[d];
-            for(unsigned int s=0; s<samples; ++s) {
-                ds.Add(vals[s*dimension+d]);
+        // Visit samples in memory order, which matters for large batches
+        for(unsigned int s=0; s<samples; ++s) {
+            const float* sample = vals + size_t(s)*dimension;
+            for(unsigned int d=0; d<dimension; ++d) {
+                stats[d].Add(sample[d]);
             }
         }
     }
 
-    blockn->AddSamples(samples,dimension,vals);
-
-    // Update pointer to most recent block.
-    while(blockn->NextBlock()) {
-        blockn = blockn->NextBlock();
+    // Add at most a block at a time, since blocks recurse into the next
+    // block for samples which don't fit.
+    while(samples) {
+        const unsigned int chunk = std::min<unsigned int>(samples, std::max(1u, block_samples_alloc));
+        blockn->AddSamples(chunk,dimension,vals);
+        vals += size_t(chunk)*dimension;
+        samples -= chunk;
+
+        // Update pointer to most recent block.
+        while(blockn->NextBlock()) {
+            blockn = blockn->NextBlock();
+        }
     }
 }
 
@@ -201,6 +331,47 @@ void DataLog::Log(const std::vector<float> & vals)
     Log(vals.size(), &vals[0]);
 }
 
+std::shared_ptr<DataLogProducer> DataLog::CreateProducer(size_t capacity)
+{
+    std::shared_ptr<DataLogProducer> producer = std::make_shared<DataLogProducer>(capacity);
+    std::lock_guard<std::mutex> l(producers_mutex);
+    producers.push_back(producer);
+    return producer;
+}
+
+void DataLog::Merge()
+{
+    std::lock_guard<std::mutex> lp(producers_mutex);
+    if(producers.empty()) return;
+
+    // A producer released before it is drained has logged its last sample.
+    // One released during the drain may have logged more, so waits for the
+    // next Merge().
+    std::vector<bool> released(producers.size());
+    for(size_t i=0; i < producers.size(); ++i) {
+        released[i] = producers[i].use_count() == 1;
+    }
+
+    std::lock_guard<std::mutex> l(access_mutex);
+    for(auto& producer : producers) {
+        producer->Consume(*this);
+    }
+
+    size_t kept = 0;
+    for(size_t i=0; i < producers.size(); ++i) {
+        if(!released[i]) {
+            producers[kept++] = std::move(producers[i]);
+        }
+    }
+    producers.resize(kept);
+}
+
+const DataLog& DataLog::Snapshot()
+{
+    Merge();
+    return *this;
+}
+
 void DataLog::Clear()
 {
     std::lock_guard<std::mutex> l(access_mutex);
@@ -213,6 +384,8 @@ void DataLog::Clear()
 
 void DataLog::Save(std::string filename)
 {
+    Merge();
+
     std::ofstream csvStream(filename);
 
     if (!Labels().empty()) {
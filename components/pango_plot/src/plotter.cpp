@@ -65,8 +65,28 @@ std::set<int> ConvertSequences(const std::string& str, char seq_char='$', char i
     return sequences;
 }
 
+// Return the sequence str consists of alone, -1 for the id sequence, or -2
+// if str is any other expression.
+int SingleSequence(const std::string& str, char seq_char='$', char id_char='i')
+{
+    std::string s;
+    for(char c : str) {
+        if(!std::isspace(c)) s += c;
+    }
+
+    if(s.size() < 2 || s[0] != seq_char) return -2;
+    if(s.size() == 2 && s[1] == id_char) return -1;
+
+    int v = 0;
+    for(size_t j=1; j < s.size(); ++j) {
+        if(!std::isdigit(s[j])) return -2;
+        v = v*10 + (s[j] - '0');
+    }
+    return v;
+}
+
 Plotter::PlotSeries::PlotSeries()
-    : log(nullptr), drawing_mode(GL_LINE_STRIP)
+    : contains_id(false), x_sequence(-2), single_sequences(false), log(nullptr), drawing_mode(GL_LINE_STRIP)
 {
 
 }
@@ -107,6 +127,8 @@ void Plotter::PlotSeries::CreatePlot(const std::string &x, const std::string &y,
     as.insert(ax.begin(), ax.end());
     as.insert(ay.begin(), ay.end());
     contains_id = ( as.find(-1) != as.end() );
+    x_sequence = SingleSequence(x);
+    single_sequences = x_sequence != -2 && SingleSequence(y) != -2;
 
     std::ostringstream oss_prog;
 
@@ -253,14 +275,13 @@ Plotter::Plotter(
     prog_text.AddShader( GlSlVertexShader,
                          "attribute vec2 a_position;\n"
                          "attribute vec2 a_texcoord;\n"
-                         "uniform vec4 u_color;\n"
+                         "attribute vec4 a_color;\n"
                          "uniform vec2 u_scale;\n"
-                         "uniform vec2 u_offset;\n"
                          "varying vec4 v_color;\n"
                          "varying vec2 v_texcoord;\n"
                          "void main() {\n"
-                         "    gl_Position = vec4(u_scale * (a_position + u_offset),0,1);\n"
-                         "    v_color = u_color;\n"
+                         "    gl_Position = vec4(u_scale * a_position,0,1);\n"
+                         "    v_color = a_color;\n"
                          "    v_texcoord = a_texcoord;\n"
                          "}\n"
                          );
@@ -322,7 +343,7 @@ void Plotter::ComputeTrackValue( float track_val[2] )
 {
     if(trigger_edge) {
         // Track last edge transition matching trigger_edge
-        const DataLogBlock* block = default_log->LastBlock();
+        const DataLogBlock* block = default_log->Snapshot().LastBlock();
         if(block) {
             int s = (int)block->StartId() + (int)block->Samples() - 1;
             const size_t dim = block->Dimensions();
@@ -343,7 +364,7 @@ void Plotter::ComputeTrackValue( float track_val[2] )
         // Fall back to simple last value tracking
     }
 
-    track_val[0] = (float)default_log->Samples();
+    track_val[0] = (float)default_log->Snapshot().Samples();
     track_val[1] = 0.0f;
 }
 
@@ -352,7 +373,7 @@ XYRangef Plotter::ComputeAutoSelection()
     XYRangef range;
     range.x = target.x;
 
-    const DataLogBlock* block = default_log->FirstBlock();
+    const DataLogBlock* block = default_log->Snapshot().FirstBlock();
 
     if(block) {
         for(size_t i=0; i < plotseries.size(); ++i)
@@ -371,8 +392,50 @@ XYRangef Plotter::ComputeAutoSelection()
     return range;
 }
 
+bool Plotter::BlockRangeX(const PlotSeries& ps, const DataLog& log, const DataLogBlock& block, float& x_first, float& x_last)
+{
+    if(block.Samples() == 0) return false;
+
+    if(ps.x_sequence == -1) {
+        x_first = (float)block.StartId();
+        x_last = (float)(block.StartId() + block.Samples() - 1);
+        return true;
+    }else if(0 <= ps.x_sequence && ps.x_sequence < (int)block.Dimensions() && log.Stats(ps.x_sequence).isMonotonic) {
+        const float* x = block.DimData(ps.x_sequence);
+        x_first = x[0];
+        x_last = x[(block.Samples()-1) * block.Dimensions()];
+        return std::isfinite(x_first) && std::isfinite(x_last);
+    }
+    return false;
+}
+
+const float* Plotter::IdArray(size_t level, size_t num_samples)
+{
+    if(id_arrays.size() <= level) {
+        id_arrays.resize(level+1);
+    }
+
+    std::vector<float>& ids = id_arrays[level];
+    if(ids.size() < num_samples) {
+        // Decimated samples are the minimum of their bucket, placed at its
+        // first sample, followed by the maximum, placed at its last.
+        const size_t bucket_size = DataLogBlock::LevelBucketSize(level);
+        ids.resize(std::max(num_samples, 2*ids.size()));
+        for(size_t k=0; k < ids.size(); ++k) {
+            ids[k] = level == 0 ? (float)k : (float)((k/2)*bucket_size + (k%2)*(bucket_size-1));
+        }
+    }
+    return ids.data();
+}
+
 void Plotter::Render()
 {
+    // Bring in samples queued by producer threads before reading logs
+    if(default_log) default_log->Merge();
+    for(PlotSeries& ps : plotseries) {
+        if(ps.log) ps.log->Merge();
+    }
+
     // Animate scroll / zooming
     UpdateView();
 
@@ -503,9 +566,6 @@ void Plotter::Render()
     //////////////////////////////////////////////////////////////////////////
     // Draw series
 
-    static size_t id_size = 0;
-    static float* id_array = 0;
-
     for(size_t i=0; i < plotseries.size(); ++i)
     {
         PlotSeries& ps = plotseries[i];
@@ -529,17 +589,25 @@ void Plotter::Render()
                 // Retrieve line width for this block
                 float line_width = block->GetLineWidth();
                 glLineWidth( line_width ); // Set line width dynamically for each block
-                 
-                if(ps.contains_id ) {
-                    if(id_size < block->Samples() ) {
-                        // Create index array that we can bind
-                        delete[] id_array;
-                        id_size = block->MaxSamples();
-                        id_array = new float[id_size];
-                        for(size_t k=0; k < id_size; ++k) {
-                            id_array[k] = (float)k;
-                        }
+
+                // When x increases with each sample, skip blocks out of view
+                // and, if x and y are plain sequences, draw the level of
+                // detail with about one bucket of samples per pixel, so that
+                // cost doesn't grow with history.
+                bool in_view = true;
+                size_t level = 0;
+                float x_first, x_last;
+                if(BlockRangeX(ps, *log, *block, x_first, x_last)) {
+                    in_view = x_first <= rview.x.max && rview.x.min <= x_last;
+                    const float pixels = std::max(1.0f, (x_last - x_first) * v.w / w);
+                    const float samples_per_pixel = block->Samples() / pixels;
+                    while(ps.single_sequences && level+1 < block->Levels() && DataLogBlock::LevelBucketSize(level+1) <= samples_per_pixel) {
+                        ++level;
                     }
+                }
+                const size_t level_samples = block->LevelSamples(level);
+
+                if(ps.contains_id ) {
                     prog.SetUniform("u_id_offset",  (float)block->StartId() );
                 }
 
@@ -547,10 +615,10 @@ void Plotter::Render()
                 bool shouldRender = true;
                 for(size_t i=0; i< ps.attribs.size(); ++i) {
                     if(0 <= ps.attribs[i].plot_id && ps.attribs[i].plot_id < (int)block->Dimensions() ) {
-                        glVertexAttribPointer(ps.attribs[i].location, 1, GL_FLOAT, GL_FALSE, (GLsizei)(block->Dimensions()*sizeof(float)), block->DimData(ps.attribs[i].plot_id) );
+                        glVertexAttribPointer(ps.attribs[i].location, 1, GL_FLOAT, GL_FALSE, (GLsizei)(block->Dimensions()*sizeof(float)), block->LevelDimData(level, ps.attribs[i].plot_id) );
                         glEnableVertexAttribArray(ps.attribs[i].location);
                     }else if( ps.attribs[i].plot_id == -1 ){
-                        glVertexAttribPointer(ps.attribs[i].location, 1, GL_FLOAT, GL_FALSE, 0, id_array );
+                        glVertexAttribPointer(ps.attribs[i].location, 1, GL_FLOAT, GL_FALSE, 0, IdArray(level, level_samples) );
                         glEnableVertexAttribArray(ps.attribs[i].location);
                     }else{
                         // bad id: don't render
@@ -561,7 +629,9 @@ void Plotter::Render()
 
                 if(shouldRender) {
                     // Draw geometry
-                    glDrawArrays(ps.drawing_mode, 0, (GLsizei)block->Samples());
+                    if(in_view) {
+                        glDrawArrays(ps.drawing_mode, 0, (GLsizei)level_samples);
+                    }
                     ps.used = true;
                 }
 
@@ -619,40 +689,34 @@ void Plotter::Render()
     }
     prog_lines.Unbind();
 
-    prog_text.SaveBind();
+    // Labels are collected and drawn together, offsets included in vertices
+    text_batch.Clear();
 
     //////////////////////////////////////////////////////////////////////////
     // Draw Key
 
-    prog_text.SetUniform("u_scale",  2.0f / v.w, 2.0f / v.h);
-
     int keyid = 0;
     for(size_t i=0; i < plotseries.size(); ++i)
     {
         PlotSeries& ps = plotseries[i];
         if(ps.used && ps.drawing_mode != pangolin::DrawingModeNone) {
-            prog_text.SetUniform("u_color", ps.colour );
-            prog_text.SetUniform("u_offset",
+            text_batch.Add(ps.title,
                 v.w-5.0f-ps.title.Width() -(v.w/2.0f),
-                v.h-1.2f*default_font().Height()*(++keyid) -(v.h/2.0f)
+                v.h-1.2f*default_font().Height()*(++keyid) -(v.h/2.0f),
+                ps.colour
             );
-            ps.title.DrawGlSl();
         }
     }
 
     //////////////////////////////////////////////////////////////////////////
     // Draw axis text
 
-    prog_text.SetUniform("u_scale",  2.0f / v.w, 2.0f / v.h);
-    prog_text.SetUniform("u_color", colour_ax );
-
     for( int i=tx[0]; i<tx[1]; ++i ) {
         std::ostringstream oss;
         oss << i*tdelta[0]*tick[0].factor << tick[0].symbol;
         GlText txt = default_font().Text(oss.str().c_str());
         float sx = v.w*((i)*tdelta[0]-rview.x.Mid())/w - txt.Width()/2.0f;
-        prog_text.SetUniform("u_offset", sx, 15 -v.h/2.0f );
-        txt.DrawGlSl();
+        text_batch.Add(txt, sx, 15 -v.h/2.0f, colour_ax);
     }
 
     for( int i=ty[0]; i<ty[1]; ++i ) {
@@ -660,10 +724,12 @@ void Plotter::Render()
         oss << i*tdelta[1]*tick[1].factor << tick[1].symbol;
         GlText txt = default_font().Text(oss.str().c_str());
         float sy = v.h*((i)*tdelta[1]-rview.y.Mid())/h - txt.Height()/2.0f;
-        prog_text.SetUniform("u_offset", 15 -v.w/2.0f, sy );
-        txt.DrawGlSl();
+        text_batch.Add(txt, 15 -v.w/2.0f, sy, colour_ax);
     }
 
+    prog_text.SaveBind();
+    prog_text.SetUniform("u_scale",  2.0f / v.w, 2.0f / v.h);
+    text_batch.FlushGlSl();
     prog_text.Unbind();
 
 
@@ -0,0 +1,168 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pangolin/plot/datalog.h>
+
+TEST_CASE("Every sample from a released producer is merged")
+{
+    const size_t num_samples = 200000;
+
+    for(int run=0; run < 5; ++run) {
+        pangolin::DataLog log;
+        std::shared_ptr<pangolin::DataLogProducer> producer = log.CreateProducer(1 << 10);
+        std::atomic<bool> done(false);
+
+        // The producer is released as soon as the last sample is queued, while
+        // the log is being merged from this thread.
+        std::thread logger([&, producer = std::move(producer)]() mutable {
+            for(size_t i=0; i < num_samples; ++i) {
+                const float vals[2] = {float(i), float(2*i)};
+                while(!producer->Log(2, vals)) {
+                    std::this_thread::yield();
+                }
+            }
+            producer.reset();
+            done = true;
+        });
+
+        while(!done) {
+            log.Merge();
+        }
+        logger.join();
+        log.Merge();
+
+        REQUIRE(log.Samples() == num_samples);
+        for(size_t i=0; i < num_samples; i += 997) {
+            REQUIRE(log.Sample(int(i))[0] == float(i));
+            REQUIRE(log.Sample(int(i))[1] == float(2*i));
+        }
+        REQUIRE(log.Sample(int(num_samples-1))[0] == float(num_samples-1));
+    }
+}
+
+TEST_CASE("Saving a log merges queued samples first")
+{
+    const std::string filename = "test_datalog.csv";
+
+    pangolin::DataLog log;
+    std::shared_ptr<pangolin::DataLogProducer> producer = log.CreateProducer();
+    for(int i=0; i < 10; ++i) {
+        REQUIRE(producer->Log({float(i), float(i+1)}));
+    }
+    REQUIRE(log.Samples() == 0);
+
+    log.Save(filename);
+    REQUIRE(log.Samples() == 10);
+
+    std::ifstream in(filename);
+    std::string line;
+    size_t lines = 0;
+    while(std::getline(in, line)) {
+        if(!line.empty()) ++lines;
+    }
+    REQUIRE(lines == 10);
+
+    in.close();
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("Snapshots include samples queued by producers")
+{
+    pangolin::DataLog log;
+    std::shared_ptr<pangolin::DataLogProducer> producer = log.CreateProducer();
+    for(int i=0; i < 10; ++i) {
+        REQUIRE(producer->Log({float(i), float(-i)}));
+    }
+    REQUIRE(log.Samples() == 0);
+    REQUIRE(log.Sample(3) == nullptr);
+
+    const pangolin::DataLog& snapshot = log.Snapshot();
+    REQUIRE(snapshot.Samples() == 10);
+    REQUIRE(snapshot.Sample(3)[1] == -3.0f);
+    REQUIRE(snapshot.LastBlock()->Samples() == 10);
+    REQUIRE(snapshot.Stats(0).max == 9.0f);
+}
+
+TEST_CASE("Samples with fewer dimensions follow those already in a block")
+{
+    pangolin::DataLogBlock block(3, 10, 0);
+    const float full[6] = {1, 2, 3, 4, 5, 6};
+    const float part[4] = {7, 8, 9, 10};
+    block.AddSamples(2, 3, full);
+    block.AddSamples(2, 2, part);
+    REQUIRE(block.Samples() == 4);
+
+    for(size_t i=0; i < 6; ++i) {
+        REQUIRE(block.Sample(i/3)[i%3] == full[i]);
+    }
+    for(size_t i=0; i < 2; ++i) {
+        REQUIRE(block.Sample(2+i)[0] == part[2*i]);
+        REQUIRE(block.Sample(2+i)[1] == part[2*i+1]);
+        REQUIRE(std::isnan(block.Sample(2+i)[2]));
+    }
+}
+
+TEST_CASE("Levels of detail hold the minimum and maximum of each bucket")
+{
+    const size_t dim = 2, max_samples = 100;
+    pangolin::DataLogBlock block(dim, max_samples, 0);
+    REQUIRE(block.Levels() == 4);
+
+    // Added a few at a time, so that levels are updated incrementally. The
+    // second dimension is missing from some samples.
+    std::vector<float> added;
+    for(size_t chunk : {7, 30, 1, 19}) {
+        std::vector<float> data;
+        for(size_t i=0; i < chunk; ++i) {
+            const size_t n = added.size() / dim;
+            data.push_back(float(n));
+            data.push_back(n >= 40 && n < 48 ? NAN : float((n * 37) % 23));
+            added.insert(added.end(), data.end() - dim, data.end());
+        }
+        block.AddSamples(chunk, dim, data.data());
+    }
+    const size_t samples = added.size() / dim;
+    REQUIRE(block.Samples() == samples);
+    REQUIRE(block.LevelSamples(0) == samples);
+    REQUIRE(block.LevelDimData(0, 1) == block.DimData(1));
+
+    for(size_t l=1; l < block.Levels(); ++l) {
+        const size_t bucket = pangolin::DataLogBlock::LevelBucketSize(l);
+        const size_t buckets = (samples + bucket - 1) / bucket;
+        REQUIRE(block.LevelSamples(l) == 2 * buckets);
+
+        for(size_t d=0; d < dim; ++d) {
+            const float* level = block.LevelDimData(l, d);
+            for(size_t b=0; b < buckets; ++b) {
+                float lo = INFINITY, hi = -INFINITY;
+                for(size_t s = b*bucket; s < std::min(samples, (b+1)*bucket); ++s) {
+                    const float v = added[s*dim + d];
+                    if(!std::isnan(v)) {
+                        lo = std::min(lo, v);
+                        hi = std::max(hi, v);
+                    }
+                }
+                if(lo > hi) {
+                    REQUIRE(std::isnan(level[2*b*dim]));
+                    REQUIRE(std::isnan(level[(2*b+1)*dim]));
+                }else{
+                    REQUIRE(level[2*b*dim] == lo);
+                    REQUIRE(level[(2*b+1)*dim] == hi);
+                }
+            }
+        }
+    }
+}
@@ -27,6 +27,7 @@
 
 #include "datalog.hpp"
 
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include <pangolin/plot/datalog.h>
 
@@ -73,14 +74,34 @@ namespace py_pangolin {
       .def("Log", (void (pangolin::DataLog::*)(float, float, float, float, float, float, float, float))&pangolin::DataLog::Log)
       .def("Log", (void (pangolin::DataLog::*)(float, float, float, float, float, float, float, float, float))&pangolin::DataLog::Log)
       .def("Log", (void (pangolin::DataLog::*)(float, float, float, float, float, float, float, float, float, float))&pangolin::DataLog::Log)
+      // Only takes numpy arrays, without conversion, so that numbers and
+      // lists still reach the overloads above and below. A 2D array holds
+      // one sample per row, and a 0D array is a sample of one value.
+      // Must stay ahead of the std::vector overload, which would otherwise
+      // take 1D float64 arrays element by element, since numpy.float64 is a
+      // Python float.
+      .def("Log", [](pangolin::DataLog& log, pybind11::array vals){
+            using FloatArray = pybind11::array_t<float, pybind11::array::c_style | pybind11::array::forcecast>;
+            const FloatArray samples = FloatArray::ensure(vals);
+            if(!samples || samples.ndim() > 2) {
+                throw std::invalid_argument("DataLog.Log expects a 1D array (one sample) or 2D array (samples x dimensions) of numbers");
+            }
+            const size_t num_samples = samples.ndim() == 2 ? samples.shape(0) : 1;
+            const size_t dimension = samples.ndim() == 0 ? 1 : samples.shape(samples.ndim() - 1);
+            if(num_samples && dimension) {
+                log.Log(dimension, samples.data(), (unsigned int)num_samples);
+            }
+        }, pybind11::arg("vals").noconvert())
       .def("Log", (void (pangolin::DataLog::*)(const std::vector<float>&))&pangolin::DataLog::Log)
+      .def("Merge", &pangolin::DataLog::Merge)
       .def("Clear", &pangolin::DataLog::Clear)
       .def("Save", &pangolin::DataLog::Save)
-      .def("FirstBlock", &pangolin::DataLog::FirstBlock)
-      .def("LastBlock", &pangolin::DataLog::LastBlock)
-      .def("Samples", &pangolin::DataLog::Samples)
-      .def("Sample", &pangolin::DataLog::Sample)
-      .def("Stats", &pangolin::DataLog::Stats);
+      // Read through Snapshot() so that samples queued by producers are seen
+      .def("FirstBlock", [](pangolin::DataLog& log){ return log.Snapshot().FirstBlock(); }, pybind11::return_value_policy::reference_internal)
+      .def("LastBlock", [](pangolin::DataLog& log){ return log.Snapshot().LastBlock(); }, pybind11::return_value_policy::reference_internal)
+      .def("Samples", [](pangolin::DataLog& log){ return log.Snapshot().Samples(); })
+      .def("Sample", [](pangolin::DataLog& log, int n){ return log.Snapshot().Sample(n); })
+      .def("Stats", [](pangolin::DataLog& log, size_t dim){ return log.Snapshot().Stats(dim); });
   }
 
 }  // py_pangolin
@@ -37,7 +37,7 @@ namespace py_pangolin {
     pybind11::class_<pangolin::GlText> glTextClass(m, "GlText");
     glTextClass.def(pybind11::init<>())
       .def("AddSpace", &pangolin::GlText::AddSpace)
-      .def("Add", &pangolin::GlText::Add)
+      .def("Add", (void (pangolin::GlText::*)(unsigned char, const pangolin::GlChar&)) &pangolin::GlText::Add)
       .def("Clear", &pangolin::GlText::Clear)
       .def("Draw", (void (pangolin::GlText::*)() const) &pangolin::GlText::Draw)
       .def("DrawGlSl", &pangolin::GlText::DrawGlSl)
@@ -292,89 +292,74 @@ namespace py_pangolin {
 
   };
 
-  pybind11::list VideoInputGrab(pangolin::VideoInput& vi, bool wait, bool newest){
-      unsigned char *buffer = new unsigned char[vi.SizeBytes()];
+  template<typename T>
+  pybind11::array StreamArray(const pangolin::StreamInfo& si, unsigned char* frame, pybind11::handle owner)
+  {
+      const pangolin::PixelFormat& pf = si.PixFormat();
+      const size_t Bpp = pf.bpp / 8;
+      return pybind11::array_t<T>(
+          {(size_t)si.Height(), (size_t)si.Width(), (size_t)pf.channels},
+          {si.Pitch(), Bpp, Bpp / pf.channels},
+          (T*)(frame + (size_t)si.Offset()),
+          owner
+      );
+  }
 
-      std::vector<pangolin::Image<unsigned char>> imgs;
+  // Returns views into a single frame buffer, one per stream.
+  //
+  // Videos which lend their own buffers, such as V4L's mapped buffers or
+  // ThreadVideo's queue, have only a few of them, and would stall once
+  // Python held on to that many frames. Frames are instead copied into a
+  // buffer recycled from the VideoInput's pool, which grows as needed. The
+  // buffer returns to the pool once Python releases every view of it.
+  pybind11::list VideoInputGrab(pangolin::VideoInput& vi, bool wait, bool newest){
       pybind11::list imgsList;
 
-      if(vi.Grab(buffer,imgs,wait,newest)) {
-          for(size_t s=0; s < vi.Streams().size(); ++s) {
-              // Let's just return the first stream for the moment
-              const pangolin::StreamInfo& si = vi.Streams()[s];
-              const pangolin::Image<uint8_t> img = si.StreamImage(buffer);
-
-              const int c = si.PixFormat().channels;
-              const std::string fmt = si.PixFormat().format;
-              const int Bpp = si.PixFormat().bpp / (8);
-              const int Bpc = Bpp / c;
-              const int bpc = si.PixFormat().bpp / c;
-              PANGO_ASSERT(bpc == 8 || bpc == 16 || bpc == 32, "only support 8, 16, 32 bits channel");
-
-              pangolin::Image<uint8_t> dstImage(
-                  new unsigned char[img.h * img.w * Bpp],
-                  img.w, img.h, img.w*Bpp
-              );
-
-              pangolin::PitchedCopy((char*)dstImage.ptr, dstImage.pitch, (char*)img.ptr, img.pitch, img.w * Bpp, img.h);
-
-              // Create a Python object that will free the allocated memory
-              pybind11::capsule free_when_done(dstImage.ptr,[](void* f) {
-                unsigned char* buffer = (unsigned char*)f;
-                delete[] buffer;
-              });
-
-              if (bpc == 8) {
-                  imgsList.append(
-                      pybind11::array_t<uint8_t>(
-                      {(int)dstImage.h, (int)dstImage.w, c },
-                      {(int)dstImage.pitch, Bpp, Bpc},
-                      (uint8_t*)dstImage.ptr,
-                      free_when_done)
-                      );
-              }
-              else if (bpc == 16){
-                  imgsList.append(
-                      pybind11::array_t<uint16_t>(
-                      {(int)dstImage.h, (int)dstImage.w, c },
-                      {(int)dstImage.pitch, Bpp, Bpc},
-                      (uint16_t*)dstImage.ptr,
-                      free_when_done)
-                      );
+      pangolin::VideoFrameLease frame;
+      {
+          // Let other Python threads run while we wait for the device
+          pybind11::gil_scoped_release release;
+          frame = newest ? vi.LeaseNewestCopy(wait) : vi.LeaseNextCopy(wait);
+      }
+      if(!frame) {
+          return imgsList;
+      }
+      unsigned char* data = frame.get();
+      pybind11::capsule owner(new pangolin::VideoFrameLease(std::move(frame)), [](void* f) {
+          delete (pangolin::VideoFrameLease*)f;
+      });
+
+      for(const pangolin::StreamInfo& si : vi.Streams()) {
+          const int c = si.PixFormat().channels;
+          const std::string fmt = si.PixFormat().format;
+          const int bpc = si.PixFormat().bpp / c;
+          PANGO_ASSERT(bpc == 8 || bpc == 16 || bpc == 32, "only support 8, 16, 32 bits channel");
+
+          if (bpc == 8) {
+              imgsList.append(StreamArray<uint8_t>(si, data, owner));
+          }
+          else if (bpc == 16){
+              imgsList.append(StreamArray<uint16_t>(si, data, owner));
+          }
+          else if (bpc == 32){
+              if (fmt == "GRAY32")
+              {
+                  imgsList.append(StreamArray<uint32_t>(si, data, owner));
               }
-              else if (bpc == 32){
-                  if (fmt == "GRAY32")
-                  {
-                      imgsList.append(
-                          pybind11::array_t<uint32_t>(
-                          {(int)dstImage.h, (int)dstImage.w, c },
-                          {(int)dstImage.pitch, Bpp, Bpc},
-                          (uint32_t*)dstImage.ptr,
-                          free_when_done)
-                          );
-                  }
-                  else if (fmt == "GRAY32F" ||
-                           fmt == "RGB96F" ||
-                           fmt == "RGBA128F")
-                  {
-                      imgsList.append(
-                          pybind11::array_t<float>(
-                          {(int)dstImage.h, (int)dstImage.w, c },
-                          {(int)dstImage.pitch, Bpp, Bpc},
-                          (float*)dstImage.ptr,
-                          free_when_done)
-                          );
-                  }
-                  else{
-                      PANGO_ASSERT(false, "unsupported 32 bpc format");
-                  }
+              else if (fmt == "GRAY32F" ||
+                       fmt == "RGB96F" ||
+                       fmt == "RGBA128F")
+              {
+                  imgsList.append(StreamArray<float>(si, data, owner));
               }
               else{
-                  PANGO_ASSERT(false, "incompatible bpc");
+                  PANGO_ASSERT(false, "unsupported 32 bpc format");
               }
           }
+          else{
+              PANGO_ASSERT(false, "incompatible bpc");
+          }
       }
-      delete[] buffer;
       return imgsList;
   }
 
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+import os
+import unittest
+
+import numpy as np
+import pypangolin as pango
+
+
+class TestDataLog(unittest.TestCase):
+    def test_sequences_log_one_sample(self):
+        log = pango.DataLog()
+        log.Log([1, 2, 3])
+        log.Log((4.0, 5.0, 6.0))
+        self.assertEqual(log.Samples(), 2)
+
+    def test_nested_sequences_arent_taken_as_arrays(self):
+        # Only numpy arrays reach the array overload, which would take this
+        # as two samples. The std::vector overload can't take it at all.
+        log = pango.DataLog()
+        with self.assertRaises(TypeError):
+            log.Log([[1, 2], [3, 4]])
+        self.assertEqual(log.Samples(), 0)
+
+    def test_arrays_log_a_sample_per_row(self):
+        log = pango.DataLog()
+        log.Log(np.array([1, 2, 3], dtype=np.float64))
+        log.Log(np.arange(8, dtype=np.int32).reshape(4, 2))
+        log.Log(np.float32(7))
+        self.assertEqual(log.Samples(), 6)
+
+    def test_logged_values(self):
+        filename = "test_pypangolin_datalog.csv"
+        log = pango.DataLog()
+        log.Log([1, 2])
+        log.Log(np.array([[3, 4], [5, 6]], dtype=np.float64))
+        log.Save(filename)
+        with open(filename) as f:
+            rows = [[float(v) for v in line.split(',')] for line in f if line.strip()]
+        os.remove(filename)
+        self.assertEqual(rows, [[1, 2], [3, 4], [5, 6]])
+
+
+if __name__ == '__main__':
+    unittest.main()
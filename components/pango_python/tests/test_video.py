@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+import unittest
+
+import numpy as np
+import pypangolin as pango
+
+
+class TestVideoGrab(unittest.TestCase):
+    def grab_and_keep(self, uri, num_frames):
+        vi = pango.VideoInput(uri)
+        vi.Start()
+        frames = []
+        for i in range(num_frames):
+            frame = vi.Grab()
+            self.assertEqual(len(frame), 1)
+            self.assertEqual(frame[0].shape, (48, 64, 3))
+            frames.append(frame)
+        return frames
+
+    def test_kept_frames_dont_starve_lending_videos(self):
+        # ThreadVideo lends frames from its queue of three buffers, so keeping
+        # more frames than that must not hold on to them.
+        frames = self.grab_and_keep("thread:[num_buffers=3]//test:[size=64x48,fmt=RGB24]//", 10)
+        for a, b in zip(frames, frames[1:]):
+            self.assertFalse(np.shares_memory(a[0], b[0]))
+
+    def test_kept_frames_from_pool(self):
+        frames = self.grab_and_keep("test:[size=64x48,fmt=RGB24]//", 10)
+        for a, b in zip(frames, frames[1:]):
+            self.assertFalse(np.shares_memory(a[0], b[0]))
+
+    def test_released_frames_are_reused(self):
+        vi = pango.VideoInput("thread:[num_buffers=3]//test:[size=64x48,fmt=RGB24]//")
+        vi.Start()
+        frame = vi.Grab()
+        address = frame[0].__array_interface__['data'][0]
+        del frame
+        frame = vi.Grab()
+        self.assertEqual(frame[0].__array_interface__['data'][0], address)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -7,6 +7,11 @@
 #include <pangolin/scene/renderable.h>
 #include <pangolin/scene/interactive_index.h>
 
+#include <algorithm>
+#include <functional>
+#include <typeinfo>
+#include <vector>
+
 #ifdef HAVE_EIGEN
 #  include <Eigen/Geometry>
 #endif
@@ -40,6 +45,58 @@ struct Axis : public Renderable, public Interactive
         glPopName();
     }
 
+    bool GetBounds(GLprecision min_c[3], GLprecision max_c[3]) const override
+    {
+        for(int i=0; i < 3; ++i) {
+            min_c[i] = std::min<GLprecision>(0, axis_length);
+            max_c[i] = std::max<GLprecision>(0, axis_length);
+        }
+        return true;
+    }
+
+    size_t InstanceKey() const override
+    {
+        // Axes of the same length are drawn identically
+        const size_t key = typeid(Axis).hash_code() ^ std::hash<float>()(axis_length);
+        return key ? key : 1;
+    }
+
+    void RenderInstances(const RenderParams& params, const OpenGlMatrix* T_instances, size_t n) override
+    {
+        if(params.render_mode != GL_RENDER) {
+            Renderable::RenderInstances(params, T_instances, n);
+            return;
+        }
+
+        // Transform the lines of every axis on the CPU and draw them at once
+        instance_vertices.resize(n*6*3);
+        instance_colours.resize(n*6*4);
+        for(size_t i=0; i < n; ++i) {
+            const GLprecision* T = T_instances[i].m;
+            GLfloat* v = instance_vertices.data() + i*6*3;
+            GLfloat* c = instance_colours.data() + i*6*4;
+            for(int a=0; a < 3; ++a) {
+                for(int k=0; k < 3; ++k) {
+                    v[a*6 + k] = GLfloat(T[12+k]);
+                    v[a*6 + 3 + k] = GLfloat(T[12+k] + axis_length * T[a*4+k]);
+                }
+                for(int p=0; p < 2; ++p) {
+                    for(int k=0; k < 4; ++k) {
+                        c[a*8 + p*4 + k] = (k == a || k == 3) ? 1.0f : 0.0f;
+                    }
+                }
+            }
+        }
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, instance_vertices.data());
+        glColorPointer(4, GL_FLOAT, 0, instance_colours.data());
+        glDrawArrays(GL_LINES, 0, GLsizei(n*6));
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+
     bool Mouse(
         int button,
         const GLprecision /*win*/[3], const GLprecision /*obj*/[3], const GLprecision /*normal*/[3],
@@ -112,6 +169,10 @@ struct Axis : public Renderable, public Interactive
     const InteractiveIndex::Token label_x;
     const InteractiveIndex::Token label_y;
     const InteractiveIndex::Token label_z;
+
+protected:
+    std::vector<GLfloat> instance_vertices;
+    std::vector<GLfloat> instance_colours;
 };
 
 }
@@ -0,0 +1,143 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <pangolin/scene/renderable.h>
+
+namespace pangolin {
+
+//! Flattened copy of a Renderable tree for drawing large scenes. Nodes are
+//! held in depth first order alongside contiguous arrays of their poses
+//! relative to the root. Each frame, a node's T_pc is compared with the
+//! value last seen and only changed subtrees are recomputed. Subtrees whose
+//! bounds lie outside of the view frustum are skipped, and renderables
+//! sharing an InstanceKey() are drawn together by one RenderInstances() call
+//! after the rest of the scene.
+//!
+//! Only the children of renderables whose ChildrenFollowPose() is true are
+//! flattened. Other renderables are drawn whole by their own Render().
+//!
+//! The tree is recompiled when a node under root is released, or its
+//! children are added or removed through Renderable::Add() / Remove() or
+//! change in number. Call Compile() after changing children, bounds or
+//! instance keys in any other way.
+class CompiledScene
+{
+public:
+    CompiledScene(Renderable& root);
+
+    //! Rebuild from the tree under root
+    void Compile();
+
+    //! Draw as root.Render(params) would, relative to the current modelview.
+    //! Instanced renderables are only batched for GL_RENDER.
+    void Render(const RenderParams& params = RenderParams());
+
+    //! As Render(params), but culling against the view frustum of
+    //! P_cull * T_cull (projection and modelview) rather than the current GL
+    //! matrices
+    void Render(const RenderParams& params, const OpenGlMatrix& P_cull, const OpenGlMatrix& T_cull);
+
+    size_t NumNodes() const
+    {
+        return nodes.size();
+    }
+
+    //! Nodes drawn by the last Render(), including instances
+    size_t NumDrawn() const
+    {
+        return num_drawn;
+    }
+
+    //! Nodes skipped by frustum culling in the last Render()
+    size_t NumCulled() const
+    {
+        return num_culled;
+    }
+
+protected:
+    struct Box
+    {
+        // Unbounded boxes are never culled
+        bool bounded;
+        GLprecision min[3];
+        GLprecision max[3];
+    };
+
+    struct Batch
+    {
+        Renderable* renderable;
+        bool flatten;
+        std::vector<OpenGlMatrix> T_instances;
+    };
+
+    // Append r and its descendants in depth first order
+    void AddNode(Renderable& r, const std::weak_ptr<Renderable>& ref, size_t parent_index);
+
+    // False if a node has been released or its children have changed since
+    // Compile()
+    bool Valid() const;
+
+    // Recompute poses and bounds of nodes whose T_pc, or an ancestor's, has
+    // changed
+    void Update();
+
+    // True if box lies entirely outside of one of the frustum planes
+    bool Outside(const Box& box, const GLprecision planes[6][4]) const;
+
+    Renderable& root;
+
+    // Indexed by node in depth first order, root first
+    std::vector<Renderable*> nodes;
+    // Owning references held by each node's parent, empty for the root.
+    // Nodes are only dereferenced once these are checked by Valid().
+    std::vector<std::weak_ptr<Renderable>> refs;
+    std::vector<uint64_t> children_version;
+    std::vector<size_t> num_children;
+    // Whether children are in nodes, rather than drawn by Render()
+    std::vector<unsigned char> flatten;
+    std::vector<size_t> parent;
+    std::vector<size_t> subtree_end;
+    std::vector<size_t> instance_key;
+    std::vector<OpenGlMatrix> T_pc;
+    std::vector<OpenGlMatrix> T_rn;
+    std::vector<unsigned char> dirty;
+    // Bounds from GetBounds(), in each node's own frame
+    std::vector<Box> own_bounds;
+    // Bounds of each node and its descendants, in the root frame
+    std::vector<Box> bounds;
+
+    std::unordered_map<size_t, Batch> batches;
+
+    size_t num_drawn;
+    size_t num_culled;
+};
+
+}
@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <map>
 #include <random>
@@ -56,12 +57,27 @@ public:
 
     Renderable& Add(const std::shared_ptr<Renderable>& child);
 
-    void Remove(const std::shared_ptr<Renderable>& child)
-    {
-        if(child) {
-            children.erase(child->guid);
-        }
-    }
+    void Remove(const std::shared_ptr<Renderable>& child);
+
+    // Bounds of what Render() draws, excluding children, in this
+    // renderable's frame. Returns false if unknown, which is the default for
+    // derived classes. An empty box (min > max) means nothing is drawn.
+    virtual bool GetBounds(GLprecision min_c[3], GLprecision max_c[3]) const;
+
+    // Renderables returning the same non-zero key draw the same geometry,
+    // differing only in pose, so that one RenderInstances() call can draw
+    // them all. Zero (the default) if this renderable isn't instanced.
+    virtual size_t InstanceKey() const;
+
+    // Draw this renderable's geometry at each of the n poses, given relative
+    // to the current modelview. The default calls Render() for each.
+    virtual void RenderInstances(const RenderParams& params, const OpenGlMatrix* T_instances, size_t n);
+
+    // True if Render() draws only this renderable's own geometry, leaving
+    // its children to RenderChildren() at their T_pc, so that a
+    // CompiledScene may draw them itself. The default is false for derived
+    // classes, which may apply their own transforms or not draw children.
+    virtual bool ChildrenFollowPose() const;
 
     // Renderable properties
     const guid_t guid;
@@ -74,6 +90,15 @@ public:
 
     // Manipulator (handler, thing)
     std::shared_ptr<Manipulator> manipulator;
+
+protected:
+    friend class CompiledScene;
+
+    // Changes whenever a child is added to or removed from this renderable
+    uint64_t children_version;
+
+    // Set while a CompiledScene draws, which handles the children itself
+    static thread_local bool children_rendered_by_scene;
 };
 
 }
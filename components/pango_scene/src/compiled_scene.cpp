@@ -0,0 +1,280 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/scene/compiled_scene.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace pangolin {
+
+namespace {
+
+// Axis aligned bounds of box transformed by T (Arvo's method)
+void TransformBox(GLprecision min_out[3], GLprecision max_out[3], const GLprecision* T, const GLprecision min_in[3], const GLprecision max_in[3])
+{
+    for(int k=0; k < 3; ++k) {
+        min_out[k] = max_out[k] = T[12+k];
+        for(int j=0; j < 3; ++j) {
+            const GLprecision a = T[j*4+k] * min_in[j];
+            const GLprecision b = T[j*4+k] * max_in[j];
+            min_out[k] += std::min(a,b);
+            max_out[k] += std::max(a,b);
+        }
+    }
+}
+
+bool IsEmpty(const GLprecision min[3], const GLprecision max[3])
+{
+    return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+}
+
+}
+
+CompiledScene::CompiledScene(Renderable& root)
+    : root(root), num_drawn(0), num_culled(0)
+{
+    Compile();
+}
+
+void CompiledScene::Compile()
+{
+    nodes.clear();
+    refs.clear();
+    children_version.clear();
+    num_children.clear();
+    flatten.clear();
+    parent.clear();
+    subtree_end.clear();
+    instance_key.clear();
+    T_pc.clear();
+    T_rn.clear();
+    own_bounds.clear();
+    batches.clear();
+
+    AddNode(root, std::weak_ptr<Renderable>(), 0);
+
+    // Everything needs computing on the first Update()
+    dirty.assign(nodes.size(), 1);
+    bounds.resize(nodes.size());
+}
+
+void CompiledScene::AddNode(Renderable& r, const std::weak_ptr<Renderable>& ref, size_t parent_index)
+{
+    const size_t i = nodes.size();
+    nodes.push_back(&r);
+    refs.push_back(ref);
+    children_version.push_back(r.children_version);
+    num_children.push_back(r.children.size());
+    flatten.push_back(r.ChildrenFollowPose());
+    parent.push_back(parent_index);
+    subtree_end.push_back(0);
+    // The root is drawn without its pose or manipulator, as in Render()
+    instance_key.push_back(i && !r.manipulator ? r.InstanceKey() : 0);
+    T_pc.push_back(r.T_pc);
+    T_rn.push_back(IdentityMatrix());
+
+    Box b;
+    b.bounded = r.GetBounds(b.min, b.max);
+    if(!flatten[i] && !r.children.empty()) {
+        // Children drawn by Render() may be anywhere
+        b.bounded = false;
+    }
+    own_bounds.push_back(b);
+
+    if(flatten[i]) {
+        for(auto& c : r.children) {
+            if(c.second) AddNode(*c.second, c.second, i);
+        }
+    }
+    subtree_end[i] = nodes.size();
+}
+
+bool CompiledScene::Valid() const
+{
+    for(size_t i=0; i < nodes.size(); ++i) {
+        if(i && refs[i].expired()) return false;
+        const Renderable& r = *nodes[i];
+        if(r.children_version != children_version[i] || r.children.size() != num_children[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompiledScene::Update()
+{
+    // Parents come before their children, so their poses are already up to
+    // date.
+    for(size_t i=1; i < nodes.size(); ++i) {
+        if(std::memcmp(nodes[i]->T_pc.m, T_pc[i].m, sizeof(T_pc[i].m))) {
+            T_pc[i] = nodes[i]->T_pc;
+            dirty[i] = 1;
+        }
+        if(dirty[i] || dirty[parent[i]]) {
+            dirty[i] = 1;
+            T_rn[i] = T_rn[parent[i]] * T_pc[i];
+        }
+    }
+
+    // Children come after their parents, so visit in reverse to grow bounds
+    // from the leaves up.
+    for(size_t i=nodes.size(); i-- > 0; ) {
+        if(!dirty[i]) continue;
+
+        Box& b = bounds[i];
+        const Box& own = own_bounds[i];
+        b.bounded = own.bounded;
+        if(own.bounded) {
+            if(IsEmpty(own.min, own.max)) {
+                std::copy(own.min, own.min+3, b.min);
+                std::copy(own.max, own.max+3, b.max);
+            }else{
+                TransformBox(b.min, b.max, T_rn[i].m, own.min, own.max);
+            }
+        }
+
+        for(size_t c = i+1; c < subtree_end[i] && b.bounded; c = subtree_end[c]) {
+            const Box& cb = bounds[c];
+            b.bounded = cb.bounded;
+            for(int k=0; k < 3; ++k) {
+                b.min[k] = std::min(b.min[k], cb.min[k]);
+                b.max[k] = std::max(b.max[k], cb.max[k]);
+            }
+        }
+
+        if(i) dirty[parent[i]] = 1;
+        dirty[i] = 0;
+    }
+}
+
+bool CompiledScene::Outside(const Box& box, const GLprecision planes[6][4]) const
+{
+    if(!box.bounded) return false;
+    if(IsEmpty(box.min, box.max)) return true;
+
+    for(int p=0; p < 6; ++p) {
+        const GLprecision* pl = planes[p];
+        // Corner of the box furthest along the plane normal
+        GLprecision d = pl[3];
+        for(int k=0; k < 3; ++k) {
+            d += pl[k] * (pl[k] >= 0 ? box.max[k] : box.min[k]);
+        }
+        if(d < 0) return true;
+    }
+    return false;
+}
+
+void CompiledScene::Render(const RenderParams& params)
+{
+    GLfloat P[16], MV[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, P);
+    glGetFloatv(GL_MODELVIEW_MATRIX, MV);
+
+    OpenGlMatrix P_cull, T_cull;
+    std::copy(P, P+16, P_cull.m);
+    std::copy(MV, MV+16, T_cull.m);
+    Render(params, P_cull, T_cull);
+}
+
+void CompiledScene::Render(const RenderParams& params, const OpenGlMatrix& P_cull, const OpenGlMatrix& T_cull)
+{
+    if(!Valid()) {
+        Compile();
+    }
+    Update();
+
+    // Frustum planes in the root frame, from the rows of projection * modelview
+    const OpenGlMatrix PT = P_cull * T_cull;
+    const GLprecision* M = PT.m;
+    GLprecision planes[6][4];
+    for(int p=0; p < 6; ++p) {
+        const int r = p / 2;
+        const GLprecision s = (p % 2) ? -1 : 1;
+        for(int c=0; c < 4; ++c) {
+            planes[p][c] = M[c*4+3] + s * M[c*4+r];
+        }
+    }
+
+    // Flattened children are visited here instead, so are skipped by
+    // RenderChildren(). Restored afterwards in case this scene is itself
+    // drawn from within a Render().
+    struct RenderChildrenGuard
+    {
+        RenderChildrenGuard() : previous(Renderable::children_rendered_by_scene) {}
+        ~RenderChildrenGuard() { Renderable::children_rendered_by_scene = previous; }
+        const bool previous;
+    } guard;
+
+    for(auto& kv : batches) {
+        kv.second.T_instances.clear();
+    }
+    num_drawn = 0;
+    num_culled = 0;
+
+    // Selection needs names pushed per renderable, so don't batch
+    const bool batching = params.render_mode == GL_RENDER;
+
+    for(size_t i=0; i < nodes.size(); ) {
+        Renderable& r = *nodes[i];
+        if(i && !r.should_show) {
+            i = subtree_end[i];
+            continue;
+        }
+        if(Outside(bounds[i], planes)) {
+            num_culled += subtree_end[i] - i;
+            i = subtree_end[i];
+            continue;
+        }
+
+        if(batching && instance_key[i]) {
+            Batch& batch = batches[instance_key[i]];
+            batch.renderable = &r;
+            batch.flatten = flatten[i];
+            batch.T_instances.push_back(T_rn[i]);
+        }else{
+            glPushMatrix();
+            T_rn[i].Multiply();
+            Renderable::children_rendered_by_scene = flatten[i];
+            r.Render(params);
+            if(i && r.manipulator) {
+                r.manipulator->Render(params);
+            }
+            glPopMatrix();
+        }
+        ++num_drawn;
+        ++i;
+    }
+
+    for(auto& kv : batches) {
+        Batch& batch = kv.second;
+        if(!batch.T_instances.empty()) {
+            Renderable::children_rendered_by_scene = batch.flatten;
+            batch.renderable->RenderInstances(params, batch.T_instances.data(), batch.T_instances.size());
+        }
+    }
+}
+
+}
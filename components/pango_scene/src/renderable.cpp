@@ -1,7 +1,12 @@
 #include <pangolin/scene/renderable.h>
 
+#include <algorithm>
+#include <limits>
+#include <typeinfo>
+
 namespace pangolin {
 
+thread_local bool Renderable::children_rendered_by_scene = false;
 
 Renderable::guid_t Renderable::UniqueGuid()
 {
@@ -11,7 +16,7 @@ Renderable::guid_t Renderable::UniqueGuid()
 }
 
 Renderable::Renderable(const std::weak_ptr<Renderable>& parent)
-    : guid(UniqueGuid()), parent(parent), T_pc(IdentityMatrix()), should_show(true)
+    : guid(UniqueGuid()), parent(parent), T_pc(IdentityMatrix()), should_show(true), children_version(0)
 {
 }
 
@@ -26,6 +31,8 @@ void Renderable::Render(const RenderParams& params) {
 
 void Renderable::RenderChildren(const RenderParams& params)
 {
+    if(children_rendered_by_scene) return;
+
     for(auto& p : children) {
         Renderable& r = *p.second;
         if(r.should_show) {
@@ -59,8 +66,47 @@ Renderable& Renderable::Add(const std::shared_ptr<Renderable>& child)
 {
     if(child) {
         children[child->guid] = child;
+        ++children_version;
     };
     return *this;
 }
 
+void Renderable::Remove(const std::shared_ptr<Renderable>& child)
+{
+    if(child && children.erase(child->guid)) {
+        ++children_version;
+    }
+}
+
+bool Renderable::GetBounds(GLprecision min_c[3], GLprecision max_c[3]) const
+{
+    if(typeid(*this) == typeid(Renderable)) {
+        // Only draws children
+        std::fill(min_c, min_c+3, std::numeric_limits<GLprecision>::max());
+        std::fill(max_c, max_c+3, std::numeric_limits<GLprecision>::lowest());
+        return true;
+    }
+    return false;
+}
+
+size_t Renderable::InstanceKey() const
+{
+    return 0;
+}
+
+void Renderable::RenderInstances(const RenderParams& params, const OpenGlMatrix* T_instances, size_t n)
+{
+    for(size_t i=0; i < n; ++i) {
+        glPushMatrix();
+        T_instances[i].Multiply();
+        Render(params);
+        glPopMatrix();
+    }
+}
+
+bool Renderable::ChildrenFollowPose() const
+{
+    return typeid(*this) == typeid(Renderable);
+}
+
 }
@@ -0,0 +1,245 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <memory>
+#include <vector>
+
+#include <pangolin/scene/compiled_scene.h>
+
+namespace
+{
+
+// Unit cube about the origin, counting how it is drawn
+struct CountedRenderable : public pangolin::Renderable
+{
+    CountedRenderable(size_t key = 0, bool follow_pose = true)
+        : key(key), follow_pose(follow_pose), renders(0), instance_calls(0), instances(0), half_size(0.5)
+    {
+    }
+
+    void Render(const pangolin::RenderParams& params) override
+    {
+        ++renders;
+        RenderChildren(params);
+    }
+
+    bool GetBounds(pangolin::GLprecision min_c[3], pangolin::GLprecision max_c[3]) const override
+    {
+        for(int i=0; i < 3; ++i) {
+            min_c[i] = -half_size;
+            max_c[i] = +half_size;
+        }
+        return true;
+    }
+
+    size_t InstanceKey() const override
+    {
+        return key;
+    }
+
+    void RenderInstances(const pangolin::RenderParams&, const pangolin::OpenGlMatrix*, size_t n) override
+    {
+        ++instance_calls;
+        instances += n;
+    }
+
+    bool ChildrenFollowPose() const override
+    {
+        return follow_pose;
+    }
+
+    size_t key;
+    bool follow_pose;
+    size_t renders;
+    size_t instance_calls;
+    size_t instances;
+    pangolin::GLprecision half_size;
+};
+
+// Sees the cube from -2 to 2 about the root's origin
+void Render(pangolin::CompiledScene& scene, const pangolin::RenderParams& params = pangolin::RenderParams())
+{
+    scene.Render(params, pangolin::ProjectionMatrixOrthographic(-2,2, -2,2, -2,2), pangolin::IdentityMatrix());
+}
+
+std::vector<std::shared_ptr<CountedRenderable>> AddCounted(pangolin::Renderable& parent, size_t n, size_t key = 0)
+{
+    std::vector<std::shared_ptr<CountedRenderable>> added;
+    for(size_t i=0; i < n; ++i) {
+        added.push_back(std::make_shared<CountedRenderable>(key));
+        parent.Add(added.back());
+    }
+    return added;
+}
+
+}
+
+TEST_CASE("Trees are flattened and each node drawn once")
+{
+    pangolin::Renderable root;
+    auto group = std::make_shared<pangolin::Renderable>();
+    root.Add(group);
+    auto leaves = AddCounted(*group, 3);
+    auto nested = AddCounted(*leaves[0], 2);
+
+    pangolin::CompiledScene scene(root);
+    REQUIRE(scene.NumNodes() == 7);
+
+    Render(scene);
+    REQUIRE(scene.NumDrawn() == 7);
+    REQUIRE(scene.NumCulled() == 0);
+    for(const auto& l : leaves) REQUIRE(l->renders == 1);
+    for(const auto& l : nested) REQUIRE(l->renders == 1);
+
+    // Hidden subtrees aren't drawn
+    leaves[0]->should_show = false;
+    Render(scene);
+    REQUIRE(scene.NumDrawn() == 4);
+    REQUIRE(leaves[0]->renders == 1);
+    for(const auto& l : nested) REQUIRE(l->renders == 1);
+}
+
+TEST_CASE("Subtrees outside of the frustum are culled")
+{
+    pangolin::Renderable root;
+    auto inside = AddCounted(root, 1);
+    auto outside = AddCounted(root, 1);
+    auto outside_children = AddCounted(*outside[0], 2);
+    outside[0]->T_pc = pangolin::OpenGlMatrix::Translate(10, 0, 0);
+
+    pangolin::CompiledScene scene(root);
+    Render(scene);
+    REQUIRE(scene.NumDrawn() == 2);
+    REQUIRE(scene.NumCulled() == 3);
+    REQUIRE(inside[0]->renders == 1);
+    REQUIRE(outside[0]->renders == 0);
+    for(const auto& c : outside_children) REQUIRE(c->renders == 0);
+
+    // Moved back into view, with one child left outside
+    outside[0]->T_pc = pangolin::OpenGlMatrix::Translate(1, 0, 0);
+    outside_children[1]->T_pc = pangolin::OpenGlMatrix::Translate(0, -5, 0);
+    Render(scene);
+    REQUIRE(scene.NumDrawn() == 4);
+    REQUIRE(scene.NumCulled() == 1);
+    REQUIRE(outside[0]->renders == 1);
+    REQUIRE(outside_children[0]->renders == 1);
+    REQUIRE(outside_children[1]->renders == 0);
+
+    // Straddling the edge of the frustum is still drawn
+    inside[0]->T_pc = pangolin::OpenGlMatrix::Translate(0, 0, 2.25);
+    Render(scene);
+    REQUIRE(inside[0]->renders == 3);
+}
+
+TEST_CASE("Renderables sharing an instance key are drawn together")
+{
+    pangolin::Renderable root;
+    auto instanced = AddCounted(root, 4, 7);
+    auto other = AddCounted(root, 2, 9);
+    auto single = AddCounted(root, 1);
+    instanced[3]->T_pc = pangolin::OpenGlMatrix::Translate(-10, 0, 0);
+
+    pangolin::CompiledScene scene(root);
+    Render(scene);
+    REQUIRE(scene.NumDrawn() == 7);
+
+    size_t calls = 0, instances = 0;
+    for(const auto& r : instanced) {
+        REQUIRE(r->renders == 0);
+        calls += r->instance_calls;
+        instances += r->instances;
+    }
+    REQUIRE(calls == 1);
+    REQUIRE(instances == 3);
+
+    calls = instances = 0;
+    for(const auto& r : other) {
+        calls += r->instance_calls;
+        instances += r->instances;
+    }
+    REQUIRE(calls == 1);
+    REQUIRE(instances == 2);
+    REQUIRE(single[0]->renders == 1);
+
+    // Selection draws each renderable on its own
+    pangolin::RenderParams select;
+    select.render_mode = GL_SELECT;
+    Render(scene, select);
+    for(size_t i=0; i < 3; ++i) REQUIRE(instanced[i]->renders == 1);
+    REQUIRE(instanced[3]->renders == 0);
+}
+
+TEST_CASE("Scenes are recompiled when their own tree changes")
+{
+    pangolin::Renderable root;
+    auto leaves = AddCounted(root, 2);
+
+    pangolin::CompiledScene scene(root);
+    REQUIRE(scene.NumNodes() == 3);
+
+    auto added = AddCounted(*leaves[1], 2);
+    Render(scene);
+    REQUIRE(scene.NumNodes() == 5);
+    REQUIRE(added[1]->renders == 1);
+
+    leaves[1]->Remove(added[0]);
+    Render(scene);
+    REQUIRE(scene.NumNodes() == 4);
+    REQUIRE(added[0]->renders == 1);
+    REQUIRE(added[1]->renders == 2);
+
+    // Erased directly, and released, without going through Remove()
+    std::weak_ptr<CountedRenderable> erased = leaves[1];
+    root.children.erase(leaves[1]->guid);
+    leaves.pop_back();
+    added.clear();
+    REQUIRE(erased.expired());
+    Render(scene);
+    REQUIRE(scene.NumNodes() == 2);
+    REQUIRE(leaves[0]->renders == 3);
+
+    // Changes to other trees leave this scene as it was compiled, so the
+    // bounds cached for leaves[0] still put it in view.
+    leaves[0]->half_size = -1;
+    pangolin::Renderable other;
+    AddCounted(other, 1);
+    Render(scene);
+    REQUIRE(leaves[0]->renders == 4);
+
+    scene.Compile();
+    Render(scene);
+    REQUIRE(leaves[0]->renders == 4);
+    REQUIRE(scene.NumDrawn() == 0);
+}
+
+TEST_CASE("Renderables drawing their own children aren't flattened")
+{
+    pangolin::Renderable root;
+    auto custom = std::make_shared<CountedRenderable>(0, false);
+    root.Add(custom);
+    auto children = AddCounted(*custom, 2);
+    // Out of view, but custom may draw it anywhere
+    children[0]->T_pc = pangolin::OpenGlMatrix::Translate(10, 0, 0);
+
+    pangolin::CompiledScene scene(root);
+    REQUIRE(scene.NumNodes() == 2);
+
+    Render(scene);
+    REQUIRE(scene.NumCulled() == 0);
+    REQUIRE(custom->renders == 1);
+    for(const auto& c : children) REQUIRE(c->renders == 1);
+
+    // Unflattened renderables may still be instanced
+    auto instanced = std::make_shared<CountedRenderable>(3, false);
+    root.Add(instanced);
+    AddCounted(*instanced, 1);
+    Render(scene);
+    REQUIRE(scene.NumNodes() == 3);
+    REQUIRE(instanced->instance_calls == 1);
+    REQUIRE(custom->renders == 2);
+    for(const auto& c : children) REQUIRE(c->renders == 2);
+}
@@ -3,6 +3,7 @@
 #include <pangolin/gl/gldraw.h>
 #include <pangolin/gl/glpixformat.h>
 #include <pangolin/gl/gltexturecache.h>
+#include <pangolin/display/default_font.h>
 #include <pangolin/display/image_view.h>
 #include <pangolin/display/widgets.h>
 #include <pangolin/utils/file_utils.h>
@@ -117,12 +118,24 @@ void VideoViewer::Run()
         container.AddDisplay(sv);
     }
 
+    // Record glyph in the top right corner, with the health of the record
+    // queue to its left.
     pangolin::View& record_graphic = pangolin::Display("record_glyph").
-            SetBounds(pangolin::Attach::Pix(-28),1.0f, pangolin::Attach::Pix(-28), 1.0f);
+            SetBounds(pangolin::Attach::Pix(-28),1.0f, pangolin::Attach::Pix(-400), 1.0f);
     record_graphic.extern_draw_function = [&](pangolin::View& v){
         if(video.IsRecording()) {
             v.ActivatePixelOrthographic();
-            pangolin::glRecordGraphic(14.0f, 14.0f, 7.0f);
+            pangolin::glRecordGraphic(v.v.w - 14.0f, 14.0f, 7.0f);
+
+            const VideoOutputQueue::Stats stats = video.RecordStats();
+            const GlText text = default_font().Text(
+                "queued %zu  dropped %zu  written %zu", stats.queued, stats.dropped, stats.written
+            );
+            if(stats.dropped) {
+                glColor3f(1.0f, 0.3f, 0.3f);
+            }
+            text.Draw(v.v.w - 28.0f - text.Width(), 9.0f);
+            glColor3f(1.0f, 1.0f, 1.0f);
         }
     };
 
@@ -222,6 +235,9 @@ void VideoViewer::OpenInput(const std::string& input_uri)
     std::lock_guard<std::mutex> lock(control_mutex);
     video.Open(input_uri, output_uri);
 
+    // Keep the display responsive while recording, at the cost of a copy
+    video.SetRecordQueue(8, VideoOutputQueue::Policy::Block);
+
     // Output details of video stream
     for(size_t s = 0; s < video.Streams().size(); ++s) {
         const pangolin::StreamInfo& si = video.Streams()[s];
@@ -125,6 +125,33 @@ public:
         return Get();
     }
 
+    // Copy of the value, safe to take whilst other threads (such as the GUI)
+    // set the var. No conversion is involved when T is the var's own type.
+    T Snapshot() const
+    {
+        return var->Snapshot();
+    }
+
+    // Changes whenever the var is set or reset by any thread.
+    uint64_t Version() const
+    {
+        return var->Version();
+    }
+
+    // Copy the value into val if it has changed since version, which is
+    // updated. Versions start from 1, so the first poll with version 0
+    // always copies. Intended for polling from real-time threads:
+    //     uint64_t version = 0; double gain;
+    //     while(run) { if(var.Poll(gain, version)) {...} }
+    bool Poll(T& val, uint64_t& version) const
+    {
+        const uint64_t latest = Version();
+        if(latest == version) return false;
+        val = Snapshot();
+        version = latest;
+        return true;
+    }
+
     const T* operator->()
     {
         return &(var->Get());
@@ -27,6 +27,8 @@
 
 #pragma once
 
+#include <mutex>
+
 #include <pangolin/var/varvaluet.h>
 #include <pangolin/var/varwrapper.h>
 #include <pangolin/utils/is_streamable.h>
@@ -64,7 +66,9 @@ public:
 
     void Reset()
     {
+        std::lock_guard<std::mutex> l(value_mutex);
         value = default_value;
+        this->version.fetch_add(1, std::memory_order_release);
     }
 
     VarMeta& Meta()
@@ -84,7 +88,15 @@ public:
 
     void Set(const VarT& val)
     {
+        std::lock_guard<std::mutex> l(value_mutex);
         value = val;
+        this->version.fetch_add(1, std::memory_order_release);
+    }
+
+    VarT Snapshot() const
+    {
+        std::lock_guard<std::mutex> l(value_mutex);
+        return value;
     }
 
 protected:
@@ -130,6 +142,9 @@ protected:
     T value;
     VarT default_value;
     VarMeta meta;
+
+    // Serialises Set(), Reset() and Snapshot(), which may be called from different threads
+    mutable std::mutex value_mutex;
 };
 
 }
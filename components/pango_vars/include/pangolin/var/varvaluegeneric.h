@@ -27,6 +27,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <cmath>
@@ -103,9 +105,18 @@ public:
     virtual void Reset() = 0;
     virtual VarMeta& Meta() = 0;
 
+    // Incremented from 1 whenever the value is set or reset, from any
+    // thread. Cheap enough to poll for changes from real-time threads.
+    virtual uint64_t Version() const
+    {
+        return version.load(std::memory_order_acquire);
+    }
+
 //protected:
     // String serialisation object.
     std::shared_ptr<VarValueT<std::string>> str;
+
+    std::atomic<uint64_t> version{1};
 };
 
 }
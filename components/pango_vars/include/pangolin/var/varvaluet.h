@@ -41,6 +41,13 @@ public:
 
     virtual const VarT& Get() const = 0;
     virtual void Set(const VarT& val) = 0;
+
+    // Copy of the value which may be taken whilst other threads Set() it.
+    // Implementations which don't synchronise just return Get().
+    virtual VarT Snapshot() const
+    {
+        return Get();
+    }
 };
 
 }
@@ -65,6 +65,11 @@ public:
         return src->Meta();
     }
 
+    uint64_t Version() const
+    {
+        return src->Version();
+    }
+
     const T& Get() const
     {
         // This might throw, but we can't reset because this is a const method
@@ -79,6 +84,12 @@ public:
         src->Set( Convert<VarS, T>::Do(val) );
     }
 
+    T Snapshot() const
+    {
+        // Leaves cache alone, which belongs to the thread using Get()
+        return Convert<T,VarS>::Do(src->Snapshot());
+    }
+
 protected:
     mutable T cache;
     std::shared_ptr<VarValueT<S>> src;
@@ -8,6 +8,8 @@
 #include <pangolin/var/var.h>
 #include <pangolin/var/varextra.h>
 
+#include <thread>
+
 using namespace pangolin;
 
 struct CustomType{
@@ -411,3 +413,63 @@ SCENARIO("Var Events")
         }
     }
 }
+
+SCENARIO("Polling Vars across threads")
+{
+    VarState::I().Clear();
+
+    GIVEN("A Var and an alias of another type") {
+        Var<double> x("poll_double", 1.5);
+        Var<int> x_int("poll_double");
+        uint64_t version = 0;
+        double val = 0.0;
+
+        REQUIRE(x.Poll(val, version));
+        REQUIRE(val == 1.5);
+        REQUIRE_FALSE(x.Poll(val, version));
+
+        WHEN("the alias is set") {
+            x_int = 7;
+
+            THEN("the change is seen through the version and snapshot") {
+                REQUIRE(x_int.Version() == x.Version());
+                REQUIRE(x.Poll(val, version));
+                REQUIRE(val == 7.0);
+                REQUIRE(x_int.Snapshot() == 7);
+            }
+        }
+
+        WHEN("the Var is reset") {
+            const uint64_t before = x.Version();
+            x.Reset();
+            REQUIRE(x.Version() == before + 1);
+        }
+    }
+
+    GIVEN("A writer thread setting a Var") {
+        Var<std::string> s("poll_string", std::string("0"));
+        const int writes = 10000;
+
+        std::thread writer([&](){
+            for(int i=1; i <= writes; ++i) {
+                s = std::to_string(i);
+            }
+        });
+
+        THEN("polled snapshots are whole and never go backwards") {
+            uint64_t version = 0;
+            std::string val;
+            int last = -1;
+            bool ordered = true;
+            while(last < writes) {
+                if(s.Poll(val, version)) {
+                    const int i = std::stoi(val);
+                    ordered = ordered && i >= last;
+                    last = i;
+                }
+            }
+            writer.join();
+            REQUIRE(ordered);
+        }
+    }
+}
@@ -0,0 +1,331 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/video/video.h>
+#include <pangolin/utils/argagg.hpp>
+#include <pangolin/utils/format_string.h>
+#include <pangolin/utils/picojson.h>
+#include <pangolin/utils/uri.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+// Count every heap allocation made by the process, including those of
+// pangolin's own threads, so that per-frame allocations can be reported.
+namespace
+{
+std::atomic<size_t> num_allocations(0);
+std::atomic<size_t> num_allocated_bytes(0);
+
+void* CountedAlloc(size_t n) noexcept
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    num_allocated_bytes.fetch_add(n, std::memory_order_relaxed);
+    return std::malloc(n ? n : 1);
+}
+
+// Kept out of line so that compilers don't see the replacement operator
+// delete freeing the result of operator new, and warn that they mismatch.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#elif defined(_MSC_VER)
+__declspec(noinline)
+#endif
+void CountedFree(void* p) noexcept
+{
+    std::free(p);
+}
+}
+
+void* operator new(size_t n)
+{
+    if(void* p = CountedAlloc(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n)
+{
+    if(void* p = CountedAlloc(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+double ElapsedMicroseconds(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+struct BenchmarkCase
+{
+    std::string name;
+    std::string input_uri;
+    // Optional, to measure recording input frames rather than grabbing them
+    std::string output_uri;
+};
+
+struct BenchmarkResult
+{
+    BenchmarkCase bench;
+    size_t frames = 0;
+    size_t frame_bytes = 0;
+    double seconds = 0.0;
+    std::vector<double> latency_us;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+
+    double MegabytesPerSecond() const
+    {
+        return seconds > 0.0 ? (frames * frame_bytes) / seconds / 1e6 : 0.0;
+    }
+
+    // Nearest rank percentile of per-frame latency, p in [0,1]
+    double LatencyPercentile(double p) const
+    {
+        if(latency_us.empty()) return 0.0;
+        std::vector<double> sorted = latency_us;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size()-1, size_t(p * sorted.size()))];
+    }
+
+    double PerFrame(size_t total) const
+    {
+        return frames ? double(total) / frames : 0.0;
+    }
+};
+
+const char* source_uri = "test:[size=%,fmt=%,static=true]//";
+
+std::vector<BenchmarkCase> DefaultCases(const std::string& size)
+{
+    const std::string rgb8 = pangolin::FormatString(source_uri, size, "RGB24");
+    const std::string gray8 = pangolin::FormatString(source_uri, size, "GRAY8");
+    const std::string gray12 = pangolin::FormatString(source_uri, size, "GRAY12");
+    const std::string gray16 = pangolin::FormatString(source_uri, size, "GRAY16LE");
+
+    return {
+        {"source",             rgb8, ""},
+        {"transform_flipx",    "flipx://" + rgb8, ""},
+        {"transform_rotatecw", "rotatecw://" + gray8, ""},
+        {"debayer_downsample", "debayer:[tile=rggb,method=downsample]//" + gray8, ""},
+        {"debayer_bilinear",   "debayer:[tile=rggb,method=bilinear]//" + gray8, ""},
+        {"debayer_edgesense",  "debayer:[tile=rggb,method=edgesense]//" + gray16, ""},
+        {"unpack",             "unpack:[fmt=GRAY16LE]//" + gray12, ""},
+        {"shift",              "shift:[shift1=4]//" + gray16, ""},
+        {"join",               "join://{" + gray8 + "}{" + gray8 + "}", ""},
+        {"chain",              "shift:[shift1=4]//flipx://unpack:[fmt=GRAY16LE]//" + gray12, ""},
+        {"chain_fused",        "fuse://shift:[shift1=4]//flipx://unpack:[fmt=GRAY16LE]//" + gray12, ""},
+        {"record_pango",       rgb8, "pango://bench_video.pango"},
+    };
+}
+
+// Latency for each frame is the time taken by GrabNext, or by WriteStreams
+// when recording. Throughput includes closing the output, which waits for
+// buffered writes to complete.
+BenchmarkResult Run(const BenchmarkCase& bench, size_t warmup_frames, size_t frames)
+{
+    BenchmarkResult result;
+    result.bench = bench;
+    result.latency_us.reserve(frames);
+
+    std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo(bench.input_uri);
+    std::vector<unsigned char> buffer(video->SizeBytes());
+    result.frame_bytes = buffer.size();
+    video->Start();
+
+    std::unique_ptr<pangolin::VideoOutputInterface> output;
+    if(!bench.output_uri.empty()) {
+        output = pangolin::OpenVideoOutput(bench.output_uri);
+        output->SetStreams(video->Streams(), bench.input_uri);
+        if(!video->GrabNext(buffer.data())) {
+            throw std::runtime_error("No frames to record from " + bench.input_uri);
+        }
+    }
+
+    const auto frame = [&]() {
+        return output ? output->WriteStreams(buffer.data()) >= 0 : video->GrabNext(buffer.data());
+    };
+
+    for(size_t i=0; i < warmup_frames; ++i) {
+        frame();
+    }
+
+    const size_t allocations_start = num_allocations;
+    const size_t allocated_bytes_start = num_allocated_bytes;
+    const Clock::time_point start = Clock::now();
+
+    for(size_t i=0; i < frames; ++i) {
+        const Clock::time_point frame_start = Clock::now();
+        if(!frame()) break;
+        result.latency_us.push_back(ElapsedMicroseconds(frame_start));
+    }
+    output.reset();
+
+    result.seconds = ElapsedMicroseconds(start) / 1e6;
+    result.allocations = num_allocations - allocations_start;
+    result.allocated_bytes = num_allocated_bytes - allocated_bytes_start;
+    result.frames = result.latency_us.size();
+
+    video->Stop();
+    return result;
+}
+
+picojson::value ToJson(const BenchmarkResult& r)
+{
+    picojson::value json;
+    json["name"] = r.bench.name;
+    json["input_uri"] = r.bench.input_uri;
+    json["output_uri"] = r.bench.output_uri;
+    json["frames"] = double(r.frames);
+    json["frame_bytes"] = double(r.frame_bytes);
+    json["seconds"] = r.seconds;
+    json["mb_per_s"] = r.MegabytesPerSecond();
+    json["latency_us"]["p50"] = r.LatencyPercentile(0.5);
+    json["latency_us"]["p90"] = r.LatencyPercentile(0.9);
+    json["latency_us"]["p99"] = r.LatencyPercentile(0.99);
+    json["latency_us"]["max"] = r.LatencyPercentile(1.0);
+    json["allocations_per_frame"] = r.PerFrame(r.allocations);
+    json["allocated_bytes_per_frame"] = r.PerFrame(r.allocated_bytes);
+    return json;
+}
+
+void PrintRow(const BenchmarkResult& r)
+{
+    std::printf("%-22s %10zu %10.1f %9.0f %9.0f %9.0f %9.0f %9.1f\n",
+        r.bench.name.c_str(), r.frame_bytes, r.MegabytesPerSecond(),
+        r.LatencyPercentile(0.5), r.LatencyPercentile(0.9), r.LatencyPercentile(0.99), r.LatencyPercentile(1.0),
+        r.PerFrame(r.allocations));
+}
+
+std::vector<std::string> Split(const std::string& s, char delim)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    for(size_t end = s.find(delim); end != std::string::npos; end = s.find(delim, start)) {
+        parts.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    parts.push_back(s.substr(start));
+    return parts;
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+    argagg::parser argparser = {{
+        { "help", {"-h", "--help"}, "shows this help", 0},
+        { "frames", {"-n", "--frames"}, "number of frames to measure for each case (default 100)", 1},
+        { "warmup", {"-w", "--warmup"}, "number of frames to run before measuring (default 5)", 1},
+        { "sizes", {"-s", "--sizes"}, "comma separated image sizes for the default cases (default 640x480,1920x1080,4096x3072)", 1},
+        { "filter", {"-f", "--filter"}, "only run cases whose name contains this string", 1},
+        { "record", {"-r", "--record"}, "record the given video URIs to this output URI, rather than grabbing them", 1},
+        { "json", {"-j", "--json"}, "print results as JSON", 0}
+    }};
+
+    argagg::parser_results args = argparser.parse(argc, argv);
+    if(args["help"]) {
+        std::cerr << "Usage:\n";
+        std::cerr << "  bench_video [options] [VideoInputUri...]\n\n";
+        std::cerr << "Measures throughput, per-frame latency and allocations of video filter chains\n";
+        std::cerr << "and recording. Without URIs, a default set of chains is measured on top of the\n";
+        std::cerr << "test:// driver at several sizes.\n\n";
+        std::cerr << argparser;
+        return 0;
+    }
+
+    const size_t frames = args["frames"].as<size_t>(100);
+    const size_t warmup = args["warmup"].as<size_t>(5);
+    const std::string filter = args["filter"].as<std::string>("");
+    const std::string record = args["record"].as<std::string>("");
+    const bool json = args["json"];
+
+    // Cases grouped by image size
+    std::vector<std::pair<std::string, std::vector<BenchmarkCase>>> groups;
+    if(args.pos.empty()) {
+        for(const std::string& size : Split(args["sizes"].as<std::string>("640x480,1920x1080,4096x3072"), ',')) {
+            groups.push_back({size, DefaultCases(size)});
+        }
+    }else{
+        groups.push_back({"", {}});
+        for(size_t i=0; i < args.pos.size(); ++i) {
+            groups.back().second.push_back({pangolin::FormatString("uri%", i), args.pos[i], record});
+        }
+    }
+
+    picojson::value results_json;
+    results_json["pangolin_version"] = PANGOLIN_VERSION_STRING;
+    results_json["hardware_threads"] = double(std::thread::hardware_concurrency());
+    results_json["frames"] = double(frames);
+    results_json["results"] = picojson::value(picojson::array_type, true);
+
+    for(const auto& group : groups) {
+        if(!json) {
+            if(!group.first.empty()) std::printf("\n%s\n", group.first.c_str());
+            std::printf("%-22s %10s %10s %9s %9s %9s %9s %9s\n", "case", "bytes", "MB/s", "p50 us", "p90 us", "p99 us", "max us", "allocs");
+        }
+        for(const BenchmarkCase& bench : group.second) {
+            if(!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+
+            try {
+                const BenchmarkResult result = Run(bench, warmup, frames);
+                if(json) {
+                    picojson::value r = ToJson(result);
+                    r["size"] = group.first;
+                    results_json["results"].push_back(r);
+                }else{
+                    PrintRow(result);
+                }
+            } catch(const std::exception& e) {
+                std::cerr << bench.name << ": " << e.what() << std::endl;
+            }
+
+            // Don't leave the default case's recording behind
+            if(args.pos.empty() && !bench.output_uri.empty()) {
+                std::remove(pangolin::ParseUri(bench.output_uri).url.c_str());
+            }
+        }
+    }
+
+    if(json) {
+        std::cout << results_json.serialize(true) << std::endl;
+    }
+
+    return 0;
+}
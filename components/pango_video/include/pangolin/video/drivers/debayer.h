@@ -32,13 +32,19 @@
 namespace pangolin
 {
 
+class ThreadPool;
+
 struct WbGains {
+    // Largest gain, which keeps fixed point scaling of 16 bit samples within
+    // 32 bits. Scaled samples saturate at the largest value of their type.
+    static constexpr float max_gain = 16.0f;
+
     WbGains():r(1.0f), g(1.0f), b(1.0f){}
     WbGains(float r_in, float g_in, float b_in):r(r_in), g(g_in), b(b_in){
-        PANGO_ASSERT(r_in >= 0.0f && r_in <= 1.0f &&
-                     g_in >= 0.0f && g_in <= 1.0f &&
-                     b_in >= 0.0f && b_in <= 1.0f ,
-                     "[Debayer] White balance gains must be between 0.0 and 1.0");
+        PANGO_ASSERT(r_in >= 0.0f && r_in <= max_gain &&
+                     g_in >= 0.0f && g_in <= max_gain &&
+                     b_in >= 0.0f && b_in <= max_gain ,
+                     "[Debayer] White balance gains must be between 0.0 and 16.0");
     }
     float r;
     float g;
@@ -71,13 +77,16 @@ typedef enum {
 } color_filter_t;
 
 // Video class that debayers its video input using the given method.
+// Bilinear and edge-aware (edgesense) methods are implemented natively and
+// split into bands of rows across num_threads threads (0 for one per
+// hardware thread). Other full resolution methods require libdc1394.
 class PANGOLIN_EXPORT DebayerVideo :
         public VideoInterface,
         public VideoFilterInterface,
         public BufferAwareVideoInterface
 {
 public:
-    DebayerVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<bayer_method_t> &method, color_filter_t tile, const WbGains& input_wb_gains);
+    DebayerVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<bayer_method_t> &method, color_filter_t tile, const WbGains& input_wb_gains, size_t num_threads = 0);
     ~DebayerVideo();
 
     //! Implement VideoInput::Start()
@@ -125,6 +134,9 @@ protected:
 
     picojson::value device_properties;
     picojson::value frame_properties;
+
+    // Helpers for the calling thread, or null to debayer on it alone.
+    std::unique_ptr<ThreadPool> pool;
 };
 
 }
@@ -0,0 +1,127 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
+
+namespace pangolin
+{
+
+class ThreadPool;
+
+// Video class which runs the chain of row filters beneath it (such as shift,
+// unpack, gamma and flips) as a single pass over bands of rows, instead of
+// each filter copying whole frames through its own buffer. Bands are small
+// enough to remain in cache between filters and are shared between threads.
+class PANGOLIN_EXPORT FusedVideo :
+    public VideoInterface,
+    public VideoFilterInterface,
+    public VideoLeaseInterface,
+    public VideoPropertiesInterface
+{
+public:
+    // band_bytes bounds the size of each filter's output for one band.
+    // num_threads of 0 uses one thread per hardware thread.
+    FusedVideo(std::unique_ptr<VideoInterface>& videoin, size_t band_bytes = 64*1024, size_t num_threads = 0);
+    ~FusedVideo();
+
+    //! Implement VideoInput::Start()
+    void Start() override;
+
+    //! Implement VideoInput::Stop()
+    void Stop() override;
+
+    //! Implement VideoInput::SizeBytes()
+    size_t SizeBytes() const override;
+
+    //! Implement VideoInput::Streams()
+    const std::vector<StreamInfo>& Streams() const override;
+
+    //! Implement VideoInput::GrabNext()
+    bool GrabNext( unsigned char* image, bool wait = true ) override;
+
+    //! Implement VideoInput::GrabNewest()
+    bool GrabNewest( unsigned char* image, bool wait = true ) override;
+
+    //! Implement VideoLeaseInterface::LeaseNext()
+    VideoFrameLease LeaseNext( bool wait = true ) override;
+
+    //! Implement VideoLeaseInterface::LeaseNewest()
+    VideoFrameLease LeaseNewest( bool wait = true ) override;
+
+    //! Implement VideoFilterInterface method
+    std::vector<VideoInterface*>& InputStreams() override;
+
+    //! Implement VideoPropertiesInterface::DeviceProperties()
+    const picojson::value& DeviceProperties() const override;
+
+    //! Implement VideoPropertiesInterface::FrameProperties()
+    //! Properties of the source frame the last output was processed from.
+    const picojson::value& FrameProperties() const override;
+
+    //! Number of filters run together per band
+    size_t NumFusedFilters() const
+    {
+        return stages.size();
+    }
+
+protected:
+    struct Stage
+    {
+        VideoRowFilterInterface* filter;
+        VideoInterface* video;
+    };
+
+    struct Band
+    {
+        size_t stream;
+        size_t y0;
+        size_t y1;
+    };
+
+    void Process(unsigned char* image, const unsigned char* frame);
+
+    void ProcessBand(const Band& band, unsigned char* image, const unsigned char* frame);
+
+    std::unique_ptr<VideoInterface> src;
+    std::vector<VideoInterface*> videoin;
+
+    // Video feeding the first stage
+    VideoInterface* source;
+    // Filters in the order they are applied
+    std::vector<Stage> stages;
+    std::vector<Band> bands;
+
+    std::unique_ptr<ThreadPool> pool;
+    VideoFramePool source_pool;
+    VideoFramePool output_pool;
+
+    picojson::value device_properties;
+    picojson::value frame_properties;
+};
+
+}
@@ -27,8 +27,9 @@
 
 #pragma once
 
-#include <pangolin/pangolin.h>
-#include <pangolin/video/video.h>
+#include <pangolin/video/video_interface.h>
+
+#include <map>
 #include <set>
 
 namespace pangolin
@@ -38,7 +39,8 @@ namespace pangolin
 class PANGOLIN_EXPORT GammaVideo :
     public VideoInterface,
     public VideoFilterInterface,
-    public BufferAwareVideoInterface
+    public BufferAwareVideoInterface,
+    public VideoRowFilterInterface
 {
 public:
     GammaVideo(std::unique_ptr<VideoInterface>& videoin, const std::map<size_t, float> &stream_gammas);
@@ -69,6 +71,9 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement VideoRowFilterInterface::ProcessRows()
+    void ProcessRows(size_t s, Image<uint8_t>& out, const Image<uint8_t>& in);
+
 protected:
     void Process(uint8_t* image, const uint8_t* buffer);
 
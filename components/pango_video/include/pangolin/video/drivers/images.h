@@ -28,24 +28,33 @@
 #pragma once
 
 #include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
 #include <pangolin/image/image_io.h>
 
+#include <atomic>
 #include <deque>
+#include <future>
 #include <vector>
 
 namespace pangolin
 {
 
-// Video class that outputs test video signal.
-class PANGOLIN_EXPORT ImagesVideo : public VideoInterface, public VideoPlaybackInterface, public VideoPropertiesInterface
+class ThreadPool;
+
+// Video class that plays back a sequence of image files. With prefetch_frames
+// > 0, the following frames are decoded ahead of time on num_threads threads
+// (0 for one per hardware thread), holding at most prefetch_frames frames.
+class PANGOLIN_EXPORT ImagesVideo : public VideoInterface, public VideoPlaybackInterface, public VideoPropertiesInterface,
+        public VideoLeaseInterface
 {
 public:
-    ImagesVideo(const std::string& wildcard_path);
+    ImagesVideo(const std::string& wildcard_path, size_t prefetch_frames = 0, size_t num_threads = 0);
 
     ImagesVideo(
         const std::string& wildcard_path, const PixelFormat& raw_fmt,
         size_t raw_width, size_t raw_height, size_t raw_pitch,
-        size_t raw_offset, size_t raw_planes
+        size_t raw_offset, size_t raw_planes,
+        size_t prefetch_frames = 0, size_t num_threads = 0
     );
 
     // Explicitly delete copy ctor and assignment operator.
@@ -71,6 +80,13 @@ public:
     
     bool GrabNewest( unsigned char* image, bool wait = true ) override;
 
+    ///////////////////////////////////
+    // Implement VideoLeaseInterface
+
+    VideoFrameLease LeaseNext( bool wait = true ) override;
+
+    VideoFrameLease LeaseNewest( bool wait = true ) override;
+
     ///////////////////////////////////
     // Implement VideoPlaybackInterface
 
@@ -98,8 +114,23 @@ protected:
 
     void PopulateFilenamesFromJson(const std::string& filename);
 
+    TypedImage LoadChannel(size_t i, size_t c) const;
+
     bool LoadFrame(size_t i);
 
+    void InitPrefetch(size_t prefetch_frames, size_t num_threads);
+
+    // Queue decoding of frames from first onwards, up to the prefetch window.
+    // Work queued for other frames is abandoned.
+    void Prefetch(size_t first);
+
+    void CancelPrefetch();
+
+    // Returns the next frame, loading it if needed, or null if there isn't one
+    Frame* PrepareNextFrame();
+
+    void CopyFrame(unsigned char* image, const Frame& frame) const;
+
     void ConfigureStreamSizes();
     
     std::vector<StreamInfo> streams;
@@ -110,6 +141,20 @@ protected:
     size_t next_frame_id;
     std::vector<std::vector<std::string> > filenames;
     std::vector<Frame> loaded;
+    VideoFramePool frame_pool;
+
+    struct PrefetchFrame
+    {
+        size_t frame_id;
+        // Empty if the frame had already been loaded
+        std::vector<std::future<TypedImage>> channels;
+    };
+
+    size_t prefetch_frames;
+    std::unique_ptr<ThreadPool> prefetch_pool;
+    std::deque<PrefetchFrame> prefetched;
+    // Incremented to skip queued decodes which are no longer wanted
+    std::shared_ptr<std::atomic<size_t>> prefetch_generation;
 
     bool unknowns_are_raw;
     PixelFormat raw_fmt;
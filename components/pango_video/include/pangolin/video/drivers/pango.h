@@ -32,6 +32,12 @@
 #include <pangolin/log/packetstream_reader.h>
 #include <pangolin/log/playback_session.h>
 #include <pangolin/utils/signal_slot.h>
+#include <pangolin/utils/thread_pool.h>
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <mutex>
 
 namespace pangolin
 {
@@ -40,7 +46,11 @@ class PANGOLIN_EXPORT PangoVideo
     : public VideoInterface, public VideoPropertiesInterface, public VideoPlaybackInterface
 {
 public:
-    PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session);
+    // With prefetch > 0, up to that many frames are read ahead and decoded
+    // in parallel on decode_threads threads (0 for one per prefetched frame,
+    // up to the number of cores). Only used for compressed streams.
+    // codec_threads > 1 decompresses each lz4 image on several threads.
+    PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session, size_t prefetch = 0, size_t decode_threads = 0, size_t codec_threads = 1);
     ~PangoVideo();
 
     // Implement VideoInterface
@@ -81,8 +91,18 @@ private:
     void HandlePipeClosed();
 
 protected:
+    struct PrefetchedFrame
+    {
+        std::vector<unsigned char> image;
+        picojson::value properties;
+    };
+
     int FindPacketStreamSource();
     void SetupStreams(const PacketStreamSource& src);
+    void DecodeFrame(std::istream& in, unsigned char* image);
+    bool GrabPrefetched(unsigned char* image);
+    void QueuePrefetch();
+    int64_t FrameTime(size_t frame_id) const;
 
     const std::string _filename;
     std::shared_ptr<PlaybackSession> _playback_session;
@@ -90,6 +110,7 @@ protected:
     SyncTimeEventPromise _event_promise;
     int _src_id;
     const PacketStreamSource* _source;
+    size_t _codec_threads;
 
     size_t _size_bytes;
     bool _fixed_size;
@@ -100,6 +121,16 @@ protected:
     std::string _source_uri;
 
     sigslot::scoped_connection session_seek;
+
+    // Read-ahead state, guarded by _prefetch_lock. _next_frame is only
+    // written under the lock, but can be read without it.
+    size_t _prefetch;
+    std::atomic<size_t> _next_frame;
+    size_t _next_prefetch;
+    std::deque<std::future<std::shared_ptr<PrefetchedFrame>>> _prefetched;
+    std::vector<std::vector<unsigned char>> _free_images;
+    std::mutex _prefetch_lock;
+    std::unique_ptr<ThreadPool> _decode_pool;
 };
 
 }
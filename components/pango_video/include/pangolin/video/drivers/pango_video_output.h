@@ -30,16 +30,54 @@
 #include <pangolin/video/video_output_interface.h>
 #include <pangolin/log/packetstream_writer.h>
 #include <pangolin/video/stream_encoder_factory.h>
+#include <pangolin/utils/memstreambuf.h>
+#include <pangolin/utils/thread_pool.h>
 
+#include <deque>
 #include <functional>
+#include <future>
+#include <mutex>
 
 namespace pangolin
 {
 
+// Recording and encoding knobs of PangoVideoOutput. The defaults record
+// synchronously, one frame and one codec thread at a time, without
+// checkpoints, as the three argument constructor does.
+struct PangoVideoOutputOptions
+{
+    // Index checkpoint every N frames and / or every interval (0 to disable)
+    size_t checkpoint_frames = 0;
+    int64_t checkpoint_interval_us = 0;
+
+    // Writes the file writer may have queued at once, and bytes to reserve
+    // up front (see threadedfilebuf)
+    size_t write_queue_depth = 1;
+    size_t preallocate_bytes = 0;
+
+    // Print file writer statistics on close
+    bool print_write_stats = false;
+
+    // Encoder pool size (0 for one per stream and frame in flight, up to the
+    // number of cores), and frames which may be encoding at once
+    size_t encoder_threads = 0;
+    size_t max_frames_in_flight = 1;
+
+    // Threads compressing each zstd or lz4 image
+    size_t codec_threads = 1;
+
+    // Padding allowed per frame so large encoded streams can be written
+    // without a copy. The default lines up any stream with the 4KB blocks
+    // of direct i/o. Streams which aren't encoded are always copied, since
+    // the caller may reuse its frame once WriteStreams returns.
+    size_t alignment_padding_bytes = 4095;
+};
+
 class PANGOLIN_EXPORT PangoVideoOutput : public VideoOutputInterface
 {
 public:
     PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris);
+    PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris, const PangoVideoOutputOptions& options);
     ~PangoVideoOutput();
 
     const std::vector<StreamInfo>& Streams() const override;
@@ -50,6 +88,32 @@ public:
 protected:
 //    void WriteHeader();
 
+    // Reusable buffers for one frame
+    struct EncodeBuffers
+    {
+        std::vector<unsigned char> frame;
+        std::vector<memstreambuf> streams;
+    };
+
+    struct EncodeBufferList
+    {
+        std::mutex lock;
+        std::vector<std::unique_ptr<EncodeBuffers>> buffers;
+    };
+
+    struct PendingFrame
+    {
+        std::shared_ptr<EncodeBuffers> buffers;
+        std::vector<std::future<void>> encoded;
+        int64_t time_us;
+        picojson::value properties;
+    };
+
+    std::shared_ptr<EncodeBuffers> AcquireEncodeBuffers();
+    void EncodeStream(size_t i, const unsigned char* frame, memstreambuf& encoded) const;
+    void WriteEncodedFrame();
+    void FlushFrames();
+
     std::vector<StreamInfo> streams;
     std::string input_uri;
     const std::string filename;
@@ -57,6 +121,7 @@ protected:
 
     PacketStreamWriter packetstream;
     size_t packetstream_buffer_size_bytes;
+    PangoVideoOutputOptions options;
     int packetstreamsrcid;
     size_t total_frame_size;
     bool is_pipe;
@@ -64,6 +129,10 @@ protected:
     bool fixed_size;
     std::map<size_t, std::string> stream_encoder_uris;
     std::vector<ImageEncoderFunc> stream_encoders;
+
+    std::unique_ptr<ThreadPool> encode_pool;
+    std::shared_ptr<EncodeBufferList> free_encode_buffers;
+    std::deque<PendingFrame> frames_in_flight;
 };
 
 }
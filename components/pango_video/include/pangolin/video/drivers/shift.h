@@ -28,13 +28,15 @@
 #pragma once
 
 #include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
 #include <set>
 
 namespace pangolin
 {
 
 // Video class that debayers its video input using the given method.
-class PANGOLIN_EXPORT ShiftVideo : public VideoInterface, public VideoFilterInterface
+class PANGOLIN_EXPORT ShiftVideo : public VideoInterface, public VideoFilterInterface, public VideoLeaseInterface,
+        public VideoRowFilterInterface
 {
 public:
     ShiftVideo(std::unique_ptr<VideoInterface>& videoin,
@@ -60,11 +62,23 @@ public:
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( uint8_t* image, bool wait = true );
 
+    //! Implement VideoLeaseInterface::LeaseNext()
+    VideoFrameLease LeaseNext( bool wait = true );
+
+    //! Implement VideoLeaseInterface::LeaseNewest()
+    VideoFrameLease LeaseNewest( bool wait = true );
+
     std::vector<VideoInterface*>& InputStreams();
 
+    //! Implement VideoRowFilterInterface::ProcessRows()
+    void ProcessRows(size_t s, Image<uint8_t>& out, const Image<uint8_t>& in);
+
 protected:
     void Process(uint8_t* buffer_out, const uint8_t* buffer_in);
 
+    // Shifts the input lease in place if possible, otherwise into a new lease
+    VideoFrameLease ProcessLease(VideoFrameLease&& in);
+
     std::unique_ptr<VideoInterface> src;
     std::vector<VideoInterface*> videoin;
     std::vector<StreamInfo> streams;
@@ -72,6 +86,11 @@ protected:
     std::unique_ptr<uint8_t[]> buffer;
     const std::map<size_t, int> shift_right_bits;
     const std::map<size_t, uint32_t> masks;
+    // True iff every output pixel is no further into the buffer than its
+    // input pixel, so that processing in place never overwrites unread input
+    bool in_place;
+    VideoFramePool input_pool;
+    VideoFramePool output_pool;
     std::set<std::string> formats_supported;
 };
 
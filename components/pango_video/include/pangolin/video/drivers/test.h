@@ -33,10 +33,12 @@ namespace pangolin
 {
 
 // Video class that outputs test video signal.
+// With static_noise, noise is generated once and every frame is a copy of it,
+// so that the source costs little when measuring downstream filters.
 class PANGOLIN_EXPORT TestVideo : public VideoInterface
 {
 public:
-    TestVideo(size_t w, size_t h, size_t n, std::string pix_fmt);
+    TestVideo(size_t w, size_t h, size_t n, std::string pix_fmt, bool static_noise = false);
     ~TestVideo();
     
     //! Implement VideoInput::Start()
@@ -60,6 +62,7 @@ public:
 protected:
     std::vector<StreamInfo> streams;
     size_t size_bytes;
+    std::vector<unsigned char> static_frame;
 };
 
 }
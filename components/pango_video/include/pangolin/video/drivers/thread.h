@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
 #include <pangolin/utils/fix_size_buffer_queue.h>
 
 namespace pangolin
@@ -37,7 +38,7 @@ namespace pangolin
 
 // Video class that creates a thread that keeps pulling frames and processing from its children.
 class PANGOLIN_EXPORT ThreadVideo :  public VideoInterface, public VideoPropertiesInterface,
-        public BufferAwareVideoInterface, public VideoFilterInterface
+        public BufferAwareVideoInterface, public VideoFilterInterface, public VideoLeaseInterface
 {
 public:
     ThreadVideo(std::unique_ptr<VideoInterface>& videoin, size_t num_buffers, const std::string& name);
@@ -56,11 +57,20 @@ public:
     const std::vector<StreamInfo>& Streams() const;
 
     //! Implement VideoInput::GrabNext()
+    //! Once the grab thread has stopped, returns false rather than waiting
+    //! when no frames are left queued. The same holds for GrabNewest,
+    //! LeaseNext and LeaseNewest.
     bool GrabNext( unsigned char* image, bool wait = true );
 
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    //! Implement VideoLeaseInterface::LeaseNext(), lending queued buffers
+    VideoFrameLease LeaseNext( bool wait = true );
+
+    //! Implement VideoLeaseInterface::LeaseNewest(), lending queued buffers
+    VideoFrameLease LeaseNewest( bool wait = true );
+
     const picojson::value& DeviceProperties() const;
 
     const picojson::value& FrameProperties() const;
@@ -93,6 +103,12 @@ protected:
         picojson::value frame_properties;
     };
 
+    // Wait, if requested, for the grab thread to queue a frame
+    bool WaitForFrame(bool wait, const char* caller);
+
+    // Lend the buffer of a successful grab until the lease is released
+    VideoFrameLease LeaseGrabResult(GrabResult&& grab);
+
     std::unique_ptr<VideoInterface> src;
     std::vector<VideoInterface*> videoin;
 
@@ -104,6 +120,8 @@ protected:
     std::thread grab_thread;
     std::string thread_name;
 
+    std::shared_ptr<VideoLeaseOwner> lease_owner;
+
     mutable picojson::value device_properties;
     picojson::value frame_properties;
 };
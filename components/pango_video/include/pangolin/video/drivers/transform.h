@@ -28,6 +28,7 @@
 #pragma once
 
 #include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
 
 namespace pangolin
 {
@@ -42,7 +43,9 @@ enum class TransformOptions
 class PANGOLIN_EXPORT TransformVideo :
     public VideoInterface,
     public VideoFilterInterface,
-    public BufferAwareVideoInterface
+    public BufferAwareVideoInterface,
+    public VideoLeaseInterface,
+    public VideoRowFilterInterface
 {
 public:
     TransformVideo(std::unique_ptr<VideoInterface>& videoin, const std::vector<TransformOptions>& flips);
@@ -66,6 +69,12 @@ public:
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    //! Implement VideoLeaseInterface::LeaseNext()
+    VideoFrameLease LeaseNext( bool wait = true );
+
+    //! Implement VideoLeaseInterface::LeaseNewest()
+    VideoFrameLease LeaseNewest( bool wait = true );
+
     //! Implement VideoFilterInterface method
     std::vector<VideoInterface*>& InputStreams();
 
@@ -73,15 +82,32 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement VideoRowFilterInterface methods
+    bool SupportsRowProcessing() const;
+
+    std::pair<size_t,size_t> InputRows(size_t s, size_t out_y0, size_t out_y1) const;
+
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in);
+
 protected:
     void Process(unsigned char* image, const unsigned char* buffer);
 
+    void ProcessInPlace(unsigned char* image);
+
+    // Flips the input lease in place if possible, otherwise transforms it
+    // into a new lease
+    VideoFrameLease ProcessLease(VideoFrameLease&& in);
+
     std::unique_ptr<VideoInterface> videoin;
     std::vector<VideoInterface*> inputs;
     std::vector<StreamInfo> streams;
     std::vector<TransformOptions> flips;
     size_t size_bytes;
     unsigned char* buffer;
+    // True iff no stream changes shape, so all can be flipped in place
+    bool in_place;
+    VideoFramePool input_pool;
+    VideoFramePool output_pool;
 
     picojson::value device_properties;
     picojson::value frame_properties;
@@ -36,7 +36,8 @@ namespace pangolin
 class PANGOLIN_EXPORT UnpackVideo :
     public VideoInterface,
     public VideoFilterInterface,
-    public BufferAwareVideoInterface
+    public BufferAwareVideoInterface,
+    public VideoRowFilterInterface
 {
 public:
     UnpackVideo(std::unique_ptr<VideoInterface>& videoin, PixelFormat new_fmt);
@@ -67,6 +68,9 @@ public:
 
     bool DropNFrames(uint32_t n);
 
+    //! Implement VideoRowFilterInterface::ProcessRows()
+    void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in);
+
 protected:
     void Process(unsigned char* image, const unsigned char* buffer);
 
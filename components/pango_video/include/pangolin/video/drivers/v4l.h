@@ -28,10 +28,14 @@
 #pragma once
 
 #include <pangolin/video/video_interface.h>
+#include <pangolin/video/video_frame_pool.h>
 
 #include <asm/types.h>
 #include <linux/videodev2.h>
 
+#include <functional>
+#include <mutex>
+
 namespace pangolin
 {
 
@@ -46,7 +50,8 @@ struct buffer {
     size_t length;
 };
 
-class PANGOLIN_EXPORT V4lVideo : public VideoInterface, public VideoUvcInterface, public VideoPropertiesInterface
+class PANGOLIN_EXPORT V4lVideo : public VideoInterface, public VideoUvcInterface, public VideoPropertiesInterface,
+        public VideoLeaseInterface
 {
 public:
     V4lVideo(const char* dev_name, uint32_t period, io_method io = IO_METHOD_MMAP, unsigned iwidth=0, unsigned iheight=0, unsigned v4l_format=V4L2_PIX_FMT_YUYV);
@@ -70,6 +75,16 @@ public:
     //! Implement VideoInput::GrabNewest()
     bool GrabNewest( unsigned char* image, bool wait = true );
 
+    //! Implement VideoLeaseInterface::LeaseNext()
+    //! For mmap and userptr io the driver's buffer is lent, and only queued
+    //! for capture again once the lease is released. Leases should be
+    //! released before Stop().
+    VideoFrameLease LeaseNext( bool wait = true );
+
+    //! Implement VideoLeaseInterface::LeaseNewest()
+    //! Dequeues every frame captured so far and lends the last of them.
+    VideoFrameLease LeaseNewest( bool wait = true );
+
     //! Implement VideoUvcInterface::IoCtrl()
     int IoCtrl(uint8_t unit, uint8_t ctrl, unsigned char* data, int len, UvcRequestCode req_code);
 
@@ -95,7 +110,10 @@ protected:
     void InitPangoDeviceProperties();
 
 
+    bool WaitForFrame(const std::function<int()>& read_frame);
+    int DequeueBuffer(v4l2_buffer& buf, bool wait);
     int ReadFrame(unsigned char* image, bool wait = true);
+    int LeaseFrame(VideoFrameLease& lease, bool wait = true);
     void Mainloop();
 
     void init_read(unsigned int buffer_size);
@@ -114,13 +132,22 @@ protected:
     int       fd;
     buffer*   buffers;
     unsigned  int n_buffers;
+    // Held by Start(), Stop() and by leases requeueing their buffer, which
+    // may be released from any thread.
+    std::mutex stream_lock;
     bool running;
+    // Incremented by each Start(), so that leases from an earlier stream
+    // don't requeue buffers which have been queued again since.
+    unsigned stream_generation;
     unsigned width;
     unsigned height;
     float fps;
     size_t image_size;
     uint32_t period;
 
+    VideoFramePool frame_pool;
+    std::shared_ptr<VideoLeaseOwner> lease_owner;
+
     picojson::value device_properties;
     picojson::value frame_properties;
 };
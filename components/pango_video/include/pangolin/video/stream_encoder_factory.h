@@ -2,7 +2,7 @@
 
 #include <memory>
 
-#include <pangolin/image/image_io.h>
+#include <pangolin/image/image_codec.h>
 
 namespace pangolin {
 
@@ -14,9 +14,12 @@ class StreamEncoderFactory
 public:
     static StreamEncoderFactory& I();
 
-    ImageEncoderFunc GetEncoder(const std::string& encoder_spec, const PixelFormat& fmt);
+    // The returned functions keep codec state between calls and may be called
+    // concurrently. num_threads > 1 allows each image to be compressed or
+    // decompressed on several threads, for codecs which support it.
+    ImageEncoderFunc GetEncoder(const std::string& encoder_spec, const PixelFormat& fmt, size_t num_threads = 1);
 
-    ImageDecoderFunc GetDecoder(const std::string& encoder_spec, const PixelFormat& fmt);
+    ImageDecoderFunc GetDecoder(const std::string& encoder_spec, const PixelFormat& fmt, size_t num_threads = 1);
 };
 
 }
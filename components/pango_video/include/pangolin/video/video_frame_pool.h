@@ -0,0 +1,110 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/video/video_interface.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace pangolin
+{
+
+//! Recycles frame sized buffers handed out as VideoFrameLease's. Used by
+//! filters and sources which have no buffer of their own to lend.
+class PANGOLIN_EXPORT VideoFramePool
+{
+public:
+    VideoFramePool(size_t frame_bytes = 0);
+
+    //! Change the size of subsequently leased buffers. Outstanding leases
+    //! remain valid but will not be recycled.
+    void Reset(size_t frame_bytes);
+
+    //! Reuse a released buffer, or allocate a new one if none are free
+    VideoFrameLease Lease();
+
+    size_t FrameBytes() const
+    {
+        return frame_bytes;
+    }
+
+protected:
+    struct FreeList
+    {
+        std::mutex lock;
+        std::vector<std::unique_ptr<unsigned char[]>> buffers;
+    };
+
+    size_t frame_bytes;
+    std::shared_ptr<FreeList> free_list;
+};
+
+//! Shared between a video source and the leases it lends so that leases
+//! released after the source is destroyed no longer return their buffer.
+class PANGOLIN_EXPORT VideoLeaseOwner
+{
+public:
+    VideoLeaseOwner() : alive(true) {}
+
+    //! Call f(), unless the source has been destroyed
+    template<typename F>
+    void IfAlive(F f)
+    {
+        std::lock_guard<std::mutex> l(lock);
+        if(alive) f();
+    }
+
+    //! Called by the source before it is destroyed
+    void Release()
+    {
+        std::lock_guard<std::mutex> l(lock);
+        alive = false;
+    }
+
+protected:
+    std::mutex lock;
+    bool alive;
+};
+
+//! Lease the next frame from video, or grab it into a buffer from pool if
+//! video doesn't implement VideoLeaseInterface.
+PANGOLIN_EXPORT
+VideoFrameLease LeaseNextFrame(VideoInterface& video, VideoFramePool& pool, bool wait = true);
+
+//! Lease the newest frame from video, or grab it into a buffer from pool if
+//! video doesn't implement VideoLeaseInterface.
+PANGOLIN_EXPORT
+VideoFrameLease LeaseNewestFrame(VideoInterface& video, VideoFramePool& pool, bool wait = true);
+
+//! True iff video and every video it filters implement VideoLeaseInterface,
+//! in which case leases are passed down the whole chain without copying
+//! into intermediate buffers.
+PANGOLIN_EXPORT
+bool SupportsLeasing(VideoInterface& video);
+
+}
@@ -28,14 +28,17 @@
 #pragma once
 
 #include <pangolin/video/video.h>
+#include <pangolin/video/video_frame_pool.h>
 #include <pangolin/video/video_output.h>
+#include <pangolin/video/video_output_queue.h>
 
 namespace pangolin
 {
 
 struct PANGOLIN_EXPORT VideoInput
     : public VideoInterface,
-      public VideoFilterInterface
+      public VideoFilterInterface,
+      public VideoLeaseInterface
 {
     /////////////////////////////////////////////////////////////
     // VideoInterface Methods
@@ -45,9 +48,21 @@ struct PANGOLIN_EXPORT VideoInput
     const std::vector<StreamInfo>& Streams() const override;
     void Start() override;
     void Stop() override;
+    // Always copy the frame into image, even where the video could lend it
+    // (see LeaseNext).
     bool GrabNext( unsigned char* image, bool wait = true ) override;
     bool GrabNewest( unsigned char* image, bool wait = true ) override;
 
+    /////////////////////////////////////////////////////////////
+    // VideoLeaseInterface Methods
+    /////////////////////////////////////////////////////////////
+
+    // Frames are lent without copying when every stage of the video
+    // supports it (see SupportsLeasing()), and are otherwise grabbed into
+    // recycled buffers.
+    VideoFrameLease LeaseNext( bool wait = true ) override;
+    VideoFrameLease LeaseNewest( bool wait = true ) override;
+
     /////////////////////////////////////////////////////////////
     // VideoFilterInterface Methods
     /////////////////////////////////////////////////////////////
@@ -69,6 +84,12 @@ struct PANGOLIN_EXPORT VideoInput
     void Open(const std::string &input_uri, const std::string &output_uri = "pango:[buffer_size_mb=100]//video_log.pango");
     void Close();
 
+    // Copy the next frame into a buffer recycled from this VideoInput's
+    // pool. Unlike LeaseNext, callers never hold on to the video's own
+    // buffers, of which drivers such as V4L may only have a few.
+    VideoFrameLease LeaseNextCopy( bool wait = true );
+    VideoFrameLease LeaseNewestCopy( bool wait = true );
+
     // experimental - not stable
     bool Grab( unsigned char* buffer, std::vector<Image<unsigned char> >& images, bool wait = true, bool newest = false);
 
@@ -112,14 +133,28 @@ struct PANGOLIN_EXPORT VideoInput
     // True iff grabbed live frames are being logged to file
     bool IsRecording() const;
 
+    // Recorded frames are copied into a queue of up to max_frames which is
+    // written to file from another thread, with policy deciding what happens
+    // when it is full. With max_frames = 0, the default, frames are written
+    // from the grabbing thread instead, without the extra copy.
+    // Takes effect from the next call to Record().
+    void SetRecordQueue(size_t max_frames, VideoOutputQueue::Policy policy = VideoOutputQueue::Policy::Block);
+
+    // Health of the record queue, all zero when not recording through one
+    VideoOutputQueue::Stats RecordStats() const;
+
 protected:
     void InitialiseRecorder();
 
+    // Record the frame if requested, returning it
+    VideoFrameLease RecordLease(VideoFrameLease&& frame, bool should_record);
+
     Uri uri_input;
     Uri uri_output;
 
     std::unique_ptr<VideoInterface> video_src;
     std::unique_ptr<VideoOutputInterface> video_recorder;
+    VideoFramePool frame_pool;
 
     // Use to store either video_src or video_file for VideoFilterInterface,
     // depending on which is active
@@ -132,6 +167,9 @@ protected:
 
     bool record_once;
     bool record_continuous;
+
+    size_t record_queue_frames;
+    VideoOutputQueue::Policy record_queue_policy;
 };
 
 // VideoInput subsumes the previous VideoRecordRepeat class.
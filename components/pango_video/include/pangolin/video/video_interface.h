@@ -31,6 +31,7 @@
 #include <pangolin/video/stream_info.h>
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #define PANGO_HAS_TIMING_DATA        "has_timing_data"
@@ -105,6 +106,28 @@ struct PANGOLIN_EXPORT BufferAwareVideoInterface
     virtual bool DropNFrames(uint32_t n) = 0;
 };
 
+//! Frame borrowed from a video source, laid out as described by the source's
+//! Streams(). The source reclaims the underlying buffer once the last copy of
+//! the lease is released, so long lived leases may starve the source.
+typedef std::shared_ptr<unsigned char> VideoFrameLease;
+
+//! Interface to video sources which can lend frames from their own buffers,
+//! avoiding the copy into a caller owned buffer made by GrabNext / GrabNewest
+struct PANGOLIN_EXPORT VideoLeaseInterface
+{
+    virtual ~VideoLeaseInterface() {}
+
+    //! Borrow the next frame from the source.
+    //! Optionally wait for a frame if one isn't ready
+    //! Returns null iff no frame was captured
+    virtual VideoFrameLease LeaseNext( bool wait = true ) = 0;
+
+    //! Borrow the newest frame from the source, discarding all older frames.
+    //! Optionally wait for a frame if one isn't ready
+    //! Returns null iff no frame was captured
+    virtual VideoFrameLease LeaseNewest( bool wait = true ) = 0;
+};
+
 struct PANGOLIN_EXPORT VideoPropertiesInterface
 {
     virtual ~VideoPropertiesInterface() {}
@@ -155,6 +178,28 @@ struct PANGOLIN_EXPORT VideoFilterInterface
     virtual std::vector<VideoInterface*>& InputStreams() = 0;
 };
 
+//! Interface to single input filters whose output rows each depend only on a
+//! range of rows of the same input stream. A chain of these filters can be
+//! run as one pass over bands of rows (see FusedVideo), rather than each
+//! filter reading and writing whole frames.
+struct PANGOLIN_EXPORT VideoRowFilterInterface
+{
+    virtual ~VideoRowFilterInterface() {}
+
+    //! False if any stream can't be processed by rows, e.g. when rotated
+    virtual bool SupportsRowProcessing() const { return true; }
+
+    //! Rows [y0,y1) of input stream s needed for output rows [out_y0, out_y1)
+    virtual std::pair<size_t,size_t> InputRows(size_t /*s*/, size_t out_y0, size_t out_y1) const
+    {
+        return {out_y0, out_y1};
+    }
+
+    //! Compute a band of output rows of stream s from the input rows given by
+    //! InputRows(). May be called concurrently for different bands.
+    virtual void ProcessRows(size_t s, Image<unsigned char>& out, const Image<unsigned char>& in) = 0;
+};
+
 struct PANGOLIN_EXPORT VideoUvcInterface
 {
     virtual ~VideoUvcInterface() {}
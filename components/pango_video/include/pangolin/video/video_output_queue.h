@@ -0,0 +1,128 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <pangolin/video/video_frame_pool.h>
+#include <pangolin/video/video_output_interface.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace pangolin
+{
+
+//! Decouples a recorder from the thread producing frames. WriteStreams
+//! copies each frame into a bounded queue which a dedicated thread writes
+//! to the wrapped output, so that encoding or I/O stalls don't hold up
+//! capture.
+class PANGOLIN_EXPORT VideoOutputQueue : public VideoOutputInterface
+{
+public:
+    //! What WriteStreams does when max_frames are already waiting
+    enum class Policy
+    {
+        Block,      //!< Wait for the writer to make space
+        DropOldest, //!< Discard the longest waiting frame
+        DropNewest  //!< Discard the frame being written, returning -1
+    };
+
+    struct Stats
+    {
+        size_t queued;  //!< Frames currently waiting to be written
+        size_t dropped; //!< Frames discarded by the policy
+        size_t written; //!< Frames written to the wrapped output
+    };
+
+    VideoOutputQueue(std::unique_ptr<VideoOutputInterface> output, size_t max_frames = 8, Policy policy = Policy::Block);
+
+    //! Writes any queued frames before returning
+    ~VideoOutputQueue();
+
+    const std::vector<StreamInfo>& Streams() const override;
+
+    //! Waits for queued frames to be written first
+    void SetStreams(const std::vector<StreamInfo>& streams, const std::string& uri ="", const picojson::value& properties = picojson::value() ) override;
+
+    //! Returns 0 once the frame is queued, or -1 if it was dropped. Errors
+    //! from writing earlier frames are rethrown here.
+    int WriteStreams(const unsigned char* data, const picojson::value& frame_properties = picojson::value() ) override;
+
+    bool IsPipe() const override;
+
+    //! Wait until every queued frame has been written
+    void Flush();
+
+    Stats GetStats() const;
+
+    Policy GetPolicy() const
+    {
+        return policy;
+    }
+
+    size_t MaxFrames() const
+    {
+        return max_frames;
+    }
+
+protected:
+    struct Frame
+    {
+        VideoFrameLease data;
+        picojson::value properties;
+    };
+
+    void WriterLoop();
+
+    // Rethrow, once, any error from the writer thread. Call with lock held.
+    void RethrowWriterError();
+
+    std::unique_ptr<VideoOutputInterface> output;
+    const size_t max_frames;
+    const Policy policy;
+
+    VideoFramePool frame_pool;
+
+    std::mutex lock;
+    std::condition_variable cond_queued;
+    std::condition_variable cond_done;
+    std::deque<Frame> queue;
+    bool writing;
+    bool should_run;
+    std::exception_ptr writer_error;
+
+    std::atomic<size_t> num_queued;
+    std::atomic<size_t> num_dropped;
+    std::atomic<size_t> num_written;
+
+    std::thread writer;
+};
+
+}
@@ -29,6 +29,11 @@
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
 #include <pangolin/video/video.h>
+#include <pangolin/utils/thread_pool.h>
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 
 #ifdef HAVE_DC1394
 #   include <dc1394/conversions.h>
@@ -61,7 +66,7 @@ pangolin::StreamInfo BayerOutputFormat( const StreamInfo& stream_in, bayer_metho
     return pangolin::StreamInfo( fmt, w, h, w*fmt.bpp / 8, reinterpret_cast<unsigned char*>(start_offset) );
 }
 
-DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vector<bayer_method_t>& bayer_method, color_filter_t tile, const WbGains& input_wb_gains)
+DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vector<bayer_method_t>& bayer_method, color_filter_t tile, const WbGains& input_wb_gains, size_t num_threads)
     : src(std::move(src_)), size_bytes(0), methods(bayer_method), tile(tile), wb_gains(input_wb_gains)
 {
     if(!src.get()) {
@@ -74,16 +79,28 @@ DebayerVideo::DebayerVideo(std::unique_ptr<VideoInterface> &src_, const std::vec
     }
 
     for(size_t s=0; s< src->Streams().size(); ++s) {
-        if( (methods[s] < BAYER_METHOD_NONE) && (!have_dc1394 || src->Streams()[0].IsPitched()) ) {
-            pango_print_warn("debayer: Switching to simple downsampling method because No DC1394 or image is pitched.\n");
-            methods[s] = BAYER_METHOD_DOWNSAMPLE;
+        const bool native = methods[s] == BAYER_METHOD_BILINEAR || methods[s] == BAYER_METHOD_EDGESENSE;
+        if( (methods[s] < BAYER_METHOD_NONE) && !native && (!have_dc1394 || src->Streams()[0].IsPitched()) ) {
+            const bool smooth = methods[s] == BAYER_METHOD_NEAREST || methods[s] == BAYER_METHOD_SIMPLE;
+            pango_print_warn("debayer: Switching to %s method because No DC1394 or image is pitched.\n", smooth ? "bilinear" : "edgesense");
+            methods[s] = smooth ? BAYER_METHOD_BILINEAR : BAYER_METHOD_EDGESENSE;
         }
 
         const StreamInfo& stin = src->Streams()[s];
+        if(methods[s] != BAYER_METHOD_NONE && (stin.Width() < 2 || stin.Height() < 2)) {
+            throw VideoException("DebayerVideo: Bayer images must be at least 2x2");
+        }
         streams.push_back(BayerOutputFormat(stin, methods[s], size_bytes));
         size_bytes += streams.back().SizeBytes();
     }
     buffer = std::unique_ptr<unsigned char[]>(new unsigned char[src->SizeBytes()]);
+
+    if(num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    if(num_threads > 1) {
+        pool = std::unique_ptr<ThreadPool>(new ThreadPool(num_threads - 1));
+    }
 }
 
 DebayerVideo::~DebayerVideo()
@@ -143,79 +160,308 @@ bool DebayerVideo::DropNFrames(uint32_t n)
     }
 }
 
-template<typename Tup, typename Tout, typename Tin>
-void DownsampleToMono(Image<Tout>& out, const Image<Tin>& in)
+namespace
+{
+
+// Bands of rows handed to each thread: large enough to amortise scheduling,
+// small enough to balance across threads.
+const size_t debayer_band_rows = 16;
+
+template<typename F>
+void ForEachRowBand(ThreadPool* pool, size_t rows, const F& f)
 {
-    for(int y=0; y< (int)out.h; ++y) {
-      Tout* pixout = out.RowPtr(y);
-      const Tin* irow0 = in.RowPtr(2*y);
-      const Tin* irow1 = in.RowPtr(2*y+1);
-      for(size_t x=0; x<out.w; ++x) {
-          Tup val = ((Tup)irow0[0] + (Tup)irow0[1] + (Tup)irow1[0] + (Tup)irow1[1]) / 4;
-          *(pixout++) = (Tout)std::min(std::max(static_cast<Tup>(0), val), static_cast<Tup>(std::numeric_limits<Tout>::max()));
-          irow0 += 2;
-          irow1 += 2;
-      }
+    if(pool) {
+        pool->ParallelFor(0, rows, f, debayer_band_rows);
+    }else{
+        f(0, rows);
     }
 }
 
-template<typename Tout, typename Tin>
-void DownsampleDebayer(Image<Tout>& out, const Image<Tin>& in, color_filter_t tile, WbGains wb_gains, const bool has_metadata_line)
+// Position of the red sample within each 2x2 cell of the colour filter.
+// Blue is diagonally opposite and green fills the remaining two.
+struct BayerLayout
+{
+    BayerLayout(color_filter_t tile)
+        : rx(tile == DC1394_COLOR_FILTER_GRBG || tile == DC1394_COLOR_FILTER_BGGR ? 1 : 0),
+          ry(tile == DC1394_COLOR_FILTER_GBRG || tile == DC1394_COLOR_FILTER_BGGR ? 1 : 0)
+    {
+    }
+
+    // Row y contains red and green samples (otherwise blue and green)
+    bool RedRow(size_t y) const
+    {
+        return (y & 1) == ry;
+    }
+
+    // Column parity of the red or blue samples in row y
+    size_t ColourParity(size_t y) const
+    {
+        return RedRow(y) ? rx : 1 - rx;
+    }
+
+    size_t rx;
+    size_t ry;
+};
+
+// White balance gains in fixed point so that kernels stay in integer lanes.
+// Acc holds the sum of four samples. Gains have shift fractional bits and are
+// clamped to WbGains::max_gain, so that a scaled sample always fits in 32
+// bits, and results saturate at max_value, the channel's full scale.
+template<typename T>
+struct BayerGains
 {
-    int y_offset = 0;
-    if (has_metadata_line) {
-        ++y_offset;
+    using Acc = typename std::conditional<sizeof(T) == 1, uint16_t, uint32_t>::type;
+    static constexpr int shift = sizeof(T) == 1 ? 8 : 12;
+
+    BayerGains(const WbGains& wb, T max_value)
+        : gain{ToFixed(wb.r), ToFixed(wb.g), ToFixed(wb.b)}, max_value(max_value)
+    {
     }
 
-    switch(tile) {
-      case DC1394_COLOR_FILTER_RGGB:
-        for(int y=0; y< (int)out.h; ++y) {
-          Tout* pixout = out.RowPtr(y);
-          const Tin* irow0 = in.RowPtr(2*y+y_offset);
-          const Tin* irow1 = in.RowPtr(2*y+1+y_offset);
-          for(size_t x=0; x<out.w; ++x) {
-              *(pixout++) = irow0[2*x] * wb_gains.r;
-              *(pixout++) = ((irow0[2*x+1] + irow1[2*x]) >> 1) * wb_gains.g;
-              *(pixout++) = irow1[2*x+1] * wb_gains.b;
-          }
+    static uint32_t ToFixed(float g)
+    {
+        const float clamped = std::min(std::max(g, 0.0f), WbGains::max_gain);
+        return static_cast<uint32_t>(std::lround(clamped * (1u << shift)));
+    }
+
+    T Apply(size_t c, Acc v) const
+    {
+        const uint32_t scaled = (uint32_t(static_cast<T>(v)) * gain[c]) >> shift;
+        return static_cast<T>(std::min<uint32_t>(scaled, max_value));
+    }
+
+    uint32_t gain[3];
+    uint32_t max_value;
+};
+
+// Signed type for colour differences against the interpolated green
+template<typename T>
+using BayerDiff = typename std::conditional<sizeof(T) == 1, int16_t, int32_t>::type;
+
+inline size_t MirrorIndex(size_t i, int offset, size_t n)
+{
+    return (offset < 0 && i == 0) ? 1 : (offset > 0 && i+1 == n) ? n-2 : i + offset;
+}
+
+// Set out[x] to colour(x, left, right) at the red or blue samples of a bayer
+// row and green(x, left, right) at its green samples, where left and right
+// are neighbour columns mirrored at the image border so that they keep the
+// same colour. The interior is filled in colour / green pairs without
+// branching. Each output row gets its own pass, which keeps the number of
+// pointers small enough for compilers to vectorise the loop.
+template<typename T, typename C, typename G>
+void FillBayerRow(T* out, size_t w, size_t colour_parity, C&& colour, G&& green)
+{
+    const auto fill = [&](size_t x) {
+        const size_t l = MirrorIndex(x, -1, w);
+        const size_t r = MirrorIndex(x, +1, w);
+        out[x] = (x & 1) == colour_parity ? colour(x, l, r) : green(x, l, r);
+    };
+
+    size_t x = 0;
+    for(; x < w && (x == 0 || (x & 1) != colour_parity); ++x) {
+        fill(x);
+    }
+    for(; x + 2 < w; x += 2) {
+        out[x]   = colour(x, x-1, x+1);
+        out[x+1] = green(x+1, x, x+2);
+    }
+    for(; x < w; ++x) {
+        fill(x);
+    }
+}
+
+// Per thread rows for intermediate results, reused between frames
+template<typename T>
+T* ScratchRows(size_t rows, size_t w)
+{
+    thread_local std::vector<T> scratch;
+    if(scratch.size() < rows * w) {
+        scratch.resize(rows * w);
+    }
+    return scratch.data();
+}
+
+// Kernels write each colour to its own row so that loops stay unit stride.
+// Packing them into RGB needs byte shuffles beyond the x86-64 baseline, so
+// GCC builds this for several ISAs and picks one at load time. ARM has NEON
+// structure stores for it as standard.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(_LINUX_)
+#  define PANGO_DEBAYER_TARGET_CLONES __attribute__((target_clones("avx2","ssse3","default")))
+#else
+#  define PANGO_DEBAYER_TARGET_CLONES
+#endif
+
+template<typename T>
+inline void InterleaveRGB(T* out, const T* planes, size_t w)
+{
+    const T* r = planes;
+    const T* g = planes + w;
+    const T* b = planes + 2*w;
+    for(size_t x=0; x < w; ++x) {
+        out[3*x+0] = r[x];
+        out[3*x+1] = g[x];
+        out[3*x+2] = b[x];
+    }
+}
+
+PANGO_DEBAYER_TARGET_CLONES
+void InterleaveRows(uint8_t* out, const uint8_t* planes, size_t w)
+{
+    InterleaveRGB(out, planes, w);
+}
+
+PANGO_DEBAYER_TARGET_CLONES
+void InterleaveRows(uint16_t* out, const uint16_t* planes, size_t w)
+{
+    InterleaveRGB(out, planes, w);
+}
+
+// K is the channel of this row's red (0) or blue (2) samples
+template<size_t K, typename T>
+void BilinearDebayerRow(T* planes, const T* up, const T* cur, const T* dn, size_t w, size_t colour_parity, const BayerGains<T> wb)
+{
+    using Acc = typename BayerGains<T>::Acc;
+    FillBayerRow(planes + K*w, w, colour_parity,
+        [&](size_t x, size_t, size_t) { return wb.Apply(K, cur[x]); },
+        [&](size_t, size_t l, size_t r) { return wb.Apply(K, (Acc(cur[l]) + cur[r] + 1) >> 1); }
+    );
+    FillBayerRow(planes + w, w, colour_parity,
+        [&](size_t x, size_t l, size_t r) { return wb.Apply(1, (Acc(cur[l]) + cur[r] + up[x] + dn[x] + 2) >> 2); },
+        [&](size_t x, size_t, size_t) { return wb.Apply(1, cur[x]); }
+    );
+    FillBayerRow(planes + (2-K)*w, w, colour_parity,
+        [&](size_t, size_t l, size_t r) { return wb.Apply(2-K, (Acc(up[l]) + up[r] + dn[l] + dn[r] + 2) >> 2); },
+        [&](size_t x, size_t, size_t) { return wb.Apply(2-K, (Acc(up[x]) + dn[x] + 1) >> 1); }
+    );
+}
+
+template<typename T>
+void BilinearDebayer(Image<T>& out, const Image<T>& in, const BayerLayout& layout, const BayerGains<T>& wb, size_t y0, size_t y1)
+{
+    T* planes = ScratchRows<T>(3, in.w);
+    for(size_t y=y0; y < y1; ++y) {
+        const T* up  = in.RowPtr(MirrorIndex(y, -1, in.h));
+        const T* cur = in.RowPtr(y);
+        const T* dn  = in.RowPtr(MirrorIndex(y, +1, in.h));
+        if(layout.RedRow(y)) {
+            BilinearDebayerRow<0>(planes, up, cur, dn, in.w, layout.ColourParity(y), wb);
+        }else{
+            BilinearDebayerRow<2>(planes, up, cur, dn, in.w, layout.ColourParity(y), wb);
+        }
+        InterleaveRows(out.RowPtr(y), planes, in.w);
+    }
+}
+
+// Green at red and blue sites is interpolated along the direction with the
+// smaller gradient, so that it isn't averaged across edges.
+template<typename T>
+void EdgeSenseGreenRow(T* green, const T* up, const T* cur, const T* dn, size_t w, size_t colour_parity)
+{
+    using Acc = typename BayerGains<T>::Acc;
+    FillBayerRow(green, w, colour_parity,
+        [&](size_t x, size_t l, size_t r) {
+            const Acc dh = cur[l] > cur[r] ? cur[l] - cur[r] : cur[r] - cur[l];
+            const Acc dv = up[x] > dn[x] ? up[x] - dn[x] : dn[x] - up[x];
+            const Acc h = (Acc(cur[l]) + cur[r] + 1) >> 1;
+            const Acc v = (Acc(up[x]) + dn[x] + 1) >> 1;
+            return static_cast<T>(dh < dv ? h : (dv < dh ? v : (h + v + 1) >> 1));
+        },
+        [&](size_t x, size_t, size_t) { return cur[x]; }
+    );
+}
+
+// Red and blue are interpolated as differences from the green plane, which
+// follow edges far better than the colours themselves.
+template<size_t K, typename T>
+void EdgeSenseDebayerRow(T* planes, const T* up, const T* cur, const T* dn, const T* gup, const T* gcur, const T* gdn,
+                         size_t w, size_t colour_parity, const BayerGains<T> wb, BayerDiff<T> max_value)
+{
+    using D = BayerDiff<T>;
+    const auto clamp = [max_value](D v) {
+        return std::min(std::max(v, D(0)), max_value);
+    };
+    FillBayerRow(planes + K*w, w, colour_parity,
+        [&](size_t x, size_t, size_t) { return wb.Apply(K, cur[x]); },
+        [&](size_t x, size_t l, size_t r) {
+            return wb.Apply(K, clamp(D(cur[x]) + D(D(cur[l]) - gcur[l] + D(cur[r]) - gcur[r]) / 2));
+        }
+    );
+    FillBayerRow(planes + w, w, colour_parity,
+        [&](size_t x, size_t, size_t) { return wb.Apply(1, gcur[x]); },
+        [&](size_t x, size_t, size_t) { return wb.Apply(1, cur[x]); }
+    );
+    FillBayerRow(planes + (2-K)*w, w, colour_parity,
+        [&](size_t x, size_t l, size_t r) {
+            return wb.Apply(2-K, clamp(D(gcur[x]) + D(D(up[l]) - gup[l] + D(up[r]) - gup[r] + D(dn[l]) - gdn[l] + D(dn[r]) - gdn[r]) / 4));
+        },
+        [&](size_t x, size_t, size_t) {
+            return wb.Apply(2-K, clamp(D(cur[x]) + D(D(up[x]) - gup[x] + D(dn[x]) - gdn[x]) / 2));
+        }
+    );
+}
+
+template<typename T>
+void EdgeSenseDebayer(Image<T>& out, const Image<T>& in, const BayerLayout& layout, const BayerGains<T>& wb, T max_value, size_t y0, size_t y1)
+{
+    // Colour rows followed by a rolling window of three interpolated green
+    // rows, indexed by row mod 3.
+    T* planes = ScratchRows<T>(6, in.w);
+    const auto green_row = [&](size_t y) {
+        return planes + (3 + y % 3) * in.w;
+    };
+    const auto interpolate_green = [&](size_t y) {
+        EdgeSenseGreenRow(green_row(y), in.RowPtr(MirrorIndex(y, -1, in.h)), in.RowPtr(y),
+                          in.RowPtr(MirrorIndex(y, +1, in.h)), in.w, layout.ColourParity(y));
+    };
+
+    interpolate_green(MirrorIndex(y0, -1, in.h));
+    interpolate_green(y0);
+
+    for(size_t y=y0; y < y1; ++y) {
+        const size_t yu = MirrorIndex(y, -1, in.h);
+        const size_t yd = MirrorIndex(y, +1, in.h);
+        if(yd > y) {
+            interpolate_green(yd);
         }
-        break;
-      case DC1394_COLOR_FILTER_GBRG:
-        for(int y=0; y< (int)out.h; ++y) {
-          Tout* pixout = out.RowPtr(y);
-          const Tin* irow0 = in.RowPtr(2*y+y_offset);
-          const Tin* irow1 = in.RowPtr(2*y+1+y_offset);
-          for(size_t x=0; x<out.w; ++x) {
-             *(pixout++) = irow1[2*x] * wb_gains.r;
-             *(pixout++) = ((irow0[2*x] + irow1[2*x+1]) >> 1) * wb_gains.g;
-             *(pixout++) = irow0[2*x+1] * wb_gains.b;
-          }
+        const T* rows[6] = {in.RowPtr(yu), in.RowPtr(y), in.RowPtr(yd), green_row(yu), green_row(y), green_row(yd)};
+        if(layout.RedRow(y)) {
+            EdgeSenseDebayerRow<0>(planes, rows[0], rows[1], rows[2], rows[3], rows[4], rows[5], in.w, layout.ColourParity(y), wb, max_value);
+        }else{
+            EdgeSenseDebayerRow<2>(planes, rows[0], rows[1], rows[2], rows[3], rows[4], rows[5], in.w, layout.ColourParity(y), wb, max_value);
         }
-        break;
-      case DC1394_COLOR_FILTER_GRBG:
-        for(int y=0; y< (int)out.h; ++y) {
-          Tout* pixout = out.RowPtr(y);
-          const Tin* irow0 = in.RowPtr(2*y+y_offset);
-          const Tin* irow1 = in.RowPtr(2*y+1+y_offset);
-          for(size_t x=0; x<out.w; ++x) {
-             *(pixout++) = irow0[2*x+1] * wb_gains.r;
-             *(pixout++) = ((irow0[2*x] + irow1[2*x+1]) >> 1) * wb_gains.g;
-             *(pixout++) = irow1[2*x] * wb_gains.b;
-          }
+        InterleaveRows(out.RowPtr(y), planes, in.w);
+    }
+}
+
+template<typename T>
+void DownsampleToMono(Image<T>& out, const Image<T>& in, size_t y0, size_t y1)
+{
+    using Acc = typename BayerGains<T>::Acc;
+    for(size_t y=y0; y < y1; ++y) {
+        T* pixout = out.RowPtr(y);
+        const T* irow0 = in.RowPtr(2*y);
+        const T* irow1 = in.RowPtr(2*y+1);
+        for(size_t x=0; x < out.w; ++x) {
+            pixout[x] = static_cast<T>((Acc(irow0[2*x]) + irow0[2*x+1] + irow1[2*x] + irow1[2*x+1]) / 4);
         }
-        break;
-      case DC1394_COLOR_FILTER_BGGR:
-        for(int y=0; y< (int)out.h; ++y) {
-          Tout* pixout = out.RowPtr(y);
-          const Tin* irow0 = in.RowPtr(2*y+y_offset);
-          const Tin* irow1 = in.RowPtr(2*y+1+y_offset);
-          for(size_t x=0; x<out.w; ++x) {
-             *(pixout++) = irow1[2*x+1] * wb_gains.r;
-             *(pixout++) = ((irow0[2*x+1] + irow1[2*x]) >> 1) * wb_gains.g;
-             *(pixout++) = irow0[2*x] * wb_gains.b;
-          }
+    }
+}
+
+template<typename T>
+void DownsampleDebayer(Image<T>& out, const Image<T>& in, const BayerLayout& layout, const BayerGains<T>& wb, size_t y0, size_t y1)
+{
+    using Acc = typename BayerGains<T>::Acc;
+    const size_t rx = layout.rx;
+    for(size_t y=y0; y < y1; ++y) {
+        T* pixout = out.RowPtr(y);
+        const T* rrow = in.RowPtr(2*y + layout.ry);
+        const T* brow = in.RowPtr(2*y + 1 - layout.ry);
+        for(size_t x=0; x < out.w; ++x) {
+            pixout[3*x+0] = wb.Apply(0, rrow[2*x+rx]);
+            pixout[3*x+1] = wb.Apply(1, (Acc(rrow[2*x+1-rx]) + brow[2*x+rx]) >> 1);
+            pixout[3*x+2] = wb.Apply(2, brow[2*x+1-rx]);
         }
-        break;
     }
 }
 
@@ -230,27 +476,63 @@ void PitchedImageCopy( Image<T>& img_out, const Image<T>& img_in ) {
     }
 }
 
-template<typename Tout, typename Tin>
-void ProcessImage(Image<Tout>& img_out, const Image<Tin>& img_in, bayer_method_t method, color_filter_t tile, WbGains wb_gains, const bool has_metadata_line)
+template<typename T>
+T MaxChannelValue(const StreamInfo& stin)
 {
+    const unsigned int bits = stin.PixFormat().channel_bit_depth;
+    return (bits > 0 && bits < 8*sizeof(T)) ? static_cast<T>((1u << bits) - 1) : std::numeric_limits<T>::max();
+}
+
+// Output rows past those which have input, when a metadata line takes the
+// place of the first sensor row, repeat the last row that does.
+template<typename T>
+void RepeatLastRow(Image<T>& out, size_t channels, size_t rows)
+{
+    for(size_t y = std::max<size_t>(rows, 1); y < out.h; ++y) {
+        std::memcpy(out.RowPtr(y), out.RowPtr(y-1), out.w * channels * sizeof(T));
+    }
+}
+
+template<typename T>
+void ProcessImage(ThreadPool* pool, Image<T>& img_out, Image<T> img_in, bayer_method_t method, color_filter_t tile, const WbGains& wb_gains, T max_value, const bool has_metadata_line)
+{
+    const BayerLayout layout(tile);
+    const BayerGains<T> wb(wb_gains, max_value);
+
+    // The bayer pattern starts below the metadata line, if there is one.
+    const size_t skip = has_metadata_line && img_in.h > 0 ? 1 : 0;
+    const Image<T> pixels = img_in.SubImage(0, skip, img_in.w, img_in.h - skip);
+
     if(method == BAYER_METHOD_NONE) {
-        PitchedImageCopy(img_out, img_in.template UnsafeReinterpret<Tout>() );
-    }else if(method == BAYER_METHOD_DOWNSAMPLE_MONO) {
-        if( sizeof(Tout) == 1) {
-            DownsampleToMono<int,Tout, Tin>(img_out, img_in);
-        }else{
-            DownsampleToMono<double,Tout, Tin>(img_out, img_in);
-        }
-    }else if(method == BAYER_METHOD_DOWNSAMPLE) {
-        DownsampleDebayer(img_out, img_in, tile, wb_gains, has_metadata_line);
+        PitchedImageCopy(img_out, img_in);
+    }else if(method == BAYER_METHOD_DOWNSAMPLE_MONO || method == BAYER_METHOD_DOWNSAMPLE) {
+        const size_t rows = std::min(img_out.h, pixels.h / 2);
+        ForEachRowBand(pool, rows, [&](size_t y0, size_t y1) {
+            if(method == BAYER_METHOD_DOWNSAMPLE_MONO) {
+                DownsampleToMono(img_out, pixels, y0, y1);
+            }else{
+                DownsampleDebayer(img_out, pixels, layout, wb, y0, y1);
+            }
+        });
+        RepeatLastRow(img_out, method == BAYER_METHOD_DOWNSAMPLE_MONO ? 1 : 3, rows);
+    }else if(method == BAYER_METHOD_BILINEAR || method == BAYER_METHOD_EDGESENSE) {
+        const size_t rows = std::min(img_out.h, pixels.h);
+        ForEachRowBand(pool, rows, [&](size_t y0, size_t y1) {
+            if(method == BAYER_METHOD_BILINEAR) {
+                BilinearDebayer(img_out, pixels, layout, wb, y0, y1);
+            }else{
+                EdgeSenseDebayer(img_out, pixels, layout, wb, max_value, y0, y1);
+            }
+        });
+        RepeatLastRow(img_out, 3, rows);
     }else{
 #ifdef HAVE_DC1394
-        if(sizeof(Tout) == 1) {
+        if(sizeof(T) == 1) {
             dc1394_bayer_decoding_8bit(
                 (uint8_t*)img_in.ptr, (uint8_t*)img_out.ptr, img_in.w, img_in.h,
                 (dc1394color_filter_t)tile, (dc1394bayer_method_t)method
             );
-        }else if(sizeof(Tout) == 2) {
+        }else if(sizeof(T) == 2) {
             dc1394_bayer_decoding_16bit(
                 (uint16_t*)img_in.ptr, (uint16_t*)img_out.ptr, img_in.w, img_in.h,
                 (dc1394color_filter_t)tile, (dc1394bayer_method_t)method,
@@ -261,6 +543,8 @@ void ProcessImage(Image<Tout>& img_out, const Image<Tin>& img_in, bayer_method_t
     }
 }
 
+}
+
 void DebayerVideo::ProcessStreams(unsigned char* out, const unsigned char *in)
 {
     const bool has_metadata_line = frame_properties.get_value<bool>(PANGO_HAS_LINE0_METADATA, false);
@@ -276,11 +560,11 @@ void DebayerVideo::ProcessStreams(unsigned char* out, const unsigned char *in)
                 std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), num_bytes);
             }
         }else if(stin.PixFormat().bpp == 8) {
-            ProcessImage(img_out, img_in, methods[s], tile, wb_gains, has_metadata_line);
+            ProcessImage<uint8_t>(pool.get(), img_out, img_in, methods[s], tile, wb_gains, MaxChannelValue<uint8_t>(stin), has_metadata_line);
         }else if(stin.PixFormat().bpp == 16){
             Image<uint16_t> img_in16  = img_in.UnsafeReinterpret<uint16_t>();
             Image<uint16_t> img_out16 = img_out.UnsafeReinterpret<uint16_t>();
-            ProcessImage(img_out16, img_in16, methods[s], tile, wb_gains, has_metadata_line);
+            ProcessImage<uint16_t>(pool.get(), img_out16, img_in16, methods[s], tile, wb_gains, MaxChannelValue<uint16_t>(stin), has_metadata_line);
         }else {
             throw std::runtime_error("debayer: unhandled format combination: " + stin.PixFormat().format );
         }
@@ -364,7 +648,8 @@ PANGOLIN_REGISTER_FACTORY(DebayerVideo)
                 {"method(\\d+)?","none","method, or methodN for multiple sub-streams, N >= 1. Possible values: nearest,simple,bilinear,hqlinear,downsample,edgesense,vng,ahd,mono,none. For methodN, the default values are set to the value of method."},
                 {"wb_r","1.0","White balance - red component"},
                 {"wb_g","1.0","White balance - green component"},
-                {"wb_b","1.0","White balance - blue component"}
+                {"wb_b","1.0","White balance - blue component"},
+                {"threads","0","Number of threads used to debayer each frame. 0 for one per hardware thread."}
             }};
         }
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
@@ -382,7 +667,7 @@ PANGOLIN_REGISTER_FACTORY(DebayerVideo)
                 std::string method_s = reader.Get<std::string>(key, method);
                 methods.push_back(DebayerVideo::BayerMethodFromString(method_s));
             }
-            return std::unique_ptr<VideoInterface>( new DebayerVideo(subvid, methods, tile, input_wb_gains) );
+            return std::unique_ptr<VideoInterface>( new DebayerVideo(subvid, methods, tile, input_wb_gains, reader.Get<size_t>("threads")) );
         }
     };
 
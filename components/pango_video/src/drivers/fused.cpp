@@ -0,0 +1,297 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/video/drivers/fused.h>
+#include <pangolin/factory/factory_registry.h>
+#include <pangolin/utils/thread_pool.h>
+#include <pangolin/video/iostream_operators.h>
+#include <pangolin/video/video.h>
+
+namespace pangolin
+{
+
+FusedVideo::FusedVideo(std::unique_ptr<VideoInterface>& src_, size_t band_bytes, size_t num_threads)
+    : src(std::move(src_)), source(nullptr)
+{
+    if(!src) {
+        throw VideoException("FusedVideo: VideoInterface in must not be null");
+    }
+    videoin.push_back(src.get());
+
+    // Collect the run of row filters from the top of the chain downwards
+    VideoInterface* video = src.get();
+    for(;;) {
+        VideoRowFilterInterface* filter = dynamic_cast<VideoRowFilterInterface*>(video);
+        VideoFilterInterface* filter_inputs = dynamic_cast<VideoFilterInterface*>(video);
+        if(!filter || !filter->SupportsRowProcessing() || !filter_inputs ||
+           filter_inputs->InputStreams().size() != 1 ||
+           filter_inputs->InputStreams()[0]->Streams().size() != video->Streams().size()) {
+            break;
+        }
+        stages.insert(stages.begin(), Stage{filter, video});
+        video = filter_inputs->InputStreams()[0];
+    }
+    source = video;
+
+    if(stages.empty()) {
+        pango_print_warn("FusedVideo: no row filters to fuse, frames are passed through.\n");
+    }
+
+    // Bands are limited by the widest row of any stage
+    const std::vector<StreamInfo>& out_streams = src->Streams();
+    for(size_t s=0; s < out_streams.size(); ++s) {
+        size_t max_pitch = source->Streams()[s].Pitch();
+        for(const Stage& stage : stages) {
+            max_pitch = std::max(max_pitch, stage.video->Streams()[s].Pitch());
+        }
+        const size_t band_rows = std::max<size_t>(1, band_bytes / std::max<size_t>(1, max_pitch));
+        const size_t h = out_streams[s].Height();
+        for(size_t y=0; y < h; y += band_rows) {
+            bands.push_back({s, y, std::min(h, y + band_rows)});
+        }
+    }
+
+    if(num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    if(num_threads > 1) {
+        // The grabbing thread also processes bands
+        pool = std::unique_ptr<ThreadPool>(new ThreadPool(num_threads - 1));
+    }
+
+    source_pool.Reset(source->SizeBytes());
+    output_pool.Reset(src->SizeBytes());
+
+    device_properties = GetVideoDeviceProperties(src.get());
+}
+
+FusedVideo::~FusedVideo()
+{
+}
+
+//! Implement VideoInput::Start()
+void FusedVideo::Start()
+{
+    videoin[0]->Start();
+}
+
+//! Implement VideoInput::Stop()
+void FusedVideo::Stop()
+{
+    videoin[0]->Stop();
+}
+
+//! Implement VideoInput::SizeBytes()
+size_t FusedVideo::SizeBytes() const
+{
+    return videoin[0]->SizeBytes();
+}
+
+//! Implement VideoInput::Streams()
+const std::vector<StreamInfo>& FusedVideo::Streams() const
+{
+    return videoin[0]->Streams();
+}
+
+namespace
+{
+// Band sized buffers between stages, reused by each thread
+unsigned char* ScratchRows(size_t i, size_t bytes)
+{
+    thread_local std::vector<unsigned char> scratch[2];
+    if(scratch[i].size() < bytes) {
+        scratch[i].resize(bytes);
+    }
+    return scratch[i].data();
+}
+}
+
+void FusedVideo::ProcessBand(const Band& band, unsigned char* image, const unsigned char* frame)
+{
+    const size_t s = band.stream;
+    const size_t n = stages.size();
+
+    // Input rows of each stage, working back from the output band
+    thread_local std::vector<std::pair<size_t,size_t>> rows;
+    rows.resize(n+1);
+    rows[n] = {band.y0, band.y1};
+    for(size_t k=n; k-- > 0;) {
+        rows[k] = stages[k].filter->InputRows(s, rows[k+1].first, rows[k+1].second);
+    }
+
+    const StreamInfo& si_source = source->Streams()[s];
+    Image<unsigned char> in = si_source.StreamImage(frame);
+    in = in.SubImage(0, rows[0].first, in.w, rows[0].second - rows[0].first);
+
+    for(size_t k=0; k < n; ++k) {
+        const StreamInfo& si_out = stages[k].video->Streams()[s];
+        const size_t h = rows[k+1].second - rows[k+1].first;
+
+        Image<unsigned char> out;
+        if(k+1 == n) {
+            out = Streams()[s].StreamImage(image);
+            out = out.SubImage(0, rows[n].first, out.w, h);
+        }else{
+            out = Image<unsigned char>(ScratchRows(k % 2, h * si_out.Pitch()), si_out.Width(), h, si_out.Pitch());
+        }
+
+        stages[k].filter->ProcessRows(s, out, in);
+        in = out;
+    }
+}
+
+void FusedVideo::Process(unsigned char* image, const unsigned char* frame)
+{
+    const auto process_bands = [&](size_t b0, size_t b1) {
+        for(size_t b=b0; b < b1; ++b) {
+            ProcessBand(bands[b], image, frame);
+        }
+    };
+
+    if(pool) {
+        pool->ParallelFor(0, bands.size(), process_bands);
+    }else{
+        process_bands(0, bands.size());
+    }
+}
+
+//! Implement VideoInput::GrabNext()
+bool FusedVideo::GrabNext( unsigned char* image, bool wait )
+{
+    if(stages.empty()) {
+        const bool grabbed = videoin[0]->GrabNext(image, wait);
+        frame_properties = GetVideoFrameProperties(videoin[0]);
+        return grabbed;
+    }
+
+    VideoFrameLease frame = LeaseNextFrame(*source, source_pool, wait);
+    if(frame) {
+        frame_properties = GetVideoFrameProperties(source);
+        Process(image, frame.get());
+    }
+    return (bool)frame;
+}
+
+//! Implement VideoInput::GrabNewest()
+bool FusedVideo::GrabNewest( unsigned char* image, bool wait )
+{
+    if(stages.empty()) {
+        const bool grabbed = videoin[0]->GrabNewest(image, wait);
+        frame_properties = GetVideoFrameProperties(videoin[0]);
+        return grabbed;
+    }
+
+    VideoFrameLease frame = LeaseNewestFrame(*source, source_pool, wait);
+    if(frame) {
+        frame_properties = GetVideoFrameProperties(source);
+        Process(image, frame.get());
+    }
+    return (bool)frame;
+}
+
+//! Implement VideoLeaseInterface::LeaseNext()
+VideoFrameLease FusedVideo::LeaseNext( bool wait )
+{
+    if(stages.empty()) {
+        VideoFrameLease lease = LeaseNextFrame(*videoin[0], output_pool, wait);
+        frame_properties = GetVideoFrameProperties(videoin[0]);
+        return lease;
+    }
+
+    VideoFrameLease frame = LeaseNextFrame(*source, source_pool, wait);
+    if(!frame) {
+        return nullptr;
+    }
+    frame_properties = GetVideoFrameProperties(source);
+    VideoFrameLease out = output_pool.Lease();
+    Process(out.get(), frame.get());
+    return out;
+}
+
+//! Implement VideoLeaseInterface::LeaseNewest()
+VideoFrameLease FusedVideo::LeaseNewest( bool wait )
+{
+    if(stages.empty()) {
+        VideoFrameLease lease = LeaseNewestFrame(*videoin[0], output_pool, wait);
+        frame_properties = GetVideoFrameProperties(videoin[0]);
+        return lease;
+    }
+
+    VideoFrameLease frame = LeaseNewestFrame(*source, source_pool, wait);
+    if(!frame) {
+        return nullptr;
+    }
+    frame_properties = GetVideoFrameProperties(source);
+    VideoFrameLease out = output_pool.Lease();
+    Process(out.get(), frame.get());
+    return out;
+}
+
+std::vector<VideoInterface*>& FusedVideo::InputStreams()
+{
+    return videoin;
+}
+
+const picojson::value& FusedVideo::DeviceProperties() const
+{
+    return device_properties;
+}
+
+const picojson::value& FusedVideo::FrameProperties() const
+{
+    return frame_properties;
+}
+
+PANGOLIN_REGISTER_FACTORY(FusedVideo)
+{
+    struct FusedVideoFactory final : public TypedFactoryInterface<VideoInterface> {
+        std::map<std::string,Precedence> Schemes() const override
+        {
+            return {{"fuse",10}};
+        }
+        const char* Description() const override
+        {
+            return "Video Filter: runs the row filters beneath it (shift, unpack, gamma, flips) as one multithreaded pass over bands of rows.";
+        }
+        ParamSet Params() const override
+        {
+            return {{
+                {"band_kb","64","Maximum size in KB of each filter's output for one band of rows"},
+                {"threads","0","Number of threads to process bands with, or 0 for one per hardware thread"}
+            }};
+        }
+        std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
+            ParamReader reader(Params(), uri);
+            std::unique_ptr<VideoInterface> subvid = pangolin::OpenVideo(uri.url);
+            return std::unique_ptr<VideoInterface>(new FusedVideo(
+                subvid, 1024 * reader.Get<size_t>("band_kb"), reader.Get<size_t>("threads")
+            ));
+        }
+    };
+
+    return FactoryRegistry::I()->RegisterFactory<VideoInterface>(std::make_shared<FusedVideoFactory>());
+}
+
+}
@@ -28,7 +28,14 @@
 #include <pangolin/video/drivers/gamma.h>
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
+#include <pangolin/video/video.h>
+
+#ifdef __AVX2__
 #include <pangolin/utils/avx_math.h>
+#endif
+
+#include <cmath>
+#include <cstring>
 
 namespace pangolin
 {
@@ -224,54 +231,59 @@ void ApplyGamma(Image<uint8_t>& out,
 }
 #endif
 
-void GammaVideo::Process(uint8_t* buffer_out, const uint8_t* buffer_in)
+void GammaVideo::ProcessRows(size_t s, Image<uint8_t>& img_out, const Image<uint8_t>& img_in)
 {
-    for(size_t s=0; s<streams.size(); ++s) {
-        Image<uint8_t> img_out = Streams()[s].StreamImage(buffer_out);
-        const Image<uint8_t> img_in  = videoin[0]->Streams()[s].StreamImage(buffer_in);
-        const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+    const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
 
-        auto i = stream_gammas.find(s);
+    auto i = stream_gammas.find(s);
 
-        if(i != stream_gammas.end() && i->second != 0.0f && i->second != 1.0f)
-        {
-            const float gamma = i->second;
+    if(i != stream_gammas.end() && i->second != 0.0f && i->second != 1.0f)
+    {
+        const float gamma = i->second;
 
-            if(Streams()[s].PixFormat().format == "GRAY8" ||
-               Streams()[s].PixFormat().format == "RGB24" ||
-               Streams()[s].PixFormat().format == "BGR24" ||
-               Streams()[s].PixFormat().format == "RGBA32" ||
-               Streams()[s].PixFormat().format == "BGRA32")
-            {
-                ApplyGamma<uint8_t>(img_out, img_in, gamma, std::pow(2, Streams()[s].PixFormat().channel_bit_depth) - 1);
-            }
-            else if(Streams()[s].PixFormat().format == "GRAY16LE" ||
-                    Streams()[s].PixFormat().format == "RGB48" ||
-                    Streams()[s].PixFormat().format == "BGR48" ||
-                    Streams()[s].PixFormat().format == "RGBA64" ||
-                    Streams()[s].PixFormat().format == "BGRA64")
-            {
-                ApplyGamma<uint16_t>(img_out, img_in, gamma, std::pow(2, Streams()[s].PixFormat().channel_bit_depth) - 1);
-            }
-            else
-            {
-                throw VideoException("GammaVideo: Stream format not supported");
-            }
+        if(Streams()[s].PixFormat().format == "GRAY8" ||
+           Streams()[s].PixFormat().format == "RGB24" ||
+           Streams()[s].PixFormat().format == "BGR24" ||
+           Streams()[s].PixFormat().format == "RGBA32" ||
+           Streams()[s].PixFormat().format == "BGRA32")
+        {
+            ApplyGamma<uint8_t>(img_out, img_in, gamma, std::pow(2, Streams()[s].PixFormat().channel_bit_depth) - 1);
+        }
+        else if(Streams()[s].PixFormat().format == "GRAY16LE" ||
+                Streams()[s].PixFormat().format == "RGB48" ||
+                Streams()[s].PixFormat().format == "BGR48" ||
+                Streams()[s].PixFormat().format == "RGBA64" ||
+                Streams()[s].PixFormat().format == "BGRA64")
+        {
+            ApplyGamma<uint16_t>(img_out, img_in, gamma, std::pow(2, Streams()[s].PixFormat().channel_bit_depth) - 1);
         }
         else
         {
-            //straight copy
-            if( img_out.w != img_in.w || img_out.h != img_in.h ) {
-                throw std::runtime_error("GammaVideo: Incompatible image sizes");
-            }
+            throw VideoException("GammaVideo: Stream format not supported");
+        }
+    }
+    else
+    {
+        //straight copy
+        if( img_out.w != img_in.w || img_out.h != img_in.h ) {
+            throw std::runtime_error("GammaVideo: Incompatible image sizes");
+        }
 
-            for(size_t y=0; y < img_out.h; ++y) {
-                std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), bytes_per_pixel * img_in.w);
-            }
+        for(size_t y=0; y < img_out.h; ++y) {
+            std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), bytes_per_pixel * img_in.w);
         }
     }
 }
 
+void GammaVideo::Process(uint8_t* buffer_out, const uint8_t* buffer_in)
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        Image<uint8_t> img_out = Streams()[s].StreamImage(buffer_out);
+        const Image<uint8_t> img_in  = videoin[0]->Streams()[s].StreamImage(buffer_in);
+        ProcessRows(s, img_out, img_in);
+    }
+}
+
 //! Implement VideoInput::GrabNext()
 bool GammaVideo::GrabNext( uint8_t* image, bool wait )
 {
@@ -330,24 +342,32 @@ bool GammaVideo::DropNFrames(uint32_t n)
 PANGOLIN_REGISTER_FACTORY(GammaVideo)
 {
     struct GammaVideoFactory final : public TypedFactoryInterface<VideoInterface> {
-        GammaVideoFactory()
+        std::map<std::string,Precedence> Schemes() const override
+        {
+            return {{"gamma",10}};
+        }
+        const char* Description() const override
+        {
+            return "Video Filter: gamma corrects a set of video streams.";
+        }
+        ParamSet Params() const override
         {
-            param_set_ = {{
+            return {{
                 {"gamma\\d+","1.0","gammaK, where 1 <= K <= N where N is the number of streams"}
             }};
         }
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
+            ParamReader reader(Params(), uri);
 
-            ParamReader reader(param_set_, uri);
             // Gamma for each stream
             std::map<size_t, float> stream_gammas;
             for(size_t i=0; i<100; ++i)
             {
                 const std::string gamma_key = pangolin::FormatString("gamma%",i+1);
 
-                if(uri.Contains(gamma_key))
+                if(reader.Contains(gamma_key))
                 {
-                    stream_gammas[i] = reader.Get<float>(gamma_key, 1.0f);
+                    stream_gammas[i] = reader.Get<float>(gamma_key);
                 }
             }
 
@@ -355,21 +375,9 @@ PANGOLIN_REGISTER_FACTORY(GammaVideo)
 
             return std::unique_ptr<VideoInterface> (new GammaVideo(subvid, stream_gammas));
         }
-        FactoryUseInfo Help( const std::string& scheme ) const override {
-            return FactoryUseInfo(scheme, "Gamma corrects a set of video streams", param_set_);
-        }
-
-        bool ValidateUri( const std::string& scheme, const Uri& uri, std::unordered_set<std::string>& unrecognized_params) const override {
-            return ValidateUriAgainstParamSet(scheme, param_set_, uri, unrecognized_params );
-        }
-
-        bool IsValidated( const std::string& ) const override {return true;}
-
-        ParamSet param_set_;
     };
 
-    auto factory = std::make_shared<GammaVideoFactory>();
-    FactoryRegistry::I()->RegisterFactory<VideoInterface>(factory, 10, "gamma");
+    return FactoryRegistry::I()->RegisterFactory<VideoInterface>(std::make_shared<GammaVideoFactory>());
 }
 
 }
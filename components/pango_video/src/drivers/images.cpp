@@ -27,6 +27,7 @@
 
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/thread_pool.h>
 #include <pangolin/video/drivers/images.h>
 #include <pangolin/video/iostream_operators.h>
 
@@ -36,27 +37,73 @@
 namespace pangolin
 {
 
+TypedImage ImagesVideo::LoadChannel(size_t i, size_t c) const
+{
+    const std::string& filename = filenames[c][i];
+    const ImageFileType file_type = FileType(filename);
+
+    if(file_type == ImageFileTypeUnknown && unknowns_are_raw) {
+        // if raw_pitch is zero, assume image is packed.
+        const size_t pitch = raw_pitch ? raw_pitch : raw_fmt.bpp * raw_width / 8;
+        return LoadImage( filename, raw_fmt, raw_width, raw_height, pitch, raw_offset, raw_planes);
+    }else{
+        return LoadImage( filename, file_type );
+    }
+}
+
 bool ImagesVideo::LoadFrame(size_t i)
 {
     if( i < num_files) {
         Frame& frame = loaded[i];
         for(size_t c=0; c< num_channels; ++c) {
-            const std::string& filename = Filename(i,c);
-            const ImageFileType file_type = FileType(filename);
-
-            if(file_type == ImageFileTypeUnknown && unknowns_are_raw) {
-                // if raw_pitch is zero, assume image is packed.
-                const size_t pitch = raw_pitch ? raw_pitch : raw_fmt.bpp * raw_width / 8;
-                frame.push_back( LoadImage( filename, raw_fmt, raw_width, raw_height, pitch, raw_offset, raw_planes) );
-            }else{
-                frame.push_back( LoadImage( filename, file_type ) );
-            }
+            frame.push_back( LoadChannel(i, c) );
         }
         return true;
     }
     return false;
 }
 
+void ImagesVideo::InitPrefetch(size_t frames, size_t num_threads)
+{
+    prefetch_frames = frames;
+    prefetch_generation = std::make_shared<std::atomic<size_t>>(0);
+    if(prefetch_frames > 0) {
+        prefetch_pool = std::unique_ptr<ThreadPool>(new ThreadPool(num_threads));
+        Prefetch(next_frame_id);
+    }
+}
+
+void ImagesVideo::Prefetch(size_t first)
+{
+    if(!prefetched.empty() && prefetched.front().frame_id != first) {
+        CancelPrefetch();
+    }
+
+    size_t next = prefetched.empty() ? first : prefetched.back().frame_id + 1;
+    for(; prefetched.size() < prefetch_frames && next < num_files; ++next) {
+        PrefetchFrame frame;
+        frame.frame_id = next;
+        if(loaded[next].size() != num_channels) {
+            // Decode each channel separately, skipping work cancelled before it starts
+            const std::shared_ptr<std::atomic<size_t>> generation = prefetch_generation;
+            const size_t queued_generation = *generation;
+            for(size_t c=0; c < num_channels; ++c) {
+                frame.channels.push_back(prefetch_pool->Submit([this, generation, queued_generation, next, c]() {
+                    return *generation == queued_generation ? LoadChannel(next, c) : TypedImage();
+                }));
+            }
+        }
+        prefetched.push_back(std::move(frame));
+    }
+}
+
+void ImagesVideo::CancelPrefetch()
+{
+    // Decodes already running finish, but their results are discarded
+    ++*prefetch_generation;
+    prefetched.clear();
+}
+
 void ImagesVideo::PopulateFilenamesFromJson(const std::string& filename)
 {
     std::ifstream ifs( PathExpand(filename));
@@ -140,9 +187,10 @@ void ImagesVideo::ConfigureStreamSizes()
         streams.push_back(stream_info);
         size_bytes += img.h*img.pitch;
     }
+    frame_pool.Reset(size_bytes);
 }
 
-ImagesVideo::ImagesVideo(const std::string& wildcard_path)
+ImagesVideo::ImagesVideo(const std::string& wildcard_path, size_t prefetch_frames, size_t num_threads)
     : num_files(-1), num_channels(0), next_frame_id(0),
       unknowns_are_raw(false)
 {
@@ -154,7 +202,7 @@ ImagesVideo::ImagesVideo(const std::string& wildcard_path)
 
     ConfigureStreamSizes();
 
-    // TODO: Queue frames in another thread.
+    InitPrefetch(prefetch_frames, num_threads);
 }
 
 ImagesVideo::ImagesVideo(
@@ -162,7 +210,8 @@ ImagesVideo::ImagesVideo(
     const PixelFormat& raw_fmt,
     size_t raw_width, size_t raw_height,
     size_t raw_pitch, size_t raw_offset,
-    size_t raw_planes
+    size_t raw_planes,
+    size_t prefetch_frames, size_t num_threads
 ) : num_files(-1), num_channels(0), next_frame_id(0),
     unknowns_are_raw(true), raw_fmt(raw_fmt),
     raw_width(raw_width), raw_height(raw_height),
@@ -177,11 +226,14 @@ ImagesVideo::ImagesVideo(
 
     ConfigureStreamSizes();
 
-    // TODO: Queue frames in another thread.
+    InitPrefetch(prefetch_frames, num_threads);
 }
 
 ImagesVideo::~ImagesVideo()
 {
+    // Wait for decodes which reference this before it is destroyed
+    CancelPrefetch();
+    prefetch_pool.reset();
 }
 
 //! Implement VideoInput::Start()
@@ -208,27 +260,57 @@ const std::vector<StreamInfo>& ImagesVideo::Streams() const
     return streams;
 }
 
-//! Implement VideoInput::GrabNext()
-bool ImagesVideo::GrabNext( unsigned char* image, bool /*wait*/ )
+ImagesVideo::Frame* ImagesVideo::PrepareNextFrame()
 {
     if(next_frame_id < loaded.size()) {
         Frame& frame = loaded[next_frame_id];
 
+        if(prefetch_pool) {
+            Prefetch(next_frame_id);
+            PrefetchFrame prefetch = std::move(prefetched.front());
+            prefetched.pop_front();
+            if(!prefetch.channels.empty()) {
+                frame.clear();
+                for(auto& channel : prefetch.channels) {
+                    frame.push_back(channel.get());
+                }
+            }
+
+            // Keep the window full whilst this frame is used
+            Prefetch(next_frame_id + 1);
+        }
+
         if(frame.size() != num_channels) {
             LoadFrame(next_frame_id);
         }
 
         for(size_t c=0; c < num_channels; ++c){
-            TypedImage& img = frame[c];
+            const TypedImage& img = frame[c];
             if(!img.ptr || img.w != streams[c].Width() || img.h != streams[c].Height() ) {
-                return false;
+                return nullptr;
             }
-            const StreamInfo& si = streams[c];
-            std::memcpy(image + (size_t)si.Offset(), img.ptr, si.SizeBytes());
-            img.Deallocate();
         }
-        frame.clear();
+        return &frame;
+    }
+
+    return nullptr;
+}
 
+void ImagesVideo::CopyFrame(unsigned char* image, const Frame& frame) const
+{
+    for(size_t c=0; c < num_channels; ++c){
+        const StreamInfo& si = streams[c];
+        std::memcpy(image + (size_t)si.Offset(), frame[c].ptr, si.SizeBytes());
+    }
+}
+
+//! Implement VideoInput::GrabNext()
+bool ImagesVideo::GrabNext( unsigned char* image, bool /*wait*/ )
+{
+    Frame* frame = PrepareNextFrame();
+    if(frame) {
+        CopyFrame(image, *frame);
+        frame->clear();
         next_frame_id++;
         return true;
     }
@@ -242,6 +324,35 @@ bool ImagesVideo::GrabNewest( unsigned char* image, bool wait )
     return GrabNext(image,wait);
 }
 
+//! Implement VideoLeaseInterface::LeaseNext()
+VideoFrameLease ImagesVideo::LeaseNext( bool /*wait*/ )
+{
+    Frame* frame = PrepareNextFrame();
+    if(!frame) {
+        return nullptr;
+    }
+
+    VideoFrameLease lease;
+    if(num_channels == 1 && (*frame)[0].pitch == streams[0].Pitch()) {
+        // Hand over the loaded image itself
+        auto image = std::make_shared<TypedImage>(std::move((*frame)[0]));
+        lease = VideoFrameLease(image, image->ptr);
+    }else{
+        lease = frame_pool.Lease();
+        CopyFrame(lease.get(), *frame);
+    }
+
+    frame->clear();
+    next_frame_id++;
+    return lease;
+}
+
+//! Implement VideoLeaseInterface::LeaseNewest()
+VideoFrameLease ImagesVideo::LeaseNewest( bool wait )
+{
+    return LeaseNext(wait);
+}
+
 size_t ImagesVideo::GetCurrentFrameId() const
 {
     return (int)next_frame_id - 1;
@@ -255,6 +366,10 @@ size_t ImagesVideo::GetTotalFrames() const
 size_t ImagesVideo::Seek(size_t frameid)
 {
     next_frame_id = std::max(size_t(0), std::min(frameid, num_files));
+    if(prefetch_pool) {
+        // Restart read ahead from the new position
+        Prefetch(next_frame_id);
+    }
     return next_frame_id;
 }
 
@@ -295,7 +410,9 @@ PANGOLIN_REGISTER_FACTORY(ImagesVideo)
                 {"size","640x480","RAW files only. Image size, required if fmt is specified"},
                 {"pitch","0","RAW files only. Specify distance from the start of one row to the next in bytes. If not specified, assumed image is packed."},
                 {"offset","0","Offset from the start of the file in bytes where the image starts"},
-                {"planes","1","Number of channel planes (outer array channels) for raw image. fmt should be the format of an element in the individual plane."}
+                {"planes","1","Number of channel planes (outer array channels) for raw image. fmt should be the format of an element in the individual plane."},
+                {"prefetch","0","Number of following frames to decode ahead of time, bounding the memory used for them. 0 decodes each frame when it is grabbed."},
+                {"threads","0","Number of threads decoding prefetched frames and channels, or 0 for one per hardware thread"}
             }};
         }
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
@@ -303,6 +420,8 @@ PANGOLIN_REGISTER_FACTORY(ImagesVideo)
 
             const bool raw = reader.Contains("fmt");
             const std::string path = PathExpand(uri.url);
+            const size_t prefetch = reader.Get<size_t>("prefetch");
+            const size_t threads = reader.Get<size_t>("threads");
 
             if(raw) {
                 const std::string sfmt = reader.Get<std::string>("fmt");
@@ -312,10 +431,10 @@ PANGOLIN_REGISTER_FACTORY(ImagesVideo)
                 const size_t image_offset = reader.Get<int>("offset");
                 const size_t image_planes = reader.Get<int>("planes");
                 return std::unique_ptr<VideoInterface>( new ImagesVideo(
-                    path, fmt, dim.x, dim.y, image_pitch, image_offset, image_planes
+                    path, fmt, dim.x, dim.y, image_pitch, image_offset, image_planes, prefetch, threads
                 ));
             }else{
-                return std::unique_ptr<VideoInterface>( new ImagesVideo(path) );
+                return std::unique_ptr<VideoInterface>( new ImagesVideo(path, prefetch, threads) );
             }
         }
     };
@@ -29,6 +29,8 @@
 #include <pangolin/log/playback_session.h>
 #include <pangolin/utils/file_extension.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/log.h>
+#include <pangolin/utils/memstreambuf.h>
 #include <pangolin/utils/signal_slot.h>
 #include <pangolin/video/drivers/pango.h>
 
@@ -39,33 +41,57 @@ namespace pangolin
 
 const std::string pango_video_type = "raw_video";
 
-PangoVideo::PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session)
+PangoVideo::PangoVideo(const std::string& filename, std::shared_ptr<PlaybackSession> playback_session, size_t prefetch, size_t decode_threads, size_t codec_threads)
     : _filename(filename),
       _playback_session(playback_session),
       _reader(_playback_session->Open(filename)),
       _event_promise(_playback_session->Time()),
       _src_id(FindPacketStreamSource()),
-      _source(nullptr)
+      _source(nullptr),
+      _codec_threads(codec_threads),
+      _prefetch(0)
 {
     PANGO_ENSURE(_src_id != -1, "No appropriate video streams found in log.");
 
     _source = &_reader->Sources()[_src_id];
     SetupStreams(*_source);
 
+    // Prefetching reads packets by index from the file mapping, independently
+    // of the reader's position. Uncompressed frames are just copied anyway.
+    if(prefetch && !_fixed_size) {
+        if(_reader->IsMapped()) {
+            _prefetch = prefetch;
+            _decode_pool.reset(new ThreadPool(decode_threads ? decode_threads : std::min<size_t>(
+                std::max(1u, std::thread::hardware_concurrency()), prefetch
+            )));
+        }else{
+            pango_print_warn("'%s' can't be memory mapped, so won't be prefetched.\n", filename.c_str());
+        }
+    }
+    _next_frame = _next_prefetch = _source->next_packet_id;
+
     // Make sure we time-seek with other playback devices
     session_seek = _playback_session->Time().OnSeek.connect(
         [&](SyncTime::TimePoint t){
             _event_promise.Cancel();
             _reader->Seek(_src_id, t);
-            _event_promise.WaitAndRenew(_source->NextPacketTime());
+            if(_prefetch) {
+                std::lock_guard<std::mutex> l(_prefetch_lock);
+                _prefetched.clear();
+                _next_frame = _next_prefetch = _source->next_packet_id;
+                QueuePrefetch();
+            }
+            _event_promise.WaitAndRenew(_reader->NextPacketTime(_src_id));
         }
     );
 
-    _event_promise.WaitAndRenew(_source->NextPacketTime());
+    _event_promise.WaitAndRenew(_reader->NextPacketTime(_src_id));
 }
 
 PangoVideo::~PangoVideo()
 {
+    // Finish decoding before members used by the decode tasks go away
+    _decode_pool.reset();
 }
 
 size_t PangoVideo::SizeBytes() const
@@ -88,37 +114,138 @@ void PangoVideo::Stop()
 
 }
 
+void PangoVideo::DecodeFrame(std::istream& in, unsigned char* image)
+{
+    for(size_t s=0; s < _streams.size(); ++s) {
+        const StreamInfo& si = _streams[s];
+        pangolin::Image<unsigned char> dst = si.StreamImage(image);
+
+        if(stream_decoder[s]) {
+            pangolin::TypedImage img = stream_decoder[s](in);
+            PANGO_ENSURE(img.IsValid());
+
+            // TODO: We can avoid this copy by decoding directly into img
+            for(size_t row =0; row < dst.h; ++row) {
+                std::memcpy(dst.RowPtr(row), img.RowPtr(row), si.RowBytes());
+            }
+        }else{
+            for(size_t row =0; row < dst.h; ++row) {
+                in.read((char*)dst.RowPtr(row), si.RowBytes());
+            }
+        }
+    }
+}
+
+int64_t PangoVideo::FrameTime(size_t frame_id) const
+{
+    return _reader->PacketTime(_src_id, frame_id);
+}
+
+void PangoVideo::QueuePrefetch()
+{
+    // Expects _prefetch_lock to be held
+    while(_prefetched.size() < _prefetch) {
+        // A file which is still being written may have been indexed further
+        // since we last looked, or be ready to be.
+        if(_next_prefetch >= _reader->IndexSize(_src_id)) {
+            _reader->UpdateIndex();
+            if(_next_prefetch >= _reader->IndexSize(_src_id)) {
+                break;
+            }
+        }
+
+        std::vector<unsigned char> image;
+        if(!_free_images.empty()) {
+            image = std::move(_free_images.back());
+            _free_images.pop_back();
+        }
+
+        const size_t frame_id = _next_prefetch++;
+        auto task = [this, frame_id, image]() mutable {
+            std::shared_ptr<PrefetchedFrame> frame;
+            std::shared_ptr<const MemoryMappedFile> mapping;
+            const unsigned char* data;
+            size_t size;
+            picojson::value meta;
+            if(_reader->ReadPacket(_src_id, frame_id, mapping, data, size, meta)) {
+                frame = std::make_shared<PrefetchedFrame>();
+                frame->image = std::move(image);
+                frame->image.resize(_size_bytes);
+                frame->properties = std::move(meta);
+
+                memreadbuf packet_buf(data, size);
+                std::istream in(&packet_buf);
+                DecodeFrame(in, frame->image.data());
+            }
+            return frame;
+        };
+        _prefetched.push_back(_decode_pool->Submit(std::move(task)));
+    }
+}
+
+bool PangoVideo::GrabPrefetched(unsigned char* image)
+{
+    std::future<std::shared_ptr<PrefetchedFrame>> next;
+    {
+        std::lock_guard<std::mutex> l(_prefetch_lock);
+        QueuePrefetch();
+        if(_prefetched.empty()) {
+            return false;
+        }
+        next = std::move(_prefetched.front());
+        _prefetched.pop_front();
+        ++_next_frame;
+        QueuePrefetch();
+    }
+
+    // Frames are returned in order, whichever finishes decoding first.
+    std::shared_ptr<PrefetchedFrame> frame = next.get();
+    if(!frame) {
+        return false;
+    }
+
+    std::memcpy(image, frame->image.data(), _size_bytes);
+    _frame_properties = std::move(frame->properties);
+
+    std::lock_guard<std::mutex> l(_prefetch_lock);
+    _free_images.push_back(std::move(frame->image));
+    return true;
+}
+
 bool PangoVideo::GrabNext(unsigned char* image, bool /*wait*/)
 {
     try
     {
+        if(_prefetch) {
+            if(!GrabPrefetched(image)) {
+                throw std::runtime_error("PangoVideo: no frame");
+            }
+
+            _event_promise.WaitAndRenew(FrameTime(_next_frame));
+            return true;
+        }
+
         Packet fi = _reader->NextFrame(_src_id);
         _frame_properties = fi.meta;
 
+        // When the file is mapped, decode or copy straight out of the mapping
+        // rather than through the file stream's buffer.
+        const unsigned char* data = fi.Data();
+        memreadbuf mapped_buf(data, data ? fi.size : 0);
+        std::istream mapped_stream(&mapped_buf);
+        std::istream& in = data ? mapped_stream : fi.Stream();
+
         if(_fixed_size) {
-            fi.Stream().read(reinterpret_cast<char*>(image), _size_bytes);
-        }else{
-            for(size_t s=0; s < _streams.size(); ++s) {
-                StreamInfo& si = _streams[s];
-                pangolin::Image<unsigned char> dst = si.StreamImage(image);
-
-                if(stream_decoder[s]) {
-                    pangolin::TypedImage img = stream_decoder[s](fi.Stream());
-                    PANGO_ENSURE(img.IsValid());
-
-                    // TODO: We can avoid this copy by decoding directly into img
-                    for(size_t row =0; row < dst.h; ++row) {
-                        std::memcpy(dst.RowPtr(row), img.RowPtr(row), si.RowBytes());
-                    }
-                }else{
-                    for(size_t row =0; row < dst.h; ++row) {
-                        fi.Stream().read((char*)dst.RowPtr(row), si.RowBytes());
-                    }
-                }
+            if(data) {
+                std::memcpy(image, data, _size_bytes);
+            }else{
+                fi.Stream().read(reinterpret_cast<char*>(image), _size_bytes);
             }
+        }else{
+            DecodeFrame(in, image);
         }
 
-        _event_promise.WaitAndRenew(_source->NextPacketTime());
+        _event_promise.WaitAndRenew(_reader->NextPacketTime(_src_id));
         return true;
     }
     catch(...)
@@ -135,19 +262,22 @@ bool PangoVideo::GrabNewest( unsigned char* image, bool wait )
 
 size_t PangoVideo::GetCurrentFrameId() const
 {
+    if(_prefetch) {
+        return (int)_next_frame - 1;
+    }
     return (int)(_reader->Sources()[_src_id].next_packet_id) - 1;
 }
 
 size_t PangoVideo::GetTotalFrames() const
 {
-    return _source->index.size();
+    return _reader->IndexSize(_src_id);
 }
 
 size_t PangoVideo::Seek(size_t next_frame_id)
 {
     // Get time for seek
-    if(next_frame_id < _source->index.size()) {
-        const int64_t capture_time = _source->index[next_frame_id].capture_time;
+    if(next_frame_id < _reader->IndexSize(_src_id)) {
+        const int64_t capture_time = _reader->PacketTime(_src_id, next_frame_id);
         _playback_session->Time().Seek(SyncTime::TimePoint(std::chrono::microseconds(capture_time)));
         return next_frame_id;
     }else{
@@ -195,7 +325,7 @@ void PangoVideo::SetupStreams(const PacketStreamSource& src)
             const std::string compressed_encoding = encoding;
             encoding = json_stream["decoded"].get<std::string>();
             const PixelFormat decoded_fmt = PixelFormatFromString(encoding);
-            stream_decoder.push_back(StreamEncoderFactory::I().GetDecoder(compressed_encoding, decoded_fmt));
+            stream_decoder.push_back(StreamEncoderFactory::I().GetDecoder(compressed_encoding, decoded_fmt, _codec_threads));
         }else{
             stream_decoder.push_back(nullptr);
         }
@@ -234,7 +364,10 @@ PANGOLIN_REGISTER_FACTORY(PangoVideo)
         ParamSet Params() const override
         {
             return {{
-                {"OrderedPlayback","false","Whether the playback respects the order of every data as they were recorded. Important for simulated playback."}
+                {"OrderedPlayback","false","Whether the playback respects the order of every data as they were recorded. Important for simulated playback."},
+                {"prefetch","0","Number of compressed frames to read ahead and decode in parallel (0 to decode on demand)"},
+                {"decode_threads","0","Threads for decoding prefetched frames (0 for one per prefetched frame, up to the number of cores)"},
+                {"codec_threads","1","Threads decompressing each lz4 image which was recorded in row blocks"}
             }};
         }
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
@@ -243,7 +376,11 @@ PANGOLIN_REGISTER_FACTORY(PangoVideo)
             ParamReader reader(Params(),uri);
 
             if( !uri.scheme.compare("pango") || FileType(uri.url) == ImageFileTypePango ) {
-                return std::unique_ptr<VideoInterface>(new PangoVideo(path.c_str(), PlaybackSession::ChooseFromParams(reader)));
+                return std::unique_ptr<VideoInterface>(new PangoVideo(
+                    path.c_str(), PlaybackSession::ChooseFromParams(reader),
+                    reader.Get<size_t>("prefetch"), reader.Get<size_t>("decode_threads"),
+                    reader.Get<size_t>("codec_threads")
+                ));
             }
             return std::unique_ptr<VideoInterface>();
         }
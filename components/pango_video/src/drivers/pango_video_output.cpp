@@ -27,6 +27,7 @@
 
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/utils/file_utils.h>
+#include <pangolin/utils/log.h>
 #include <pangolin/utils/memstreambuf.h>
 #include <pangolin/utils/picojson.h>
 #include <pangolin/utils/sigstate.h>
@@ -52,21 +53,36 @@ void SigPipeHandler(int sig)
 }
 
 PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris)
+    : PangoVideoOutput(filename, buffer_size_bytes, stream_encoder_uris, PangoVideoOutputOptions())
+{
+}
+
+PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_size_bytes, const std::map<size_t, std::string> &stream_encoder_uris, const PangoVideoOutputOptions& options)
     : filename(filename),
       packetstream_buffer_size_bytes(buffer_size_bytes),
+      options(options),
       packetstreamsrcid(-1),
       total_frame_size(0),
       is_pipe(pangolin::IsPipe(filename)),
       fixed_size(true),
-      stream_encoder_uris(stream_encoder_uris)
+      stream_encoder_uris(stream_encoder_uris),
+      free_encode_buffers(std::make_shared<EncodeBufferList>())
 {
+    this->options.max_frames_in_flight = std::max<size_t>(1, options.max_frames_in_flight);
+
+    packetstream.SetCheckpointInterval(options.checkpoint_frames, options.checkpoint_interval_us);
+    packetstream.SetAlignmentPadding(options.alignment_padding_bytes);
+
     if(!is_pipe)
     {
-        packetstream.Open(filename, packetstream_buffer_size_bytes);
+        packetstream.Open(filename, packetstream_buffer_size_bytes, options.write_queue_depth, options.preallocate_bytes);
     }
     else
     {
         RegisterNewSigCallback(&SigPipeHandler, (void*)this, SIGPIPE);
+
+        // Frames must not be held back from a pipe we may discard
+        this->options.max_frames_in_flight = 1;
     }
 
     // Instantiate encoders
@@ -74,6 +90,25 @@ PangoVideoOutput::PangoVideoOutput(const std::string& filename, size_t buffer_si
 
 PangoVideoOutput::~PangoVideoOutput()
 {
+    try {
+        FlushFrames();
+    } catch(const std::exception& e) {
+        pango_print_error("Unable to write frames to '%s': %s\n", filename.c_str(), e.what());
+    }
+
+    if(options.print_write_stats) {
+        packetstream.Close();
+        const ThreadedFileBufStats stats = packetstream.WriteStats();
+        pango_print_info(
+            "'%s': %zu writes, %.1f MB, latency mean %.2f ms / max %.2f ms, max %zu in flight, "
+            "max %.1f MB buffered, %zu buffer full waits (%.2f ms), %.1f MB written without a copy.\n",
+            filename.c_str(), stats.writes, stats.bytes_written / (1024.0*1024.0),
+            stats.mean_write_latency_us() / 1000.0, stats.max_write_latency_us / 1000.0,
+            stats.max_writes_in_flight, stats.max_queued_bytes / (1024.0*1024.0),
+            stats.producer_waits, stats.producer_wait_us / 1000.0,
+            stats.pinned_bytes / (1024.0*1024.0)
+        );
+    }
 }
 
 const std::vector<StreamInfo>& PangoVideoOutput::Streams() const
@@ -124,7 +159,7 @@ void PangoVideoOutput::SetStreams(const std::vector<StreamInfo>& st, const std::
                 // instantiate encoder and write it's name to the stream properties
                 json_stream["decoded"] = si.PixFormat().format;
                 encoder_name = stream_encoder_uris[i];
-                stream_encoders[i] = StreamEncoderFactory::I().GetEncoder(encoder_name, si.PixFormat());
+                stream_encoders[i] = StreamEncoderFactory::I().GetEncoder(encoder_name, si.PixFormat(), options.codec_threads);
                 fixed_size = false;
             }
 
@@ -143,12 +178,89 @@ void PangoVideoOutput::SetStreams(const std::vector<StreamInfo>& st, const std::
         pss.data_size_bytes = fixed_size ? total_frame_size : 0;
         pss.data_definitions = "struct Frame{ uint8 stream_data[" + pangolin::Convert<std::string, size_t>::Do(total_frame_size) + "];};";
 
+        if(!fixed_size) {
+            encode_pool.reset(new ThreadPool(options.encoder_threads ? options.encoder_threads : std::min<size_t>(
+                std::max(1u, std::thread::hardware_concurrency()), streams.size() * options.max_frames_in_flight
+            )));
+        }
+
         packetstreamsrcid = (int)packetstream.AddSource(pss);
     } else {
         throw std::runtime_error("Unable to add new streams");
     }
 }
 
+std::shared_ptr<PangoVideoOutput::EncodeBuffers> PangoVideoOutput::AcquireEncodeBuffers()
+{
+    std::unique_ptr<EncodeBuffers> buffers;
+    {
+        std::lock_guard<std::mutex> l(free_encode_buffers->lock);
+        if(!free_encode_buffers->buffers.empty()) {
+            buffers = std::move(free_encode_buffers->buffers.back());
+            free_encode_buffers->buffers.pop_back();
+        }
+    }
+
+    if(!buffers) {
+        buffers.reset(new EncodeBuffers());
+        for(size_t i=0; i < streams.size(); ++i) {
+            buffers->streams.emplace_back(streams[i].SizeBytes());
+        }
+    }
+
+    // Return to the free list once the writer is also finished with them
+    std::shared_ptr<EncodeBufferList> free_list = free_encode_buffers;
+    return std::shared_ptr<EncodeBuffers>(buffers.release(), [free_list](EncodeBuffers* b){
+        std::lock_guard<std::mutex> l(free_list->lock);
+        free_list->buffers.emplace_back(b);
+    });
+}
+
+void PangoVideoOutput::EncodeStream(size_t i, const unsigned char* frame, memstreambuf& encoded) const
+{
+    encoded.clear();
+    std::ostream encode_stream(&encoded);
+
+    const StreamInfo& si = streams[i];
+    const Image<unsigned char> stream_image = si.StreamImage(frame);
+
+    if(stream_encoders[i]) {
+        // Encode to buffer
+        stream_encoders[i](encode_stream, stream_image);
+    }else{
+        if(stream_image.IsContiguous()) {
+            encode_stream.write((char*)stream_image.ptr, si.SizeBytes());
+        }else{
+            for(size_t row=0; row < stream_image.h; ++row) {
+                encode_stream.write((char*)stream_image.RowPtr(row), si.RowBytes());
+            }
+        }
+    }
+}
+
+void PangoVideoOutput::WriteEncodedFrame()
+{
+    PendingFrame f = std::move(frames_in_flight.front());
+    frames_in_flight.pop_front();
+
+    // Streams are written out back to back
+    std::vector<PacketSegment> segments;
+    for(size_t i=0; i < f.encoded.size(); ++i) {
+        f.encoded[i].get();
+        const std::vector<uint8_t>& encoded = f.buffers->streams[i].buffer;
+        segments.push_back({reinterpret_cast<const char*>(encoded.data()), encoded.size()});
+    }
+
+    packetstream.WriteSourcePacket(packetstreamsrcid, segments, f.time_us, f.buffers, f.properties);
+}
+
+void PangoVideoOutput::FlushFrames()
+{
+    while(!frames_in_flight.empty()) {
+        WriteEncodedFrame();
+    }
+}
+
 int PangoVideoOutput::WriteStreams(const unsigned char* data, const picojson::value& frame_properties)
 {
     const int64_t host_reception_time_us = frame_properties.get_value(PANGO_HOST_RECEPTION_TIME_US, Time_us(TimeNow()));
@@ -170,7 +282,7 @@ int PangoVideoOutput::WriteStreams(const unsigned char* data, const picojson::va
         {
             if (fd != -1)
             {
-                packetstream.Open(filename, packetstream_buffer_size_bytes);
+                packetstream.Open(filename, packetstream_buffer_size_bytes, options.write_queue_depth, options.preallocate_bytes);
                 close(fd);
             }
         }
@@ -202,60 +314,32 @@ int PangoVideoOutput::WriteStreams(const unsigned char* data, const picojson::va
 #endif
 
     if(!fixed_size) {
-        // TODO: Make this more efficient (without so many allocs and memcpy's)
-
-        std::vector<memstreambuf> encoded_stream_data;
+        std::shared_ptr<EncodeBuffers> buffers = AcquireEncodeBuffers();
 
-        // Create buffers for compressed data: the first will be reused for all the data later
-        encoded_stream_data.emplace_back(total_frame_size);
-        for(size_t i=1; i < streams.size(); ++i) {
-            encoded_stream_data.emplace_back(streams[i].SizeBytes());
+        // Frames encoded after we return need their own copy of the input
+        const unsigned char* frame = data;
+        if(options.max_frames_in_flight > 1) {
+            buffers->frame.assign(data, data + total_frame_size);
+            frame = buffers->frame.data();
         }
 
-        // lambda encodes frame data i to encoded_stream_data[i]
-        auto encode_stream = [&](int i){
-            encoded_stream_data[i].clear();
-            std::ostream encode_stream(&encoded_stream_data[i]);
-
-            const StreamInfo& si = streams[i];
-            const Image<unsigned char> stream_image = si.StreamImage(data);
-
-            if(stream_encoders[i]) {
-                // Encode to buffer
-                stream_encoders[i](encode_stream, stream_image);
-            }else{
-                if(stream_image.IsContiguous()) {
-                    encode_stream.write((char*)stream_image.ptr, streams[i].SizeBytes());
-                }else{
-                    for(size_t row=0; row < stream_image.h; ++row) {
-                        encode_stream.write((char*)stream_image.RowPtr(row), si.RowBytes());
-                    }
-                }
-            }
-            return true;
-        };
-
-        // Compress each stream (>0 in another thread)
-        std::vector<std::future<bool>> encode_finished;
-        for(size_t i=1; i < streams.size(); ++i) {
-            encode_finished.emplace_back(std::async(std::launch::async, [&,i](){
-                return encode_stream(i);
+        PendingFrame pending;
+        pending.buffers = buffers;
+        pending.time_us = host_reception_time_us;
+        pending.properties = frame_properties;
+        for(size_t i=0; i < streams.size(); ++i) {
+            pending.encoded.push_back(encode_pool->Submit([this, buffers, frame, i](){
+                EncodeStream(i, frame, buffers->streams[i]);
             }));
         }
-        // Encode stream 0 in this thread
-        encode_stream(0);
-
-        // Reuse our first compression stream for the rest of the data too.
-        std::vector<uint8_t>& encoded = encoded_stream_data[0].buffer;
+        frames_in_flight.push_back(std::move(pending));
 
-        // Wait on all threads to finish and copy into data packet
-        for(size_t i=1; i < streams.size(); ++i) {
-            encode_finished[i-1].get();
-            encoded.insert(encoded.end(), encoded_stream_data[i].buffer.begin(), encoded_stream_data[i].buffer.end());
+        // Write out frames in order, leaving up to max_frames_in_flight-1 encoding.
+        while(frames_in_flight.size() >= options.max_frames_in_flight) {
+            WriteEncodedFrame();
         }
-
-        packetstream.WriteSourcePacket(packetstreamsrcid, reinterpret_cast<const char*>(encoded.data()), host_reception_time_us, encoded.size(), frame_properties);
     }else{
+        // Copied, since the caller may reuse data as soon as we return
         packetstream.WriteSourcePacket(packetstreamsrcid, reinterpret_cast<const char*>(data), host_reception_time_us, total_frame_size, frame_properties);
     }
 
@@ -278,7 +362,16 @@ PANGOLIN_REGISTER_FACTORY(PangoVideoOutput)
             return {{
                 {"buffer_size_mb","100","Buffer size in MB"},
                 {"unique_filename","","This is flag to create a unique file name in the case of file already exists."},
-                {"encoder(\\d+)?"," ","encoder or encoderN, 1 <= N <= 100. The default values of encoderN are set to encoder"}
+                {"encoder(\\d+)?"," ","encoder or encoderN, 1 <= N <= 100. The default values of encoderN are set to encoder"},
+                {"checkpoint_frames","0","Write an index checkpoint every N frames so partial recordings open without a rebuild (0 to disable)"},
+                {"checkpoint_ms","0","Write an index checkpoint with the first frame once N milliseconds have passed since the last one (0 to disable)"},
+                {"queue_depth","1","Number of disk writes to keep in flight (Linux with io_uring only)"},
+                {"preallocate_mb","0","Reserve file space in chunks of this size ahead of writing (0 to disable)"},
+                {"write_stats","false","Print write latency and buffer usage on close, to help choose buffer_size_mb"},
+                {"encoder_threads","0","Number of threads for encoding streams (0 for one per stream and frame in flight, up to the number of cores)"},
+                {"encoder_frames","1","Number of frames which may be encoding at once. Above 1, input frames are copied so that WriteStreams can return before they are encoded."},
+                {"codec_threads","1","Number of threads compressing each zstd or lz4 image. lz4 images are split into independently compressed row blocks."},
+                {"align_padding","4095","Bytes of padding allowed per frame so that large encoded streams can be written without a copy by direct i/o (0 to copy them instead). Unencoded streams are always copied."}
             }};
         }
         std::unique_ptr<VideoOutputInterface> Open(const Uri& uri) override {
@@ -307,8 +400,19 @@ PANGOLIN_REGISTER_FACTORY(PangoVideoOutput)
                 stream_encoder_uris[i] = reader.Get<std::string>(encoder_key, default_encoder);
             }
 
+            PangoVideoOutputOptions options;
+            options.checkpoint_frames = reader.Get<size_t>("checkpoint_frames");
+            options.checkpoint_interval_us = reader.Get<int64_t>("checkpoint_ms") * 1000;
+            options.write_queue_depth = reader.Get<size_t>("queue_depth");
+            options.preallocate_bytes = reader.Get<size_t>("preallocate_mb") * mb;
+            options.print_write_stats = reader.Get<bool>("write_stats");
+            options.encoder_threads = reader.Get<size_t>("encoder_threads");
+            options.max_frames_in_flight = reader.Get<size_t>("encoder_frames");
+            options.codec_threads = reader.Get<size_t>("codec_threads");
+            options.alignment_padding_bytes = reader.Get<size_t>("align_padding");
+
             return std::unique_ptr<VideoOutputInterface>(
-                new PangoVideoOutput(filename, buffer_size_bytes, stream_encoder_uris)
+                new PangoVideoOutput(filename, buffer_size_bytes, stream_encoder_uris, options)
             );
         }
     };
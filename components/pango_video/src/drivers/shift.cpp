@@ -36,7 +36,7 @@ namespace pangolin
 ShiftVideo::ShiftVideo(std::unique_ptr<VideoInterface>& src_,
                        const std::map<size_t, int>& shift_right_bits,
                        const std::map<size_t, uint32_t>& masks)
-    : src(std::move(src_)), size_bytes(0), shift_right_bits(shift_right_bits), masks(masks)
+    : src(std::move(src_)), size_bytes(0), shift_right_bits(shift_right_bits), masks(masks), in_place(true)
 {
     if(!src) {
         throw VideoException("ShiftVideo: VideoInterface in must not be null");
@@ -97,6 +97,18 @@ ShiftVideo::ShiftVideo(std::unique_ptr<VideoInterface>& src_,
     }
 
     buffer.reset(new uint8_t[src->SizeBytes()]);
+
+    for(size_t s=0; s < streams.size(); ++s) {
+        const StreamInfo& in = src->Streams()[s];
+        const StreamInfo& out = streams[s];
+        const bool in_order = s+1 == streams.size() ||
+            (size_t)in.Offset() + in.SizeBytes() <= (size_t)src->Streams()[s+1].Offset();
+        in_place = in_place && in_order && (size_t)out.Offset() <= (size_t)in.Offset() &&
+            out.Pitch() <= in.Pitch() && out.PixFormat().bpp <= in.PixFormat().bpp;
+    }
+
+    input_pool.Reset(src->SizeBytes());
+    output_pool.Reset(size_bytes);
 }
 
 ShiftVideo::~ShiftVideo()
@@ -145,34 +157,39 @@ void DoShift16to8(
     }
 }
 
-void ShiftVideo::Process(uint8_t* buffer_out, const uint8_t* buffer_in)
+void ShiftVideo::ProcessRows(size_t s, Image<uint8_t>& img_out, const Image<uint8_t>& img_in)
 {
-    for(size_t s=0; s<streams.size(); ++s) {
-        const Image<uint8_t> img_in  = videoin[0]->Streams()[s].StreamImage(buffer_in);
-        Image<uint8_t> img_out = Streams()[s].StreamImage(buffer_out);
-        const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+    auto i = shift_right_bits.find(s);
 
-        auto i = shift_right_bits.find(s);
-
-        if(i != shift_right_bits.end() && i->second != 0)
-        {
-            auto m = masks.find(s);
-            DoShift16to8(img_out, img_in, i->second, (m == masks.end() ? 0xffff : m->second), std::pow(2, videoin[0]->Streams()[s].PixFormat().channel_bit_depth) - 1);
+    if(i != shift_right_bits.end() && i->second != 0)
+    {
+        auto m = masks.find(s);
+        DoShift16to8(img_out, img_in, i->second, (m == masks.end() ? 0xffff : m->second), std::pow(2, videoin[0]->Streams()[s].PixFormat().channel_bit_depth) - 1);
+    }
+    else
+    {
+        //straight copy
+        if( img_out.w != img_in.w || img_out.h != img_in.h ) {
+            throw std::runtime_error("ShiftVideo: Incompatible image sizes");
         }
-        else
-        {
-            //straight copy
-            if( img_out.w != img_in.w || img_out.h != img_in.h ) {
-                throw std::runtime_error("ShiftVideo: Incompatible image sizes");
-            }
 
-            for(size_t y=0; y < img_out.h; ++y) {
-                std::memcpy(img_out.RowPtr((int)y), img_in.RowPtr((int)y), bytes_per_pixel * img_in.w);
-            }
+        // Rows may overlap when processing in place
+        const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+        for(size_t y=0; y < img_out.h; ++y) {
+            std::memmove(img_out.RowPtr((int)y), img_in.RowPtr((int)y), bytes_per_pixel * img_in.w);
         }
     }
 }
 
+void ShiftVideo::Process(uint8_t* buffer_out, const uint8_t* buffer_in)
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        const Image<uint8_t> img_in  = videoin[0]->Streams()[s].StreamImage(buffer_in);
+        Image<uint8_t> img_out = Streams()[s].StreamImage(buffer_out);
+        ProcessRows(s, img_out, img_in);
+    }
+}
+
 //! Implement VideoInput::GrabNext()
 bool ShiftVideo::GrabNext( uint8_t* image, bool wait )
 {
@@ -195,6 +212,34 @@ bool ShiftVideo::GrabNewest( uint8_t* image, bool wait )
     }
 }
 
+VideoFrameLease ShiftVideo::ProcessLease(VideoFrameLease&& in)
+{
+    if(!in) {
+        return nullptr;
+    }
+
+    if(in_place && in.use_count() == 1) {
+        Process(in.get(), in.get());
+        return std::move(in);
+    }
+
+    VideoFrameLease out = output_pool.Lease();
+    Process(out.get(), in.get());
+    return out;
+}
+
+//! Implement VideoLeaseInterface::LeaseNext()
+VideoFrameLease ShiftVideo::LeaseNext( bool wait )
+{
+    return ProcessLease(LeaseNextFrame(*videoin[0], input_pool, wait));
+}
+
+//! Implement VideoLeaseInterface::LeaseNewest()
+VideoFrameLease ShiftVideo::LeaseNewest( bool wait )
+{
+    return ProcessLease(LeaseNewestFrame(*videoin[0], input_pool, wait));
+}
+
 std::vector<VideoInterface*>& ShiftVideo::InputStreams()
 {
     return videoin;
@@ -29,6 +29,8 @@
 #include <pangolin/factory/factory_registry.h>
 #include <pangolin/video/iostream_operators.h>
 
+#include <cstring>
+
 namespace pangolin
 {
 
@@ -39,7 +41,7 @@ void setRandomData(unsigned char * arr, size_t size){
   }
 }
 
-TestVideo::TestVideo(size_t w, size_t h, size_t n, std::string pix_fmt)
+TestVideo::TestVideo(size_t w, size_t h, size_t n, std::string pix_fmt, bool static_noise)
 {
     const PixelFormat pfmt = PixelFormatFromString(pix_fmt);
 
@@ -50,6 +52,11 @@ TestVideo::TestVideo(size_t w, size_t h, size_t n, std::string pix_fmt)
         streams.push_back(stream_info);
         size_bytes += w*h*(pfmt.bpp)/8;
     }
+
+    if(static_noise) {
+        static_frame.resize(size_bytes);
+        setRandomData(static_frame.data(), size_bytes);
+    }
 }
 
 TestVideo::~TestVideo()
@@ -84,7 +91,11 @@ const std::vector<StreamInfo>& TestVideo::Streams() const
 //! Implement VideoInput::GrabNext()
 bool TestVideo::GrabNext( unsigned char* image, bool /*wait*/ )
 {
-    setRandomData(image, size_bytes);
+    if(static_frame.empty()) {
+        setRandomData(image, size_bytes);
+    }else{
+        std::memcpy(image, static_frame.data(), size_bytes);
+    }
     return true;
 }
 
@@ -110,7 +121,8 @@ PANGOLIN_REGISTER_FACTORY(TestVideo)
             return {{
                 {"size","640x480","Image dimension"},
                 {"n","1","Number of streams"},
-                {"fmt","RGB24","Pixel format: see pixel format help for all possible values"}
+                {"fmt","RGB24","Pixel format: see pixel format help for all possible values"},
+                {"static","false","Generate noise once and repeat it in every frame"}
             }};
         }
         std::unique_ptr<VideoInterface> Open(const Uri& uri) override {
@@ -118,7 +130,8 @@ PANGOLIN_REGISTER_FACTORY(TestVideo)
             const ImageDim dim = reader.Get<ImageDim>("size");
             const int n = reader.Get<int>("n");
             std::string fmt  = reader.Get<std::string>("fmt");
-            return std::unique_ptr<VideoInterface>(new TestVideo(dim.x,dim.y,n,fmt));
+            const bool static_noise = reader.Get<bool>("static");
+            return std::unique_ptr<VideoInterface>(new TestVideo(dim.x,dim.y,n,fmt,static_noise));
         }
     };
 
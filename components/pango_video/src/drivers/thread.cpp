@@ -48,7 +48,8 @@ const uint64_t grab_fail_thread_sleep_us = 1000;
 const uint64_t capture_timout_ms = 5000;
 
 ThreadVideo::ThreadVideo(std::unique_ptr<VideoInterface> &src_, size_t num_buffers, const std::string& name)
-    : src(std::move(src_)), quit_grab_thread(true), thread_name(name)
+    : src(std::move(src_)), quit_grab_thread(true), thread_name(name),
+      lease_owner(std::make_shared<VideoLeaseOwner>())
 {
     if(!src) {
         throw VideoException("ThreadVideo: VideoInterface in must not be null");
@@ -65,6 +66,8 @@ ThreadVideo::ThreadVideo(std::unique_ptr<VideoInterface> &src_, size_t num_buffe
 
 ThreadVideo::~ThreadVideo()
 {
+    // Outstanding leases free their buffers instead of returning them
+    lease_owner->Release();
     Stop();
 
     src.reset();
@@ -124,6 +127,27 @@ bool ThreadVideo::DropNFrames(uint32_t n)
     return queue.DropNFrames(n);
 }
 
+bool ThreadVideo::WaitForFrame(bool wait, const char* caller)
+{
+    if(queue.AvailableFrames() == 0) {
+        if(!wait || quit_grab_thread) {
+            // No frames available, no wait, simply return false.
+            DBGPRINT("%s no available frames no wait.", caller);
+            return false;
+        }
+
+        // Must return a frame so block on notification from grab thread.
+        std::unique_lock<std::mutex> lk(cvMtx);
+        DBGPRINT("%s no available frames wait for notification.", caller);
+        if(cv.wait_for(lk, std::chrono::milliseconds(capture_timout_ms)) == std::cv_status::timeout)
+        {
+            pango_print_warn("ThreadVideo: %s blocking read for frames reached timeout.\n", caller);
+            return false;
+        }
+    }
+    return true;
+}
+
 //! Implement VideoInput::GrabNext()
 bool ThreadVideo::GrabNext( unsigned char* image, bool wait )
 {
@@ -133,76 +157,86 @@ bool ThreadVideo::GrabNext( unsigned char* image, bool wait )
        pango_print_warn("Thread %s(%12p) has run out of %d buffers\n", thread_name.c_str(), this, (int)queue.AvailableFrames());
     }
 
-    if(queue.AvailableFrames() == 0 && !wait) {
-        // No frames available, no wait, simply return false.
-        DBGPRINT("GrabNext no available frames no wait.");
+    if(!WaitForFrame(wait, "GrabNext")) {
         return false;
-    }else{
-        if(queue.AvailableFrames() == 0 && wait) {
-            if (quit_grab_thread)
-            {
-                return false;
-            }
-            // Must return a frame so block on notification from grab thread.
-            std::unique_lock<std::mutex> lk(cvMtx);
-            DBGPRINT("GrabNext no available frames wait for notification.");
-            if(cv.wait_for(lk, std::chrono::milliseconds(capture_timout_ms)) == std::cv_status::timeout)
-            {
-                pango_print_warn("ThreadVideo: GrabNext blocking read for frames reached timeout.\n");
-                return false;
-            }
-        }
-
-        // At least one valid frame in queue, return it.
-        GrabResult grab = queue.getNext();
-        if(grab.return_status) {
-            DBGPRINT("GrabNext at least one frame available.");
-            const size_t buffer_size = videoin[0]->SizeBytes();
-            std::memcpy(image, grab.buffer.get(), buffer_size);
-            frame_properties = grab.frame_properties;
-        }else{
-            DBGPRINT("GrabNext returned false")
-        }
-        queue.returnOrAddUsedBuffer(std::move(grab));
+    }
 
-        TGRABANDPRINT("GrabNext took")
-        return grab.return_status;
+    // At least one valid frame in queue, return it.
+    GrabResult grab = queue.getNext();
+    const bool success = grab.return_status;
+    if(success) {
+        DBGPRINT("GrabNext at least one frame available.");
+        std::memcpy(image, grab.buffer.get(), videoin[0]->SizeBytes());
+        frame_properties = grab.frame_properties;
+    }else{
+        DBGPRINT("GrabNext returned false")
     }
+    queue.returnOrAddUsedBuffer(std::move(grab));
+
+    TGRABANDPRINT("GrabNext took")
+    return success;
 }
 
 //! Implement VideoInput::GrabNewest()
 bool ThreadVideo::GrabNewest( unsigned char* image, bool wait )
 {
     TSTART()
-    if(queue.AvailableFrames() == 0 && !wait) {
-        // No frames available, no wait, simply return false.
-        DBGPRINT("GrabNext no available frames no wait.");
+
+    if(!WaitForFrame(wait, "GrabNewest")) {
         return false;
-    }else{
-        if(queue.AvailableFrames() == 0 && wait) {
-            // Must return a frame so block on notification from grab thread.
-            std::unique_lock<std::mutex> lk(cvMtx);
-            DBGPRINT("GrabNewest no available frames wait for notification.");
-            if(cv.wait_for(lk, std::chrono::milliseconds(capture_timout_ms)) == std::cv_status::timeout)
-            {
-                pango_print_warn("ThreadVideo: GrabNewest blocking read for frames reached timeout.\n");
-                return false;
-            }
-        }
+    }
 
-        // At least one valid frame in queue, return it.
-        DBGPRINT("GrabNewest at least one frame available.");
-        GrabResult grab = queue.getNewest();
-        const bool success = grab.return_status;
-        if(success) {
-            std::memcpy(image, grab.buffer.get(), videoin[0]->SizeBytes());
-            frame_properties = grab.frame_properties;
-        }
+    // At least one valid frame in queue, return it.
+    DBGPRINT("GrabNewest at least one frame available.");
+    GrabResult grab = queue.getNewest();
+    const bool success = grab.return_status;
+    if(success) {
+        std::memcpy(image, grab.buffer.get(), videoin[0]->SizeBytes());
+        frame_properties = grab.frame_properties;
+    }
+    queue.returnOrAddUsedBuffer(std::move(grab));
+    TGRABANDPRINT("GrabNewest memcpy of available frame took")
+
+    return success;
+}
+
+VideoFrameLease ThreadVideo::LeaseGrabResult(GrabResult&& grab)
+{
+    if(!grab.return_status) {
         queue.returnOrAddUsedBuffer(std::move(grab));
-        TGRABANDPRINT("GrabNewest memcpy of available frame took")
+        return nullptr;
+    }
 
-        return success;
+    frame_properties = grab.frame_properties;
+
+    // Buffer goes back to the queue's free list once the lease is released
+    auto held = std::make_shared<GrabResult>(std::move(grab));
+    std::shared_ptr<VideoLeaseOwner> owner = lease_owner;
+    return VideoFrameLease(held->buffer.get(), [this, owner, held](unsigned char*){
+        owner->IfAlive([&](){ queue.returnOrAddUsedBuffer(std::move(*held)); });
+    });
+}
+
+//! Implement VideoLeaseInterface::LeaseNext()
+VideoFrameLease ThreadVideo::LeaseNext( bool wait )
+{
+    if(queue.EmptyBuffers() == 0) {
+       pango_print_warn("Thread %s(%12p) has run out of %d buffers\n", thread_name.c_str(), this, (int)queue.AvailableFrames());
+    }
+
+    if(!WaitForFrame(wait, "LeaseNext")) {
+        return nullptr;
+    }
+    return LeaseGrabResult(queue.getNext());
+}
+
+//! Implement VideoLeaseInterface::LeaseNewest()
+VideoFrameLease ThreadVideo::LeaseNewest( bool wait )
+{
+    if(!WaitForFrame(wait, "LeaseNewest")) {
+        return nullptr;
     }
+    return LeaseGrabResult(queue.getNewest());
 }
 
 void ThreadVideo::operator()()
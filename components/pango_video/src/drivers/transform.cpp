@@ -30,6 +30,7 @@
 #include <pangolin/video/iostream_operators.h>
 #include <pangolin/video/video.h>
 
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 
@@ -38,7 +39,7 @@ namespace pangolin
 
 
 TransformVideo::TransformVideo(std::unique_ptr<VideoInterface>& src, const std::vector<TransformOptions>& flips)
-    : videoin(std::move(src)), flips(flips), size_bytes(0),buffer(0)
+    : videoin(std::move(src)), flips(flips), size_bytes(0),buffer(0), in_place(true)
 {
     if(!videoin) {
         throw VideoException("TransformVideo: VideoInterface in must not be null");
@@ -59,6 +60,7 @@ TransformVideo::TransformVideo(std::unique_ptr<VideoInterface>& src, const std::
             case TransformOptions::RotateCW:
             case TransformOptions::RotateCCW:
 
+            in_place = false;
             unsigned char*ptr=videoin->Streams()[i].Offset();
             size_t w=videoin->Streams()[i].Height();
             size_t h=videoin->Streams()[i].Width();
@@ -70,6 +72,8 @@ TransformVideo::TransformVideo(std::unique_ptr<VideoInterface>& src, const std::
 
     size_bytes = videoin->SizeBytes();
     buffer = new unsigned char[size_bytes];
+    input_pool.Reset(videoin->SizeBytes());
+    output_pool.Reset(size_bytes);
 }
 
 TransformVideo::~TransformVideo()
@@ -171,7 +175,8 @@ void TiledFlipX(Image<unsigned char>& img_out, const Image<unsigned char>& img_i
             for(size_t y = 0; y < yspan; y++)
                 memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
 
-            for(size_t y = 0; y < TSZ; y++)
+            // Only rows read from the image are written back
+            for(size_t y = 0; y < yspan; y++)
                 for(size_t x = 0; x < TSZ / 2; x++)
                     ChainSwap2(d[y][x], d[y][TSZ - 1 - x]);
 
@@ -205,7 +210,9 @@ void TiledRotate180(Image<unsigned char>& img_out, const Image<unsigned char>& i
             for(size_t y = 0; y < yspan; y++)
                 memcpy(d[y], img_in.RowPtr(yin + y) + xin * BPP, xspan * BPP);
 
-            for(size_t y = 0; y < TSZ / 2; y++)
+            // Only rows read from the image are written back, so short
+            // tiles (e.g. bands of rows) need fewer swaps
+            for(size_t y = 0; y < std::min(yspan, TSZ / 2); y++)
                 for(size_t x = 0; x < TSZ; x++)
                     ChainSwap2(d[y][x], d[TSZ - 1 - y][TSZ - 1 - x]);
 
@@ -435,43 +442,119 @@ void RotateCCW(Image<unsigned char>& img_out, const Image<unsigned char>& img_in
     }
 }
 
+template <size_t BPP>
+void ReverseRow(unsigned char* row, size_t w)
+{
+    typedef struct
+    {
+        unsigned char d[BPP];
+    } T;
+    std::reverse((T*)row, (T*)row + w);
+}
 
-void TransformVideo::Process(unsigned char* buffer_out, const unsigned char* buffer_in)
+void ReversePixels(unsigned char* row, size_t w, size_t bytes_per_pixel)
 {
+    if(bytes_per_pixel == 1)
+        ReverseRow<1>(row, w);
+    else if(bytes_per_pixel == 2)
+        ReverseRow<2>(row, w);
+    else if(bytes_per_pixel == 3)
+        ReverseRow<3>(row, w);
+    else if(bytes_per_pixel == 4)
+        ReverseRow<4>(row, w);
+    else if(bytes_per_pixel == 6)
+        ReverseRow<6>(row, w);
+    else {
+        for(size_t x = 0; x < w / 2; ++x) {
+            unsigned char* a = row + x * bytes_per_pixel;
+            std::swap_ranges(a, a + bytes_per_pixel, row + (w - 1 - x) * bytes_per_pixel);
+        }
+    }
+}
 
+void FlipInPlace(Image<unsigned char>& img, size_t bytes_per_pixel, bool flip_x, bool flip_y)
+{
+    const size_t row_bytes = img.w * bytes_per_pixel;
+
+    if(flip_y) {
+        for(size_t y = 0; y < img.h / 2; ++y) {
+            unsigned char* row = img.RowPtr(y);
+            std::swap_ranges(row, row + row_bytes, img.RowPtr(img.h - 1 - y));
+        }
+    }
+
+    if(flip_x) {
+        for(size_t y = 0; y < img.h; ++y) {
+            ReversePixels(img.RowPtr(y), img.w, bytes_per_pixel);
+        }
+    }
+}
+
+void TransformVideo::ProcessRows(size_t s, Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+{
+    const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+
+    switch (flips[s]) {
+    case TransformOptions::FlipX:
+        FlipX(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::FlipY:
+        FlipY(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::FlipXY:
+        FlipXY(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::RotateCW:
+        RotateCW(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::RotateCCW:
+        RotateCCW(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::Transpose:
+        Transpose(img_out, img_in, bytes_per_pixel);
+        break;
+    case TransformOptions::None:
+        PitchedImageCopy(img_out, img_in, bytes_per_pixel);
+        break;
+    default:
+        pango_print_warn("TransformVideo::Process(): Invalid enum %i.\n", int(flips[s]));
+        break;
+    }
+}
+
+bool TransformVideo::SupportsRowProcessing() const
+{
+    // Rotations and transposes map rows to columns
+    return in_place;
+}
+
+std::pair<size_t,size_t> TransformVideo::InputRows(size_t s, size_t out_y0, size_t out_y1) const
+{
+    if(flips[s] == TransformOptions::FlipY || flips[s] == TransformOptions::FlipXY) {
+        const size_t h = streams[s].Height();
+        return {h - out_y1, h - out_y0};
+    }
+    return {out_y0, out_y1};
+}
+
+void TransformVideo::Process(unsigned char* buffer_out, const unsigned char* buffer_in)
+{
     for(size_t s=0; s<streams.size(); ++s) {
         Image<unsigned char> img_out = Streams()[s].StreamImage(buffer_out);
         const Image<unsigned char> img_in  = videoin->Streams()[s].StreamImage(buffer_in);
-        const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
-
-        switch (flips[s]) {
-        case TransformOptions::FlipX:
-            FlipX(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::FlipY:
-            FlipY(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::FlipXY:
-            FlipXY(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::RotateCW:
-            RotateCW(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::RotateCCW:
-            RotateCCW(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::Transpose:
-            Transpose(img_out, img_in, bytes_per_pixel);
-            break;
-        case TransformOptions::None:
-            PitchedImageCopy(img_out, img_in, bytes_per_pixel);
-            break;
-        default:
-            pango_print_warn("TransformVideo::Process(): Invalid enum %i.\n", int(flips[s]));
-            break;
-        }
+        ProcessRows(s, img_out, img_in);
     }
+}
 
+void TransformVideo::ProcessInPlace(unsigned char* image)
+{
+    for(size_t s=0; s<streams.size(); ++s) {
+        Image<unsigned char> img = Streams()[s].StreamImage(image);
+        const size_t bytes_per_pixel = Streams()[s].PixFormat().bpp / 8;
+        const bool flip_x = flips[s] == TransformOptions::FlipX || flips[s] == TransformOptions::FlipXY;
+        const bool flip_y = flips[s] == TransformOptions::FlipY || flips[s] == TransformOptions::FlipXY;
+        FlipInPlace(img, bytes_per_pixel, flip_x, flip_y);
+    }
 }
 
 //! Implement VideoInput::GrabNext()
@@ -496,6 +579,34 @@ bool TransformVideo::GrabNewest( unsigned char* image, bool wait )
     }
 }
 
+VideoFrameLease TransformVideo::ProcessLease(VideoFrameLease&& in)
+{
+    if(!in) {
+        return nullptr;
+    }
+
+    if(in_place && in.use_count() == 1) {
+        ProcessInPlace(in.get());
+        return std::move(in);
+    }
+
+    VideoFrameLease out = output_pool.Lease();
+    Process(out.get(), in.get());
+    return out;
+}
+
+//! Implement VideoLeaseInterface::LeaseNext()
+VideoFrameLease TransformVideo::LeaseNext( bool wait )
+{
+    return ProcessLease(LeaseNextFrame(*videoin, input_pool, wait));
+}
+
+//! Implement VideoLeaseInterface::LeaseNewest()
+VideoFrameLease TransformVideo::LeaseNewest( bool wait )
+{
+    return ProcessLease(LeaseNewestFrame(*videoin, input_pool, wait));
+}
+
 std::vector<VideoInterface*>& TransformVideo::InputStreams()
 {
     return inputs;
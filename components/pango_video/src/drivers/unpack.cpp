@@ -157,37 +157,41 @@ void ConvertFrom12bit(
     }
 }
 
+void UnpackVideo::ProcessRows(size_t s, Image<unsigned char>& img_out, const Image<unsigned char>& img_in)
+{
+    const int bits_in  = videoin[0]->Streams()[s].PixFormat().bpp;
+
+    if(Streams()[s].PixFormat().format == "GRAY32F") {
+        if( bits_in == 8) {
+            ConvertFrom8bit<float>(img_out, img_in);
+        }else if( bits_in == 10) {
+            ConvertFrom10bit<float>(img_out, img_in);
+        }else if( bits_in == 12){
+            ConvertFrom12bit<float>(img_out, img_in);
+        }else{
+            throw pangolin::VideoException("Unsupported bitdepths.");
+        }
+    }else if(Streams()[s].PixFormat().format == "GRAY16LE") {
+        if( bits_in == 8) {
+            ConvertFrom8bit<uint16_t>(img_out, img_in);
+        }else if( bits_in == 10) {
+            ConvertFrom10bit<uint16_t>(img_out, img_in);
+        }else if( bits_in == 12){
+            ConvertFrom12bit<uint16_t>(img_out, img_in);
+        }else{
+            throw pangolin::VideoException("Unsupported bitdepths.");
+        }
+    }else{
+    }
+}
+
 void UnpackVideo::Process(unsigned char* image, const unsigned char* buffer)
 {
     TSTART()
     for(size_t s=0; s<streams.size(); ++s) {
         const Image<unsigned char> img_in  = videoin[0]->Streams()[s].StreamImage(buffer);
         Image<unsigned char> img_out = Streams()[s].StreamImage(image);
-
-        const int bits_in  = videoin[0]->Streams()[s].PixFormat().bpp;
-
-        if(Streams()[s].PixFormat().format == "GRAY32F") {
-            if( bits_in == 8) {
-                ConvertFrom8bit<float>(img_out, img_in);
-            }else if( bits_in == 10) {
-                ConvertFrom10bit<float>(img_out, img_in);
-            }else if( bits_in == 12){
-                ConvertFrom12bit<float>(img_out, img_in);
-            }else{
-                throw pangolin::VideoException("Unsupported bitdepths.");
-            }
-        }else if(Streams()[s].PixFormat().format == "GRAY16LE") {
-            if( bits_in == 8) {
-                ConvertFrom8bit<uint16_t>(img_out, img_in);
-            }else if( bits_in == 10) {
-                ConvertFrom10bit<uint16_t>(img_out, img_in);
-            }else if( bits_in == 12){
-                ConvertFrom12bit<uint16_t>(img_out, img_in);
-            }else{
-                throw pangolin::VideoException("Unsupported bitdepths.");
-            }
-        }else{
-        }
+        ProcessRows(s, img_out, img_in);
     }
     TGRABANDPRINT("Unpacking took ")
 }
@@ -78,7 +78,8 @@ inline std::string V4lToString(int32_t v)
 }
 
 V4lVideo::V4lVideo(const char* dev_name, uint32_t period, io_method io, unsigned iwidth, unsigned iheight, unsigned v4l_format)
-    : io(io), fd(-1), buffers(0), n_buffers(0), running(false), period(period)
+    : io(io), fd(-1), buffers(0), n_buffers(0), running(false), stream_generation(0), period(period),
+      lease_owner(std::make_shared<VideoLeaseOwner>())
 {
     open_device(dev_name);
     init_device(dev_name,iwidth,iheight,0,v4l_format);
@@ -89,10 +90,10 @@ V4lVideo::V4lVideo(const char* dev_name, uint32_t period, io_method io, unsigned
 
 V4lVideo::~V4lVideo()
 {
-    if(running)
-    {
-        Stop();
-    }
+    // Buffers are unmapped below, so outstanding leases mustn't requeue them
+    lease_owner->Release();
+
+    Stop();
 
     uninit_device();
     close_device();
@@ -114,7 +115,7 @@ size_t V4lVideo::SizeBytes() const
     return image_size;
 }
 
-bool V4lVideo::GrabNext( unsigned char* image, bool wait )
+bool V4lVideo::WaitForFrame(const std::function<int()>& read_frame)
 {
     for (;;) {
         fd_set fds;
@@ -144,7 +145,7 @@ bool V4lVideo::GrabNext( unsigned char* image, bool wait )
             return false;
         }
 
-        if (ReadFrame(image, wait))
+        if (read_frame())
             break;
 
         /* EAGAIN - continue select loop. */
@@ -153,16 +154,84 @@ bool V4lVideo::GrabNext( unsigned char* image, bool wait )
     return true;
 }
 
+bool V4lVideo::GrabNext( unsigned char* image, bool wait )
+{
+    return WaitForFrame([&](){ return ReadFrame(image, wait); });
+}
+
 bool V4lVideo::GrabNewest( unsigned char* image, bool wait )
 {
     // TODO: Implement
     return GrabNext(image,wait);
 }
 
+VideoFrameLease V4lVideo::LeaseNext( bool wait )
+{
+    VideoFrameLease lease;
+    WaitForFrame([&](){ return LeaseFrame(lease, wait); });
+    return lease;
+}
+
+VideoFrameLease V4lVideo::LeaseNewest( bool wait )
+{
+    VideoFrameLease lease = LeaseNext(wait);
+    if (lease && io != IO_METHOD_READ) {
+        // Swap for any newer frames already captured. Each superseded lease
+        // queues its buffer for capture again as it is replaced.
+        VideoFrameLease newer;
+        while (LeaseFrame(newer, false)) {
+            lease = std::move(newer);
+        }
+    }
+    return lease;
+}
+
+int V4lVideo::DequeueBuffer(v4l2_buffer& buf, bool wait)
+{
+    CLEAR (buf);
+
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = (io == IO_METHOD_MMAP) ? V4L2_MEMORY_MMAP : V4L2_MEMORY_USERPTR;
+
+    if (-1 == xioctl (fd, VIDIOC_DQBUF, &buf)) {
+        // Sleep for one period if wait is specified
+        if (wait && io == IO_METHOD_MMAP) {
+          std::this_thread::sleep_for(std::chrono::microseconds(period));
+        }
+        switch (errno) {
+        case EAGAIN:
+            return 0;
+
+        case EIO:
+            /* Could ignore EIO, see spec. */
+
+            /* fall through */
+
+        default:
+            throw VideoException("VIDIOC_DQBUF", strerror(errno));
+        }
+    }
+    // This is a hack, this ts sould come from the device.
+    frame_properties[PANGO_HOST_RECEPTION_TIME_US] = picojson::value(pangolin::Time_us(pangolin::TimeNow()));
+
+    if (io == IO_METHOD_MMAP) {
+        assert (buf.index < n_buffers);
+    }else{
+        unsigned int i;
+        for (i = 0; i < n_buffers; ++i)
+            if (buf.m.userptr == (unsigned long) buffers[i].start
+                    && buf.length == buffers[i].length)
+                break;
+
+        assert (i < n_buffers);
+    }
+
+    return 1;
+}
+
 int V4lVideo::ReadFrame(unsigned char* image, bool wait)
 {
     struct v4l2_buffer buf;
-    unsigned int i;
 
     switch (io) {
     case IO_METHOD_READ:
@@ -189,77 +258,24 @@ int V4lVideo::ReadFrame(unsigned char* image, bool wait)
         break;
 
     case IO_METHOD_MMAP:
-        CLEAR (buf);
-
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-
-        if (-1 == xioctl (fd, VIDIOC_DQBUF, &buf)) {
-            // Sleep for one period if wait is specified
-            if (wait) {
-              std::this_thread::sleep_for(std::chrono::microseconds(period));
-            }
-            switch (errno) {
-            case EAGAIN:
-                return 0;
-
-            case EIO:
-                /* Could ignore EIO, see spec. */
-
-                /* fall through */
-
-            default:
-                throw VideoException("VIDIOC_DQBUF", strerror(errno));
-            }
-        }
-        // This is a hack, this ts sould come from the device.
-        frame_properties[PANGO_HOST_RECEPTION_TIME_US] = picojson::value(pangolin::Time_us(pangolin::TimeNow()));
-
-        assert (buf.index < n_buffers);
+        if (!DequeueBuffer(buf, wait))
+            return 0;
 
         //            process_image (buffers[buf.index].start);
         memcpy(image,buffers[buf.index].start,buffers[buf.index].length);
 
-
         if (-1 == xioctl (fd, VIDIOC_QBUF, &buf))
             throw VideoException("VIDIOC_QBUF", strerror(errno));
 
         break;
 
     case IO_METHOD_USERPTR:
-        CLEAR (buf);
-
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_USERPTR;
-
-        if (-1 == xioctl (fd, VIDIOC_DQBUF, &buf)) {
-            switch (errno) {
-            case EAGAIN:
-                return 0;
-
-            case EIO:
-                /* Could ignore EIO, see spec. */
-
-                /* fall through */
-
-            default:
-                throw VideoException("VIDIOC_DQBUF", strerror(errno));
-            }
-        }
-        // This is a hack, this ts sould come from the device.
-        frame_properties[PANGO_HOST_RECEPTION_TIME_US] = picojson::value(pangolin::Time_us(pangolin::TimeNow()));
-
-        for (i = 0; i < n_buffers; ++i)
-            if (buf.m.userptr == (unsigned long) buffers[i].start
-                    && buf.length == buffers[i].length)
-                break;
-
-        assert (i < n_buffers);
+        if (!DequeueBuffer(buf, wait))
+            return 0;
 
         //            process_image ((void *) buf.m.userptr);
         memcpy(image,(void *)buf.m.userptr,buf.length);
 
-
         if (-1 == xioctl (fd, VIDIOC_QBUF, &buf))
             throw VideoException("VIDIOC_QBUF", strerror(errno));
 
@@ -269,8 +285,48 @@ int V4lVideo::ReadFrame(unsigned char* image, bool wait)
     return 1;
 }
 
+int V4lVideo::LeaseFrame(VideoFrameLease& lease, bool wait)
+{
+    if (io == IO_METHOD_READ) {
+        // read() needs a destination anyway, so lend a pooled copy
+        lease = frame_pool.Lease();
+        if (!ReadFrame(lease.get(), wait)) {
+            lease.reset();
+            return 0;
+        }
+        return 1;
+    }
+
+    struct v4l2_buffer buf;
+    if (!DequeueBuffer(buf, wait))
+        return 0;
+
+    unsigned char* ptr = (io == IO_METHOD_MMAP) ?
+        (unsigned char*)buffers[buf.index].start : (unsigned char*)buf.m.userptr;
+
+    // Queue the buffer for capture again once the lease is released, unless
+    // streaming has since been restarted, which queues every buffer anyway.
+    std::shared_ptr<VideoLeaseOwner> owner = lease_owner;
+    unsigned generation;
+    {
+        std::lock_guard<std::mutex> l(stream_lock);
+        generation = stream_generation;
+    }
+    lease = VideoFrameLease(ptr, [this, owner, buf, generation](unsigned char*){
+        owner->IfAlive([&](){
+            std::lock_guard<std::mutex> l(stream_lock);
+            struct v4l2_buffer requeue = buf;
+            if (running && generation == stream_generation && -1 == xioctl (fd, VIDIOC_QBUF, &requeue)) {
+                pango_print_warn("V4lVideo: VIDIOC_QBUF error releasing lease: %s\n", strerror(errno));
+            }
+        });
+    });
+    return 1;
+}
+
 void V4lVideo::Stop()
 {
+    std::lock_guard<std::mutex> l(stream_lock);
     if(running) {
         enum v4l2_buf_type type;
 
@@ -298,6 +354,7 @@ void V4lVideo::Stop()
 
 void V4lVideo::Start()
 {
+    std::lock_guard<std::mutex> l(stream_lock);
     if(!running) {
         unsigned int i;
         enum v4l2_buf_type type;
@@ -352,6 +409,7 @@ void V4lVideo::Start()
             break;
         }
 
+        ++stream_generation;
         running = true;
     }
 }
@@ -583,6 +641,7 @@ void V4lVideo::init_device(const char* dev_name, unsigned iwidth, unsigned iheig
     width = fmt.fmt.pix.width;
     height = fmt.fmt.pix.height;
     image_size = fmt.fmt.pix.sizeimage;
+    frame_pool.Reset(image_size);
 
     if(ifps!=0)
     {
@@ -38,24 +38,27 @@ inline EncoderDetails EncoderDetailsFromString(const std::string& encoder_spec)
     return { encoder_name, NameToImageFileType(encoder_name), quality};
 }
 
-ImageEncoderFunc StreamEncoderFactory::GetEncoder(const std::string& encoder_spec, const PixelFormat& fmt)
+ImageEncoderFunc StreamEncoderFactory::GetEncoder(const std::string& encoder_spec, const PixelFormat& fmt, size_t num_threads)
 {
     const EncoderDetails encdet = EncoderDetailsFromString(encoder_spec);
     if(encdet.file_type == ImageFileTypeUnknown)
         throw std::invalid_argument("Unsupported encoder format: " + encoder_spec);
 
-    return [fmt,encdet](std::ostream& os, const Image<unsigned char>& img){
-        SaveImage(img,fmt,os,encdet.file_type,true,encdet.quality);
+    std::shared_ptr<ImageEncoder> encoder = CreateImageEncoder(encdet.file_type, fmt, encdet.quality, num_threads);
+    return [encoder](std::ostream& os, const Image<unsigned char>& img){
+        encoder->Encode(os, img);
     };
 }
 
-ImageDecoderFunc StreamEncoderFactory::GetDecoder(const std::string& encoder_spec, const PixelFormat& fmt)
+ImageDecoderFunc StreamEncoderFactory::GetDecoder(const std::string& encoder_spec, const PixelFormat& fmt, size_t num_threads)
 {
+    PANGOLIN_UNUSED(fmt);
     const EncoderDetails encdet = EncoderDetailsFromString(encoder_spec);
     PANGO_ENSURE(encdet.file_type != ImageFileTypeUnknown);
 
-    return [fmt,encdet](std::istream& is){
-        return LoadImage(is,encdet.file_type);
+    std::shared_ptr<ImageDecoder> decoder = CreateImageDecoder(encdet.file_type, num_threads);
+    return [decoder](std::istream& is){
+        return decoder->Decode(is);
     };
 }
 
@@ -0,0 +1,101 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/video/video_frame_pool.h>
+
+namespace pangolin
+{
+
+VideoFramePool::VideoFramePool(size_t frame_bytes)
+    : frame_bytes(frame_bytes), free_list(std::make_shared<FreeList>())
+{
+}
+
+void VideoFramePool::Reset(size_t bytes)
+{
+    frame_bytes = bytes;
+    free_list = std::make_shared<FreeList>();
+}
+
+VideoFrameLease VideoFramePool::Lease()
+{
+    std::unique_ptr<unsigned char[]> buffer;
+    {
+        std::lock_guard<std::mutex> l(free_list->lock);
+        if(!free_list->buffers.empty()) {
+            buffer = std::move(free_list->buffers.back());
+            free_list->buffers.pop_back();
+        }
+    }
+    if(!buffer) {
+        buffer.reset(new unsigned char[frame_bytes]);
+    }
+
+    // The free list outlives the pool until every lease has been released
+    std::shared_ptr<FreeList> list = free_list;
+    return VideoFrameLease(buffer.release(), [list](unsigned char* b){
+        std::lock_guard<std::mutex> l(list->lock);
+        list->buffers.emplace_back(b);
+    });
+}
+
+VideoFrameLease LeaseNextFrame(VideoInterface& video, VideoFramePool& pool, bool wait)
+{
+    VideoLeaseInterface* leaser = dynamic_cast<VideoLeaseInterface*>(&video);
+    if(leaser) {
+        return leaser->LeaseNext(wait);
+    }
+
+    VideoFrameLease lease = pool.Lease();
+    return video.GrabNext(lease.get(), wait) ? lease : nullptr;
+}
+
+VideoFrameLease LeaseNewestFrame(VideoInterface& video, VideoFramePool& pool, bool wait)
+{
+    VideoLeaseInterface* leaser = dynamic_cast<VideoLeaseInterface*>(&video);
+    if(leaser) {
+        return leaser->LeaseNewest(wait);
+    }
+
+    VideoFrameLease lease = pool.Lease();
+    return video.GrabNewest(lease.get(), wait) ? lease : nullptr;
+}
+
+bool SupportsLeasing(VideoInterface& video)
+{
+    if(!dynamic_cast<VideoLeaseInterface*>(&video)) {
+        return false;
+    }
+
+    VideoFilterInterface* filter = dynamic_cast<VideoFilterInterface*>(&video);
+    if(filter) {
+        for(VideoInterface* input : filter->InputStreams()) {
+            if(!SupportsLeasing(*input)) return false;
+        }
+    }
+    return true;
+}
+
+}
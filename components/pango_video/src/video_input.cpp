@@ -32,14 +32,16 @@ namespace pangolin
 {
 
 VideoInput::VideoInput()
-    : frame_num(0), record_frame_skip(1), record_once(false), record_continuous(false)
+    : frame_num(0), record_frame_skip(1), record_once(false), record_continuous(false),
+      record_queue_frames(0), record_queue_policy(VideoOutputQueue::Policy::Block)
 {
 }
 
 VideoInput::VideoInput(
     const std::string& input_uri,
     const std::string& output_uri
-    ) : frame_num(0), record_frame_skip(1), record_once(false), record_continuous(false)
+    ) : frame_num(0), record_frame_skip(1), record_once(false), record_continuous(false),
+      record_queue_frames(0), record_queue_policy(VideoOutputQueue::Policy::Block)
 {
     Open(input_uri, output_uri);
 }
@@ -62,6 +64,7 @@ void VideoInput::Open(
 
     // Reset state
     frame_num = 0;
+    frame_pool.Reset(video_src->SizeBytes());
     videos.resize(1);
     videos[0] = video_src.get();
 }
@@ -120,6 +123,10 @@ void VideoInput::InitialiseRecorder()
         video_src->Streams(), uri_input.full_uri,
         GetVideoDeviceProperties(video_src.get())
     );
+
+    if(record_queue_frames) {
+        video_recorder.reset(new VideoOutputQueue(std::move(video_recorder), record_queue_frames, record_queue_policy));
+    }
 }
 
 void VideoInput::Record()
@@ -206,6 +213,43 @@ bool VideoInput::GrabNewest( unsigned char* image, bool wait )
     return success;
 }
 
+VideoFrameLease VideoInput::RecordLease(VideoFrameLease&& frame, bool should_record)
+{
+    if( should_record && video_recorder != 0 && frame) {
+        video_recorder->WriteStreams(frame.get(), GetVideoFrameProperties(video_src.get()) );
+        record_once = false;
+    }
+    return std::move(frame);
+}
+
+VideoFrameLease VideoInput::LeaseNext( bool wait )
+{
+    frame_num++;
+
+    const bool should_record = (record_continuous && !(frame_num % record_frame_skip)) || record_once;
+    return RecordLease(LeaseNextFrame(*video_src, frame_pool, wait), should_record);
+}
+
+VideoFrameLease VideoInput::LeaseNewest( bool wait )
+{
+    frame_num++;
+
+    const bool should_record = (record_continuous && !(frame_num % record_frame_skip)) || record_once;
+    return RecordLease(LeaseNewestFrame(*video_src, frame_pool, wait), should_record);
+}
+
+VideoFrameLease VideoInput::LeaseNextCopy( bool wait )
+{
+    VideoFrameLease frame = frame_pool.Lease();
+    return GrabNext(frame.get(), wait) ? frame : nullptr;
+}
+
+VideoFrameLease VideoInput::LeaseNewestCopy( bool wait )
+{
+    VideoFrameLease frame = frame_pool.Lease();
+    return GrabNewest(frame.get(), wait) ? frame : nullptr;
+}
+
 void VideoInput::SetTimelapse(size_t one_in_n_frames)
 {
     record_frame_skip = one_in_n_frames;
@@ -216,5 +260,19 @@ bool VideoInput::IsRecording() const
     return video_recorder != 0;
 }
 
+void VideoInput::SetRecordQueue(size_t max_frames, VideoOutputQueue::Policy policy)
+{
+    record_queue_frames = max_frames;
+    record_queue_policy = policy;
+}
+
+VideoOutputQueue::Stats VideoInput::RecordStats() const
+{
+    if(const VideoOutputQueue* queue = dynamic_cast<const VideoOutputQueue*>(video_recorder.get())) {
+        return queue->GetStats();
+    }
+    return {0, 0, 0};
+}
+
 }
 
@@ -0,0 +1,188 @@
+/* This file is part of the Pangolin Project.
+ * http://github.com/stevenlovegrove/Pangolin
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pangolin/video/video_output_queue.h>
+#include <pangolin/video/video_exception.h>
+#include <pangolin/utils/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace pangolin
+{
+
+namespace
+{
+
+size_t FrameBytes(const std::vector<StreamInfo>& streams)
+{
+    size_t frame_bytes = 0;
+    for(const StreamInfo& s : streams) {
+        frame_bytes = std::max(frame_bytes, size_t(s.Offset()) + s.SizeBytes());
+    }
+    return frame_bytes;
+}
+
+}
+
+VideoOutputQueue::VideoOutputQueue(std::unique_ptr<VideoOutputInterface> output, size_t max_frames, Policy policy)
+    : output(std::move(output)), max_frames(std::max<size_t>(1, max_frames)), policy(policy),
+      writing(false), should_run(true), num_queued(0), num_dropped(0), num_written(0)
+{
+    if(!this->output) {
+        throw VideoException("VideoOutputQueue requires an output to write to");
+    }
+    frame_pool.Reset(FrameBytes(this->output->Streams()));
+    writer = std::thread(&VideoOutputQueue::WriterLoop, this);
+}
+
+VideoOutputQueue::~VideoOutputQueue()
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        should_run = false;
+    }
+    cond_queued.notify_all();
+    writer.join();
+
+    if(writer_error) {
+        try {
+            std::rethrow_exception(writer_error);
+        }catch(const std::exception& e) {
+            pango_print_error("Error writing queued video frames: %s\n", e.what());
+        }
+    }
+}
+
+const std::vector<StreamInfo>& VideoOutputQueue::Streams() const
+{
+    return output->Streams();
+}
+
+void VideoOutputQueue::SetStreams(const std::vector<StreamInfo>& streams, const std::string& uri, const picojson::value& properties)
+{
+    Flush();
+    output->SetStreams(streams, uri, properties);
+    frame_pool.Reset(FrameBytes(streams));
+}
+
+int VideoOutputQueue::WriteStreams(const unsigned char* data, const picojson::value& frame_properties)
+{
+    if(!frame_pool.FrameBytes()) {
+        throw VideoException("VideoOutputQueue: SetStreams must be called before WriteStreams");
+    }
+
+    // Copy before taking the lock so as not to hold up the writer
+    Frame frame = {frame_pool.Lease(), frame_properties};
+    std::memcpy(frame.data.get(), data, frame_pool.FrameBytes());
+
+    std::unique_lock<std::mutex> l(lock);
+    RethrowWriterError();
+
+    if(queue.size() >= max_frames) {
+        switch(policy) {
+        case Policy::Block:
+            cond_done.wait(l, [this](){ return queue.size() < max_frames || writer_error; });
+            RethrowWriterError();
+            break;
+        case Policy::DropOldest:
+            queue.pop_front();
+            ++num_dropped;
+            break;
+        case Policy::DropNewest:
+            ++num_dropped;
+            return -1;
+        }
+    }
+
+    queue.push_back(std::move(frame));
+    num_queued = queue.size();
+    l.unlock();
+    cond_queued.notify_one();
+    return 0;
+}
+
+bool VideoOutputQueue::IsPipe() const
+{
+    return output->IsPipe();
+}
+
+void VideoOutputQueue::Flush()
+{
+    std::unique_lock<std::mutex> l(lock);
+    cond_done.wait(l, [this](){ return queue.empty() && !writing; });
+    RethrowWriterError();
+}
+
+VideoOutputQueue::Stats VideoOutputQueue::GetStats() const
+{
+    return {num_queued, num_dropped, num_written};
+}
+
+void VideoOutputQueue::RethrowWriterError()
+{
+    if(writer_error) {
+        std::exception_ptr e = writer_error;
+        writer_error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void VideoOutputQueue::WriterLoop()
+{
+    std::unique_lock<std::mutex> l(lock);
+    while(true) {
+        cond_queued.wait(l, [this](){ return !queue.empty() || !should_run; });
+        if(queue.empty()) break;
+
+        Frame frame = std::move(queue.front());
+        queue.pop_front();
+        num_queued = queue.size();
+        writing = true;
+        l.unlock();
+
+        std::exception_ptr error;
+        try {
+            output->WriteStreams(frame.data.get(), frame.properties);
+            ++num_written;
+        }catch(...) {
+            error = std::current_exception();
+        }
+        frame.data.reset();
+
+        l.lock();
+        writing = false;
+        if(error) {
+            // Frames behind a failed write are unlikely to fare better
+            num_dropped += queue.size();
+            queue.clear();
+            num_queued = 0;
+            writer_error = error;
+        }
+        cond_done.notify_all();
+    }
+}
+
+}
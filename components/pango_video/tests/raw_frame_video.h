@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <pangolin/video/video_interface.h>
+
+// Test video which serves the same raw frame on every grab, with one stream
+// per format. Each frame is numbered in its "frame" property.
+class RawFrameVideo : public pangolin::VideoInterface, public pangolin::VideoPropertiesInterface
+{
+public:
+    // channel_bits overrides the format's bit depth if non-zero, as for
+    // 10 or 12 bit samples held in 16 bits.
+    RawFrameVideo(const std::vector<unsigned char>& frame, const char* fmt, size_t w, size_t h, unsigned channel_bits = 0)
+        : frame(frame), frame_count(0)
+    {
+        AddStreams({fmt}, w, h);
+        if(channel_bits) {
+            streams[0] = pangolin::StreamInfo(OverrideBits(streams[0].PixFormat(), channel_bits), w, h, streams[0].Pitch(), streams[0].Offset());
+        }
+    }
+
+    // Mark every grabbed frame as having a metadata line in place of row 0
+    void SetHasMetadataLine(bool has_metadata_line)
+    {
+        has_metadata = has_metadata_line;
+    }
+
+    // Frame of random samples
+    RawFrameVideo(const std::vector<const char*>& fmts, size_t w, size_t h)
+        : frame_count(0)
+    {
+        frame.resize(AddStreams(fmts, w, h));
+        std::mt19937 rng(7);
+        for(auto& b : frame) b = static_cast<unsigned char>(rng());
+    }
+
+    size_t SizeBytes() const override { return frame.size(); }
+    const std::vector<pangolin::StreamInfo>& Streams() const override { return streams; }
+    void Start() override {}
+    void Stop() override {}
+    bool GrabNext(unsigned char* image, bool) override
+    {
+        std::memcpy(image, frame.data(), frame.size());
+        frame_properties["frame"] = picojson::value(double(++frame_count));
+        if(has_metadata) {
+            frame_properties[PANGO_HAS_LINE0_METADATA] = picojson::value(true);
+        }
+        return true;
+    }
+    bool GrabNewest(unsigned char* image, bool wait) override { return GrabNext(image, wait); }
+
+    const picojson::value& DeviceProperties() const override { return device_properties; }
+    const picojson::value& FrameProperties() const override { return frame_properties; }
+
+private:
+    static pangolin::PixelFormat OverrideBits(pangolin::PixelFormat pf, unsigned channel_bits)
+    {
+        pf.channel_bit_depth = channel_bits;
+        return pf;
+    }
+
+    size_t AddStreams(const std::vector<const char*>& fmts, size_t w, size_t h)
+    {
+        size_t size_bytes = 0;
+        for(const char* fmt : fmts) {
+            const pangolin::PixelFormat pf = pangolin::PixelFormatFromString(fmt);
+            streams.push_back(pangolin::StreamInfo(pf, w, h, w * pf.bpp / 8, (unsigned char*)size_bytes));
+            size_bytes += streams.back().SizeBytes();
+        }
+        return size_bytes;
+    }
+
+    std::vector<unsigned char> frame;
+    std::vector<pangolin::StreamInfo> streams;
+    size_t frame_count;
+    bool has_metadata = false;
+    picojson::value device_properties;
+    picojson::value frame_properties;
+};
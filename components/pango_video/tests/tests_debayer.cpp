@@ -0,0 +1,215 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <pangolin/video/drivers/debayer.h>
+
+#include "raw_frame_video.h"
+
+namespace
+{
+
+// Red sample position within each 2x2 cell for RGGB, GBRG, GRBG, BGGR
+const pangolin::color_filter_t tiles[] = {
+    pangolin::DC1394_COLOR_FILTER_RGGB, pangolin::DC1394_COLOR_FILTER_GBRG,
+    pangolin::DC1394_COLOR_FILTER_GRBG, pangolin::DC1394_COLOR_FILTER_BGGR
+};
+const size_t red_x[] = {0, 0, 1, 1};
+const size_t red_y[] = {0, 1, 0, 1};
+
+// Sample rgb at each pixel according to the colour filter
+template<typename T>
+std::vector<unsigned char> Mosaic(size_t w, size_t h, size_t tile, const T rgb[3])
+{
+    std::vector<unsigned char> raw(w * h * sizeof(T));
+    T* px = reinterpret_cast<T*>(raw.data());
+    for(size_t y=0; y < h; ++y) {
+        for(size_t x=0; x < w; ++x) {
+            const bool rx = (x & 1) == red_x[tile];
+            const bool ry = (y & 1) == red_y[tile];
+            px[y*w + x] = rx && ry ? rgb[0] : (!rx && !ry ? rgb[2] : rgb[1]);
+        }
+    }
+    return raw;
+}
+
+std::vector<unsigned char> Debayer(const std::vector<unsigned char>& raw, const char* fmt, size_t w, size_t h,
+                                   pangolin::bayer_method_t method, pangolin::color_filter_t tile, size_t threads,
+                                   const pangolin::WbGains& wb = pangolin::WbGains())
+{
+    std::unique_ptr<pangolin::VideoInterface> src(new RawFrameVideo(raw, fmt, w, h));
+    pangolin::DebayerVideo video(src, {method}, tile, wb, threads);
+    std::vector<unsigned char> out(video.SizeBytes());
+    REQUIRE(video.GrabNext(out.data()));
+    return out;
+}
+
+template<typename T>
+void CheckUniformColour(const char* fmt, const T rgb[3])
+{
+    const size_t w = 37, h = 41;
+    for(size_t t=0; t < 4; ++t) {
+        const std::vector<unsigned char> raw = Mosaic<T>(w, h, t, rgb);
+        for(auto method : {pangolin::BAYER_METHOD_BILINEAR, pangolin::BAYER_METHOD_EDGESENSE}) {
+            const std::vector<unsigned char> out = Debayer(raw, fmt, w, h, method, tiles[t], 3);
+            REQUIRE(out.size() == w * h * 3 * sizeof(T));
+            const T* px = reinterpret_cast<const T*>(out.data());
+            for(size_t i=0; i < w*h; ++i) {
+                REQUIRE(px[3*i+0] == rgb[0]);
+                REQUIRE(px[3*i+1] == rgb[1]);
+                REQUIRE(px[3*i+2] == rgb[2]);
+            }
+        }
+    }
+}
+
+}
+
+TEST_CASE("Uniform colour is reconstructed exactly")
+{
+    const uint8_t rgb8[3] = {200, 100, 30};
+    CheckUniformColour<uint8_t>("GRAY8", rgb8);
+
+    const uint16_t rgb16[3] = {60000, 1234, 4095};
+    CheckUniformColour<uint16_t>("GRAY16LE", rgb16);
+}
+
+TEST_CASE("Debayered rows don't depend on the number of threads")
+{
+    const size_t w = 64, h = 203;
+    std::vector<unsigned char> raw(w * h * 2);
+    std::mt19937 rng(42);
+    for(auto& b : raw) b = static_cast<unsigned char>(rng());
+
+    for(auto method : {pangolin::BAYER_METHOD_BILINEAR, pangolin::BAYER_METHOD_EDGESENSE, pangolin::BAYER_METHOD_DOWNSAMPLE}) {
+        for(const char* fmt : {"GRAY8", "GRAY16LE"}) {
+            const size_t size = w * h * (fmt[4] == '8' ? 1 : 2);
+            const std::vector<unsigned char> in(raw.begin(), raw.begin() + size);
+            const std::vector<unsigned char> single = Debayer(in, fmt, w, h, method, tiles[1], 1);
+            REQUIRE(Debayer(in, fmt, w, h, method, tiles[1], 4) == single);
+        }
+    }
+}
+
+TEST_CASE("Bilinear interpolation of a bayer pattern")
+{
+    // 4x4 RGGB with increasing samples; check pixels against hand worked
+    // averages, including mirrored samples at the border.
+    const size_t w = 4, h = 4;
+    std::vector<unsigned char> raw(w * h);
+    for(size_t i=0; i < raw.size(); ++i) raw[i] = static_cast<unsigned char>(10 * i);
+
+    const std::vector<unsigned char> out = Debayer(raw, "GRAY8", w, h, pangolin::BAYER_METHOD_BILINEAR, tiles[0], 1);
+    auto px = [&](size_t x, size_t y, size_t c) { return out[3*(y*w + x) + c]; };
+
+    // Red site (0,0): green from (1,0),(0,1) mirrored twice, blue from (1,1)
+    REQUIRE(px(0,0,0) == 0);
+    REQUIRE(px(0,0,1) == 25);
+    REQUIRE(px(0,0,2) == 50);
+    // Green site (1,0) in a red row: red across, blue below
+    REQUIRE(px(1,0,0) == 10);
+    REQUIRE(px(1,0,1) == 10);
+    REQUIRE(px(1,0,2) == 50);
+    // Blue site (1,1): red on diagonals, green on the cross
+    REQUIRE(px(1,1,0) == 50);
+    REQUIRE(px(1,1,1) == 50);
+    REQUIRE(px(1,1,2) == 50);
+    // Green site (2,1) in a blue row: blue across, red above and below
+    REQUIRE(px(2,1,0) == 60);
+    REQUIRE(px(2,1,1) == 60);
+    REQUIRE(px(2,1,2) == 60);
+}
+
+TEST_CASE("White balance is applied to downsampled output")
+{
+    const uint8_t rgb[3] = {200, 100, 50};
+    const std::vector<unsigned char> raw = Mosaic<uint8_t>(8, 6, 3, rgb);
+    const std::vector<unsigned char> out = Debayer(raw, "GRAY8", 8, 6, pangolin::BAYER_METHOD_DOWNSAMPLE, tiles[3], 2, pangolin::WbGains(0.5f, 1.0f, 0.25f));
+    REQUIRE(out.size() == 4 * 3 * 3);
+    // Scaled values are truncated
+    for(size_t i=0; i < 12; ++i) {
+        REQUIRE(int(out[3*i+0]) == 100);
+        REQUIRE(int(out[3*i+1]) == 100);
+        REQUIRE(int(out[3*i+2]) == 12);
+    }
+}
+
+TEST_CASE("White balance gains above one saturate")
+{
+    const uint16_t rgb[3] = {65535, 40000, 1000};
+    const std::vector<unsigned char> raw = Mosaic<uint16_t>(8, 6, 0, rgb);
+    const pangolin::WbGains wb(2.0f, 1.5f, 2.5f);
+    for(auto method : {pangolin::BAYER_METHOD_BILINEAR, pangolin::BAYER_METHOD_EDGESENSE, pangolin::BAYER_METHOD_DOWNSAMPLE}) {
+        const std::vector<unsigned char> out = Debayer(raw, "GRAY16LE", 8, 6, method, tiles[0], 1, wb);
+        const uint16_t* px = reinterpret_cast<const uint16_t*>(out.data());
+        for(size_t i=0; i < out.size() / (3 * sizeof(uint16_t)); ++i) {
+            REQUIRE(px[3*i+0] == 65535);
+            REQUIRE(px[3*i+1] == 60000);
+            REQUIRE(px[3*i+2] == 2500);
+        }
+    }
+
+    const uint8_t rgb8[3] = {200, 100, 50};
+    const std::vector<unsigned char> raw8 = Mosaic<uint8_t>(8, 6, 0, rgb8);
+    const std::vector<unsigned char> out8 = Debayer(raw8, "GRAY8", 8, 6, pangolin::BAYER_METHOD_BILINEAR, tiles[0], 1, pangolin::WbGains(2.0f, 2.0f, 2.0f));
+    for(size_t i=0; i < out8.size() / 3; ++i) {
+        REQUIRE(int(out8[3*i+0]) == 255);
+        REQUIRE(int(out8[3*i+1]) == 200);
+        REQUIRE(int(out8[3*i+2]) == 100);
+    }
+}
+
+TEST_CASE("White balance saturates at the channel bit depth")
+{
+    const uint16_t rgb[3] = {4000, 3000, 100};
+    const std::vector<unsigned char> raw = Mosaic<uint16_t>(8, 6, 0, rgb);
+    for(auto method : {pangolin::BAYER_METHOD_BILINEAR, pangolin::BAYER_METHOD_EDGESENSE, pangolin::BAYER_METHOD_DOWNSAMPLE}) {
+        std::unique_ptr<pangolin::VideoInterface> src(new RawFrameVideo(raw, "GRAY16LE", 8, 6, 12));
+        pangolin::DebayerVideo video(src, {method}, tiles[0], pangolin::WbGains(2.0f, 2.0f, 2.0f), 1);
+        std::vector<unsigned char> out(video.SizeBytes());
+        REQUIRE(video.GrabNext(out.data()));
+        const uint16_t* px = reinterpret_cast<const uint16_t*>(out.data());
+        for(size_t i=0; i < out.size() / (3 * sizeof(uint16_t)); ++i) {
+            REQUIRE(px[3*i+0] == 4095);
+            REQUIRE(px[3*i+1] == 4095);
+            REQUIRE(px[3*i+2] == 200);
+        }
+    }
+}
+
+TEST_CASE("Bayer pattern starts below a metadata line")
+{
+    // 12 sensor rows below one metadata line
+    const size_t w = 16, h = 12;
+    std::vector<unsigned char> raw((h+1) * w);
+    std::mt19937 rng(3);
+    for(auto& b : raw) b = static_cast<unsigned char>(rng());
+    const std::vector<unsigned char> sensor(raw.begin() + w, raw.end());
+
+    for(auto method : {pangolin::BAYER_METHOD_BILINEAR, pangolin::BAYER_METHOD_EDGESENSE,
+                       pangolin::BAYER_METHOD_DOWNSAMPLE, pangolin::BAYER_METHOD_DOWNSAMPLE_MONO}) {
+        const std::vector<unsigned char> expected = Debayer(sensor, "GRAY8", w, h, method, tiles[1], 2);
+
+        RawFrameVideo* raw_video = new RawFrameVideo(raw, "GRAY8", w, h+1);
+        raw_video->SetHasMetadataLine(true);
+        std::unique_ptr<pangolin::VideoInterface> src(raw_video);
+        pangolin::DebayerVideo video(src, {method}, tiles[1], pangolin::WbGains(), 2);
+        std::vector<unsigned char> out(video.SizeBytes());
+        REQUIRE(video.GrabNext(out.data()));
+
+        // Rows below the last with input repeat it
+        const size_t row_bytes = video.Streams()[0].RowBytes();
+        REQUIRE(out.size() >= expected.size());
+        REQUIRE(std::memcmp(out.data(), expected.data(), expected.size()) == 0);
+        for(size_t p = expected.size(); p < out.size(); p += row_bytes) {
+            REQUIRE(std::memcmp(out.data() + p, out.data() + p - row_bytes, row_bytes) == 0);
+        }
+    }
+}
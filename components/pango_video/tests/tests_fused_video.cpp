@@ -0,0 +1,119 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <pangolin/video/drivers/fused.h>
+#include <pangolin/video/drivers/gamma.h>
+#include <pangolin/video/drivers/shift.h>
+#include <pangolin/video/drivers/transform.h>
+#include <pangolin/video/drivers/unpack.h>
+#include <pangolin/video/video.h>
+
+#include "raw_frame_video.h"
+
+namespace
+{
+
+typedef std::unique_ptr<pangolin::VideoInterface> VideoPtr;
+
+// unpack, gamma, flip and shift a 12 bit stream
+VideoPtr UnpackGammaFlipShift(pangolin::TransformOptions flip)
+{
+    VideoPtr video(new RawFrameVideo({"GRAY12"}, 38, 29));
+    video.reset(new pangolin::UnpackVideo(video, pangolin::PixelFormatFromString("GRAY16LE")));
+    video.reset(new pangolin::GammaVideo(video, {{0, 0.7f}}));
+    video.reset(new pangolin::TransformVideo(video, {flip}));
+    video.reset(new pangolin::ShiftVideo(video, {{0, 4}}, {}));
+    return video;
+}
+
+// Flip each of two colour streams differently
+VideoPtr FlipStreams()
+{
+    VideoPtr video(new RawFrameVideo({"RGB24", "GRAY16LE"}, 21, 17));
+    video.reset(new pangolin::TransformVideo(video, {pangolin::TransformOptions::FlipXY, pangolin::TransformOptions::FlipY}));
+    video.reset(new pangolin::TransformVideo(video, {pangolin::TransformOptions::FlipX, pangolin::TransformOptions::None}));
+    return video;
+}
+
+std::vector<unsigned char> Grab(pangolin::VideoInterface& video)
+{
+    std::vector<unsigned char> image(video.SizeBytes());
+    REQUIRE(video.GrabNext(image.data()));
+    return image;
+}
+
+}
+
+TEST_CASE("Fused filter chains match running each filter in turn")
+{
+    for(auto flip : {pangolin::TransformOptions::None, pangolin::TransformOptions::FlipX,
+                     pangolin::TransformOptions::FlipY, pangolin::TransformOptions::FlipXY}) {
+        VideoPtr expected = UnpackGammaFlipShift(flip);
+        const std::vector<unsigned char> expected_image = Grab(*expected);
+
+        for(size_t threads : {1, 3}) {
+            // Small bands so that each stream is split several times
+            VideoPtr chain = UnpackGammaFlipShift(flip);
+            pangolin::FusedVideo fused(chain, 256, threads);
+            REQUIRE(fused.NumFusedFilters() == 4);
+            REQUIRE(fused.Streams()[0].PixFormat().format == "GRAY8");
+            REQUIRE(Grab(fused) == expected_image);
+
+            pangolin::VideoFrameLease lease = fused.LeaseNext();
+            REQUIRE(std::memcmp(lease.get(), expected_image.data(), expected_image.size()) == 0);
+        }
+    }
+
+    VideoPtr expected = FlipStreams();
+    VideoPtr chain = FlipStreams();
+    pangolin::FusedVideo fused(chain, 100, 2);
+    REQUIRE(fused.NumFusedFilters() == 2);
+    REQUIRE(Grab(fused) == Grab(*expected));
+}
+
+TEST_CASE("Fusion stops at filters which don't work on rows")
+{
+    const auto rotated_below = []() {
+        VideoPtr video(new RawFrameVideo({"GRAY16LE"}, 12, 7));
+        video.reset(new pangolin::TransformVideo(video, {pangolin::TransformOptions::RotateCW}));
+        video.reset(new pangolin::ShiftVideo(video, {{0, 8}}, {}));
+        return video;
+    };
+    VideoPtr expected = rotated_below();
+    VideoPtr chain = rotated_below();
+    pangolin::FusedVideo fused(chain, 64, 1);
+    REQUIRE(fused.NumFusedFilters() == 1);
+    REQUIRE(Grab(fused) == Grab(*expected));
+
+    VideoPtr video(new RawFrameVideo({"GRAY8"}, 12, 7));
+    video.reset(new pangolin::TransformVideo(video, {pangolin::TransformOptions::RotateCCW}));
+    pangolin::FusedVideo passthrough(video, 64, 1);
+    REQUIRE(passthrough.NumFusedFilters() == 0);
+    REQUIRE(Grab(passthrough).size() == 12*7);
+}
+
+TEST_CASE("Frame properties are forwarded from the source")
+{
+    VideoPtr chain = UnpackGammaFlipShift(pangolin::TransformOptions::FlipX);
+    pangolin::FusedVideo fused(chain, 256, 2);
+    Grab(fused);
+    REQUIRE(fused.FrameProperties()["frame"].get<double>() == 1.0);
+    pangolin::VideoFrameLease lease = fused.LeaseNext();
+    REQUIRE(fused.FrameProperties()["frame"].get<double>() == 2.0);
+    REQUIRE(pangolin::GetVideoFrameProperties(&fused)["frame"].get<double>() == 2.0);
+}
+
+TEST_CASE("Fused chains open from URIs")
+{
+    VideoPtr video = pangolin::OpenVideo("fuse:[threads=2]//gamma:[gamma1=0.5]//flipy://test:[size=64x48,fmt=GRAY8]//");
+    REQUIRE(dynamic_cast<pangolin::FusedVideo*>(video.get())->NumFusedFilters() == 2);
+    Grab(*video);
+}
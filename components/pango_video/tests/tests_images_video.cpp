@@ -0,0 +1,109 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pangolin/image/image_io.h>
+#include <pangolin/utils/format_string.h>
+#include <pangolin/video/drivers/images.h>
+#include <pangolin/video/video.h>
+
+namespace
+{
+
+const size_t num_test_frames = 12;
+const size_t w = 23, h = 17;
+
+// Two channels of grey PGM images, each filled with a value unique to the file
+std::vector<std::string> WriteTestImages()
+{
+    std::vector<std::string> filenames;
+    for(const char* channel : {"a", "b"}) {
+        for(size_t i=0; i < num_test_frames; ++i) {
+            pangolin::ManagedImage<unsigned char> img(w, h);
+            img.Fill(static_cast<unsigned char>(10*i + (channel[0]-'a')));
+            const std::string filename = pangolin::FormatString("./test_images_video_%_%.pgm", channel, i < 10 ? "0" + std::to_string(i) : std::to_string(i));
+            pangolin::SaveImage(img, pangolin::PixelFormatFromString("GRAY8"), filename);
+            filenames.push_back(filename);
+        }
+    }
+    return filenames;
+}
+
+const std::string test_wildcard = "[./test_images_video_a_*.pgm,./test_images_video_b_*.pgm]";
+
+void CheckFrame(pangolin::VideoInterface& video, size_t i)
+{
+    std::vector<unsigned char> buffer(video.SizeBytes());
+    REQUIRE(video.GrabNext(buffer.data()));
+    REQUIRE(buffer.size() == 2*w*h);
+    REQUIRE(buffer[0] == 10*i);
+    REQUIRE(buffer[w*h-1] == 10*i);
+    REQUIRE(buffer[w*h] == 10*i + 1);
+    REQUIRE(buffer[2*w*h-1] == 10*i + 1);
+}
+
+}
+
+TEST_CASE("Prefetched frames match frames loaded on demand")
+{
+    const std::vector<std::string> filenames = WriteTestImages();
+
+    for(size_t prefetch : {0, 1, 3, 20}) {
+        pangolin::ImagesVideo video(test_wildcard, prefetch, 2);
+        REQUIRE(video.GetTotalFrames() == num_test_frames);
+        for(size_t i=0; i < num_test_frames; ++i) {
+            CheckFrame(video, i);
+        }
+        std::vector<unsigned char> buffer(video.SizeBytes());
+        REQUIRE(!video.GrabNext(buffer.data()));
+    }
+
+    for(const std::string& f : filenames) std::remove(f.c_str());
+}
+
+TEST_CASE("Seeking restarts read ahead")
+{
+    const std::vector<std::string> filenames = WriteTestImages();
+
+    {
+        pangolin::ImagesVideo video(test_wildcard, 4, 3);
+        CheckFrame(video, 0);
+        CheckFrame(video, 1);
+
+        video.Seek(9);
+        CheckFrame(video, 9);
+        CheckFrame(video, 10);
+
+        // Back to frames which were read ahead before
+        video.Seek(2);
+        CheckFrame(video, 2);
+
+        // Leasing shares the prefetched frames
+        video.Seek(5);
+        pangolin::VideoFrameLease lease = video.LeaseNext();
+        REQUIRE(lease);
+        REQUIRE(lease.get()[0] == 50);
+        REQUIRE(lease.get()[w*h] == 51);
+        CheckFrame(video, 6);
+
+        // Destroyed with decodes still queued
+        video.Seek(0);
+    }
+
+    {
+        std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo("images:[prefetch=2,threads=1]//" + test_wildcard);
+        video->Start();
+        for(size_t i=0; i < num_test_frames; ++i) {
+            CheckFrame(*video, i);
+        }
+    }
+
+    for(const std::string& f : filenames) std::remove(f.c_str());
+}
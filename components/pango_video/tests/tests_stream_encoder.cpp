@@ -0,0 +1,250 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <pangolin/image/image_io.h>
+#include <pangolin/log/packetstream_reader.h>
+#include <pangolin/utils/memstreambuf.h>
+#include <pangolin/video/stream_encoder_factory.h>
+#include <pangolin/video/video.h>
+#include <pangolin/video/video_output.h>
+
+namespace
+{
+
+// Compressible, but different for each seed
+pangolin::ManagedImage<unsigned char> TestImage(size_t w, size_t h, size_t bytes_pp, size_t pitch_padding, unsigned seed)
+{
+    pangolin::ManagedImage<unsigned char> img(w * bytes_pp, h, w * bytes_pp + pitch_padding);
+    std::mt19937 rng(seed);
+    for(size_t y=0; y < h; ++y) {
+        for(size_t x=0; x < w * bytes_pp; ++x) {
+            img(x,y) = static_cast<unsigned char>((x/8 + y/4 + seed) + (rng() % 4));
+        }
+    }
+    return img;
+}
+
+// Images passed to encoders are sized in pixels of the stream format
+pangolin::Image<unsigned char> StreamImage(const pangolin::ManagedImage<unsigned char>& img, size_t w)
+{
+    return pangolin::Image<unsigned char>(img.ptr, w, img.h, img.pitch);
+}
+
+void CheckEqual(const pangolin::Image<unsigned char>& expected, const pangolin::TypedImage& img)
+{
+    REQUIRE(img.IsValid());
+    REQUIRE(img.w == expected.w);
+    REQUIRE(img.h == expected.h);
+    for(size_t y=0; y < img.h; ++y) {
+        REQUIRE(std::memcmp(img.RowPtr(y), expected.RowPtr(y), img.pitch) == 0);
+    }
+}
+
+bool CodecAvailable(const std::string& encoder_spec)
+{
+    try {
+        pangolin::StreamEncoderFactory::I().GetEncoder(encoder_spec, pangolin::PixelFormatFromString("RGB24"));
+        return true;
+    } catch(const std::runtime_error&) {
+        WARN("Skipping " << encoder_spec << ", which this build doesn't support.");
+        return false;
+    }
+}
+
+}
+
+TEST_CASE("Stateful encoders round trip images across threads")
+{
+    const pangolin::PixelFormat fmt = pangolin::PixelFormatFromString("RGB24");
+    const size_t w = 640, h = 480;
+
+    for(const std::string spec : {"lzf1", "zstd1", "png"}) {
+        if(!CodecAvailable(spec)) continue;
+
+        for(size_t threads : {1, 4}) {
+            pangolin::ImageEncoderFunc encoder = pangolin::StreamEncoderFactory::I().GetEncoder(spec, fmt, threads);
+            pangolin::ImageDecoderFunc decoder = pangolin::StreamEncoderFactory::I().GetDecoder(spec, fmt, threads);
+
+            // Reuses codec contexts from frame to frame, including with padded rows
+            for(unsigned i=0; i < 3; ++i) {
+                const pangolin::ManagedImage<unsigned char> img = TestImage(w, h, 3, i==1 ? 13 : 0, i);
+                std::stringstream ss;
+                encoder(ss, StreamImage(img, w));
+                CheckEqual(StreamImage(img, w), decoder(ss));
+            }
+
+            // Several frames encoding at once each get their own context
+            std::vector<std::string> encoded(4);
+            std::vector<std::thread> workers;
+            for(unsigned i=0; i < encoded.size(); ++i) {
+                workers.emplace_back([&, i]() {
+                    const pangolin::ManagedImage<unsigned char> img = TestImage(w, h, 3, 0, 10+i);
+                    std::stringstream ss;
+                    encoder(ss, StreamImage(img, w));
+                    encoded[i] = ss.str();
+                });
+            }
+            for(auto& t : workers) t.join();
+
+            for(unsigned i=0; i < encoded.size(); ++i) {
+                const pangolin::ManagedImage<unsigned char> img = TestImage(w, h, 3, 0, 10+i);
+                std::stringstream ss(encoded[i]);
+                CheckEqual(StreamImage(img, w), decoder(ss));
+            }
+        }
+    }
+}
+
+TEST_CASE("LZ4 row blocks are read by single threaded decoders")
+{
+    if(!CodecAvailable("lzf1")) return;
+
+    const pangolin::PixelFormat fmt = pangolin::PixelFormatFromString("RGB24");
+    const pangolin::ManagedImage<unsigned char> img = TestImage(1024, 768, 3, 0, 7);
+    const pangolin::Image<unsigned char> bytes = StreamImage(img, 1024);
+
+    std::stringstream blocked, whole;
+    pangolin::StreamEncoderFactory::I().GetEncoder("lzf1", fmt, 4)(blocked, bytes);
+    pangolin::SaveImage(bytes, fmt, whole, pangolin::ImageFileTypeLz4);
+    REQUIRE(blocked.str() != whole.str());
+
+    CheckEqual(bytes, pangolin::LoadImage(blocked, pangolin::ImageFileTypeLz4));
+    CheckEqual(bytes, pangolin::LoadImage(whole, pangolin::ImageFileTypeLz4));
+}
+
+TEST_CASE("Pango recording with multithreaded codecs plays back")
+{
+    if(!CodecAvailable("lzf1")) return;
+
+    const std::string filename = "test_stream_encoder.pango";
+    const std::string test_uri = "test:[size=1024x768,fmt=RGB24]//";
+    std::vector<std::vector<unsigned char>> frames;
+    {
+        std::unique_ptr<pangolin::VideoInterface> src = pangolin::OpenVideo(test_uri);
+        std::unique_ptr<pangolin::VideoOutputInterface> out = pangolin::OpenVideoOutput(
+            "pango:[encoder=lzf1,codec_threads=3,encoder_frames=2]//" + filename
+        );
+        out->SetStreams(src->Streams(), test_uri);
+        src->Start();
+        for(size_t i=0; i < 5; ++i) {
+            frames.emplace_back(src->SizeBytes());
+            REQUIRE(src->GrabNext(frames.back().data()));
+            out->WriteStreams(frames.back().data());
+        }
+    }
+
+    {
+        std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo("pango:[codec_threads=2]//" + filename);
+        std::vector<unsigned char> buffer(video->SizeBytes());
+        for(const auto& frame : frames) {
+            REQUIRE(video->GrabNext(buffer.data()));
+            REQUIRE(buffer == frame);
+        }
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("Prefetched pango playback follows a recording which is still being written")
+{
+    if(!CodecAvailable("png")) return;
+
+    const std::string filename = "test_stream_encoder_growing.pango";
+    const std::string test_uri = "test:[size=64x48,fmt=RGB24]//";
+    const size_t num_frames = 10;
+    std::vector<std::vector<unsigned char>> frames;
+    {
+        std::unique_ptr<pangolin::VideoInterface> src = pangolin::OpenVideo(test_uri);
+        std::unique_ptr<pangolin::VideoOutputInterface> out = pangolin::OpenVideoOutput(
+            "pango:[encoder=png,checkpoint_frames=2]//" + filename
+        );
+        out->SetStreams(src->Streams(), test_uri);
+        src->Start();
+        for(size_t i=0; i < num_frames; ++i) {
+            frames.emplace_back(src->SizeBytes());
+            REQUIRE(src->GrabNext(frames.back().data()));
+            out->WriteStreams(frames.back().data());
+        }
+    }
+
+    std::string contents;
+    {
+        std::ifstream in(filename, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    uint64_t indexpos = 0;
+    std::memcpy(&indexpos, contents.data() + contents.size() - sizeof(uint64_t), sizeof(uint64_t));
+
+    // As if the writer is part way through frame 5
+    size_t cut_pos;
+    {
+        pangolin::PacketStreamReader reader(filename);
+        cut_pos = size_t(reader.Sources()[0].index[5].pos) + 10;
+    }
+    {
+        std::ofstream of(filename, std::ios::binary | std::ios::trunc);
+        of.write(contents.data(), cut_pos);
+    }
+
+    {
+        std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo("pango:[prefetch=3]//" + filename);
+        std::vector<unsigned char> buffer(video->SizeBytes());
+        for(size_t i=0; i < 5; ++i) {
+            REQUIRE(video->GrabNext(buffer.data()));
+            REQUIRE(buffer == frames[i]);
+        }
+        REQUIRE(!video->GrabNext(buffer.data()));
+
+        // The rest of the recording arrives
+        {
+            std::ofstream of(filename, std::ios::binary | std::ios::app);
+            of.write(contents.data() + cut_pos, indexpos - cut_pos);
+        }
+        for(size_t i=5; i < num_frames; ++i) {
+            REQUIRE(video->GrabNext(buffer.data()));
+            REQUIRE(buffer == frames[i]);
+        }
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("LZ4 images with impossible block counts are rejected")
+{
+    if(!CodecAvailable("lzf1")) return;
+
+    const pangolin::PixelFormat fmt = pangolin::PixelFormatFromString("RGB24");
+    const pangolin::ManagedImage<unsigned char> img = TestImage(1024, 768, 3, 0, 3);
+    std::stringstream blocked;
+    pangolin::StreamEncoderFactory::I().GetEncoder("lzf1", fmt, 4)(blocked, StreamImage(img, 1024));
+
+    // Mirrors lz4_image_header, whose compressed_size holds minus the number
+    // of row blocks
+#pragma pack(push, 1)
+    struct Header { char magic[3]; char fmt[16]; size_t w, h; int64_t compressed_size; };
+#pragma pack(pop)
+    const std::string encoded = blocked.str();
+    Header header;
+    std::memcpy(&header, encoded.data(), sizeof(header));
+    REQUIRE(header.compressed_size < 0);
+
+    for(int64_t num_blocks : {int64_t(769), int64_t(1) << 40}) {
+        header.compressed_size = -num_blocks;
+        std::string corrupt = encoded;
+        std::memcpy(&corrupt[0], &header, sizeof(header));
+        std::stringstream ss(corrupt);
+        REQUIRE_THROWS_AS(pangolin::LoadImage(ss, pangolin::ImageFileTypeLz4), std::runtime_error);
+    }
+}
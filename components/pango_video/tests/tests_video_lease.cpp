@@ -0,0 +1,210 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include <pangolin/video/drivers/shift.h>
+#include <pangolin/video/drivers/transform.h>
+#include <pangolin/video/video.h>
+#include <pangolin/video/video_frame_pool.h>
+#include <pangolin/video/video_input.h>
+
+namespace
+{
+
+// Lends frames from its own pair of buffers, counting those outstanding
+class LeasingVideo : public pangolin::VideoInterface, public pangolin::VideoLeaseInterface
+{
+public:
+    LeasingVideo(const char* fmt, size_t w, size_t h)
+        : outstanding(0), next_value(0)
+    {
+        const pangolin::PixelFormat pf = pangolin::PixelFormatFromString(fmt);
+        streams.push_back(pangolin::StreamInfo(pf, w, h, w * pf.bpp / 8, nullptr));
+        for(auto& b : buffers) b.resize(streams[0].SizeBytes());
+    }
+
+    size_t SizeBytes() const override { return streams[0].SizeBytes(); }
+    const std::vector<pangolin::StreamInfo>& Streams() const override { return streams; }
+    void Start() override {}
+    void Stop() override {}
+
+    bool GrabNext(unsigned char* image, bool) override
+    {
+        Fill(image);
+        return true;
+    }
+    bool GrabNewest(unsigned char* image, bool wait) override { return GrabNext(image, wait); }
+
+    pangolin::VideoFrameLease LeaseNext(bool) override
+    {
+        if(outstanding == buffers.size()) return nullptr;
+        unsigned char* b = buffers[outstanding++].data();
+        Fill(b);
+        return pangolin::VideoFrameLease(b, [this](unsigned char*){ --outstanding; });
+    }
+    pangolin::VideoFrameLease LeaseNewest(bool wait) override { return LeaseNext(wait); }
+
+    // Frames count up from a value which increments each frame
+    void Fill(unsigned char* image)
+    {
+        for(size_t i=0; i < SizeBytes(); ++i) image[i] = static_cast<unsigned char>(next_value + i);
+        ++next_value;
+    }
+
+    std::vector<unsigned char>& Buffer(size_t i) { return buffers[i]; }
+
+    size_t outstanding;
+
+private:
+    unsigned char next_value;
+    std::array<std::vector<unsigned char>, 2> buffers;
+    std::vector<pangolin::StreamInfo> streams;
+};
+
+}
+
+TEST_CASE("Frame pool recycles released buffers")
+{
+    pangolin::VideoFramePool pool(64);
+    unsigned char* first;
+    {
+        pangolin::VideoFrameLease a = pool.Lease();
+        pangolin::VideoFrameLease b = pool.Lease();
+        REQUIRE(a.get() != b.get());
+        first = a.get();
+    }
+    pangolin::VideoFrameLease c = pool.Lease();
+    pangolin::VideoFrameLease d = pool.Lease();
+    REQUIRE((c.get() == first || d.get() == first));
+
+    // Leases outlive the pool
+    pangolin::VideoFrameLease e;
+    {
+        pangolin::VideoFramePool short_lived(8);
+        e = short_lived.Lease();
+    }
+    e.get()[7] = 1;
+}
+
+TEST_CASE("Sources without leasing are grabbed into pooled buffers")
+{
+    std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo("test:[size=32x16,fmt=GRAY8]//");
+    REQUIRE(!pangolin::SupportsLeasing(*video));
+
+    pangolin::VideoFramePool pool(video->SizeBytes());
+    pangolin::VideoFrameLease lease = pangolin::LeaseNextFrame(*video, pool);
+    REQUIRE(lease);
+}
+
+TEST_CASE("Flips are applied in place on the source's buffer")
+{
+    const size_t w = 7, h = 5;
+    for(const char* fmt : {"GRAY8", "RGB24", "RGBA32"}) {
+        for(auto flip : {pangolin::TransformOptions::FlipX, pangolin::TransformOptions::FlipY, pangolin::TransformOptions::FlipXY}) {
+            std::unique_ptr<pangolin::VideoInterface> expected_src(new LeasingVideo(fmt, w, h));
+            pangolin::TransformVideo expected(expected_src, {flip});
+            std::vector<unsigned char> grabbed(expected.SizeBytes());
+            REQUIRE(expected.GrabNext(grabbed.data()));
+
+            LeasingVideo* source = new LeasingVideo(fmt, w, h);
+            std::unique_ptr<pangolin::VideoInterface> src(source);
+            pangolin::TransformVideo video(src, {flip});
+            REQUIRE(pangolin::SupportsLeasing(video));
+            {
+                pangolin::VideoFrameLease lease = video.LeaseNext();
+                REQUIRE(lease.get() == source->Buffer(0).data());
+                REQUIRE(std::memcmp(lease.get(), grabbed.data(), grabbed.size()) == 0);
+                REQUIRE(source->outstanding == 1);
+            }
+            REQUIRE(source->outstanding == 0);
+        }
+    }
+}
+
+TEST_CASE("Rotations and shared leases are transformed into new buffers")
+{
+    const size_t w = 6, h = 3;
+    std::unique_ptr<pangolin::VideoInterface> expected_src(new LeasingVideo("GRAY16LE", w, h));
+    pangolin::TransformVideo expected(expected_src, {pangolin::TransformOptions::RotateCW});
+    std::vector<unsigned char> grabbed(expected.SizeBytes());
+    REQUIRE(expected.GrabNext(grabbed.data()));
+
+    LeasingVideo* source = new LeasingVideo("GRAY16LE", w, h);
+    std::unique_ptr<pangolin::VideoInterface> src(source);
+    pangolin::TransformVideo video(src, {pangolin::TransformOptions::RotateCW});
+    {
+        pangolin::VideoFrameLease lease = video.LeaseNext();
+        REQUIRE(lease.get() != source->Buffer(0).data());
+        REQUIRE(std::memcmp(lease.get(), grabbed.data(), grabbed.size()) == 0);
+        // The source's buffer was released once transformed
+        REQUIRE(source->outstanding == 0);
+    }
+}
+
+TEST_CASE("Shifts to a smaller format are applied in place")
+{
+    const size_t w = 9, h = 4;
+    const std::map<size_t, int> shifts = {{0, 4}};
+
+    std::unique_ptr<pangolin::VideoInterface> expected_src(new LeasingVideo("GRAY16LE", w, h));
+    pangolin::ShiftVideo expected(expected_src, shifts, {});
+    std::vector<unsigned char> grabbed(expected.SizeBytes());
+    REQUIRE(expected.GrabNext(grabbed.data()));
+
+    LeasingVideo* source = new LeasingVideo("GRAY16LE", w, h);
+    std::unique_ptr<pangolin::VideoInterface> src(source);
+    pangolin::ShiftVideo video(src, shifts, {});
+    pangolin::VideoFrameLease lease = video.LeaseNext();
+    REQUIRE(lease.get() == source->Buffer(0).data());
+    REQUIRE(std::memcmp(lease.get(), grabbed.data(), grabbed.size()) == 0);
+}
+
+TEST_CASE("Thread video lends its queued buffers")
+{
+    std::unique_ptr<pangolin::VideoInterface> video = pangolin::OpenVideo("thread:[num_buffers=3]//test:[size=16x8,fmt=GRAY8]//");
+    pangolin::VideoLeaseInterface* leaser = dynamic_cast<pangolin::VideoLeaseInterface*>(video.get());
+    REQUIRE(leaser);
+    video->Start();
+
+    std::vector<pangolin::VideoFrameLease> leases;
+    while(leases.size() < 3) {
+        pangolin::VideoFrameLease lease = leaser->LeaseNext();
+        if(lease) leases.push_back(lease);
+    }
+    REQUIRE(leases[0].get() != leases[1].get());
+    REQUIRE(leases[1].get() != leases[2].get());
+
+    // Buffers return to the queue and are filled again
+    leases.clear();
+    pangolin::VideoFrameLease lease;
+    while(!lease) lease = leaser->LeaseNext();
+    video->Stop();
+}
+
+TEST_CASE("Copied frames are recycled without holding a lending video's buffers")
+{
+    pangolin::VideoInput video("thread:[num_buffers=3]//test:[size=16x8,fmt=GRAY8]//");
+    REQUIRE(video.Cast<pangolin::VideoLeaseInterface>());
+    video.Start();
+
+    // More frames than the thread video has buffers
+    std::vector<pangolin::VideoFrameLease> frames;
+    while(frames.size() < 10) {
+        pangolin::VideoFrameLease frame = video.LeaseNextCopy();
+        if(frame) frames.push_back(frame);
+    }
+
+    unsigned char* released = frames.back().get();
+    frames.pop_back();
+    pangolin::VideoFrameLease frame;
+    while(!frame) frame = video.LeaseNextCopy();
+    REQUIRE(frame.get() == released);
+    video.Stop();
+}
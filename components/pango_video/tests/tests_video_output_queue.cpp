@@ -0,0 +1,184 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#else
+#include <catch2/catch_test_macros.hpp>
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <pangolin/video/video_output_queue.h>
+
+namespace
+{
+
+// Outlives the output which the queue owns
+struct Gate
+{
+    Gate() : open(false), started(0), fail(false) {}
+
+    void Open()
+    {
+        std::lock_guard<std::mutex> l(lock);
+        open = true;
+        cond.notify_all();
+    }
+
+    void WaitForStarted(size_t n)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        cond.wait(l, [&](){ return started >= n; });
+    }
+
+    std::mutex lock;
+    std::condition_variable cond;
+    bool open;
+    size_t started;
+    bool fail;
+    std::vector<unsigned char> written;
+};
+
+// Records the first byte of each frame, waiting for the gate to open first
+class GatedOutput : public pangolin::VideoOutputInterface
+{
+public:
+    GatedOutput(Gate& gate) : gate(gate) {}
+
+    const std::vector<pangolin::StreamInfo>& Streams() const override { return streams; }
+
+    void SetStreams(const std::vector<pangolin::StreamInfo>& s, const std::string&, const picojson::value&) override
+    {
+        streams = s;
+    }
+
+    int WriteStreams(const unsigned char* data, const picojson::value&) override
+    {
+        std::unique_lock<std::mutex> l(gate.lock);
+        ++gate.started;
+        gate.cond.notify_all();
+        gate.cond.wait(l, [this](){ return gate.open; });
+        if(gate.fail) throw std::runtime_error("disk full");
+        gate.written.push_back(data[0]);
+        return 0;
+    }
+
+    bool IsPipe() const override { return false; }
+
+private:
+    Gate& gate;
+    std::vector<pangolin::StreamInfo> streams;
+};
+
+std::unique_ptr<pangolin::VideoOutputInterface> MakeOutput(Gate& gate)
+{
+    return std::unique_ptr<pangolin::VideoOutputInterface>(new GatedOutput(gate));
+}
+
+std::vector<pangolin::StreamInfo> GrayStreams(size_t w, size_t h)
+{
+    const pangolin::PixelFormat pf = pangolin::PixelFormatFromString("GRAY8");
+    return {pangolin::StreamInfo(pf, w, h, w, nullptr)};
+}
+
+// Write frame 0 and wait for the writer to be stuck on it, then offer frames
+// 1 to n with the writer unable to keep up.
+std::vector<unsigned char> WriteBehindStalledWriter(pangolin::VideoOutputQueue::Policy policy, size_t max_frames, size_t n, std::vector<int>& results, pangolin::VideoOutputQueue::Stats& stats)
+{
+    Gate gate;
+    pangolin::VideoOutputQueue queue(MakeOutput(gate), max_frames, policy);
+    queue.SetStreams(GrayStreams(4, 3));
+
+    std::vector<unsigned char> frame(12);
+    REQUIRE(queue.WriteStreams(frame.data()) == 0);
+    gate.WaitForStarted(1);
+
+    for(size_t i=1; i <= n; ++i) {
+        frame[0] = static_cast<unsigned char>(i);
+        results.push_back(queue.WriteStreams(frame.data()));
+    }
+    stats = queue.GetStats();
+
+    gate.Open();
+    queue.Flush();
+    REQUIRE(queue.GetStats().queued == 0);
+    REQUIRE(queue.GetStats().written == gate.written.size());
+    return gate.written;
+}
+
+}
+
+TEST_CASE("Queued frames are written in order")
+{
+    Gate gate;
+    gate.Open();
+    {
+        pangolin::VideoOutputQueue queue(MakeOutput(gate), 2);
+        queue.SetStreams(GrayStreams(8, 2));
+        REQUIRE(queue.Streams().size() == 1);
+
+        std::vector<unsigned char> frame(16);
+        for(int i=0; i < 50; ++i) {
+            frame[0] = static_cast<unsigned char>(i);
+            REQUIRE(queue.WriteStreams(frame.data()) == 0);
+        }
+        queue.Flush();
+
+        const pangolin::VideoOutputQueue::Stats stats = queue.GetStats();
+        REQUIRE(stats.written == 50);
+        REQUIRE(stats.dropped == 0);
+        REQUIRE(stats.queued == 0);
+        REQUIRE(gate.written.size() == 50);
+        for(int i=0; i < 50; ++i) REQUIRE(gate.written[i] == i);
+
+        // Destruction writes anything left
+        frame[0] = 99;
+        queue.WriteStreams(frame.data());
+    }
+    REQUIRE(gate.written.size() == 51);
+    REQUIRE(gate.written.back() == 99);
+}
+
+TEST_CASE("A full queue drops the newest frames")
+{
+    std::vector<int> results;
+    pangolin::VideoOutputQueue::Stats stats;
+    const std::vector<unsigned char> written = WriteBehindStalledWriter(pangolin::VideoOutputQueue::Policy::DropNewest, 2, 5, results, stats);
+    REQUIRE(results == std::vector<int>({0, 0, -1, -1, -1}));
+    REQUIRE(stats.queued == 2);
+    REQUIRE(stats.dropped == 3);
+    REQUIRE(stats.written == 0);
+    REQUIRE(written == std::vector<unsigned char>({0, 1, 2}));
+}
+
+TEST_CASE("A full queue drops the oldest frames")
+{
+    std::vector<int> results;
+    pangolin::VideoOutputQueue::Stats stats;
+    const std::vector<unsigned char> written = WriteBehindStalledWriter(pangolin::VideoOutputQueue::Policy::DropOldest, 2, 5, results, stats);
+    REQUIRE(results == std::vector<int>({0, 0, 0, 0, 0}));
+    REQUIRE(stats.queued == 2);
+    REQUIRE(stats.dropped == 3);
+    REQUIRE(written == std::vector<unsigned char>({0, 4, 5}));
+}
+
+TEST_CASE("Errors from the writer are rethrown to the caller")
+{
+    Gate gate;
+    gate.fail = true;
+    gate.Open();
+    pangolin::VideoOutputQueue queue(MakeOutput(gate), 4);
+    queue.SetStreams(GrayStreams(4, 1));
+
+    std::vector<unsigned char> frame(4);
+    REQUIRE(queue.WriteStreams(frame.data()) == 0);
+    REQUIRE_THROWS_AS(queue.Flush(), std::runtime_error);
+
+    // Reported once
+    gate.fail = false;
+    REQUIRE(queue.WriteStreams(frame.data()) == 0);
+    queue.Flush();
+    REQUIRE(queue.GetStats().written == 1);
+}
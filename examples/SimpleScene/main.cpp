@@ -1,6 +1,7 @@
 #include <pangolin/display/display.h>
 #include <pangolin/display/view.h>
 #include <pangolin/scene/axis.h>
+#include <pangolin/scene/compiled_scene.h>
 #include <pangolin/scene/scenehandler.h>
 
 int main( int /*argc*/, char** /*argv*/ )
@@ -22,6 +23,9 @@ int main( int /*argc*/, char** /*argv*/ )
         tree.Add(axis_i);
     }
 
+    // Flattened copy of tree for drawing. Picking still uses tree directly.
+    pangolin::CompiledScene scene(tree);
+
     // Create Interactive View in window
     pangolin::SceneHandler handler(tree, s_cam);
     pangolin::View& d_cam = pangolin::CreateDisplay()
@@ -30,7 +34,7 @@ int main( int /*argc*/, char** /*argv*/ )
 
     d_cam.SetDrawFunction([&](pangolin::View& view){
         view.Activate(s_cam);
-        tree.Render();
+        scene.Render();
     });
 
     while( !pangolin::ShouldQuit() )